@@ -0,0 +1,314 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+
+#include <vector>
+#include <algorithm>
+
+// first-fit allocator of ranges [offset, offset + size) within a buffer of the given capacity (in arbitrary units)
+class RangeAllocator {
+public:
+    RangeAllocator(size_t capacity = 0) : capacity(capacity)
+    {
+        if (capacity > 0)
+            freeRanges.push_back({ 0, capacity });
+    }
+
+    // allocates size units starting at a multiple of alignment (does not need to be a power of 2).
+    // Returns false if there is no free range large enough.
+    bool Allocate(size_t size, size_t alignment, size_t& offset)
+    {
+        for (size_t i = 0; i < freeRanges.size(); i++)
+        {
+            Range& r = freeRanges[i];
+            size_t aligned = (r.offset + alignment - 1) / alignment * alignment;
+            if (aligned + size > r.offset + r.size)
+                continue;
+
+            // split the free range into the (optional) padding in front and the rest behind the allocation
+            size_t end = r.offset + r.size;
+            size_t padding = aligned - r.offset;
+            if (padding > 0)
+            {
+                r.size = padding;
+                if (aligned + size < end)
+                    freeRanges.insert(freeRanges.begin() + i + 1, { aligned + size, end - aligned - size });
+            }
+            else if (aligned + size < end)
+                r = { aligned + size, end - aligned - size };
+            else
+                freeRanges.erase(freeRanges.begin() + i);
+
+            offset = aligned;
+            used += size;
+            return true;
+        }
+        return false;
+    }
+
+    // returns a range to the allocator (merged with its free neighbours)
+    void Free(size_t offset, size_t size)
+    {
+        auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range& r, size_t o) { return r.offset < o; });
+        it = freeRanges.insert(it, { offset, size });
+        used -= size;
+        // merge with the next and the previous range
+        if (it + 1 != freeRanges.end() && it->offset + it->size == (it + 1)->offset)
+        {
+            it->size += (it + 1)->size;
+            freeRanges.erase(it + 1);
+        }
+        if (it != freeRanges.begin() && (it - 1)->offset + (it - 1)->size == it->offset)
+        {
+            (it - 1)->size += it->size;
+            freeRanges.erase(it);
+        }
+    }
+
+    // enlarges the managed range to newCapacity
+    void Grow(size_t newCapacity)
+    {
+        if (!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().size == capacity)
+            freeRanges.back().size += newCapacity - capacity;
+        else
+            freeRanges.push_back({ capacity, newCapacity - capacity });
+        capacity = newCapacity;
+    }
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+
+private:
+    struct Range { size_t offset, size; };
+    std::vector<Range> freeRanges; // sorted by offset
+    size_t capacity;
+    size_t used = 0;
+};
+
+// a single vertex attribute (for glVertexAttribFormat)
+struct VertexAttribute {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLuint offset;
+};
+
+// memory layout of interleaved vertices
+struct VertexFormat {
+    std::vector<VertexAttribute> attributes;
+    GLsizei stride;
+};
+
+// location of the per draw index that is fed by the arena (instanced attribute, see DrawList)
+const GLuint DRAW_ID_LOCATION = 5;
+
+// One large vertex buffer and one large index buffer that hold the geometry of all meshes, plus one VAO per vertex format.
+// Meshes are just ranges in these buffers (base vertex + first index), which allows drawing many of them without
+// switching any state (see glMultiDrawElementsIndirect in DrawList). The buffers grow when they run full.
+class GeometryArena {
+public:
+    GLBuffer VBO, EBO;
+
+    // registers a vertex format and returns its id (to be used with VertexArray/AllocateVertices)
+    unsigned int RegisterFormat(const VertexFormat& format)
+    {
+        init();
+        GLVertexArray vao = createVertexArray();
+        glState().BindVertexArray(vao);
+        for (const VertexAttribute& a : format.attributes)
+        {
+            glEnableVertexAttribArray(a.location);
+            if (a.type == GL_INT || a.type == GL_UNSIGNED_INT)
+                glVertexAttribIFormat(a.location, a.size, a.type, a.offset);
+            else
+                glVertexAttribFormat(a.location, a.size, a.type, GL_FALSE, a.offset);
+            glVertexAttribBinding(a.location, 0);
+        }
+        glBindVertexBuffer(0, VBO, 0, format.stride);
+        // per draw index (advances once per instance, so baseInstance selects it)
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        glVertexAttribIFormat(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0);
+        glVertexAttribBinding(DRAW_ID_LOCATION, 1);
+        glVertexBindingDivisor(1, 1);
+        glBindVertexBuffer(1, drawIdBuffer, 0, sizeof(GLuint));
+        glState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glState().BindVertexArray(0);
+
+        formats.push_back(format);
+        vaos.push_back(std::move(vao));
+        return (unsigned int)vaos.size() - 1;
+    }
+
+    unsigned int VertexArray(unsigned int format) const { return vaos[format]; }
+
+    // copies count vertices (of the given format) into the arena and returns their base vertex
+    GLint AllocateVertices(unsigned int format, const void* data, size_t count)
+    {
+        size_t offset = allocateVertexRange(format, count);
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, count * formats[format].stride, data);
+        return (GLint)(offset / formats[format].stride);
+    }
+
+    // like AllocateVertices, but the vertices are copied on the GPU from a (staging) buffer at sourceOffset
+    GLint AllocateVertices(unsigned int format, GLuint source, GLintptr sourceOffset, size_t count)
+    {
+        size_t offset = allocateVertexRange(format, count);
+        glState().BindBuffer(GL_COPY_READ_BUFFER, source);
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, offset, count * formats[format].stride);
+        return (GLint)(offset / formats[format].stride);
+    }
+
+    // copies count indices into the arena and returns the position of the first one
+    GLuint AllocateIndices(const unsigned int* data, size_t count)
+    {
+        size_t offset = allocateIndexRange(count);
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset * sizeof(unsigned int), count * sizeof(unsigned int), data);
+        return (GLuint)offset;
+    }
+
+    // like AllocateIndices, but the indices are copied on the GPU from a (staging) buffer at sourceOffset
+    GLuint AllocateIndices(GLuint source, GLintptr sourceOffset, size_t count)
+    {
+        size_t offset = allocateIndexRange(count);
+        glState().BindBuffer(GL_COPY_READ_BUFFER, source);
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, offset * sizeof(unsigned int), count * sizeof(unsigned int));
+        return (GLuint)offset;
+    }
+
+    void FreeVertices(unsigned int format, GLint baseVertex, size_t count)
+    {
+        vertexRanges.Free(baseVertex * formats[format].stride, count * formats[format].stride);
+    }
+
+    void FreeIndices(GLuint firstIndex, size_t count) { indexRanges.Free(firstIndex, count); }
+
+    // makes sure the per draw indices 0..count-1 exist
+    void EnsureDrawIds(size_t count)
+    {
+        if (count <= drawIdCount)
+            return;
+        drawIdCount = std::max(count, drawIdCount * 2);
+        std::vector<GLuint> ids(drawIdCount);
+        for (size_t i = 0; i < drawIdCount; i++)
+            ids[i] = (GLuint)i;
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, drawIdBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    }
+
+    size_t VertexBytesUsed() const { return vertexRanges.Used(); }
+    size_t VertexBytesCapacity() const { return vertexRanges.Capacity(); }
+    size_t IndicesUsed() const { return indexRanges.Used(); }
+    size_t IndicesCapacity() const { return indexRanges.Capacity(); }
+    // how often the buffers had to grow (each growth copies the whole buffer)
+    unsigned int VertexGrowths() const { return vertexGrowths; }
+    unsigned int IndexGrowths() const { return indexGrowths; }
+
+private:
+    std::vector<VertexFormat> formats;
+    std::vector<GLVertexArray> vaos;
+    RangeAllocator vertexRanges, indexRanges;
+    GLBuffer drawIdBuffer;
+    size_t drawIdCount = 0;
+    unsigned int vertexGrowths = 0, indexGrowths = 0;
+
+    static const size_t INITIAL_VERTEX_BYTES = 16 * 1024 * 1024;
+    static const size_t INITIAL_INDICES = 4 * 1024 * 1024;
+
+    void init()
+    {
+        if (VBO)
+            return;
+        VBO = createBuffer();
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_VERTEX_BYTES, NULL, GL_STATIC_DRAW);
+        vertexRanges = RangeAllocator(INITIAL_VERTEX_BYTES);
+        EBO = createBuffer();
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, INITIAL_INDICES * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        indexRanges = RangeAllocator(INITIAL_INDICES);
+        drawIdBuffer = createBuffer();
+        EnsureDrawIds(1024);
+    }
+
+    // replaces the buffer by a larger one and copies the old content over (the old one is deleted)
+    static void growBuffer(GLBuffer& buffer, size_t oldSize, size_t newSize)
+    {
+        GLBuffer newBuffer = createBuffer();
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+        glState().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+        buffer = std::move(newBuffer);
+    }
+
+    // reserves the range of count vertices (growing the buffer if needed) and returns its byte offset
+    size_t allocateVertexRange(unsigned int format, size_t count)
+    {
+        size_t stride = formats[format].stride;
+        size_t offset;
+        if (!vertexRanges.Allocate(count * stride, stride, offset))
+        {
+            growVertices(vertexRanges.Capacity() + count * stride + stride);
+            vertexRanges.Allocate(count * stride, stride, offset);
+        }
+        return offset;
+    }
+
+    size_t allocateIndexRange(size_t count)
+    {
+        size_t offset;
+        if (!indexRanges.Allocate(count, 1, offset))
+        {
+            growIndices(indexRanges.Capacity() + count);
+            indexRanges.Allocate(count, 1, offset);
+        }
+        return offset;
+    }
+
+    void growVertices(size_t minCapacity)
+    {
+        size_t capacity = std::max(minCapacity, vertexRanges.Capacity() * 2);
+        vertexGrowths++;
+        growBuffer(VBO, vertexRanges.Capacity(), capacity);
+        vertexRanges.Grow(capacity);
+        updateVertexArrays();
+    }
+
+    void growIndices(size_t minCapacity)
+    {
+        size_t capacity = std::max(minCapacity, indexRanges.Capacity() * 2);
+        indexGrowths++;
+        growBuffer(EBO, indexRanges.Capacity() * sizeof(unsigned int), capacity * sizeof(unsigned int));
+        indexRanges.Grow(capacity);
+        updateVertexArrays();
+    }
+
+    // points all VAOs to the current buffers
+    void updateVertexArrays()
+    {
+        for (size_t i = 0; i < vaos.size(); i++)
+        {
+            glState().BindVertexArray(vaos[i]);
+            glBindVertexBuffer(0, VBO, 0, formats[i].stride);
+            glState().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        }
+        glState().BindVertexArray(0);
+    }
+};
+
+// the (global) geometry arena, created on first use (needs a current OpenGL context)
+GeometryArena& geometryArena()
+{
+    static GeometryArena arena;
+    return arena;
+}
+
+#endif
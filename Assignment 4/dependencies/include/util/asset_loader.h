@@ -0,0 +1,285 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/mesh.h>
+#include <util/model.h>
+#include <util/upload_thread.h>
+#include <util/parallel.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <chrono> // for timing
+
+// default amount of data (geometry and texels) created on the GPU per frame by AsyncLoader::Update
+const size_t DEFAULT_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+// Loads assets in the background. The CPU part of a request (reading and decoding files, importing models, building
+// levels of detail, ...) runs on worker threads. The OpenGL objects are created on the main thread in Update, which
+// uploads no more than a budget of bytes per frame (but at least one piece), or, if the upload thread is running (see
+// util/upload_thread.h), by the workers queueing the uploads there; the main thread then only publishes the objects.
+// Until its upload is complete, users of an asset see a placeholder; the finished asset is swapped in at once (see
+// AssetRegistry::Replace in util/assets.h).
+class AsyncLoader {
+public:
+    // uploads (the next part of) a loaded asset, subtracts the uploaded bytes from budget and returns true once the
+    // asset is complete. It is called again in the next Update if it returns false (also to wait for an UploadTicket).
+    typedef std::function<bool(size_t& budget)> UploadStep;
+    // the CPU part of a request, runs on a worker thread (no OpenGL calls!) and returns the upload step
+    typedef std::function<UploadStep()> LoadJob;
+
+    struct Stats {
+        unsigned int queued = 0;    // requests waiting for a worker
+        unsigned int loading = 0;   // requests running on a worker
+        unsigned int uploading = 0; // requests waiting for (or in) their upload
+        unsigned int completed = 0; // since the start
+        size_t bytesUploaded = 0;   // in the last Update
+        // time from the request to the swap (of the completed requests)
+        float lastLatencyMs = 0.0f;
+        float averageLatencyMs = 0.0f;
+        float maxLatencyMs = 0.0f;
+    };
+
+    ~AsyncLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    // queues a request (name is only used for messages). The workers are started with the first request.
+    void Request(const std::string& name, LoadJob job)
+    {
+        if (workers.empty())
+        {
+            unsigned int cores = std::thread::hardware_concurrency(); // (0 if unknown)
+            unsigned int n = std::min(4u, cores > 2 ? cores - 1 : 1u);   // leave a core to the render loop
+            for (unsigned int i = 0; i < n; i++)
+                workers.emplace_back([this] { work(); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({ name, std::move(job), Clock::now() });
+        }
+        wakeUp.notify_one();
+    }
+
+    // uploads the loaded requests (call once per frame on the thread of the OpenGL context)
+    void Update(size_t budgetBytes = DEFAULT_UPLOAD_BUDGET)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Upload& upload : loaded)
+                uploads.push_back(std::move(upload));
+            loaded.clear();
+        }
+
+        uploadThread().Update();
+
+        // (a step that waits for the upload thread returns false without using the budget, the next ones still run)
+        size_t budget = budgetBytes;
+        for (auto it = uploads.begin(); it != uploads.end() && budget > 0;)
+        {
+            if (!it->step(budget))
+            {
+                ++it; // out of budget or not uploaded yet, continue in the next frame
+                continue;
+            }
+            float latency = std::chrono::duration<float, std::milli>(Clock::now() - it->requested).count();
+            it = uploads.erase(it);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.completed++;
+            stats.lastLatencyMs = latency;
+            stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency);
+            stats.averageLatencyMs += (latency - stats.averageLatencyMs) / stats.completed;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.bytesUploaded = budgetBytes - budget;
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats s = stats;
+        s.queued = (unsigned int)requests.size();
+        s.loading = loading;
+        s.uploading = (unsigned int)(loaded.size() + uploads.size());
+        return s;
+    }
+
+    // true if there are no requests in flight
+    bool Idle() const
+    {
+        Stats s = GetStats();
+        return s.queued + s.loading + s.uploading == 0;
+    }
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+    struct Job {
+        std::string name;
+        LoadJob load;
+        Clock::time_point requested;
+    };
+    struct Upload {
+        std::string name;
+        UploadStep step;
+        Clock::time_point requested;
+    };
+
+    mutable std::mutex mutex; // guards everything below but uploads (main thread only)
+    std::condition_variable wakeUp;
+    std::deque<Job> requests;
+    std::vector<Upload> loaded;
+    unsigned int loading = 0;
+    bool stopping = false;
+    Stats stats;
+    std::deque<Upload> uploads;
+    std::vector<std::thread> workers;
+
+    void work()
+    {
+        parallelWorker() = true; // (the parallel parts of the loads run inline, the workers already use the cores)
+        for (;;)
+        {
+            Job request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+                request = std::move(requests.front());
+                requests.pop_front();
+                loading++;
+            }
+
+            UploadStep step;
+            try
+            {
+                step = request.load();
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << "AsyncLoader: loading " << request.name << " failed: " << e.what() << std::endl;
+            }
+            if (!step)
+                step = [](size_t&) { return true; }; // nothing to upload, the placeholder stays
+
+            std::lock_guard<std::mutex> lock(mutex);
+            loading--;
+            loaded.push_back({ request.name, std::move(step), request.requested });
+        }
+    }
+};
+
+// the (global) loader used by the AssetManager(s)
+AsyncLoader& asyncLoader()
+{
+    static AsyncLoader loader;
+    return loader;
+}
+
+// placeholders (created on first use, need a current OpenGL context)
+// ------------------------------------------------------------------------
+// an 8x8 grey checker board (2D texture)
+GLuint checkerTexture()
+{
+    static GLuint texture = 0;
+    if (texture == 0)
+    {
+        unsigned char texels[8 * 8 * 3];
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+                for (int c = 0; c < 3; c++)
+                    texels[(y * 8 + x) * 3 + c] = ((x + y) & 1) ? 200 : 55;
+        glGenTextures(1, &texture);
+        glState().BindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 8, 8, 0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    return texture;
+}
+
+// a grey cube map (one texel per face)
+GLuint placeholderCubemap()
+{
+    static GLuint texture = 0;
+    if (texture == 0)
+    {
+        unsigned char grey[3] = { 128, 128, 128 };
+        glGenTextures(1, &texture);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (unsigned int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    return texture;
+}
+
+// the mesh data of a sphere with radius 1 around the origin (uv sphere with tangents along u)
+MeshData unitSphereData(unsigned int segments = 32, unsigned int rings = 16)
+{
+    const float PI = 3.14159265359f;
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    for (unsigned int y = 0; y <= rings; y++)
+    {
+        for (unsigned int x = 0; x <= segments; x++)
+        {
+            float u = (float)x / segments, v = (float)y / rings;
+            float phi = u * 2.0f * PI, theta = v * PI;
+            Vertex vertex;
+            vertex.Position = glm::vec3(std::cos(phi) * std::sin(theta), std::cos(theta), std::sin(phi) * std::sin(theta));
+            vertex.Normal = vertex.Position;
+            vertex.TexCoords = glm::vec2(u, v);
+            vertex.Tangent = glm::vec3(-std::sin(phi), 0.0f, std::cos(phi));
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+            vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int y = 0; y < rings; y++)
+    {
+        for (unsigned int x = 0; x < segments; x++)
+        {
+            unsigned int i0 = y * (segments + 1) + x, i1 = i0 + segments + 1;
+            indices.insert(indices.end(), { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 });
+        }
+    }
+    return MeshData(std::move(vertices), std::move(indices));
+}
+
+// a unit sphere model
+Model& placeholderModel()
+{
+    geometryArena(); // (created first so it outlives the model, see modelRegistry)
+    static Model model;
+    if (model.meshes.empty())
+    {
+        model.AddMesh(unitSphereData());
+        model.UpdateBounds();
+    }
+    return model;
+}
+
+#endif
@@ -0,0 +1,489 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <util/hash.h>
+#include <util/lz4.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// An asset pack bundles the files of a group (models already converted to the layout of MeshData, textures, shaders, ...)
+// in a single file that is memory mapped at runtime: one open for all assets, and entries that are stored uncompressed
+// are used right from the mapping (no copy). Packs are written by the packer tool (src/tools/packer) and mounted with
+// FileSystem::mount (see util/filesystem.h).
+// Layout (little endian):
+//   PackHeader
+//   blobs of the entries, each aligned to header.alignment bytes
+//   table of contents: header.entryCount PackEntry structs, sorted by name hash (binary search)
+//   names: the names of the entries (not zero terminated), only used for listing and to detect collisions
+const uint32_t PACK_MAGIC = 0x4b415041; // "APAK"
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_ALIGNMENT = 64;
+
+enum PackCodec : uint32_t {
+    PACK_RAW = 0,
+    PACK_LZ4 = 1 // one LZ4 block (see util/lz4.h)
+};
+
+enum PackEntryType : uint32_t {
+    PACK_FILE = 0, // a copy of a file
+    PACK_MODEL = 1 // a converted model (see writeModelData in util/model.h)
+};
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct PackEntry {
+    uint64_t nameHash;   // hashName of the normalized name
+    uint64_t offset;     // of the blob in the pack
+    uint64_t storedSize; // size of the blob in the pack
+    uint64_t rawSize;    // size after decompression
+    uint32_t codec;
+    uint32_t type;
+    uint32_t nameOffset; // in the names
+    uint32_t nameLength;
+};
+
+static_assert(sizeof(PackHeader) == 40 && sizeof(PackEntry) == 48, "pack structs must not be padded");
+
+// the name of a path in a pack: '\' becomes '/', "." and "dir/.." are removed and leading ".." are dropped, so
+// "../resources/objects/../textures/wood.png" and "resources\textures\wood.png" find the same entry
+std::string normalizePackName(std::string_view path)
+{
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    for (size_t i = 0; i <= path.size(); i++)
+    {
+        if (i < path.size() && path[i] != '/' && path[i] != '\\')
+            continue;
+        std::string_view part = path.substr(start, i - start);
+        start = i + 1;
+        if (part.empty() || part == ".")
+            continue;
+        if (part == ".." && !parts.empty() && parts.back() != "..")
+            parts.pop_back();
+        else
+            parts.push_back(part);
+    }
+    std::string name;
+    for (std::string_view part : parts)
+    {
+        if (part == "..")
+            continue;
+        if (!name.empty())
+            name += '/';
+        name += part;
+    }
+    return name;
+}
+
+// the contents of a file: either points into a memory mapped pack (zero copy) or into storage
+struct FileData {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    uint32_t type = PACK_FILE;
+    std::vector<unsigned char> storage;
+
+    explicit operator bool() const { return data != nullptr; }
+    bool ZeroCopy() const { return data != nullptr && storage.empty() && size > 0; }
+    std::string_view Text() const { return std::string_view((const char*)data, size); }
+};
+
+// a read only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+            data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        size = (size_t)fileSize.QuadPart;
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+        size = (size_t)info.st_size;
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+            data = (const unsigned char*)mapped;
+#endif
+        if (data == nullptr)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void*)data, size);
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+// a mounted (memory mapped) pack. Reading is thread safe (the pack is never modified).
+class AssetPack {
+public:
+    bool Open(const std::string& packPath)
+    {
+        path = packPath;
+        if (!file.Open(packPath))
+            return false;
+        const unsigned char* base = file.Data();
+        size_t size = file.Size();
+        if (size < sizeof(PackHeader))
+            return fail("too small");
+        std::memcpy(&header, base, sizeof(PackHeader));
+        if (header.magic != PACK_MAGIC || header.version != PACK_VERSION)
+            return fail("not a pack (or of another version)");
+        if (header.tocOffset % alignof(PackEntry) != 0 || header.tocOffset > size ||
+            (size - header.tocOffset) / sizeof(PackEntry) < header.entryCount ||
+            header.namesOffset > size || size - header.namesOffset < header.namesSize)
+            return fail("corrupt table of contents");
+        // (the mapping is page aligned and so is the table of contents in it)
+        toc = (const PackEntry*)(base + header.tocOffset);
+        names = (const char*)(base + header.namesOffset);
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            const PackEntry& entry = toc[i];
+            if (entry.offset > size || size - entry.offset < entry.storedSize ||
+                (uint64_t)entry.nameOffset + entry.nameLength > header.namesSize ||
+                (i > 0 && toc[i - 1].nameHash >= entry.nameHash))
+                return fail("corrupt entry");
+        }
+        return true;
+    }
+
+    const std::string& Path() const { return path; }
+    uint32_t NumEntries() const { return toc ? header.entryCount : 0; }
+    const PackEntry& Entry(uint32_t i) const { return toc[i]; }
+    std::string_view Name(const PackEntry& entry) const { return std::string_view(names + entry.nameOffset, entry.nameLength); }
+
+    // the entry of a (normalized) name hash, nullptr if it isn't in the pack
+    const PackEntry* Find(uint64_t nameHash) const
+    {
+        const PackEntry* end = toc + NumEntries();
+        const PackEntry* entry = std::lower_bound(toc, end, nameHash,
+            [](const PackEntry& e, uint64_t hash) { return e.nameHash < hash; });
+        return entry != end && entry->nameHash == nameHash ? entry : nullptr;
+    }
+
+    const PackEntry* Find(std::string_view name) const
+    {
+        return Find(hashName(normalizePackName(name)));
+    }
+
+    // the contents of an entry: uncompressed entries point into the mapping, compressed ones are decompressed into
+    // out.storage
+    bool Read(const PackEntry& entry, FileData& out) const
+    {
+        const unsigned char* blob = file.Data() + entry.offset;
+        out.type = entry.type;
+        out.storage.clear();
+        if (entry.codec == PACK_RAW)
+        {
+            out.data = blob;
+            out.size = (size_t)entry.storedSize;
+            return true;
+        }
+        if (entry.codec == PACK_LZ4)
+        {
+            out.storage.resize((size_t)entry.rawSize);
+            if (lz4Decompress(blob, (size_t)entry.storedSize, out.storage.data(), out.storage.size()))
+            {
+                out.data = out.storage.data();
+                out.size = out.storage.size();
+                return true;
+            }
+        }
+        std::cout << "AssetPack: failed to read " << Name(entry) << " from " << path << std::endl;
+        out.data = nullptr;
+        out.size = 0;
+        return false;
+    }
+
+private:
+    std::string path;
+    MappedFile file;
+    PackHeader header = {};
+    const PackEntry* toc = nullptr;
+    const char* names = nullptr;
+
+    bool fail(const char* reason)
+    {
+        std::cout << "AssetPack: " << path << ": " << reason << std::endl;
+        file.Close();
+        toc = nullptr;
+        return false;
+    }
+};
+
+// writes a pack (used by the packer tool): Add the entries, then Finish
+class PackWriter {
+public:
+    // statistics
+    size_t bytesIn = 0, bytesOut = 0;
+
+    bool Open(const std::string& packPath)
+    {
+        path = packPath;
+        file.open(packPath, std::ios::binary | std::ios::trunc);
+        PackHeader header = {};
+        file.write((const char*)&header, sizeof(header)); // (written again by Finish)
+        offset = sizeof(header);
+        return (bool)file;
+    }
+
+    // adds an entry. With compress, the data is stored LZ4 compressed if that saves at least 1/8 of it.
+    bool Add(const std::string& name, const void* data, size_t size, uint32_t type = PACK_FILE, bool compress = false)
+    {
+        PackEntry entry = {};
+        std::string normalized = normalizePackName(name);
+        entry.nameHash = hashName(normalized);
+        entry.rawSize = size;
+        entry.type = type;
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)normalized.size();
+        names += normalized;
+
+        const unsigned char* stored = (const unsigned char*)data;
+        entry.storedSize = size;
+        std::vector<unsigned char> compressed;
+        if (compress && size > 0)
+        {
+            compressed.resize(lz4CompressBound(size));
+            size_t compressedSize = lz4Compress(stored, size, compressed.data(), compressed.size());
+            if (compressedSize > 0 && compressedSize <= size - size / 8)
+            {
+                entry.codec = PACK_LZ4;
+                entry.storedSize = compressedSize;
+                stored = compressed.data();
+            }
+        }
+
+        pad(PACK_ALIGNMENT);
+        entry.offset = offset;
+        file.write((const char*)stored, (std::streamsize)entry.storedSize);
+        offset += entry.storedSize;
+        entries.push_back(entry);
+        bytesIn += size;
+        bytesOut += (size_t)entry.storedSize;
+        return (bool)file;
+    }
+
+    // writes the table of contents and the header. Fails if two names have the same hash.
+    bool Finish()
+    {
+        std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.nameHash < b.nameHash; });
+        for (size_t i = 1; i < entries.size(); i++)
+        {
+            if (entries[i].nameHash == entries[i - 1].nameHash)
+            {
+                std::cout << "PackWriter: duplicate name (or hash collision): "
+                    << names.substr(entries[i].nameOffset, entries[i].nameLength) << std::endl;
+                return false;
+            }
+        }
+        PackHeader header = {};
+        header.magic = PACK_MAGIC;
+        header.version = PACK_VERSION;
+        header.entryCount = (uint32_t)entries.size();
+        header.alignment = PACK_ALIGNMENT;
+        pad(PACK_ALIGNMENT);
+        header.tocOffset = offset;
+        file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(PackEntry)));
+        offset += entries.size() * sizeof(PackEntry);
+        header.namesOffset = offset;
+        header.namesSize = names.size();
+        file.write(names.data(), (std::streamsize)names.size());
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(header));
+        file.close();
+        return !file.fail();
+    }
+
+private:
+    std::string path;
+    std::ofstream file;
+    std::vector<PackEntry> entries;
+    std::string names;
+    uint64_t offset = 0;
+
+    void pad(uint64_t alignment)
+    {
+        static const char zeros[PACK_ALIGNMENT] = {};
+        uint64_t padding = (alignment - offset % alignment) % alignment;
+        file.write(zeros, (std::streamsize)padding);
+        offset += padding;
+    }
+};
+
+// (de)serialization of plain data into blobs (see writeModelData in util/model.h)
+// ------------------------------------------------------------------------
+class BlobWriter {
+public:
+    std::vector<unsigned char> bytes;
+
+    template <class T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written");
+        const unsigned char* p = (const unsigned char*)&value;
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    // a count followed by the elements
+    template <class T>
+    void WriteArray(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written");
+        Write((uint64_t)values.size());
+        const unsigned char* p = (const unsigned char*)values.data();
+        bytes.insert(bytes.end(), p, p + values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string& s)
+    {
+        Write((uint64_t)s.size());
+        bytes.insert(bytes.end(), s.begin(), s.end());
+    }
+};
+
+// reads what a BlobWriter wrote; every read fails (and returns false) once the end is reached
+class BlobReader {
+public:
+    BlobReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    template <class T>
+    bool Read(T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read");
+        if (size - position < sizeof(T))
+            return false;
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    template <class T>
+    bool ReadArray(std::vector<T>& values)
+    {
+        uint64_t count;
+        if (!Read(count) || count > (size - position) / sizeof(T))
+            return false;
+        values.resize((size_t)count);
+        std::memcpy(values.data(), data + position, (size_t)count * sizeof(T));
+        position += (size_t)count * sizeof(T);
+        return true;
+    }
+
+    bool ReadString(std::string& s)
+    {
+        uint64_t length;
+        if (!Read(length) || length > size - position)
+            return false;
+        s.assign((const char*)data + position, (size_t)length);
+        position += (size_t)length;
+        return true;
+    }
+
+    // returns count bytes in place (no copy) or nullptr
+    const unsigned char* ReadBytes(size_t count)
+    {
+        if (size - position < count)
+            return nullptr;
+        const unsigned char* bytes = data + position;
+        position += count;
+        return bytes;
+    }
+
+    bool AtEnd() const { return position == size; }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t position = 0;
+};
+
+#endif
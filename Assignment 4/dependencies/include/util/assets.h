@@ -5,6 +5,7 @@
 
 
 #include <glad/glad.h> // holds all OpenGL type declarations
+#include <util/glstate.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -12,50 +13,55 @@
 #include <vector>
 #include <optional>
 #include <any>
+#include <memory>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
 #include <chrono> // for timing
 
+#include <util/hash.h>
 #include <util/model.h>
+#include <util/image.h>
+#include <util/asset_loader.h>
 
 bool powerOf2(int n)
 {
     return (n & (n - 1)) == 0; // see http://www.graphics.stanford.edu/~seander/bithacks.html or https://stackoverflow.com/questions/108318/whats-the-simplest-way-to-test-whether-a-number-is-a-power-of-2-in-c
 }
 
-// utility function for loading a 2D texture from file
+// creates a (mipmapped) 2D texture from a decoded image (name is only used for messages)
 // ---------------------------------------------------
-unsigned int loadTexture(const char* path)
+unsigned int uploadTexture(const ImageData& image, const std::string& name)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    // stbi_set_flip_vertically_on_load(flipVertically);
-
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    if (image)
     {
         try
         {
-            if (width <= 0 || height <= 0) throw "Texture is 0 in at least one dimension!";
+            if (image.width <= 0 || image.height <= 0) throw "Texture is 0 in at least one dimension!";
 
             // test for power of 2
-            if (!powerOf2(width) || !powerOf2(height)) throw "Texture is not power of 2!"; // if this happens make sure that the texture has power of 2 dimensions (e.g., 512, 1024, ...)
+            if (!powerOf2(image.width) || !powerOf2(image.height)) throw "Texture is not power of 2!"; // if this happens make sure that the texture has power of 2 dimensions (e.g., 512, 1024, ...)
 
 
             GLenum format;
-            if (nrComponents == 1)
+            if (image.components == 1)
                 format = GL_RED;
-            else if (nrComponents == 3)
+            else if (image.components == 3)
                 format = GL_RGB;
-            else if (nrComponents == 4)
+            else if (image.components == 4)
                 format = GL_RGBA;
             else
                 throw "Number of Channels not supported!";
 
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            glState().BindTexture(GL_TEXTURE_2D, textureID);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
             glGenerateMipmap(GL_TEXTURE_2D);
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -64,45 +70,61 @@ unsigned int loadTexture(const char* path)
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         }
         catch (const char* emsg) {
-            std::cout << "Failed to use texture " << path << " because: " << emsg << endl;
+            std::cout << "Failed to use texture " << name << " because: " << emsg << endl;
         }
-
-        stbi_image_free(data);
     }
-    else
+
+    return textureID;
+}
+
+// GPU memory of a 2D texture with all its mip levels, from the sizes OpenGL reports for its internal format (drivers
+// may still pad, e.g., RGB8 to 4 bytes per texel)
+// ---------------------------------------------------
+size_t textureMemory(unsigned int texture)
+{
+    glState().BindTexture(GL_TEXTURE_2D, texture);
+    size_t bytes = 0;
+    for (int level = 0; ; level++)
     {
-        std::cout << "Failed to load texture at path: " << path << std::endl;
-        stbi_image_free(data);
+        GLint width = 0, height = 0, r = 0, g = 0, b = 0, a = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0)
+            break;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_RED_SIZE, &r);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_GREEN_SIZE, &g);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_BLUE_SIZE, &b);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_ALPHA_SIZE, &a);
+        bytes += (size_t)width * height * (r + g + b + a) / 8;
     }
+    return bytes;
+}
 
-    return textureID;
+// utility function for loading a 2D texture from file (optionally flipped upside down)
+// ---------------------------------------------------
+unsigned int loadTexture(const char* path, bool flip = false)
+{
+    return uploadTexture(decodeImage(path, flip), path);
 }
 
 
 typedef std::map<const std::string, std::string> CubeMapPaths;
-// utility function for loading a cube map texture from file
-// ---------------------------------------------------
-unsigned int loadCubemap(CubeMapPaths cubemap) {
+const char* CUBEMAP_FACES[6] = { "right", "left", "top", "bottom", "front", "back" };
 
+// creates a cube map texture from 6 decoded faces (in the order of CUBEMAP_FACES, RGB)
+// ---------------------------------------------------
+unsigned int uploadCubemap(const ImageData faces[6])
+{
     unsigned int cubeTextureID;
     glGenTextures(1, &cubeTextureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTextureID);
-
-    std::string faces[6] = { "right", "left","top","bottom","front","back" };
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubeTextureID);
 
-    //stbi_set_flip_vertically_on_load(true);
-
-    int width, height, nrComponents;
     for (unsigned int i = 0; i < 6; i++) {
-        auto imgpath = cubemap[faces[i]];
-        unsigned char* image = stbi_load(imgpath.c_str(), &width, &height, &nrComponents, 0);
-
-        if (image) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-            stbi_image_free(image);
+        if (faces[i]) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces[i].width, faces[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, faces[i].pixels.get());
         }
         else {
-            std::cout << "Cubemap texture failed to load for: " << faces[i] << std::endl;
+            std::cout << "Cubemap texture failed to load for: " << CUBEMAP_FACES[i] << std::endl;
         }
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -114,6 +136,24 @@ unsigned int loadCubemap(CubeMapPaths cubemap) {
     return cubeTextureID;
 }
 
+// decodes the 6 faces of a cube map (no OpenGL calls)
+void decodeCubemap(const CubeMapPaths& cubemap, ImageData faces[6])
+{
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        auto face = cubemap.find(CUBEMAP_FACES[i]);
+        faces[i] = face != cubemap.end() ? decodeImage(face->second, false, 3) : ImageData();
+    }
+}
+
+// utility function for loading a cube map texture from file
+// ---------------------------------------------------
+unsigned int loadCubemap(const CubeMapPaths& cubemap) {
+    ImageData faces[6];
+    decodeCubemap(cubemap, faces);
+    return uploadCubemap(faces);
+}
+
 // forward declarations
 class Model; // difined in model.h
 
@@ -126,11 +166,11 @@ typedef std::map<const std::string, AssetItemMap> Assets;
 // if textures should be flipped upside down use { TEX_FLIP, true }
 const std::string TEX_FLIP = "setting-flip-texture";
 
-// a std::map (global variable) that stores all the assets that need to be loaded (i.e., textures and models). Also makes sure that assets are only loaded once!
-std::map<const std::string, std::any> loadedAssets;
-
-
-
+// key of the asset name in group (e.g., constexpr uint64_t key = assetKey("cube", "model");)
+constexpr uint64_t assetKey(std::string_view group, std::string_view name)
+{
+    return hashName(name, hashName("/", hashName(group)));
+}
 
 // Helper class for textures
 class Tex
@@ -139,171 +179,539 @@ private:
     unsigned int m_id; // OpenGL texture id to use with glBindTexture
 public:
     Tex(unsigned int id) :m_id{ id } {}
-    operator unsigned int() { return m_id; } // cast operator
+    operator unsigned int() const { return m_id; } // cast operator
 };
 
-class AssetManager
-{
+// typed handle of a loaded asset (an index into the AssetRegistry of its type). Resolve it once (e.g., with
+// AssetManager::FindModel) and use AssetManager::Get (or the registry) every frame, which is a plain array access.
+template <class T>
+struct AssetHandle {
+    static const uint32_t INVALID = 0xFFFFFFFF;
+    uint32_t index = INVALID;
+
+    bool Valid() const { return index != INVALID; }
+    bool operator==(const AssetHandle& other) const { return index == other.index; }
+    bool operator!=(const AssetHandle& other) const { return index != other.index; }
+};
+
+// Stores the loaded assets of one type (e.g., all models) and makes sure that every asset is only loaded once.
+// Assets are looked up by a hashed key (e.g., of their path), they never move, so references stay valid.
+// Assets that are loaded asynchronously are reserved with a placeholder, which Get returns until they are replaced.
+template <class T>
+class AssetRegistry {
+public:
+    // returns the handle of the asset with the given key (invalid if it has not been loaded)
+    AssetHandle<T> Find(uint64_t key) const
+    {
+        auto it = lookup.find(key);
+        return it != lookup.end() ? AssetHandle<T>{ it->second } : AssetHandle<T>();
+    }
+
+    // returns the handle of the asset with the given key, calls load() (returning a std::unique_ptr<T>) if it is not loaded yet
+    template <class Load>
+    AssetHandle<T> FindOrLoad(uint64_t key, Load load)
+    {
+        AssetHandle<T> handle = Find(key);
+        if (handle.Valid())
+            return handle;
+        handle = add(key, load());
+        return handle;
+    }
+
+    // adds an entry for an asset that is still loading, Get returns placeholder until the asset is replaced
+    AssetHandle<T> Reserve(uint64_t key, T& placeholder)
+    {
+        AssetHandle<T> handle = add(key, nullptr);
+        current[handle.index] = &placeholder;
+        return handle;
+    }
+
+    // swaps the loaded asset in (call on the main thread, e.g., from an upload step of the AsyncLoader)
+    void Replace(AssetHandle<T> handle, std::unique_ptr<T> asset)
+    {
+        items[handle.index] = std::move(asset);
+        current[handle.index] = items[handle.index].get();
+    }
+
+    // false while the placeholder is used
+    bool Ready(AssetHandle<T> handle) const { return items[handle.index] != nullptr; }
+
+    T& Get(AssetHandle<T> handle) { return *current[handle.index]; }
+    const T& Get(AssetHandle<T> handle) const { return *current[handle.index]; }
+    size_t Size() const { return items.size(); }
+
+    // destroys all assets, all handles become invalid (call it before the OpenGL context is destroyed)
+    void Clear()
+    {
+        items.clear();
+        current.clear();
+        lookup.clear();
+    }
+
 private:
-    Assets m_assets;
-    std::string m_active;
+    std::vector<std::unique_ptr<T>> items; // the loaded assets (null while loading)
+    std::vector<T*> current;               // the assets or their placeholders
+    std::unordered_map<uint64_t, uint32_t> lookup;
 
-    // checks if there is a TEX_FLIP="setting-flip-texture" key in the group and check if it is boolean
-    bool flipImagesForGroup(const std::string& group)
+    AssetHandle<T> add(uint64_t key, std::unique_ptr<T> asset)
     {
-        auto g = m_assets.at(group);
-        if (g.find(TEX_FLIP) != g.end()) // key found
-            return GetAsset<bool>(group, TEX_FLIP);
-        else
-            return false; // if key is not set we assume no flipping!
+        AssetHandle<T> handle;
+        handle.index = (uint32_t)items.size();
+        current.push_back(asset.get());
+        items.push_back(std::move(asset));
+        lookup.emplace(key, handle.index);
+        return handle;
     }
+};
 
-    bool GroupExists(const std::string& group)
+// the (global) registries of the loaded models and textures (shared by all AssetManagers)
+AssetRegistry<Model>& modelRegistry()
+{
+    // (the meshes of the models return their geometry to the arena when they are destroyed, so the arena is created
+    // first: statics are destroyed in reverse order, the arena outlives the registry)
+    geometryArena();
+    static AssetRegistry<Model> registry;
+    return registry;
+}
+
+AssetRegistry<Tex>& textureRegistry()
+{
+    static AssetRegistry<Tex> registry;
+    return registry;
+}
+
+// loads an asset with load() and prints how long it took
+template <class Load>
+auto loadTimed(const char* type, const std::string& name, Load load)
+{
+    std::cout << "Loading " << type << " " << name << " ... ";
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto asset = load();
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
+    return asset;
+}
+
+// Describes the assets of a demo in groups (e.g., one group per model with its textures and transformation).
+// The descriptions are stored in a hash map keyed by assetKey(group, name); models and textures are loaded lazily
+// into the global registries the first time they are requested. Request them once (GetModel returns a reference,
+// FindModel/FindTexture a handle) rather than every frame.
+// In async mode (SetAsync) models and textures are loaded on worker threads (see util/asset_loader.h): requests return
+// right away and a placeholder (a unit sphere or a checker texture) is used until the asset is swapped in by
+// asyncLoader().Update(), which has to be called every frame. Keep the handles (not references or texture ids) then.
+// If the upload thread is running (uploadThread().Start, see util/upload_thread.h) the OpenGL objects are created there.
+class AssetManager
+{
+private:
+    std::unordered_map<uint64_t, std::any> m_entries; // assetKey(group, name) -> description
+    std::vector<std::string> m_groups;                // in alphabetical order
+    int m_active = 0;
+    uint64_t m_activeHash = 0;                         // hashName(group + "/") of the active group
+    bool m_async = false;
+    std::vector<std::vector<std::string>> m_files;     // per group: the paths of its entries (see Prefetch)
+
+    // state of a model upload (see modelUpload and stagedModelUpload)
+    struct ModelUpload {
+        ModelData data;
+        std::unique_ptr<Model> model;
+        size_t nextMesh = 0;
+        // created by the upload thread: the textures (see MaterialData::uploaded) and the geometry of all meshes
+        std::vector<GLTexture> stagedTextures;
+        GLBuffer staging;
+        std::vector<GLintptr> vertexOffsets, indexOffsets;
+    };
+
+    // runs upload on the upload thread and then publish in an upload step on the main thread. If the upload thread
+    // isn't running, the step does both (upload returns the bytes it uploaded).
+    static AsyncLoader::UploadStep uploadStep(std::function<size_t()> upload, std::function<void()> publish)
     {
-        if (m_assets.find(group) != m_assets.end()) // key found
+        std::shared_ptr<UploadTicket> ticket = uploadThread().Enqueue(upload);
+        return [ticket, upload, publish](size_t& budget) {
+            if (ticket->failed)
+                budget -= std::min(budget, upload());
+            else if (!ticket->done)
+                return false;
+            publish();
             return true;
-        else
-            return false;
+        };
     }
 
-    template <class T>
-    T Convert(std::any& r)
+    // uploads the decoded textures (with all mip levels) and the geometry of all meshes into staging objects (runs on
+    // the upload thread) and returns the uploaded bytes
+    static size_t stageModel(ModelUpload& upload)
     {
-        try
+        size_t bytes = 0;
+        for (MaterialData& material : upload.data.materials)
         {
-            return std::any_cast<T>(r);
+            for (int t = 0; t < MaterialData::NUM_TEXTURES; t++)
+            {
+                ImageData& image = material.images[t];
+                if (!image || image.components != 4)
+                    continue;
+                GLTexture texture = createTexture(GL_TEXTURE_2D);
+                glState().BindTexture(GL_TEXTURE_2D, texture);
+                glTexStorage2D(GL_TEXTURE_2D, MaterialTable::numMipLevels(image.width, image.height), GL_RGBA8, image.width, image.height);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
+                glGenerateMipmap(GL_TEXTURE_2D);
+                material.uploaded[t] = texture;
+                bytes += image.Bytes();
+                image.pixels.reset(); // (the size is still needed)
+                upload.stagedTextures.push_back(std::move(texture));
+            }
         }
-        catch (const std::bad_any_cast& e)
+
+        size_t size = 0;
+        for (const MeshData& mesh : upload.data.meshes)
+            size += mesh.Bytes();
+        if (size == 0)
+            return bytes;
+        upload.staging = createBuffer();
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, upload.staging);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+        GLintptr offset = 0;
+        for (const MeshData& mesh : upload.data.meshes)
         {
-            std::cout << e.what() << '\n';
-            std::cout << "object is of type " << r.type().name() << " and cannot be cast to " << typeid(T).name() << std::endl;
-            throw e;
-            //return T();
+            upload.vertexOffsets.push_back(offset);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data());
+            offset += mesh.vertices.size() * sizeof(Vertex);
+            upload.indexOffsets.push_back(offset);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data());
+            offset += mesh.indices.size() * sizeof(unsigned int);
         }
+        return bytes + size;
     }
 
-    template <>
-    Model Convert(std::any& r)
+    // stages the model on the upload thread, then copies it into the material table and the geometry arena on the
+    // GPU (in one step, the main thread doesn't transfer any data). Falls back to modelUpload without upload thread.
+    static AsyncLoader::UploadStep stagedModelUpload(AssetHandle<Model> handle, std::shared_ptr<ModelUpload> upload)
     {
-        try
-        {
-            auto path = std::any_cast<const char*>(r);
+        std::shared_ptr<UploadTicket> ticket = uploadThread().Enqueue([upload] { return stageModel(*upload); });
+        AsyncLoader::UploadStep fallback = modelUpload(handle, upload);
+        return [handle, upload, ticket, fallback](size_t& budget) {
+            if (ticket->failed)
+                return fallback(budget);
+            if (!ticket->done)
+                return false;
+            upload->model = std::make_unique<Model>();
+            upload->model->AddMaterials(upload->data);
+            std::vector<MeshData>& meshes = upload->data.meshes;
+            for (size_t i = 0; i < meshes.size(); i++)
+                upload->model->AddMesh(std::move(meshes[i]), upload->staging, upload->vertexOffsets[i], upload->indexOffsets[i]);
+            upload->model->UpdateBounds();
+            modelRegistry().Replace(handle, std::move(upload->model));
+            // (the copies are queued, deleting the staging objects now is fine)
+            upload->stagedTextures.clear();
+            upload->staging = GLBuffer();
+            return true;
+        };
+    }
 
-            if (loadedAssets.count(path) <= 0) // not loaded yet (lazy init)
+    // creates the materials and then the meshes of the model, as many as fit into the budget per call
+    static AsyncLoader::UploadStep modelUpload(AssetHandle<Model> handle, std::shared_ptr<ModelUpload> upload)
+    {
+        return [handle, upload](size_t& budget) {
+            if (!upload->model)
             {
-                std::cout << "Loading Model " << path << " ... ";
-                auto t1 = std::chrono::high_resolution_clock::now();
-                Model* m = new Model(path);
-                loadedAssets.insert(std::pair<const std::string, std::any>(path, *m));
-                auto t2 = std::chrono::high_resolution_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
-
-                std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
+                upload->model = std::make_unique<Model>();
+                upload->model->AddMaterials(upload->data);
+                size_t bytes = 0;
+                for (const MaterialData& material : upload->data.materials)
+                    for (const ImageData& image : material.images) bytes += image.Bytes();
+                budget -= std::min(budget, bytes);
             }
-            auto m = std::any_cast<Model&>(loadedAssets.at(path));
-            return m;
-        }
-        catch (const std::bad_any_cast& e)
+            std::vector<MeshData>& meshes = upload->data.meshes;
+            while (upload->nextMesh < meshes.size() && budget > 0)
+            {
+                MeshData& mesh = meshes[upload->nextMesh++];
+                budget -= std::min(budget, mesh.Bytes());
+                upload->model->AddMesh(std::move(mesh));
+            }
+            if (upload->nextMesh < meshes.size())
+                return false;
+            upload->model->UpdateBounds();
+            modelRegistry().Replace(handle, std::move(upload->model));
+            return true;
+        };
+    }
+
+    static Tex& placeholderTexture()
+    {
+        static Tex tex(checkerTexture());
+        return tex;
+    }
+
+    static Tex& placeholderCubeTexture()
+    {
+        static Tex tex(placeholderCubemap());
+        return tex;
+    }
+
+    const std::any& entry(uint64_t key, std::string_view group, std::string_view name) const
+    {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
         {
-            std::cout << e.what() << '\n';
-            throw e;
+            std::cout << "AssetManager: there is no asset " << name << " in group " << group << std::endl;
+            throw std::out_of_range("asset not found");
         }
+        return it->second;
     }
 
-    template <>
-    Tex Convert(std::any& r)
+    const std::any& entry(std::string_view group, std::string_view name) const
     {
-        try
-        {   // handle 6 face cube maps
-            auto cubemap = std::any_cast<CubeMapPaths>(r);
-            auto uniquename = "cubemap_" + cubemap["front"];
+        return entry(assetKey(group, name), group, name);
+    }
 
-            if (loadedAssets.count(uniquename) <= 0) // not loaded yet (lazy init)
-            {
-                std::cout << "Loading CubeMap " << uniquename << " ... ";
-                auto t1 = std::chrono::high_resolution_clock::now();
-                loadedAssets.insert(std::pair<const std::string, std::any>(uniquename, Tex(loadCubemap(cubemap))));
-                auto t2 = std::chrono::high_resolution_clock::now();
-                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    // checks if there is a TEX_FLIP="setting-flip-texture" key in the group and check if it is boolean
+    bool flipImagesForGroup(std::string_view group) const
+    {
+        auto it = m_entries.find(assetKey(group, TEX_FLIP));
+        if (it != m_entries.end()) // key found
+            return Convert<bool>(it->second);
+        else
+            return false; // if key is not set we assume no flipping!
+    }
 
-                std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
-            }
-            auto c = std::any_cast<Tex>(loadedAssets.at(uniquename));
-            return c;
+    bool GroupExists(const std::string& group) const
+    {
+        return std::find(m_groups.begin(), m_groups.end(), group) != m_groups.end();
+    }
 
+    template <class T>
+    static const T& Convert(const std::any& r)
+    {
+        const T* value = std::any_cast<T>(&r);
+        if (!value)
+        {
+            std::cout << "object is of type " << r.type().name() << " and cannot be cast to " << typeid(T).name() << std::endl;
+            throw std::bad_any_cast();
         }
-        catch (const std::bad_any_cast& e_cubemap) // if not a cube map
+        return *value;
+    }
+
+public: 
+    AssetManager(const Assets& assets)
+    {
+        for (auto const& group : assets)
         {
-            try
-            {   // handle 2D textures
-                auto path = std::any_cast<const char*>(r);
-
-                if (loadedAssets.count(path) <= 0) // not loaded yet (lazy init)
-                {
-                    std::cout << "Loading Texture " << path << " ... ";
-                    auto t1 = std::chrono::high_resolution_clock::now();
-                    loadedAssets.insert(std::pair<const std::string, std::any>(path, Tex(loadTexture(path))));
-                    auto t2 = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
-
-                    std::cout << "done (in " << (duration / 1000) << " milliseconds)." << std::endl;
-                }
-                auto t = std::any_cast<Tex>(loadedAssets.at(path));
-                return t;
-            }
-            catch (const std::bad_any_cast& e)
+            m_groups.push_back(group.first);
+            m_files.emplace_back();
+            for (auto const& item : group.second)
             {
-                std::cout << e.what() << '\n';
-                throw e;
+                if (!m_entries.emplace(assetKey(group.first, item.first), item.second).second)
+                    std::cout << "AssetManager: hash collision for " << group.first << "/" << item.first << std::endl;
+                if (const char* const* path = std::any_cast<const char*>(&item.second))
+                    m_files.back().push_back(*path);
+                else if (const CubeMapPaths* cubemap = std::any_cast<CubeMapPaths>(&item.second))
+                    for (auto const& face : *cubemap)
+                        m_files.back().push_back(face.second);
             }
         }
+        SetActiveGroup(0);
     }
 
-public: 
-    AssetManager(const Assets assets) : m_assets{ assets } { m_active = m_assets.begin()->first;  }
+    // handles (resolve once, then use Get)
+    // ------------------------------------------------------------------------
+    AssetHandle<Model> FindModel(std::string_view group, std::string_view name)
+    {
+        const char* path = Convert<const char*>(entry(group, name));
+        AssetRegistry<Model>& registry = modelRegistry();
+        if (!m_async)
+            return registry.FindOrLoad(hashName(path), [&] {
+                return loadTimed("Model", path, [&] { return std::make_unique<Model>(path); });
+            });
+
+        AssetHandle<Model> handle = registry.Find(hashName(path));
+        if (handle.Valid())
+            return handle;
+        handle = registry.Reserve(hashName(path), placeholderModel());
+        std::string file = path;
+        bool flip = flipImagesForGroup(group);
+        asyncLoader().Request(file, [handle, file, flip]() -> AsyncLoader::UploadStep {
+            auto upload = std::make_shared<ModelUpload>();
+            upload->data = Model::Load(file);
+            if (upload->data.meshes.empty())
+                return AsyncLoader::UploadStep(); // (failed, keep the placeholder)
+            upload->data.DecodeTextures(flip);
+            return stagedModelUpload(handle, upload);
+        });
+        return handle;
+    }
 
-    template<class T>
-    T GetAsset(const std::string& group, const std::string &name)
+    AssetHandle<Tex> FindTexture(std::string_view group, std::string_view name)
     {
-        return Convert<T>(m_assets.at(group).at(name));
+        const std::any& r = entry(group, name);
+        AssetRegistry<Tex>& registry = textureRegistry();
+        if (const CubeMapPaths* cubemap = std::any_cast<CubeMapPaths>(&r)) // 6 face cube maps
+        {
+            std::string uniquename = "cubemap_" + cubemap->at("front");
+            if (!m_async)
+                return registry.FindOrLoad(hashName(uniquename), [&] {
+                    return loadTimed("CubeMap", uniquename, [&] { return std::make_unique<Tex>(loadCubemap(*cubemap)); });
+                });
+
+            AssetHandle<Tex> handle = registry.Find(hashName(uniquename));
+            if (handle.Valid())
+                return handle;
+            handle = registry.Reserve(hashName(uniquename), placeholderCubeTexture());
+            asyncLoader().Request(uniquename, [handle, paths = *cubemap]() -> AsyncLoader::UploadStep {
+                auto faces = std::make_shared<std::array<ImageData, 6>>();
+                decodeCubemap(paths, faces->data());
+                auto texture = std::make_shared<unsigned int>(0);
+                return uploadStep([faces, texture] {
+                    *texture = uploadCubemap(faces->data());
+                    size_t bytes = 0;
+                    for (ImageData& face : *faces) { bytes += face.Bytes(); face.pixels.reset(); }
+                    return bytes;
+                }, [handle, texture] { textureRegistry().Replace(handle, std::make_unique<Tex>(*texture)); });
+            });
+            return handle;
+        }
+
+        // 2D textures (optionally flipped on the y-axis)
+        const char* path = Convert<const char*>(r);
+        bool flip = flipImagesForGroup(group);
+        if (!m_async)
+            return registry.FindOrLoad(hashName(path), [&] {
+                return loadTimed("Texture", path, [&] { return std::make_unique<Tex>(loadTexture(path, flip)); });
+            });
+
+        AssetHandle<Tex> handle = registry.Find(hashName(path));
+        if (handle.Valid())
+            return handle;
+        handle = registry.Reserve(hashName(path), placeholderTexture());
+        std::string file = path;
+        asyncLoader().Request(file, [handle, file, flip]() -> AsyncLoader::UploadStep {
+            auto image = std::make_shared<ImageData>(decodeImage(file, flip));
+            auto texture = std::make_shared<unsigned int>(0);
+            return uploadStep([file, image, texture] {
+                *texture = uploadTexture(*image, file);
+                image->pixels.reset();
+                return image->Bytes();
+            }, [handle, texture] { textureRegistry().Replace(handle, std::make_unique<Tex>(*texture)); });
+        });
+        return handle;
     }
 
-    // Textures need a specialized function, due to the possiblity of flipping it vertically
-    template<>
-    Tex GetAsset(const std::string& group, const std::string& name)
+    // one RGB texture with the ambient occlusion (r), roughness (g) and metallic (b) maps of the group packed together
+    // when they are loaded (see packOrm in util/image.h), instead of three textures of which the shaders only read
+    // one channel. The maps are also kept by their own names, FindTexture still loads them separately.
+    AssetHandle<Tex> FindOrmTexture(std::string_view group, std::string_view ao = "ao", std::string_view roughness = "roughness",
+                                    std::string_view metallic = "metallness")
     {
-        // Optionally tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-        stbi_set_flip_vertically_on_load(flipImagesForGroup(group));
+        std::string paths[3] = { Convert<const char*>(entry(group, ao)), Convert<const char*>(entry(group, roughness)),
+                                 Convert<const char*>(entry(group, metallic)) };
+        std::string name = "orm:" + paths[0] + "|" + paths[1] + "|" + paths[2];
+        bool flip = flipImagesForGroup(group);
+        auto decode = [paths, flip] {
+            ImageData images[3];
+            for (int i = 0; i < 3; i++)
+                images[i] = decodeImage(paths[i], flip);
+            return packOrm(images[0], images[1], images[2]);
+        };
+        AssetRegistry<Tex>& registry = textureRegistry();
+        if (!m_async)
+            return registry.FindOrLoad(hashName(name), [&] {
+                return loadTimed("Texture", name, [&] { return std::make_unique<Tex>(uploadTexture(decode(), name)); });
+            });
+
+        AssetHandle<Tex> handle = registry.Find(hashName(name));
+        if (handle.Valid())
+            return handle;
+        handle = registry.Reserve(hashName(name), placeholderTexture());
+        asyncLoader().Request(name, [handle, name, decode]() -> AsyncLoader::UploadStep {
+            auto image = std::make_shared<ImageData>(decode());
+            auto texture = std::make_shared<unsigned int>(0);
+            return uploadStep([name, image, texture] {
+                *texture = uploadTexture(*image, name);
+                image->pixels.reset();
+                return image->Bytes();
+            }, [handle, texture] { textureRegistry().Replace(handle, std::make_unique<Tex>(*texture)); });
+        });
+        return handle;
+    }
+
+    AssetHandle<Model> FindActiveModel(std::string_view name) { return FindModel(m_groups[m_active], name); }
+    AssetHandle<Tex> FindActiveTexture(std::string_view name) { return FindTexture(m_groups[m_active], name); }
+    AssetHandle<Tex> FindActiveOrmTexture() { return FindOrmTexture(m_groups[m_active]); }
+
+    static Model& Get(AssetHandle<Model> handle) { return modelRegistry().Get(handle); }
+    static Tex Get(AssetHandle<Tex> handle) { return textureRegistry().Get(handle); }
+    static bool Ready(AssetHandle<Model> handle) { return modelRegistry().Ready(handle); }
+    static bool Ready(AssetHandle<Tex> handle) { return textureRegistry().Ready(handle); }
+
+    // asynchronous loading (see above)
+    void SetAsync(bool async) { m_async = async; }
+    bool IsAsync() const { return m_async; }
 
-        return Convert<Tex>(m_assets.at(group).at(name));
+    // reads the files of the group (the ones that aren't loaded yet) in one batch in the background (see
+    // util/async_io.h). Loading them afterwards takes the buffers instead of reading the files one by one.
+    void Prefetch(std::string_view group)
+    {
+        auto it = std::find(m_groups.begin(), m_groups.end(), group);
+        if (it == m_groups.end()) return;
+        std::vector<std::string> files;
+        for (const std::string& path : m_files[it - m_groups.begin()])
+            if (!modelRegistry().Find(hashName(path)).Valid() && !textureRegistry().Find(hashName(path)).Valid() &&
+                !FileSystem::findPacked(path)) // (read from the mounted pack, a prefetch would never be taken)
+                files.push_back(path);
+        asyncIO().Prefetch(files);
     }
 
+    // access by name
+    // ------------------------------------------------------------------------
+    // Textures (Tex) are loaded and returned by value (the OpenGL id), models have to be requested with GetModel.
+    // Everything else (e.g., transformations, paths or functions) is returned as a reference to its description.
     template<class T>
-    T GetActiveAsset(const std::string& name)
+    decltype(auto) GetAsset(std::string_view group, std::string_view name)
     {
-        return GetAsset<T>(m_active, name);
+        if constexpr (std::is_same_v<T, Tex>)
+            return Get(FindTexture(group, name));
+        else
+            return Convert<T>(entry(group, name));
     }
 
-    std::vector<std::string> GetGroups() const
+    template<class T>
+    decltype(auto) GetActiveAsset(std::string_view name)
     {
-        std::vector<std::string> keys;
-        for (auto const& amp : m_assets) { keys.push_back(amp.first); }
-        return keys;
+        if constexpr (std::is_same_v<T, Tex>)
+            return Get(FindTexture(m_groups[m_active], name));
+        else
+            return Convert<T>(entry(hashName(name, m_activeHash), m_groups[m_active], name));
     }
 
+    // Models are not copied out of the asset manager, the reference stays valid
+    Model& GetModel(std::string_view group, std::string_view name)
+    {
+        return Get(FindModel(group, name));
+    }
+
+    Model& GetActiveModel(std::string_view name)
+    {
+        return GetModel(m_groups[m_active], name);
+    }
+
+    // groups
+    // ------------------------------------------------------------------------
+    const std::vector<std::string>& GetGroups() const { return m_groups; }
+
     void SetActiveGroup(const std::string& group)
     {
         // make sure the group exists!
         if (!GroupExists(group)) return;
-        m_active = group;
+        SetActiveGroup((int)std::distance(m_groups.begin(), std::find(m_groups.begin(), m_groups.end(), group)));
     }
 
-    void SetActiveGroup(const int id) { SetActiveGroup(GetGroups().at(id));}
-    const std::string GetActiveGroup() { return m_active; }
-    const int GetActiveGroupId() { 
-        auto groups = GetGroups();
-        return std::distance(groups.begin(), std::find(groups.begin(), groups.end(), GetActiveGroup())); 
+    void SetActiveGroup(const int id)
+    {
+        if (id < 0 || id >= (int)m_groups.size()) return;
+        m_active = id;
+        m_activeHash = hashName("/", hashName(m_groups[id]));
     }
+    const std::string& GetActiveGroup() const { return m_groups[m_active]; }
+    int GetActiveGroupId() const { return m_active; }
 
 };
 
@@ -0,0 +1,630 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <util/asset_pack.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono> // for timing
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Reads the files of a scene in batches, with all reads in flight at once instead of one blocking read after the
+// other (startup on cold caches or network volumes is bound by the latency of the reads, not the bandwidth).
+// On Linux the reads go through io_uring (set up with the raw system calls, no liburing needed), elsewhere, or if
+// io_uring isn't available (old kernels, seccomp), a pool of threads does blocking reads.
+// Prefetch queues a batch and returns right away; FileSystem::read takes the buffers of prefetched files (waiting for
+// them if they are still in flight), so the decoders (stbi_load_from_memory, the OBJ loader, ASSIMP's
+// ReadFileFromMemory, the shaders) get them without touching the disk again.
+
+#ifdef __linux__
+// a minimal io_uring: one submission and one completion queue, reads only
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring() { Close(); }
+
+    bool Init(unsigned int entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0)
+            return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMap = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqesMap == MAP_FAILED)
+        {
+            if (sqesMap != MAP_FAILED) munmap(sqesMap, sqesSize);
+            Close();
+            return false;
+        }
+        sqes = (io_uring_sqe*)sqesMap;
+
+        unsigned char* sq = (unsigned char*)sqRing;
+        sqHead = (unsigned int*)(sq + params.sq_off.head);
+        sqTail = (unsigned int*)(sq + params.sq_off.tail);
+        sqMask = *(unsigned int*)(sq + params.sq_off.ring_mask);
+        sqEntries = *(unsigned int*)(sq + params.sq_off.ring_entries);
+        sqArray = (unsigned int*)(sq + params.sq_off.array);
+        unsigned char* cq = (unsigned char*)cqRing;
+        cqHead = (unsigned int*)(cq + params.cq_off.head);
+        cqTail = (unsigned int*)(cq + params.cq_off.tail);
+        cqMask = *(unsigned int*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void Close()
+    {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing && sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+        sqes = nullptr;
+        sqRing = cqRing = nullptr;
+        ringFd = -1;
+    }
+
+    unsigned int Entries() const { return sqEntries; }
+
+    // queues a read of size bytes at offset of fd into buffer (submitted with the next Submit). Returns false if the
+    // submission queue is full.
+    bool QueueRead(int fd, void* buffer, unsigned int size, uint64_t offset, uint64_t userData)
+    {
+        unsigned int tail = *sqTail; // (only written by us)
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+            return false;
+        unsigned int index = tail & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = (uint64_t)(uintptr_t)buffer;
+        sqe.len = size;
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        queued++;
+        return true;
+    }
+
+    // submits the queued reads and waits until at least waitFor of them completed. Returns false on errors.
+    bool Submit(unsigned int waitFor)
+    {
+        int submitted;
+        do
+            submitted = (int)syscall(__NR_io_uring_enter, ringFd, queued, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        while (submitted < 0 && errno == EINTR);
+        if (submitted < 0)
+            return false;
+        queued -= std::min(queued, (unsigned int)submitted);
+        return true;
+    }
+
+    // waits until at least one completion is there, without submitting anything. Returns false on errors.
+    bool Wait()
+    {
+        int result;
+        do
+            result = (int)syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        while (result < 0 && errno == EINTR);
+        return result >= 0;
+    }
+
+    // reads queued but not submitted yet
+    unsigned int Queued() const { return queued; }
+
+    // the next completion (result: bytes read or -errno), false if there is none
+    bool PopCompletion(uint64_t& userData, int& result)
+    {
+        unsigned int head = *cqHead; // (only written by us)
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+            return false;
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        userData = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned int* sqHead = nullptr;
+    unsigned int* sqTail = nullptr;
+    unsigned int* sqArray = nullptr;
+    unsigned int sqMask = 0, sqEntries = 0;
+    unsigned int* cqHead = nullptr;
+    unsigned int* cqTail = nullptr;
+    unsigned int cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned int queued = 0;
+};
+#endif
+
+class AsyncIO {
+public:
+    enum Backend { IO_URING, THREADS };
+
+    // statistics of the last batch
+    struct Stats {
+        Backend backend = THREADS;
+        unsigned int files = 0;
+        unsigned int failed = 0;
+        size_t bytes = 0;
+        unsigned int maxQueueDepth = 0; // reads in flight at the same time
+        float batchMs = 0.0f;
+        float averageLatencyMs = 0.0f;  // from the start of the batch to the last byte of a file
+        float maxLatencyMs = 0.0f;
+    };
+
+    struct FileLatency {
+        std::string path;
+        size_t bytes;
+        float ms; // negative if the read failed
+    };
+
+    // prefetched files that aren't taken within this time after they were read are dropped
+    static const unsigned int PREFETCH_EXPIRY_MS = 30000;
+
+    // reads in flight with io_uring (large files are split into reads of READ_SIZE bytes)
+    static const unsigned int QUEUE_DEPTH = 64;
+    static const unsigned int READ_SIZE = 1 << 20;
+    // threads of the fallback (they mostly wait for the storage)
+    static const unsigned int IO_THREADS = 16;
+
+    AsyncIO()
+    {
+#ifdef __linux__
+        const char* backend = getenv("ASYNC_IO_BACKEND");
+        useIoUring = !(backend && std::string(backend) == "threads");
+#endif
+    }
+
+    ~AsyncIO()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // selects the backend (io_uring is used if it can be set up, unless ASYNC_IO_BACKEND=threads is set)
+    void UseIoUring(bool use) { useIoUring = use; }
+
+    // queues the reads of the files (paths that are already cached or in flight are skipped) and returns right away
+    void Prefetch(const std::vector<std::string>& paths)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            dropExpired();
+            for (const std::string& path : paths)
+            {
+                std::string key = cacheKey(path);
+                if (files.emplace(key, File()).second)
+                    queue.push_back(key);
+            }
+            if (!worker.joinable())
+                worker = std::thread([this] { work(); });
+        }
+        wakeUp.notify_all();
+    }
+
+    // moves the contents of a prefetched file into out (waiting until it is read). Returns false if the file wasn't
+    // prefetched (or its read failed); the caller reads it itself then. Every prefetch is taken once.
+    bool Take(const std::string& path, FileData& out)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (files.empty())
+            return false;
+        dropExpired();
+        std::string key = cacheKey(path);
+        if (files.find(key) == files.end())
+            return false;
+        done.wait(lock, [&] { return files[key].ready; });
+        File file = std::move(files[key]);
+        files.erase(key);
+        if (file.failed)
+            return false;
+        out = FileData();
+        out.storage = std::move(file.data);
+        out.data = out.storage.data();
+        out.size = out.storage.size();
+        return true;
+    }
+
+    // forgets the prefetched files that weren't taken (waits for the batches in flight)
+    void Clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return queue.empty() && !busy; });
+        files.clear();
+    }
+
+    // reads the files right away (blocking, all reads in flight at once) into data. Returns the number of failures.
+    unsigned int ReadAll(const std::vector<std::string>& paths, std::vector<std::vector<unsigned char>>& data, std::vector<bool>& failed)
+    {
+        data.assign(paths.size(), std::vector<unsigned char>());
+        failed.assign(paths.size(), false);
+        std::vector<float> latencies(paths.size(), 0.0f);
+        Stats batch;
+        auto start = Clock::now();
+        bool read = false;
+#ifdef __linux__
+        if (useIoUring)
+        {
+            read = readIoUring(paths, data, failed, latencies, batch, start);
+            if (!read)
+            {
+                std::cout << "AsyncIO: io_uring is not available, using threads" << std::endl;
+                useIoUring = false;
+            }
+        }
+#endif
+        if (!read)
+            readThreads(paths, data, failed, latencies, batch, start);
+
+        batch.batchMs = msSince(start);
+        std::vector<FileLatency> perFile;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            batch.files++;
+            batch.failed += failed[i] ? 1 : 0;
+            batch.bytes += data[i].size();
+            if (!failed[i])
+            {
+                batch.averageLatencyMs += latencies[i];
+                batch.maxLatencyMs = std::max(batch.maxLatencyMs, latencies[i]);
+            }
+            perFile.push_back({ paths[i], data[i].size(), failed[i] ? -1.0f : latencies[i] });
+        }
+        if (batch.files > batch.failed)
+            batch.averageLatencyMs /= batch.files - batch.failed;
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats = batch;
+        lastBatch = std::move(perFile);
+        return batch.failed;
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+
+    // the files of the last batch with their latencies
+    std::vector<FileLatency> LastBatch() const
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return lastBatch;
+    }
+
+    static const char* BackendName(Backend backend) { return backend == IO_URING ? "io_uring" : "threads"; }
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+    struct File {
+        std::vector<unsigned char> data;
+        bool ready = false;
+        bool failed = false;
+        Clock::time_point readTime; // (when it became ready)
+    };
+
+    std::mutex mutex; // guards files, queue, busy and stopping
+    std::condition_variable wakeUp, done;
+    std::unordered_map<std::string, File> files;
+    std::deque<std::string> queue;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker;
+    std::atomic<bool> useIoUring{ false };
+
+    mutable std::mutex statsMutex;
+    Stats stats;
+    std::vector<FileLatency> lastBatch;
+
+    static std::string cacheKey(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    static float msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+
+    // drops the prefetched files nobody took in time (e.g., a group that was switched away from before it was loaded).
+    // The mutex has to be locked.
+    void dropExpired()
+    {
+        for (auto it = files.begin(); it != files.end();)
+        {
+            if (it->second.ready && msSince(it->second.readTime) > PREFETCH_EXPIRY_MS)
+                it = files.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // reads the queued files, one batch with everything that is queued at a time
+    void work()
+    {
+        for (;;)
+        {
+            std::vector<std::string> paths;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                paths.assign(queue.begin(), queue.end());
+                queue.clear();
+                busy = true;
+            }
+
+            std::vector<std::vector<unsigned char>> data;
+            std::vector<bool> failed;
+            ReadAll(paths, data, failed);
+            Stats batch = GetStats();
+            std::cout << "AsyncIO: read " << batch.files << " files (" << batch.bytes / 1024 << " KB) in " << batch.batchMs
+                << " ms with " << BackendName(batch.backend) << ", queue depth " << batch.maxQueueDepth << ", latency avg "
+                << batch.averageLatencyMs << " ms, max " << batch.maxLatencyMs << " ms" << (batch.failed ? ", failed: " : "");
+            for (size_t i = 0; i < paths.size(); i++)
+                if (failed[i])
+                    std::cout << paths[i] << " ";
+            std::cout << std::endl;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < paths.size(); i++)
+                {
+                    File& file = files[paths[i]];
+                    file.data = std::move(data[i]);
+                    file.failed = failed[i];
+                    file.ready = true;
+                    file.readTime = Clock::now();
+                }
+                busy = false;
+            }
+            done.notify_all();
+        }
+    }
+
+    // the fallback: blocking reads on a pool of threads
+    void readThreads(const std::vector<std::string>& paths, std::vector<std::vector<unsigned char>>& data, std::vector<bool>& failed,
+                     std::vector<float>& latencies, Stats& batch, Clock::time_point start)
+    {
+        batch.backend = THREADS;
+        std::atomic<size_t> next(0);
+        std::atomic<unsigned int> inFlight(0), maxInFlight(0);
+        std::vector<char> ok(paths.size(), 0); // (vector<bool> can't be written from several threads)
+        auto work = [&]() {
+            for (size_t i = next++; i < paths.size(); i = next++)
+            {
+                unsigned int depth = ++inFlight;
+                for (unsigned int m = maxInFlight; depth > m && !maxInFlight.compare_exchange_weak(m, depth);)
+                    ;
+                std::ifstream file(paths[i], std::ios::binary | std::ios::ate);
+                if (file)
+                {
+                    std::streamoff size = file.tellg();
+                    data[i].resize((size_t)size);
+                    file.seekg(0);
+                    ok[i] = (bool)file.read((char*)data[i].data(), size);
+                }
+                latencies[i] = msSince(start);
+                inFlight--;
+            }
+        };
+        size_t threads = std::min<size_t>(IO_THREADS, paths.size());
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++)
+            pool.emplace_back(work);
+        work();
+        for (std::thread& thread : pool)
+            thread.join();
+        for (size_t i = 0; i < paths.size(); i++)
+            failed[i] = !ok[i];
+        batch.maxQueueDepth = maxInFlight;
+    }
+
+#ifdef __linux__
+    // reads all files through io_uring. Returns false (before reading anything) if io_uring can't be set up.
+    bool readIoUring(const std::vector<std::string>& paths, std::vector<std::vector<unsigned char>>& data, std::vector<bool>& failed,
+                     std::vector<float>& latencies, Stats& batch, Clock::time_point start)
+    {
+        IoUring ring;
+        if (!ring.Init(QUEUE_DEPTH))
+            return false;
+        batch.backend = IO_URING;
+
+        // open the files (on a pool of threads, opening is a round trip on network volumes too)
+        std::vector<int> fds(paths.size(), -1);
+        std::vector<size_t> remaining(paths.size(), 0);
+        std::atomic<size_t> next(0);
+        auto open = [&]() {
+            for (size_t i = next++; i < paths.size(); i = next++)
+            {
+                int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+                struct stat info;
+                if (fd >= 0 && fstat(fd, &info) == 0)
+                {
+                    fds[i] = fd;
+                    data[i].resize((size_t)info.st_size);
+                    remaining[i] = (size_t)info.st_size;
+                }
+                else if (fd >= 0)
+                    close(fd);
+            }
+        };
+        {
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < std::min<size_t>(IO_THREADS, paths.size()); t++)
+                pool.emplace_back(open);
+            open();
+            for (std::thread& thread : pool)
+                thread.join();
+        }
+
+        // the reads, user data is their index
+        struct Read {
+            size_t file;
+            uint64_t offset;
+            unsigned int size;
+        };
+        std::vector<Read> reads;
+        std::deque<size_t> pending;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            failed[i] = fds[i] < 0;
+            if (failed[i])
+                continue;
+            if (remaining[i] == 0)
+                latencies[i] = msSince(start);
+            for (size_t offset = 0; offset < remaining[i]; offset += READ_SIZE)
+            {
+                pending.push_back(reads.size());
+                reads.push_back({ i, offset, (unsigned int)std::min<size_t>(READ_SIZE, remaining[i] - offset) });
+            }
+        }
+
+        auto finishRead = [&](size_t file, size_t bytes) {
+            remaining[file] -= std::min(remaining[file], bytes);
+            if (remaining[file] == 0)
+                latencies[file] = msSince(start);
+        };
+        unsigned int inFlight = 0;
+        bool ringFailed = false;
+        while (!pending.empty() || inFlight > 0)
+        {
+            unsigned int queued = 0;
+            while (!pending.empty() && inFlight + queued < ring.Entries())
+            {
+                const Read& read = reads[pending.front()];
+                if (!ring.QueueRead(fds[read.file], data[read.file].data() + read.offset, read.size, read.offset, pending.front()))
+                    break;
+                pending.pop_front();
+                queued++;
+            }
+            inFlight += queued;
+            batch.maxQueueDepth = std::max(batch.maxQueueDepth, inFlight);
+            if (!ring.Submit(1))
+            {
+                ringFailed = true;
+                break;
+            }
+
+            uint64_t index;
+            int result;
+            while (ring.PopCompletion(index, result))
+            {
+                inFlight--;
+                Read& read = reads[(size_t)index];
+                if (result == -EAGAIN || result == -EINTR)
+                    pending.push_back((size_t)index); // (try again)
+                else if (result == -EINVAL || result == -EOPNOTSUPP)
+                {
+                    // IORING_OP_READ needs Linux 5.6: do the read here
+                    ssize_t n = pread(fds[read.file], data[read.file].data() + read.offset, read.size, (off_t)read.offset);
+                    if (n == (ssize_t)read.size)
+                        finishRead(read.file, read.size);
+                    else
+                        failed[read.file] = true;
+                }
+                else if (result < 0 || (result == 0 && read.size > 0))
+                    failed[read.file] = true; // (error, or the file got shorter)
+                else if ((unsigned int)result < read.size)
+                {
+                    // short read: read the rest
+                    finishRead(read.file, (size_t)result);
+                    read.offset += (unsigned int)result;
+                    read.size -= (unsigned int)result;
+                    pending.push_back((size_t)index);
+                }
+                else
+                    finishRead(read.file, read.size);
+            }
+        }
+        if (ringFailed)
+        {
+            std::cout << "AsyncIO: io_uring_enter failed (" << std::strerror(errno) << ")" << std::endl;
+            // the reads the kernel already took write into the buffers until they complete: wait for all of them before
+            // the ring is closed and the buffers are released (the queued ones were never submitted)
+            unsigned int submitted = inFlight - ring.Queued();
+            uint64_t index;
+            int result;
+            while (submitted > 0)
+            {
+                while (submitted > 0 && ring.PopCompletion(index, result))
+                    submitted--;
+                if (submitted > 0 && !ring.Wait())
+                    break;
+            }
+            if (submitted > 0)
+            {
+                // (can't even wait: the buffers of the unfinished files are leaked, rather than written after their
+                // release)
+                std::cout << "AsyncIO: can't wait for " << submitted << " reads, leaking their buffers" << std::endl;
+                for (size_t i = 0; i < paths.size(); i++)
+                    if (remaining[i] > 0)
+                        new std::vector<unsigned char>(std::move(data[i]));
+            }
+            ring.Close();
+            for (size_t i = 0; i < paths.size(); i++)
+                failed[i] = failed[i] || remaining[i] > 0;
+        }
+        for (int fd : fds)
+            if (fd >= 0)
+                close(fd);
+        return true;
+    }
+#endif
+};
+
+// the (global) I/O service used by FileSystem::read
+AsyncIO& asyncIO()
+{
+    static AsyncIO io;
+    return io;
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef BRDF_LUT_H
+#define BRDF_LUT_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/glstate.h>
+#include <util/brdf_lut_table.h> // (BRDF_LUT_SIZE, BRDF_LUT_DATA, brdfLUTTexel, brdfLUTError)
+
+// The split sum BRDF LUT of image based lighting: the scale (r) and bias (g) of F0 over n.v (columns) and roughness
+// (rows). It depends on nothing of the scene, so it is integrated once by src/tools/brdflut and embedded here; it is
+// smooth, 64 x 64 texels with linear filtering are as good as the 512 x 512 ones brdf.fs rendered on every launch.
+
+// creates the LUT texture from the embedded table (RG16F, clamped, linear), no integration at runtime
+unsigned int createBrdfLUT()
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glState().BindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 0, GL_RG, GL_HALF_FLOAT, BRDF_LUT_DATA);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+#endif
@@ -0,0 +1,524 @@
+// generated by src/tools/brdflut (brdflut <this file> 64), don't edit
+#ifndef BRDF_LUT_DATA_H
+#define BRDF_LUT_DATA_H
+
+#include <cstdint>
+
+// the split sum BRDF LUT of src/ibl/brdf.fs: RG16F texels (scale and bias of F0), columns n.v, rows roughness
+const int BRDF_LUT_SIZE = 64;
+const uint16_t BRDF_LUT_DATA[64 * 64 * 2] = {
+    0x28e2, 0x3ba2, 0x2f23, 0x3b16, 0x31c6, 0x3a8c, 0x33d6, 0x3a08, 0x34e2, 0x398d, 0x35c9, 0x391a, 0x36a1, 0x38ae, 0x376b, 0x384a,
+    0x3813, 0x37d8, 0x386b, 0x372a, 0x38bc, 0x3687, 0x3907, 0x35f1, 0x394d, 0x3566, 0x398d, 0x34e5, 0x39c9, 0x346d, 0x3a00, 0x33ff,
+    0x3a33, 0x3335, 0x3a61, 0x327a, 0x3a8c, 0x31d0, 0x3ab3, 0x3133, 0x3ad7, 0x30a4, 0x3af7, 0x3022, 0x3b15, 0x2f56, 0x3b30, 0x2e7e,
+    0x3b48, 0x2dbb, 0x3b5e, 0x2d0b, 0x3b72, 0x2c6b, 0x3b84, 0x2bb9, 0x3b94, 0x2ab9, 0x3ba3, 0x29d3, 0x3baf, 0x2907, 0x3bbb, 0x2852,
+    0x3bc5, 0x2765, 0x3bce, 0x264b, 0x3bd5, 0x2554, 0x3bdc, 0x247c, 0x3be2, 0x2380, 0x3be7, 0x223b, 0x3beb, 0x2124, 0x3bef, 0x2036,
+    0x3bf2, 0x1ed6, 0x3bf5, 0x1d80, 0x3bf7, 0x1c62, 0x3bf9, 0x1ae8, 0x3bfb, 0x1961, 0x3bfc, 0x1822, 0x3bfd, 0x1643, 0x3bfe, 0x14aa,
+    0x3bfe, 0x12d3, 0x3bff, 0x10e4, 0x3bff, 0x0ed8, 0x3bff, 0x0ca8, 0x3c00, 0x0a23, 0x3c00, 0x07ca, 0x3c00, 0x04b9, 0x3c00, 0x02b5,
+    0x3c00, 0x0173, 0x3c00, 0x00b5, 0x3c00, 0x004f, 0x3c00, 0x001d, 0x3c00, 0x0008, 0x3c00, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x28a7, 0x3b29, 0x2f01, 0x3af1, 0x31b4, 0x3a77, 0x33c5, 0x39fb, 0x34da, 0x3984, 0x35c2, 0x3913, 0x369a, 0x38a9, 0x3764, 0x3846,
+    0x3810, 0x37d1, 0x3867, 0x3724, 0x38b9, 0x3683, 0x3904, 0x35ee, 0x394a, 0x3563, 0x398b, 0x34e2, 0x39c6, 0x346c, 0x39fd, 0x33fc,
+    0x3a30, 0x3332, 0x3a5f, 0x3278, 0x3a8a, 0x31ce, 0x3ab1, 0x3132, 0x3ad5, 0x30a3, 0x3af6, 0x3021, 0x3b13, 0x2f54, 0x3b2e, 0x2e7d,
+    0x3b47, 0x2dba, 0x3b5d, 0x2d0a, 0x3b71, 0x2c6b, 0x3b83, 0x2bb8, 0x3b93, 0x2ab8, 0x3ba2, 0x29d3, 0x3bae, 0x2907, 0x3bba, 0x2852,
+    0x3bc4, 0x2764, 0x3bcd, 0x264a, 0x3bd4, 0x2553, 0x3bdb, 0x247b, 0x3be1, 0x237f, 0x3be6, 0x223b, 0x3beb, 0x2124, 0x3bee, 0x2035,
+    0x3bf2, 0x1ed5, 0x3bf4, 0x1d80, 0x3bf7, 0x1c61, 0x3bf9, 0x1ae8, 0x3bfa, 0x1961, 0x3bfb, 0x1822, 0x3bfc, 0x1643, 0x3bfd, 0x14aa,
+    0x3bfe, 0x12d3, 0x3bfe, 0x10e4, 0x3bff, 0x0ed8, 0x3bff, 0x0ca8, 0x3bff, 0x0a23, 0x3c00, 0x07ca, 0x3c00, 0x04b9, 0x3c00, 0x02b5,
+    0x3c00, 0x0173, 0x3c00, 0x00b5, 0x3c00, 0x004f, 0x3c00, 0x001d, 0x3c00, 0x0008, 0x3c00, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x287b, 0x3a52, 0x2ec9, 0x3aa6, 0x3196, 0x3a4e, 0x33a6, 0x39e0, 0x34cb, 0x3971, 0x35b3, 0x3905, 0x368c, 0x389e, 0x3756, 0x383d,
+    0x3809, 0x37c4, 0x3861, 0x371a, 0x38b3, 0x367b, 0x38fe, 0x35e7, 0x3944, 0x355d, 0x3985, 0x34de, 0x39c1, 0x3468, 0x39f9, 0x33f6,
+    0x3a2c, 0x332d, 0x3a5b, 0x3274, 0x3a86, 0x31ca, 0x3aad, 0x312f, 0x3ad1, 0x30a1, 0x3af2, 0x301f, 0x3b10, 0x2f51, 0x3b2b, 0x2e7a,
+    0x3b44, 0x2db8, 0x3b5a, 0x2d08, 0x3b6e, 0x2c69, 0x3b80, 0x2bb5, 0x3b91, 0x2ab6, 0x3b9f, 0x29d1, 0x3bac, 0x2906, 0x3bb8, 0x2851,
+    0x3bc2, 0x2763, 0x3bcb, 0x2649, 0x3bd3, 0x2552, 0x3bda, 0x247b, 0x3be0, 0x237e, 0x3be5, 0x223a, 0x3be9, 0x2123, 0x3bed, 0x2035,
+    0x3bf0, 0x1ed5, 0x3bf3, 0x1d7f, 0x3bf6, 0x1c61, 0x3bf8, 0x1ae7, 0x3bf9, 0x1960, 0x3bfb, 0x1822, 0x3bfc, 0x1643, 0x3bfd, 0x14aa,
+    0x3bfd, 0x12d4, 0x3bfe, 0x10e4, 0x3bfe, 0x0ed8, 0x3bff, 0x0ca9, 0x3bff, 0x0a24, 0x3bff, 0x07cc, 0x3bff, 0x04ba, 0x3bff, 0x02b6,
+    0x3c00, 0x0173, 0x3c00, 0x00b6, 0x3c00, 0x004f, 0x3c00, 0x001d, 0x3c00, 0x0008, 0x3c00, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x28c5, 0x396c, 0x2e94, 0x3a3b, 0x3171, 0x3a10, 0x337f, 0x39b8, 0x34b7, 0x3954, 0x359f, 0x38f0, 0x3678, 0x388e, 0x3743, 0x3831,
+    0x3800, 0x37b0, 0x3858, 0x370a, 0x38aa, 0x366e, 0x38f6, 0x35dc, 0x393c, 0x3555, 0x397e, 0x34d7, 0x39ba, 0x3462, 0x39f2, 0x33ec,
+    0x3a25, 0x3325, 0x3a54, 0x326d, 0x3a80, 0x31c5, 0x3aa7, 0x312a, 0x3acc, 0x309d, 0x3aed, 0x301c, 0x3b0b, 0x2f4c, 0x3b27, 0x2e77,
+    0x3b3f, 0x2db5, 0x3b56, 0x2d05, 0x3b6a, 0x2c67, 0x3b7d, 0x2bb2, 0x3b8d, 0x2ab3, 0x3b9c, 0x29cf, 0x3ba9, 0x2904, 0x3bb5, 0x2850,
+    0x3bbf, 0x2761, 0x3bc8, 0x2648, 0x3bd0, 0x2551, 0x3bd7, 0x247a, 0x3bdd, 0x237d, 0x3be3, 0x223a, 0x3be7, 0x2123, 0x3beb, 0x2035,
+    0x3bef, 0x1ed5, 0x3bf2, 0x1d7f, 0x3bf4, 0x1c61, 0x3bf6, 0x1ae8, 0x3bf8, 0x1961, 0x3bf9, 0x1823, 0x3bfb, 0x1644, 0x3bfb, 0x14ac,
+    0x3bfc, 0x12d6, 0x3bfd, 0x10e6, 0x3bfd, 0x0edb, 0x3bfe, 0x0cab, 0x3bfe, 0x0a28, 0x3bff, 0x07d0, 0x3bff, 0x04bd, 0x3bff, 0x02b8,
+    0x3bff, 0x0175, 0x3bff, 0x00b6, 0x3bff, 0x004f, 0x3c00, 0x001d, 0x3c00, 0x0008, 0x3c00, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x29c9, 0x38ca, 0x2e7d, 0x39b7, 0x314f, 0x39be, 0x3354, 0x3981, 0x349f, 0x392c, 0x3586, 0x38d2, 0x3660, 0x3877, 0x372b, 0x381f,
+    0x37e8, 0x3794, 0x384c, 0x36f3, 0x389e, 0x365b, 0x38eb, 0x35cd, 0x3932, 0x3549, 0x3974, 0x34cd, 0x39b0, 0x345a, 0x39e9, 0x33df,
+    0x3a1c, 0x331a, 0x3a4c, 0x3265, 0x3a78, 0x31be, 0x3aa0, 0x3125, 0x3ac4, 0x3098, 0x3ae6, 0x3018, 0x3b04, 0x2f46, 0x3b20, 0x2e71,
+    0x3b3a, 0x2db1, 0x3b50, 0x2d02, 0x3b65, 0x2c65, 0x3b78, 0x2bae, 0x3b88, 0x2ab0, 0x3b97, 0x29cd, 0x3ba5, 0x2902, 0x3bb1, 0x284f,
+    0x3bbb, 0x275f, 0x3bc4, 0x2647, 0x3bcd, 0x2551, 0x3bd4, 0x247a, 0x3bda, 0x237d, 0x3be0, 0x223a, 0x3be5, 0x2123, 0x3be9, 0x2035,
+    0x3bec, 0x1ed6, 0x3bef, 0x1d81, 0x3bf2, 0x1c63, 0x3bf4, 0x1aeb, 0x3bf6, 0x1964, 0x3bf8, 0x1825, 0x3bf9, 0x1648, 0x3bfa, 0x14af,
+    0x3bfb, 0x12db, 0x3bfc, 0x10ea, 0x3bfc, 0x0ee2, 0x3bfd, 0x0cb0, 0x3bfd, 0x0a2f, 0x3bfe, 0x07dc, 0x3bfe, 0x04c5, 0x3bfe, 0x02be,
+    0x3bff, 0x0178, 0x3bff, 0x00b8, 0x3bff, 0x0050, 0x3bff, 0x001e, 0x3bff, 0x0008, 0x3c00, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x2b8f, 0x386d, 0x2e9c, 0x392f, 0x313a, 0x395e, 0x332d, 0x393c, 0x3488, 0x38fb, 0x356d, 0x38ac, 0x3644, 0x3859, 0x370e, 0x3807,
+    0x37cc, 0x376f, 0x383f, 0x36d5, 0x3891, 0x3644, 0x38de, 0x35ba, 0x3925, 0x3539, 0x3967, 0x34bf, 0x39a4, 0x344f, 0x39dd, 0x33cc,
+    0x3a11, 0x330b, 0x3a41, 0x3259, 0x3a6e, 0x31b4, 0x3a96, 0x311d, 0x3abb, 0x3092, 0x3add, 0x3013, 0x3afc, 0x2f3e, 0x3b18, 0x2e6b,
+    0x3b32, 0x2dac, 0x3b49, 0x2cfe, 0x3b5e, 0x2c62, 0x3b71, 0x2baa, 0x3b82, 0x2aad, 0x3b92, 0x29cb, 0x3b9f, 0x2901, 0x3bab, 0x284e,
+    0x3bb6, 0x275e, 0x3bc0, 0x2646, 0x3bc8, 0x2551, 0x3bd0, 0x247a, 0x3bd6, 0x237f, 0x3bdc, 0x223c, 0x3be1, 0x2125, 0x3be6, 0x2037,
+    0x3be9, 0x1eda, 0x3bed, 0x1d85, 0x3bef, 0x1c66, 0x3bf2, 0x1af1, 0x3bf4, 0x1969, 0x3bf6, 0x182a, 0x3bf7, 0x1650, 0x3bf8, 0x14b6,
+    0x3bf9, 0x12e6, 0x3bfa, 0x10f3, 0x3bfb, 0x0ef0, 0x3bfc, 0x0cbb, 0x3bfc, 0x0a40, 0x3bfd, 0x07f4, 0x3bfd, 0x04d6, 0x3bfe, 0x02c9,
+    0x3bfe, 0x017f, 0x3bfe, 0x00bd, 0x3bff, 0x0053, 0x3bff, 0x001f, 0x3bff, 0x0009, 0x3bff, 0x0002, 0x3c00, 0x0000, 0x3c00, 0x0000,
+    0x2d03, 0x383a, 0x2f02, 0x38b2, 0x3139, 0x38f6, 0x3312, 0x38ed, 0x3473, 0x38bf, 0x3553, 0x387e, 0x3629, 0x3836, 0x36f2, 0x37d5,
+    0x37af, 0x3741, 0x3830, 0x36af, 0x3882, 0x3624, 0x38cf, 0x35a0, 0x3917, 0x3524, 0x3959, 0x34af, 0x3997, 0x3442, 0x39d0, 0x33b8,
+    0x3a05, 0x32fa, 0x3a35, 0x324a, 0x3a62, 0x31a8, 0x3a8b, 0x3112, 0x3ab0, 0x3089, 0x3ad2, 0x300c, 0x3af2, 0x2f32, 0x3b0e, 0x2e61,
+    0x3b29, 0x2da6, 0x3b41, 0x2cfa, 0x3b56, 0x2c5f, 0x3b69, 0x2ba6, 0x3b7b, 0x2aaa, 0x3b8b, 0x29c9, 0x3b99, 0x2900, 0x3ba5, 0x284e,
+    0x3bb0, 0x275f, 0x3bba, 0x2648, 0x3bc3, 0x2553, 0x3bcb, 0x247c, 0x3bd2, 0x2383, 0x3bd8, 0x2240, 0x3bdd, 0x212a, 0x3be2, 0x203c,
+    0x3be6, 0x1ee2, 0x3be9, 0x1d8c, 0x3bec, 0x1c6d, 0x3bef, 0x1afd, 0x3bf1, 0x1974, 0x3bf3, 0x1833, 0x3bf5, 0x165f, 0x3bf6, 0x14c2,
+    0x3bf7, 0x12fb, 0x3bf8, 0x1104, 0x3bf9, 0x0f0b, 0x3bfa, 0x0cd0, 0x3bfb, 0x0a5f, 0x3bfb, 0x0811, 0x3bfc, 0x04f6, 0x3bfd, 0x02df,
+    0x3bfd, 0x018d, 0x3bfd, 0x00c5, 0x3bfe, 0x0057, 0x3bfe, 0x0021, 0x3bff, 0x000a, 0x3bff, 0x0002, 0x3bff, 0x0000, 0x3c00, 0x0000,
+    0x2e86, 0x3818, 0x2fb6, 0x384b, 0x3154, 0x388f, 0x3308, 0x3899, 0x3463, 0x387b, 0x353c, 0x3848, 0x360d, 0x380b, 0x36d4, 0x3792,
+    0x3790, 0x370a, 0x3820, 0x3683, 0x3872, 0x3601, 0x38bf, 0x3582, 0x3907, 0x350a, 0x3949, 0x3499, 0x3987, 0x342f, 0x39c1, 0x339b,
+    0x39f6, 0x32e3, 0x3a27, 0x3237, 0x3a54, 0x319a, 0x3a7e, 0x3107, 0x3aa4, 0x3081, 0x3ac7, 0x3005, 0x3ae7, 0x2f27, 0x3b04, 0x2e59,
+    0x3b1e, 0x2d9d, 0x3b36, 0x2cf3, 0x3b4c, 0x2c59, 0x3b60, 0x2b9d, 0x3b72, 0x2aa3, 0x3b82, 0x29c4, 0x3b90, 0x28fc, 0x3b9e, 0x284d,
+    0x3ba9, 0x2760, 0x3bb4, 0x264a, 0x3bbd, 0x2556, 0x3bc5, 0x2480, 0x3bcc, 0x238b, 0x3bd3, 0x2248, 0x3bd8, 0x2132, 0x3bdd, 0x2043,
+    0x3be2, 0x1ef0, 0x3be5, 0x1d99, 0x3be9, 0x1c78, 0x3beb, 0x1b11, 0x3bee, 0x1985, 0x3bf0, 0x1842, 0x3bf2, 0x1679, 0x3bf4, 0x14d8,
+    0x3bf5, 0x131f, 0x3bf6, 0x1121, 0x3bf7, 0x0f39, 0x3bf8, 0x0cf4, 0x3bf9, 0x0a96, 0x3bfa, 0x0839, 0x3bfb, 0x0531, 0x3bfb, 0x0308,
+    0x3bfc, 0x01a9, 0x3bfd, 0x00d7, 0x3bfd, 0x0062, 0x3bfe, 0x0027, 0x3bfe, 0x000d, 0x3bff, 0x0003, 0x3bff, 0x0001, 0x3c00, 0x0000,
+    0x3020, 0x37f8, 0x3058, 0x37f1, 0x318e, 0x382f, 0x3315, 0x3842, 0x345b, 0x3833, 0x352b, 0x380d, 0x35f6, 0x37b5, 0x36b8, 0x3742,
+    0x3770, 0x36c8, 0x380f, 0x364e, 0x3861, 0x35d6, 0x38ae, 0x355f, 0x38f6, 0x34ee, 0x3939, 0x3482, 0x3977, 0x341c, 0x39b0, 0x3378,
+    0x39e5, 0x32c6, 0x3a17, 0x321f, 0x3a44, 0x3185, 0x3a6e, 0x30f6, 0x3a95, 0x3074, 0x3ab9, 0x2ff6, 0x3ad9, 0x2f18, 0x3af7, 0x2e4e,
+    0x3b12, 0x2d96, 0x3b2b, 0x2cee, 0x3b41, 0x2c55, 0x3b56, 0x2b98, 0x3b68, 0x2aa0, 0x3b79, 0x29c3, 0x3b88, 0x28fc, 0x3b95, 0x284c,
+    0x3ba1, 0x275e, 0x3bac, 0x2649, 0x3bb5, 0x2556, 0x3bbe, 0x2480, 0x3bc5, 0x238d, 0x3bcc, 0x224a, 0x3bd2, 0x213b, 0x3bd8, 0x204d,
+    0x3bdd, 0x1f04, 0x3be1, 0x1dac, 0x3be4, 0x1c8a, 0x3be7, 0x1b30, 0x3bea, 0x19a1, 0x3bed, 0x185a, 0x3bef, 0x16a2, 0x3bf1, 0x14fb,
+    0x3bf2, 0x1359, 0x3bf4, 0x1151, 0x3bf5, 0x0f86, 0x3bf6, 0x0d30, 0x3bf7, 0x0af4, 0x3bf8, 0x0881, 0x3bf9, 0x059b, 0x3bfa, 0x0354,
+    0x3bfb, 0x01de, 0x3bfc, 0x00fa, 0x3bfc, 0x0078, 0x3bfd, 0x0034, 0x3bfe, 0x0014, 0x3bfe, 0x0007, 0x3bff, 0x0003, 0x3c00, 0x0001,
+    0x3111, 0x37be, 0x30f3, 0x376d, 0x31e6, 0x37b5, 0x333c, 0x37dd, 0x345c, 0x37d2, 0x3520, 0x379d, 0x35e2, 0x374c, 0x369e, 0x36ea,
+    0x3752, 0x367f, 0x37fe, 0x3611, 0x3850, 0x35a2, 0x389c, 0x3535, 0x38e4, 0x34cc, 0x3926, 0x3466, 0x3964, 0x3405, 0x399e, 0x3352,
+    0x39d4, 0x32a7, 0x3a06, 0x3206, 0x3a34, 0x3170, 0x3a5e, 0x30e4, 0x3a85, 0x3064, 0x3aa9, 0x2fdc, 0x3aca, 0x2f02, 0x3ae8, 0x2e3c,
+    0x3b04, 0x2d89, 0x3b1e, 0x2ce5, 0x3b35, 0x2c4f, 0x3b4a, 0x2b8f, 0x3b5c, 0x2a9a, 0x3b6e, 0x29c1, 0x3b7d, 0x28fd, 0x3b8b, 0x284e,
+    0x3b98, 0x2764, 0x3ba3, 0x2650, 0x3bad, 0x255d, 0x3bb6, 0x2488, 0x3bbe, 0x239c, 0x3bc5, 0x225a, 0x3bcc, 0x2143, 0x3bd1, 0x2054,
+    0x3bd6, 0x1f0f, 0x3bdb, 0x1db6, 0x3bde, 0x1c93, 0x3be2, 0x1b40, 0x3be5, 0x19af, 0x3be8, 0x1876, 0x3beb, 0x16da, 0x3bed, 0x152c,
+    0x3bef, 0x13ae, 0x3bf1, 0x1199, 0x3bf2, 0x0ffd, 0x3bf4, 0x0d92, 0x3bf5, 0x0b8f, 0x3bf6, 0x08fa, 0x3bf8, 0x0655, 0x3bf9, 0x03df,
+    0x3bfa, 0x0243, 0x3bfa, 0x0141, 0x3bfb, 0x00a9, 0x3bfc, 0x0054, 0x3bfd, 0x0028, 0x3bfe, 0x0013, 0x3bff, 0x0009, 0x3bff, 0x0005,
+    0x320f, 0x377f, 0x31a7, 0x3700, 0x325a, 0x3723, 0x337c, 0x3743, 0x3469, 0x3740, 0x351e, 0x371c, 0x35d5, 0x36dd, 0x368a, 0x368d,
+    0x3738, 0x3630, 0x37df, 0x35ce, 0x383f, 0x3569, 0x388a, 0x3505, 0x38d1, 0x34a3, 0x3913, 0x3444, 0x3951, 0x33d2, 0x398b, 0x3326,
+    0x39c1, 0x3281, 0x39f3, 0x31e7, 0x3a22, 0x3157, 0x3a4c, 0x30d0, 0x3a74, 0x3055, 0x3a99, 0x2fc3, 0x3aba, 0x2eee, 0x3ad9, 0x2e2b,
+    0x3af5, 0x2d7a, 0x3b0f, 0x2cd8, 0x3b26, 0x2c44, 0x3b3b, 0x2b7f, 0x3b4f, 0x2a8f, 0x3b61, 0x29b9, 0x3b71, 0x28f9, 0x3b80, 0x284c,
+    0x3b8d, 0x2764, 0x3b99, 0x2652, 0x3ba3, 0x2561, 0x3bad, 0x2490, 0x3bb6, 0x23af, 0x3bbe, 0x226d, 0x3bc4, 0x2156, 0x3bca, 0x2066,
+    0x3bd0, 0x1f31, 0x3bd5, 0x1dd5, 0x3bd9, 0x1caf, 0x3bdd, 0x1b73, 0x3be0, 0x19db, 0x3be3, 0x188d, 0x3be6, 0x16fa, 0x3be8, 0x1545,
+    0x3bea, 0x13d6, 0x3bec, 0x11b8, 0x3bee, 0x1017, 0x3bf1, 0x0df4, 0x3bf2, 0x0c31, 0x3bf4, 0x09b0, 0x3bf5, 0x077d, 0x3bf7, 0x04c9,
+    0x3bf8, 0x02f7, 0x3bf9, 0x01c8, 0x3bfa, 0x010b, 0x3bfb, 0x009a, 0x3bfc, 0x0058, 0x3bfd, 0x0033, 0x3bfe, 0x001e, 0x3bff, 0x0012,
+    0x3312, 0x373a, 0x326d, 0x36a3, 0x32e5, 0x36a6, 0x33d6, 0x36b9, 0x3481, 0x36b8, 0x3525, 0x369d, 0x35d0, 0x366b, 0x367a, 0x3629,
+    0x3722, 0x35dc, 0x37c3, 0x3585, 0x382f, 0x352b, 0x3878, 0x34d0, 0x38be, 0x3476, 0x38ff, 0x341d, 0x393d, 0x3391, 0x3976, 0x32ed,
+    0x39ac, 0x3253, 0x39df, 0x31c1, 0x3a0e, 0x3138, 0x3a39, 0x30b7, 0x3a61, 0x303f, 0x3a86, 0x2fa0, 0x3aa8, 0x2ed2, 0x3ac7, 0x2e16,
+    0x3ae4, 0x2d6a, 0x3afe, 0x2ccb, 0x3b16, 0x2c3b, 0x3b2c, 0x2b6f, 0x3b40, 0x2a83, 0x3b52, 0x29ae, 0x3b63, 0x28ef, 0x3b71, 0x2843,
+    0x3b7f, 0x2759, 0x3b8b, 0x264b, 0x3b97, 0x255e, 0x3ba1, 0x2491, 0x3bab, 0x23b4, 0x3bb3, 0x2274, 0x3bba, 0x215e, 0x3bc1, 0x206e,
+    0x3bc6, 0x1f42, 0x3bcc, 0x1deb, 0x3bd1, 0x1cc7, 0x3bd5, 0x1ba1, 0x3bd9, 0x1a05, 0x3bdc, 0x18b2, 0x3be0, 0x173b, 0x3be2, 0x157d,
+    0x3be5, 0x1419, 0x3be7, 0x1204, 0x3be9, 0x1054, 0x3beb, 0x0e17, 0x3bed, 0x0c2e, 0x3bef, 0x0993, 0x3bf0, 0x0732, 0x3bf2, 0x0479,
+    0x3bf3, 0x0306, 0x3bf5, 0x0225, 0x3bf7, 0x0159, 0x3bf8, 0x00d0, 0x3bf9, 0x0078, 0x3bfb, 0x0041, 0x3bfc, 0x0020, 0x3bfd, 0x000c,
+    0x340c, 0x36f1, 0x3340, 0x364e, 0x3384, 0x3638, 0x3422, 0x363d, 0x34a4, 0x3639, 0x3537, 0x3624, 0x35d3, 0x35fd, 0x3672, 0x35c6,
+    0x3711, 0x3584, 0x37ab, 0x3539, 0x3821, 0x34eb, 0x3868, 0x3498, 0x38ac, 0x3446, 0x38ed, 0x33ea, 0x3929, 0x334c, 0x3962, 0x32b2,
+    0x3998, 0x3222, 0x39ca, 0x3197, 0x39f9, 0x3114, 0x3a24, 0x309a, 0x3a4d, 0x3028, 0x3a72, 0x2f7b, 0x3a95, 0x2eb5, 0x3ab5, 0x2dfe,
+    0x3ad2, 0x2d56, 0x3aed, 0x2cbc, 0x3b06, 0x2c30, 0x3b1c, 0x2b61, 0x3b31, 0x2a7b, 0x3b44, 0x29a9, 0x3b55, 0x28ed, 0x3b65, 0x2843,
+    0x3b73, 0x2759, 0x3b80, 0x264f, 0x3b8b, 0x2563, 0x3b96, 0x2492, 0x3b9f, 0x23b5, 0x3ba8, 0x2279, 0x3bb0, 0x2166, 0x3bb7, 0x2078,
+    0x3bbd, 0x1f5d, 0x3bc4, 0x1e08, 0x3bc9, 0x1ce1, 0x3bce, 0x1bd1, 0x3bd2, 0x1a31, 0x3bd6, 0x18d9, 0x3bd9, 0x177e, 0x3bdd, 0x15bb,
+    0x3be0, 0x145d, 0x3be3, 0x127f, 0x3be5, 0x10be, 0x3be8, 0x0ec9, 0x3bea, 0x0cbf, 0x3bec, 0x0a7a, 0x3bee, 0x084e, 0x3bef, 0x058d,
+    0x3bf1, 0x0379, 0x3bf3, 0x021a, 0x3bf4, 0x013b, 0x3bf6, 0x00b3, 0x3bf8, 0x009f, 0x3bf9, 0x0081, 0x3bfb, 0x004b, 0x3bfc, 0x0022,
+    0x348d, 0x36a3, 0x340e, 0x3600, 0x3419, 0x35d8, 0x3463, 0x35cf, 0x34d0, 0x35c8, 0x3552, 0x35b3, 0x35df, 0x3591, 0x3672, 0x3564,
+    0x3706, 0x352c, 0x3799, 0x34eb, 0x3814, 0x34a5, 0x3859, 0x345e, 0x389b, 0x3414, 0x38da, 0x3392, 0x3916, 0x3300, 0x394e, 0x3273,
+    0x3983, 0x31eb, 0x39b5, 0x3168, 0x39e4, 0x30ed, 0x3a0f, 0x3079, 0x3a37, 0x300b, 0x3a5d, 0x2f4a, 0x3a80, 0x2e8e, 0x3aa1, 0x2de0,
+    0x3abe, 0x2d3e, 0x3ada, 0x2caa, 0x3af3, 0x2c21, 0x3b0a, 0x2b48, 0x3b1f, 0x2a67, 0x3b33, 0x299c, 0x3b45, 0x28e4, 0x3b55, 0x283f,
+    0x3b64, 0x2759, 0x3b72, 0x2652, 0x3b7e, 0x2567, 0x3b89, 0x2497, 0x3b93, 0x23c2, 0x3b9c, 0x2286, 0x3ba5, 0x2174, 0x3bac, 0x2085,
+    0x3bb3, 0x1f6e, 0x3bb9, 0x1e0f, 0x3bbf, 0x1ceb, 0x3bc4, 0x1be5, 0x3bc8, 0x1a47, 0x3bcd, 0x18f6, 0x3bd1, 0x17b7, 0x3bd5, 0x15fb,
+    0x3bd9, 0x148b, 0x3bdc, 0x12c8, 0x3bdf, 0x10f7, 0x3be1, 0x0f21, 0x3be4, 0x0d01, 0x3be6, 0x0ae8, 0x3be9, 0x08e0, 0x3beb, 0x068b,
+    0x3bed, 0x043e, 0x3bef, 0x02a9, 0x3bf1, 0x019c, 0x3bf2, 0x00f0, 0x3bf4, 0x0085, 0x3bf6, 0x0045, 0x3bf7, 0x001f, 0x3bfa, 0x002c,
+    0x350c, 0x3654, 0x347e, 0x35b5, 0x3475, 0x3580, 0x34ab, 0x356d, 0x3505, 0x355e, 0x3576, 0x354b, 0x35f4, 0x352d, 0x367a, 0x3505,
+    0x3703, 0x34d5, 0x378d, 0x349e, 0x380a, 0x3460, 0x384c, 0x3420, 0x388c, 0x33bb, 0x38c9, 0x3337, 0x3904, 0x32b3, 0x393b, 0x322f,
+    0x396f, 0x31b0, 0x39a1, 0x3137, 0x39cf, 0x30c4, 0x39fa, 0x3056, 0x3a22, 0x2fdb, 0x3a48, 0x2f1b, 0x3a6b, 0x2e66, 0x3a8c, 0x2dbc,
+    0x3aaa, 0x2d21, 0x3ac6, 0x2c93, 0x3ae0, 0x2c10, 0x3af8, 0x2b32, 0x3b0e, 0x2a58, 0x3b22, 0x2990, 0x3b35, 0x28db, 0x3b45, 0x2838,
+    0x3b55, 0x274e, 0x3b63, 0x264d, 0x3b70, 0x2568, 0x3b7c, 0x249d, 0x3b87, 0x23d7, 0x3b91, 0x229d, 0x3b9a, 0x218a, 0x3ba2, 0x209a,
+    0x3ba9, 0x1f97, 0x3bb0, 0x1e36, 0x3bb6, 0x1d0f, 0x3bbc, 0x1c13, 0x3bc1, 0x1a7d, 0x3bc5, 0x191c, 0x3bca, 0x17f4, 0x3bce, 0x162c,
+    0x3bd2, 0x14b2, 0x3bd5, 0x1317, 0x3bd9, 0x1149, 0x3bdc, 0x0fb1, 0x3bdf, 0x0d8c, 0x3be2, 0x0bef, 0x3be5, 0x097c, 0x3be7, 0x075d,
+    0x3be9, 0x04cc, 0x3beb, 0x0306, 0x3bed, 0x01d8, 0x3bf0, 0x015f, 0x3bf2, 0x00de, 0x3bf4, 0x0081, 0x3bf6, 0x0042, 0x3bf8, 0x001b,
+    0x3588, 0x3603, 0x34ef, 0x356d, 0x34d4, 0x3531, 0x34f8, 0x3515, 0x3541, 0x3501, 0x35a2, 0x34eb, 0x3611, 0x34d0, 0x368a, 0x34ac,
+    0x3708, 0x3481, 0x3787, 0x3451, 0x3803, 0x341c, 0x3842, 0x33c5, 0x387f, 0x334f, 0x38ba, 0x32d6, 0x38f2, 0x325e, 0x3929, 0x31e9,
+    0x395c, 0x3175, 0x398c, 0x3103, 0x39ba, 0x3096, 0x39e5, 0x3030, 0x3a0e, 0x2f9e, 0x3a33, 0x2ee7, 0x3a57, 0x2e3a, 0x3a77, 0x2d99,
+    0x3a96, 0x2d05, 0x3ab2, 0x2c7c, 0x3acc, 0x2bf7, 0x3ae4, 0x2b0d, 0x3afb, 0x2a3b, 0x3b10, 0x297c, 0x3b23, 0x28d1, 0x3b35, 0x2834,
+    0x3b46, 0x274d, 0x3b54, 0x264e, 0x3b62, 0x256a, 0x3b6e, 0x249f, 0x3b79, 0x23dc, 0x3b84, 0x22a6, 0x3b8d, 0x2195, 0x3b96, 0x20a9,
+    0x3b9e, 0x1fbf, 0x3ba6, 0x1e64, 0x3bad, 0x1d38, 0x3bb3, 0x1c38, 0x3bb8, 0x1ac0, 0x3bbe, 0x1957, 0x3bc3, 0x1836, 0x3bc7, 0x1689,
+    0x3bcb, 0x14ff, 0x3bcf, 0x1385, 0x3bd2, 0x118f, 0x3bd6, 0x101e, 0x3bd9, 0x0df5, 0x3bdc, 0x0c36, 0x3be0, 0x0a14, 0x3be2, 0x082e,
+    0x3be5, 0x058e, 0x3be8, 0x03c3, 0x3beb, 0x0290, 0x3bed, 0x01a2, 0x3bef, 0x00fb, 0x3bf1, 0x008c, 0x3bf4, 0x0065, 0x3bf6, 0x0039,
+    0x35ff, 0x35b3, 0x355f, 0x3527, 0x3536, 0x34e7, 0x354a, 0x34c4, 0x3583, 0x34ab, 0x35d4, 0x3494, 0x3636, 0x347a, 0x36a1, 0x3459,
+    0x3713, 0x3433, 0x3788, 0x3408, 0x37ff, 0x33b0, 0x383a, 0x334b, 0x3874, 0x32e2, 0x38ac, 0x3276, 0x38e3, 0x3209, 0x3917, 0x319c,
+    0x3949, 0x3133, 0x3979, 0x30cc, 0x39a6, 0x3069, 0x39d0, 0x3008, 0x39f8, 0x2f58, 0x3a1e, 0x2eab, 0x3a41, 0x2e0a, 0x3a62, 0x2d73,
+    0x3a81, 0x2ce5, 0x3a9e, 0x2c61, 0x3ab8, 0x2bcf, 0x3ad1, 0x2af1, 0x3ae8, 0x2a25, 0x3afd, 0x2969, 0x3b10, 0x28bd, 0x3b22, 0x2824,
+    0x3b33, 0x2735, 0x3b43, 0x2642, 0x3b52, 0x2569, 0x3b5f, 0x24a6, 0x3b6c, 0x23ef, 0x3b77, 0x22ba, 0x3b80, 0x21a9, 0x3b8a, 0x20bb,
+    0x3b92, 0x1fe0, 0x3b9a, 0x1e82, 0x3ba1, 0x1d54, 0x3ba8, 0x1c56, 0x3bae, 0x1afb, 0x3bb4, 0x1996, 0x3bba, 0x1869, 0x3bbf, 0x16e2,
+    0x3bc4, 0x1550, 0x3bc8, 0x1409, 0x3bcc, 0x1220, 0x3bd0, 0x108d, 0x3bd4, 0x0e9d, 0x3bd7, 0x0cb3, 0x3bda, 0x0a85, 0x3bdd, 0x08a3,
+    0x3be1, 0x065a, 0x3be4, 0x046d, 0x3be7, 0x030e, 0x3be9, 0x01f6, 0x3bec, 0x0130, 0x3bef, 0x00cf, 0x3bf1, 0x007d, 0x3bf3, 0x0040,
+    0x3672, 0x3564, 0x35ce, 0x34e3, 0x3599, 0x34a1, 0x359f, 0x347a, 0x35c9, 0x345e, 0x360c, 0x3444, 0x3660, 0x3429, 0x36bf, 0x340c,
+    0x3725, 0x33d1, 0x3790, 0x3383, 0x37fd, 0x332f, 0x3835, 0x32d4, 0x386c, 0x3276, 0x38a1, 0x3216, 0x38d5, 0x31b3, 0x3907, 0x3151,
+    0x3938, 0x30f0, 0x3966, 0x3091, 0x3992, 0x3035, 0x39bc, 0x2fba, 0x39e4, 0x2f12, 0x3a09, 0x2e6f, 0x3a2c, 0x2dd6, 0x3a4c, 0x2d45,
+    0x3a6c, 0x2cc0, 0x3a89, 0x2c44, 0x3aa4, 0x2ba2, 0x3abd, 0x2acd, 0x3ad4, 0x2a07, 0x3aea, 0x2953, 0x3afe, 0x28b1, 0x3b11, 0x281d,
+    0x3b22, 0x272b, 0x3b32, 0x2636, 0x3b40, 0x255d, 0x3b4e, 0x249c, 0x3b5a, 0x23e1, 0x3b66, 0x22b8, 0x3b72, 0x21b5, 0x3b7c, 0x20d1,
+    0x3b86, 0x2007, 0x3b8e, 0x1ead, 0x3b96, 0x1d7b, 0x3b9d, 0x1c76, 0x3ba4, 0x1b3e, 0x3bab, 0x19d2, 0x3bb0, 0x189e, 0x3bb6, 0x174a,
+    0x3bbb, 0x15a9, 0x3bc0, 0x145f, 0x3bc5, 0x12a1, 0x3bc9, 0x10ef, 0x3bcd, 0x0f34, 0x3bd0, 0x0d2d, 0x3bd4, 0x0b7d, 0x3bd8, 0x094a,
+    0x3bdb, 0x074a, 0x3bde, 0x04dc, 0x3be2, 0x035c, 0x3be5, 0x0247, 0x3be8, 0x019c, 0x3beb, 0x0110, 0x3bed, 0x009b, 0x3bef, 0x0056,
+    0x36df, 0x3516, 0x363a, 0x34a1, 0x35fb, 0x345f, 0x35f4, 0x3435, 0x3612, 0x3416, 0x3648, 0x33f6, 0x368f, 0x33c0, 0x36e2, 0x3385,
+    0x373d, 0x3347, 0x379e, 0x32ff, 0x3801, 0x32b3, 0x3834, 0x3263, 0x3866, 0x320d, 0x3898, 0x31b6, 0x38c9, 0x315d, 0x38f9, 0x3105,
+    0x3928, 0x30ac, 0x3955, 0x3056, 0x397f, 0x3001, 0x39a8, 0x2f5f, 0x39cf, 0x2ec3, 0x39f4, 0x2e2e, 0x3a17, 0x2da1, 0x3a38, 0x2d19,
+    0x3a56, 0x2c9a, 0x3a73, 0x2c23, 0x3a8e, 0x2b69, 0x3aa7, 0x2aa0, 0x3abf, 0x29e6, 0x3ad6, 0x293b, 0x3aea, 0x289e, 0x3afe, 0x280e,
+    0x3b0f, 0x2717, 0x3b20, 0x262f, 0x3b30, 0x255c, 0x3b3e, 0x249f, 0x3b4b, 0x23ea, 0x3b57, 0x22be, 0x3b62, 0x21b8, 0x3b6c, 0x20d2,
+    0x3b76, 0x2008, 0x3b80, 0x1ebe, 0x3b89, 0x1d99, 0x3b91, 0x1c9d, 0x3b98, 0x1b82, 0x3b9f, 0x1a0f, 0x3ba6, 0x18d6, 0x3bac, 0x17a2,
+    0x3bb2, 0x1604, 0x3bb7, 0x14ac, 0x3bbc, 0x132c, 0x3bc1, 0x1172, 0x3bc5, 0x100b, 0x3bca, 0x0e01, 0x3bce, 0x0c56, 0x3bd2, 0x0a1a,
+    0x3bd5, 0x082d, 0x3bd9, 0x05ed, 0x3bdc, 0x03f5, 0x3bdf, 0x0283, 0x3be1, 0x0183, 0x3be3, 0x0117, 0x3be7, 0x00cb, 0x3bea, 0x0072,
+    0x3748, 0x34cb, 0x36a2, 0x3460, 0x365b, 0x3420, 0x364b, 0x33eb, 0x365d, 0x33a9, 0x3687, 0x3371, 0x36c2, 0x3339, 0x370a, 0x3301,
+    0x375a, 0x32c3, 0x37b1, 0x3284, 0x3806, 0x323e, 0x3834, 0x31f4, 0x3863, 0x31a9, 0x3892, 0x315a, 0x38c0, 0x310a, 0x38ee, 0x30b9,
+    0x391a, 0x306a, 0x3944, 0x301a, 0x396e, 0x2f99, 0x3995, 0x2f04, 0x39bb, 0x2e73, 0x39df, 0x2de7, 0x3a01, 0x2d64, 0x3a22, 0x2ce7,
+    0x3a41, 0x2c72, 0x3a5e, 0x2c03, 0x3a79, 0x2b35, 0x3a92, 0x2a73, 0x3aaa, 0x29bf, 0x3ac0, 0x291a, 0x3ad5, 0x2885, 0x3ae9, 0x27f7,
+    0x3afb, 0x26fe, 0x3b0d, 0x261d, 0x3b1d, 0x2551, 0x3b2c, 0x2499, 0x3b3a, 0x23ee, 0x3b47, 0x22cc, 0x3b53, 0x21c8, 0x3b5e, 0x20e3,
+    0x3b68, 0x201a, 0x3b71, 0x1eda, 0x3b7a, 0x1db1, 0x3b83, 0x1cad, 0x3b8a, 0x1ba3, 0x3b92, 0x1a39, 0x3b9a, 0x190a, 0x3ba1, 0x1809,
+    0x3ba7, 0x165f, 0x3bad, 0x14f4, 0x3bb2, 0x1397, 0x3bb7, 0x11ca, 0x3bbc, 0x106b, 0x3bc1, 0x0e9b, 0x3bc6, 0x0cee, 0x3bca, 0x0b1e,
+    0x3bce, 0x0918, 0x3bd2, 0x072d, 0x3bd5, 0x04d9, 0x3bd7, 0x0349, 0x3bdb, 0x0233, 0x3bde, 0x0152, 0x3be0, 0x00b5, 0x3be3, 0x0071,
+    0x37ab, 0x3483, 0x3707, 0x3422, 0x36ba, 0x33c9, 0x36a1, 0x3373, 0x36a9, 0x332f, 0x36c8, 0x32f4, 0x36f9, 0x32bd, 0x3736, 0x3286,
+    0x377c, 0x324c, 0x37c9, 0x320f, 0x380d, 0x31d1, 0x3838, 0x318e, 0x3862, 0x3148, 0x388e, 0x3101, 0x38b9, 0x30b9, 0x38e4, 0x3070,
+    0x390e, 0x3027, 0x3936, 0x2fbe, 0x395e, 0x2f31, 0x3984, 0x2ea7, 0x39a8, 0x2e21, 0x39cb, 0x2da1, 0x39ed, 0x2d26, 0x3a0d, 0x2cb1,
+    0x3a2b, 0x2c44, 0x3a48, 0x2bbb, 0x3a64, 0x2af9, 0x3a7d, 0x2a44, 0x3a95, 0x299a, 0x3aac, 0x28fd, 0x3ac1, 0x286d, 0x3ad5, 0x27cf,
+    0x3ae7, 0x26df, 0x3af9, 0x2607, 0x3b09, 0x2541, 0x3b19, 0x2490, 0x3b27, 0x23e4, 0x3b35, 0x22c8, 0x3b41, 0x21ca, 0x3b4d, 0x20ed,
+    0x3b58, 0x202b, 0x3b62, 0x1efd, 0x3b6c, 0x1dd0, 0x3b75, 0x1cce, 0x3b7d, 0x1be3, 0x3b85, 0x1a72, 0x3b8c, 0x1933, 0x3b93, 0x1829,
+    0x3b9a, 0x169e, 0x3ba1, 0x153d, 0x3ba7, 0x1419, 0x3bac, 0x124f, 0x3bb2, 0x10cc, 0x3bb7, 0x0f28, 0x3bbb, 0x0d54, 0x3bc0, 0x0bd5,
+    0x3bc3, 0x09b6, 0x3bc7, 0x081e, 0x3bcb, 0x05b3, 0x3bcf, 0x03fb, 0x3bd3, 0x02ab, 0x3bd7, 0x01c0, 0x3bda, 0x0112, 0x3bdd, 0x0082,
+    0x3804, 0x343e, 0x3768, 0x33cc, 0x3716, 0x3357, 0x36f5, 0x3302, 0x36f4, 0x32bd, 0x370a, 0x3282, 0x3731, 0x324b, 0x3764, 0x3214,
+    0x37a1, 0x31dd, 0x37e5, 0x31a5, 0x3817, 0x3169, 0x383d, 0x312d, 0x3864, 0x30ee, 0x388c, 0x30ac, 0x38b4, 0x306b, 0x38dc, 0x3029,
+    0x3903, 0x2fcd, 0x392a, 0x2f49, 0x394f, 0x2ec9, 0x3974, 0x2e4b, 0x3997, 0x2dd1, 0x39b9, 0x2d5a, 0x39d9, 0x2ce8, 0x39f8, 0x2c7c,
+    0x3a16, 0x2c15, 0x3a32, 0x2b67, 0x3a4d, 0x2ab2, 0x3a67, 0x2a0b, 0x3a7f, 0x296d, 0x3a96, 0x28db, 0x3aac, 0x2853, 0x3ac0, 0x27a7,
+    0x3ad3, 0x26c3, 0x3ae5, 0x25ef, 0x3af5, 0x252f, 0x3b05, 0x2484, 0x3b14, 0x23d8, 0x3b22, 0x22c3, 0x3b2f, 0x21ca, 0x3b3b, 0x20f3,
+    0x3b47, 0x2034, 0x3b52, 0x1f15, 0x3b5c, 0x1df0, 0x3b66, 0x1cf5, 0x3b6f, 0x1c17, 0x3b77, 0x1aad, 0x3b7e, 0x1967, 0x3b85, 0x1858,
+    0x3b8d, 0x16f7, 0x3b93, 0x157f, 0x3b99, 0x144b, 0x3b9f, 0x12a1, 0x3ba4, 0x1124, 0x3ba9, 0x0fd8, 0x3bad, 0x0dd4, 0x3bb2, 0x0c48,
+    0x3bb6, 0x0a2e, 0x3bbb, 0x0885, 0x3bc0, 0x0673, 0x3bc5, 0x04a9, 0x3bc8, 0x0314, 0x3bcd, 0x01f0, 0x3bd1, 0x012a, 0x3bd6, 0x00bc,
+    0x3830, 0x33f7, 0x37c4, 0x3359, 0x376f, 0x32ea, 0x3748, 0x3297, 0x373f, 0x3253, 0x374d, 0x3218, 0x376b, 0x31e1, 0x3795, 0x31ac,
+    0x37c9, 0x3177, 0x3802, 0x3141, 0x3822, 0x310a, 0x3844, 0x30d1, 0x3868, 0x3099, 0x388d, 0x305d, 0x38b1, 0x3020, 0x38d6, 0x2fc7,
+    0x38fb, 0x2f50, 0x391f, 0x2ed8, 0x3943, 0x2e62, 0x3965, 0x2def, 0x3987, 0x2d7f, 0x39a8, 0x2d13, 0x39c7, 0x2cab, 0x39e5, 0x2c46,
+    0x3a02, 0x2bce, 0x3a1e, 0x2b19, 0x3a38, 0x2a6e, 0x3a51, 0x29cc, 0x3a68, 0x2937, 0x3a7f, 0x28ae, 0x3a95, 0x2830, 0x3aaa, 0x2776,
+    0x3abe, 0x269e, 0x3ad0, 0x25d5, 0x3ae1, 0x251e, 0x3af1, 0x2479, 0x3b00, 0x23c4, 0x3b0e, 0x22b7, 0x3b1c, 0x21c9, 0x3b28, 0x20f7,
+    0x3b34, 0x203a, 0x3b3f, 0x1f24, 0x3b4a, 0x1e03, 0x3b54, 0x1d09, 0x3b5d, 0x1c2f, 0x3b66, 0x1ae9, 0x3b6f, 0x19ae, 0x3b77, 0x189b,
+    0x3b7e, 0x175e, 0x3b84, 0x15d6, 0x3b89, 0x1492, 0x3b8e, 0x1331, 0x3b94, 0x118a, 0x3b9a, 0x1038, 0x3b9f, 0x0e52, 0x3ba5, 0x0cc8,
+    0x3baa, 0x0b09, 0x3baf, 0x08f9, 0x3bb3, 0x06c3, 0x3bb9, 0x04c2, 0x3bbe, 0x033a, 0x3bc4, 0x0253, 0x3bc9, 0x016c, 0x3bcc, 0x00cf,
+    0x3859, 0x337a, 0x380d, 0x32ea, 0x37c4, 0x3283, 0x3798, 0x3232, 0x3789, 0x31f0, 0x378f, 0x31b5, 0x37a5, 0x317f, 0x37c7, 0x314b,
+    0x37f3, 0x3119, 0x3813, 0x30e5, 0x382f, 0x30b1, 0x384e, 0x307c, 0x386e, 0x3047, 0x388f, 0x3012, 0x38b1, 0x2fb7, 0x38d3, 0x2f47,
+    0x38f4, 0x2ed7, 0x3916, 0x2e6b, 0x3938, 0x2e00, 0x3958, 0x2d96, 0x3978, 0x2d2f, 0x3997, 0x2ccc, 0x39b5, 0x2c6c, 0x39d3, 0x2c10,
+    0x39ef, 0x2b70, 0x3a0a, 0x2ac8, 0x3a23, 0x2a2a, 0x3a3c, 0x2995, 0x3a53, 0x2908, 0x3a6a, 0x2884, 0x3a7e, 0x2809, 0x3a93, 0x2733,
+    0x3aa6, 0x2669, 0x3ab9, 0x25ae, 0x3acb, 0x2504, 0x3adb, 0x2467, 0x3aeb, 0x23ad, 0x3af9, 0x22ac, 0x3b07, 0x21c4, 0x3b14, 0x20f1,
+    0x3b20, 0x203a, 0x3b2c, 0x1f33, 0x3b37, 0x1e19, 0x3b41, 0x1d20, 0x3b4a, 0x1c43, 0x3b53, 0x1b0f, 0x3b5b, 0x19d1, 0x3b62, 0x18be,
+    0x3b69, 0x17b7, 0x3b70, 0x163a, 0x3b77, 0x14f3, 0x3b7e, 0x13bb, 0x3b85, 0x11fb, 0x3b8b, 0x1090, 0x3b91, 0x0efb, 0x3b97, 0x0d3b,
+    0x3b9e, 0x0bb8, 0x3ba4, 0x09a6, 0x3baa, 0x0821, 0x3baf, 0x05b3, 0x3bb4, 0x03af, 0x3bb8, 0x025f, 0x3bbc, 0x018a, 0x3bc1, 0x00e3,
+    0x387f, 0x3302, 0x3837, 0x3281, 0x380b, 0x3220, 0x37e5, 0x31d3, 0x37d1, 0x3193, 0x37d0, 0x3159, 0x37df, 0x3124, 0x37fa, 0x30f2,
+    0x380f, 0x30c1, 0x3825, 0x3090, 0x383d, 0x305f, 0x3858, 0x302e, 0x3875, 0x2ff8, 0x3893, 0x2f93, 0x38b2, 0x2f31, 0x38d1, 0x2ecd,
+    0x38f0, 0x2e68, 0x390f, 0x2e03, 0x392e, 0x2da0, 0x394d, 0x2d40, 0x396b, 0x2ce1, 0x3988, 0x2c86, 0x39a5, 0x2c2e, 0x39c1, 0x2bb2,
+    0x39dc, 0x2b0f, 0x39f6, 0x2a75, 0x3a0f, 0x29e2, 0x3a27, 0x2957, 0x3a3e, 0x28d5, 0x3a54, 0x285b, 0x3a69, 0x27d1, 0x3a7d, 0x26fd,
+    0x3a90, 0x2637, 0x3aa2, 0x2582, 0x3ab3, 0x24dc, 0x3ac3, 0x2449, 0x3ad3, 0x2387, 0x3ae2, 0x2295, 0x3af0, 0x21b6, 0x3afe, 0x20ee,
+    0x3b0a, 0x203d, 0x3b15, 0x1f39, 0x3b20, 0x1e19, 0x3b29, 0x1d25, 0x3b33, 0x1c53, 0x3b3b, 0x1b36, 0x3b43, 0x19f8, 0x3b4c, 0x18e2,
+    0x3b55, 0x17f3, 0x3b5d, 0x166e, 0x3b65, 0x1526, 0x3b6d, 0x141b, 0x3b75, 0x1278, 0x3b7c, 0x1105, 0x3b83, 0x0fa5, 0x3b89, 0x0dba,
+    0x3b90, 0x0c45, 0x3b96, 0x0a35, 0x3b9b, 0x087f, 0x3ba1, 0x0656, 0x3ba6, 0x0473, 0x3bab, 0x02de, 0x3bb0, 0x01b8, 0x3bb6, 0x00fd,
+    0x38a3, 0x3292, 0x385d, 0x321d, 0x3832, 0x31c2, 0x3818, 0x3179, 0x380b, 0x313b, 0x3808, 0x3103, 0x380c, 0x30d0, 0x3816, 0x309f,
+    0x3825, 0x306f, 0x3837, 0x3042, 0x384d, 0x3013, 0x3864, 0x2fc9, 0x387d, 0x2f6c, 0x3898, 0x2f0f, 0x38b4, 0x2eb1, 0x38d0, 0x2e57,
+    0x38ed, 0x2dfc, 0x390a, 0x2da0, 0x3927, 0x2d46, 0x3943, 0x2ced, 0x395f, 0x2c97, 0x397b, 0x2c43, 0x3996, 0x2be3, 0x39b0, 0x2b46,
+    0x39ca, 0x2ab0, 0x39e3, 0x2a22, 0x39fb, 0x299a, 0x3a13, 0x291a, 0x3a29, 0x28a0, 0x3a3e, 0x282e, 0x3a53, 0x2786, 0x3a67, 0x26c1,
+    0x3a79, 0x2609, 0x3a8b, 0x255d, 0x3a9c, 0x24bf, 0x3aab, 0x242e, 0x3abb, 0x2357, 0x3ac9, 0x2269, 0x3ad7, 0x2198, 0x3ae4, 0x20dd,
+    0x3af0, 0x2032, 0x3afb, 0x1f2f, 0x3b06, 0x1e22, 0x3b10, 0x1d35, 0x3b1a, 0x1c60, 0x3b24, 0x1b48, 0x3b2e, 0x1a11, 0x3b37, 0x1902,
+    0x3b40, 0x181a, 0x3b49, 0x16a8, 0x3b52, 0x1559, 0x3b5a, 0x1442, 0x3b62, 0x12b8, 0x3b6a, 0x1144, 0x3b72, 0x101a, 0x3b79, 0x0e3c,
+    0x3b80, 0x0ca3, 0x3b86, 0x0adc, 0x3b8c, 0x08fa, 0x3b92, 0x070a, 0x3b98, 0x04e0, 0x3b9e, 0x035a, 0x3ba5, 0x0228, 0x3ba9, 0x0136,
+    0x38c4, 0x3227, 0x3881, 0x31bd, 0x3856, 0x3169, 0x383b, 0x3124, 0x382c, 0x30e8, 0x3827, 0x30b3, 0x3828, 0x3081, 0x3830, 0x3052,
+    0x383b, 0x3024, 0x384a, 0x2fef, 0x385c, 0x2f99, 0x3871, 0x2f41, 0x3887, 0x2eea, 0x389e, 0x2e94, 0x38b7, 0x2e3d, 0x38d0, 0x2de7,
+    0x38eb, 0x2d95, 0x3905, 0x2d42, 0x3920, 0x2cf0, 0x393a, 0x2c9e, 0x3954, 0x2c4f, 0x396e, 0x2c01, 0x3988, 0x2b6e, 0x39a1, 0x2adf,
+    0x39b9, 0x2a54, 0x39d1, 0x29cf, 0x39e8, 0x2951, 0x39fe, 0x28da, 0x3a14, 0x286a, 0x3a28, 0x2800, 0x3a3c, 0x2739, 0x3a4f, 0x267e,
+    0x3a61, 0x25d1, 0x3a73, 0x2532, 0x3a83, 0x249f, 0x3a93, 0x2417, 0x3aa1, 0x2332, 0x3aaf, 0x224d, 0x3abc, 0x2180, 0x3ac8, 0x20c6,
+    0x3ad4, 0x2020, 0x3ae0, 0x1f1e, 0x3aec, 0x1e1e, 0x3af8, 0x1d34, 0x3b03, 0x1c66, 0x3b0e, 0x1b69, 0x3b18, 0x1a2d, 0x3b22, 0x1915,
+    0x3b2b, 0x182c, 0x3b35, 0x16d9, 0x3b3e, 0x158b, 0x3b47, 0x1471, 0x3b4f, 0x1305, 0x3b58, 0x1187, 0x3b5f, 0x104d, 0x3b67, 0x0e99,
+    0x3b6e, 0x0d14, 0x3b75, 0x0b8c, 0x3b7b, 0x097c, 0x3b81, 0x07bf, 0x3b88, 0x0565, 0x3b8e, 0x03a1, 0x3b93, 0x024c, 0x3b99, 0x015b,
+    0x38e3, 0x31c3, 0x38a3, 0x3163, 0x3878, 0x3115, 0x385d, 0x30d4, 0x384c, 0x309b, 0x3845, 0x3067, 0x3844, 0x3038, 0x3848, 0x300a,
+    0x3851, 0x2fbe, 0x385d, 0x2f68, 0x386c, 0x2f16, 0x387e, 0x2ec4, 0x3891, 0x2e72, 0x38a6, 0x2e22, 0x38bc, 0x2dd2, 0x38d2, 0x2d81,
+    0x38ea, 0x2d32, 0x3902, 0x2ce6, 0x391a, 0x2c9c, 0x3933, 0x2c53, 0x394b, 0x2c0a, 0x3963, 0x2b85, 0x397a, 0x2afb, 0x3992, 0x2a77,
+    0x39a9, 0x29f9, 0x39bf, 0x297f, 0x39d5, 0x290a, 0x39ea, 0x289b, 0x39fe, 0x2832, 0x3a12, 0x279f, 0x3a24, 0x26e6, 0x3a37, 0x263b,
+    0x3a48, 0x2598, 0x3a59, 0x2501, 0x3a69, 0x2475, 0x3a78, 0x23f0, 0x3a87, 0x2305, 0x3a94, 0x222f, 0x3aa1, 0x216b, 0x3aae, 0x20b7,
+    0x3abb, 0x2016, 0x3ac8, 0x1f0e, 0x3ad4, 0x1e0d, 0x3ae0, 0x1d2d, 0x3aec, 0x1c69, 0x3af8, 0x1b76, 0x3b03, 0x1a42, 0x3b0d, 0x1937,
+    0x3b18, 0x1854, 0x3b21, 0x1712, 0x3b2a, 0x15b5, 0x3b33, 0x149e, 0x3b3c, 0x1361, 0x3b44, 0x11d4, 0x3b4b, 0x1083, 0x3b52, 0x0ef4,
+    0x3b5a, 0x0d52, 0x3b61, 0x0bff, 0x3b69, 0x09fd, 0x3b70, 0x084e, 0x3b76, 0x0602, 0x3b7b, 0x03fb, 0x3b81, 0x0271, 0x3b87, 0x0169,
+    0x38ff, 0x3165, 0x38c2, 0x310e, 0x3898, 0x30c6, 0x387c, 0x3088, 0x386b, 0x3052, 0x3861, 0x3021, 0x385e, 0x2fe6, 0x3860, 0x2f90,
+    0x3866, 0x2f3c, 0x3870, 0x2eeb, 0x387c, 0x2e9b, 0x388b, 0x2e4f, 0x389b, 0x2e03, 0x38ae, 0x2db7, 0x38c1, 0x2d6d, 0x38d5, 0x2d23,
+    0x38ea, 0x2cda, 0x38ff, 0x2c91, 0x3915, 0x2c4b, 0x392b, 0x2c09, 0x3942, 0x2b8e, 0x3958, 0x2b0c, 0x396e, 0x2a8e, 0x3983, 0x2a14,
+    0x3998, 0x299e, 0x39ad, 0x292e, 0x39c1, 0x28c3, 0x39d5, 0x285c, 0x39e8, 0x27f7, 0x39fa, 0x2740, 0x3a0c, 0x2692, 0x3a1e, 0x25f1,
+    0x3a2f, 0x255b, 0x3a3f, 0x24d1, 0x3a4e, 0x244e, 0x3a5d, 0x23ab, 0x3a6a, 0x22ca, 0x3a79, 0x2204, 0x3a88, 0x214c, 0x3a95, 0x20a4,
+    0x3aa3, 0x200b, 0x3ab0, 0x1efe, 0x3abd, 0x1e05, 0x3ac9, 0x1d28, 0x3ad5, 0x1c64, 0x3ae1, 0x1b72, 0x3aec, 0x1a4a, 0x3af7, 0x1947,
+    0x3b01, 0x1863, 0x3b0b, 0x173d, 0x3b15, 0x15f1, 0x3b1d, 0x14cf, 0x3b25, 0x13aa, 0x3b2d, 0x1216, 0x3b35, 0x10d1, 0x3b3d, 0x0f77,
+    0x3b45, 0x0da5, 0x3b4c, 0x0c30, 0x3b53, 0x0a2e, 0x3b59, 0x086b, 0x3b60, 0x065f, 0x3b68, 0x0444, 0x3b70, 0x02cc, 0x3b76, 0x019e,
+    0x3919, 0x310c, 0x38df, 0x30bd, 0x38b6, 0x307b, 0x389a, 0x3041, 0x3887, 0x300e, 0x387c, 0x2fbc, 0x3877, 0x2f66, 0x3877, 0x2f13,
+    0x387b, 0x2ec3, 0x3882, 0x2e77, 0x388c, 0x2e2b, 0x3898, 0x2de2, 0x38a6, 0x2d9b, 0x38b6, 0x2d54, 0x38c6, 0x2d0f, 0x38d8, 0x2cca,
+    0x38eb, 0x2c87, 0x38fe, 0x2c45, 0x3911, 0x2c02, 0x3925, 0x2b85, 0x3939, 0x2b0c, 0x394d, 0x2a96, 0x3961, 0x2a24, 0x3975, 0x29b3,
+    0x3988, 0x2947, 0x399b, 0x28df, 0x39ae, 0x287c, 0x39c0, 0x281e, 0x39d2, 0x278a, 0x39e4, 0x26df, 0x39f5, 0x2641, 0x3a05, 0x25ac,
+    0x3a14, 0x251e, 0x3a23, 0x249a, 0x3a32, 0x2420, 0x3a41, 0x2363, 0x3a50, 0x2292, 0x3a5f, 0x21d2, 0x3a6e, 0x211f, 0x3a7c, 0x2082,
+    0x3a8b, 0x1fe8, 0x3a98, 0x1ee4, 0x3aa6, 0x1df9, 0x3ab2, 0x1d24, 0x3abe, 0x1c64, 0x3ac9, 0x1b76, 0x3ad4, 0x1a49, 0x3ade, 0x1948,
+    0x3ae8, 0x186c, 0x3af2, 0x175c, 0x3afb, 0x160d, 0x3b05, 0x14f1, 0x3b0e, 0x1403, 0x3b16, 0x1266, 0x3b1e, 0x1102, 0x3b27, 0x0fd2,
+    0x3b2f, 0x0e19, 0x3b37, 0x0c9e, 0x3b3e, 0x0acc, 0x3b45, 0x08e4, 0x3b4d, 0x06d8, 0x3b54, 0x04b6, 0x3b5b, 0x02f3, 0x3b62, 0x01cc,
+    0x3930, 0x30b9, 0x38f9, 0x3072, 0x38d1, 0x3034, 0x38b5, 0x2ffc, 0x38a2, 0x2f9b, 0x3895, 0x2f40, 0x388f, 0x2eed, 0x388d, 0x2e9f,
+    0x388f, 0x2e53, 0x3894, 0x2e0a, 0x389b, 0x2dc4, 0x38a5, 0x2d7d, 0x38b1, 0x2d3a, 0x38be, 0x2cf9, 0x38cc, 0x2cb7, 0x38dc, 0x2c77,
+    0x38ec, 0x2c39, 0x38fd, 0x2bf7, 0x390e, 0x2b7f, 0x391f, 0x2b07, 0x3931, 0x2a93, 0x3943, 0x2a25, 0x3955, 0x29bc, 0x3967, 0x2956,
+    0x3978, 0x28f3, 0x398a, 0x2894, 0x399b, 0x2839, 0x39ac, 0x27c3, 0x39bd, 0x271e, 0x39cd, 0x2682, 0x39dc, 0x25ee, 0x39eb, 0x2561,
+    0x39fa, 0x24e0, 0x3a0a, 0x2467, 0x3a19, 0x23e8, 0x3a29, 0x2314, 0x3a38, 0x2250, 0x3a47, 0x21a0, 0x3a56, 0x20fa, 0x3a64, 0x2063,
+    0x3a72, 0x1fad, 0x3a7f, 0x1eb4, 0x3a8c, 0x1dd7, 0x3a98, 0x1d10, 0x3aa5, 0x1c5d, 0x3ab0, 0x1b78, 0x3abb, 0x1a56, 0x3ac5, 0x1959,
+    0x3ace, 0x1877, 0x3ad8, 0x1768, 0x3ae1, 0x1622, 0x3aeb, 0x1509, 0x3af4, 0x1418, 0x3afd, 0x1299, 0x3b06, 0x1149, 0x3b0f, 0x1025,
+    0x3b17, 0x0e59, 0x3b1f, 0x0cd8, 0x3b28, 0x0b58, 0x3b30, 0x0964, 0x3b37, 0x0797, 0x3b3e, 0x0525, 0x3b45, 0x0356, 0x3b4b, 0x01e6,
+    0x3945, 0x306c, 0x3911, 0x302a, 0x38ea, 0x2fe3, 0x38ce, 0x2f7d, 0x38ba, 0x2f22, 0x38ad, 0x2ecc, 0x38a5, 0x2e7d, 0x38a1, 0x2e32,
+    0x38a1, 0x2dea, 0x38a4, 0x2da5, 0x38aa, 0x2d62, 0x38b1, 0x2d21, 0x38bb, 0x2ce0, 0x38c6, 0x2ca2, 0x38d2, 0x2c66, 0x38df, 0x2c2a,
+    0x38ed, 0x2bde, 0x38fb, 0x2b6d, 0x390b, 0x2afe, 0x391a, 0x2a92, 0x392a, 0x2a27, 0x3939, 0x29bf, 0x3949, 0x295c, 0x3959, 0x28fd,
+    0x396a, 0x28a3, 0x397a, 0x284d, 0x3989, 0x27f1, 0x3999, 0x2751, 0x39a7, 0x26b8, 0x39b6, 0x2626, 0x39c4, 0x259d, 0x39d4, 0x251d,
+    0x39e3, 0x24a2, 0x39f3, 0x2430, 0x3a03, 0x238c, 0x3a12, 0x22c9, 0x3a21, 0x2212, 0x3a30, 0x2168, 0x3a3e, 0x20cc, 0x3a4c, 0x2041,
+    0x3a59, 0x1f7d, 0x3a66, 0x1e91, 0x3a72, 0x1db6, 0x3a7d, 0x1cf2, 0x3a89, 0x1c48, 0x3a94, 0x1b5b, 0x3a9e, 0x1a4d, 0x3aa9, 0x195b,
+    0x3ab3, 0x1882, 0x3abd, 0x1788, 0x3ac7, 0x1638, 0x3ad0, 0x1519, 0x3ada, 0x142a, 0x3ae3, 0x12ba, 0x3aeb, 0x1161, 0x3af4, 0x1041,
+    0x3afd, 0x0eb1, 0x3b06, 0x0d1e, 0x3b0d, 0x0b98, 0x3b16, 0x09a1, 0x3b1d, 0x0812, 0x3b24, 0x058c, 0x3b2c, 0x0394, 0x3b34, 0x0227,
+    0x3958, 0x3023, 0x3926, 0x2fcf, 0x3901, 0x2f66, 0x38e5, 0x2f07, 0x38d1, 0x2eb0, 0x38c3, 0x2e60, 0x38ba, 0x2e14, 0x38b5, 0x2dcc,
+    0x38b3, 0x2d88, 0x38b4, 0x2d47, 0x38b8, 0x2d07, 0x38bd, 0x2cc9, 0x38c4, 0x2c8d, 0x38cd, 0x2c52, 0x38d7, 0x2c19, 0x38e2, 0x2bc4,
+    0x38ee, 0x2b56, 0x38fa, 0x2aeb, 0x3907, 0x2a84, 0x3915, 0x2a21, 0x3922, 0x29c1, 0x3930, 0x2961, 0x393f, 0x2905, 0x394d, 0x28ac,
+    0x395b, 0x2858, 0x3969, 0x2807, 0x3977, 0x2776, 0x3984, 0x26e2, 0x3993, 0x2655, 0x39a1, 0x25d0, 0x39b0, 0x2551, 0x39bf, 0x24d9,
+    0x39cf, 0x2468, 0x39de, 0x23fe, 0x39ed, 0x2336, 0x39fc, 0x227b, 0x3a0a, 0x21d1, 0x3a18, 0x2134, 0x3a25, 0x20a1, 0x3a32, 0x201a,
+    0x3a3f, 0x1f3d, 0x3a4b, 0x1e63, 0x3a57, 0x1d97, 0x3a62, 0x1cdf, 0x3a6c, 0x1c35, 0x3a77, 0x1b3b, 0x3a81, 0x1a33, 0x3a8c, 0x1948,
+    0x3a97, 0x187c, 0x3aa1, 0x178f, 0x3aac, 0x164f, 0x3ab5, 0x1539, 0x3abe, 0x1442, 0x3ac7, 0x12e0, 0x3ad0, 0x1185, 0x3ad8, 0x105e,
+    0x3ae1, 0x0ecd, 0x3ae9, 0x0d3d, 0x3af1, 0x0c00, 0x3af9, 0x09d7, 0x3b01, 0x0824, 0x3b09, 0x05d0, 0x3b11, 0x03cc, 0x3b19, 0x023d,
+    0x3968, 0x2fbf, 0x3939, 0x2f52, 0x3916, 0x2ef0, 0x38fa, 0x2e97, 0x38e6, 0x2e46, 0x38d7, 0x2dfa, 0x38cd, 0x2db2, 0x38c6, 0x2d6d,
+    0x38c3, 0x2d2d, 0x38c3, 0x2cef, 0x38c4, 0x2cb3, 0x38c8, 0x2c78, 0x38cd, 0x2c3f, 0x38d4, 0x2c08, 0x38dc, 0x2ba3, 0x38e5, 0x2b3b,
+    0x38ee, 0x2ad7, 0x38f9, 0x2a74, 0x3904, 0x2a14, 0x390f, 0x29b7, 0x391b, 0x295e, 0x3928, 0x2908, 0x3934, 0x28b4, 0x3940, 0x2861,
+    0x394c, 0x2812, 0x3958, 0x278e, 0x3965, 0x26fe, 0x3972, 0x2677, 0x3980, 0x25f6, 0x398f, 0x257a, 0x399e, 0x2506, 0x39ad, 0x2497,
+    0x39bb, 0x242e, 0x39ca, 0x2398, 0x39d8, 0x22e0, 0x39e5, 0x2236, 0x39f3, 0x2194, 0x39ff, 0x20fc, 0x3a0c, 0x2074, 0x3a18, 0x1feb,
+    0x3a23, 0x1f01, 0x3a2e, 0x1e2b, 0x3a39, 0x1d67, 0x3a44, 0x1cbb, 0x3a4f, 0x1c1e, 0x3a5a, 0x1b20, 0x3a65, 0x1a1c, 0x3a6f, 0x1935,
+    0x3a7a, 0x186c, 0x3a83, 0x1775, 0x3a8d, 0x1642, 0x3a96, 0x1537, 0x3aa0, 0x144d, 0x3aaa, 0x1308, 0x3ab2, 0x11a3, 0x3abc, 0x107c,
+    0x3ac4, 0x0f0f, 0x3acd, 0x0d71, 0x3ad5, 0x0c20, 0x3ade, 0x0a29, 0x3ae6, 0x086c, 0x3aee, 0x0611, 0x3af6, 0x03fd, 0x3afe, 0x026c,
+    0x3976, 0x2f40, 0x394a, 0x2edc, 0x3928, 0x2e81, 0x390d, 0x2e2f, 0x38f9, 0x2de2, 0x38e9, 0x2d9a, 0x38de, 0x2d56, 0x38d6, 0x2d15,
+    0x38d2, 0x2cd7, 0x38d0, 0x2c9c, 0x38d0, 0x2c64, 0x38d2, 0x2c2c, 0x38d5, 0x2bed, 0x38da, 0x2b85, 0x38e0, 0x2b20, 0x38e7, 0x2abd,
+    0x38ef, 0x2a60, 0x38f7, 0x2a05, 0x3900, 0x29ab, 0x390a, 0x2954, 0x3914, 0x2901, 0x391f, 0x28b1, 0x3929, 0x2864, 0x3933, 0x281a,
+    0x393e, 0x27a2, 0x394a, 0x2716, 0x3955, 0x2690, 0x3962, 0x2612, 0x3970, 0x259a, 0x397e, 0x2529, 0x398c, 0x24bc, 0x399a, 0x2455,
+    0x39a7, 0x23eb, 0x39b4, 0x2335, 0x39c1, 0x2288, 0x39ce, 0x21e7, 0x39da, 0x2153, 0x39e6, 0x20c9, 0x39f1, 0x2047, 0x39fc, 0x1f9c,
+    0x3a07, 0x1ec2, 0x3a12, 0x1dfa, 0x3a1d, 0x1d42, 0x3a28, 0x1c99, 0x3a33, 0x1c01, 0x3a3e, 0x1af7, 0x3a48, 0x1a03, 0x3a52, 0x192a,
+    0x3a5c, 0x1862, 0x3a65, 0x1766, 0x3a6f, 0x1635, 0x3a78, 0x152d, 0x3a82, 0x1448, 0x3a8c, 0x130b, 0x3a95, 0x11bc, 0x3a9e, 0x109c,
+    0x3aa7, 0x0f39, 0x3ab0, 0x0da6, 0x3ab8, 0x0c52, 0x3ac1, 0x0a6a, 0x3ac9, 0x08a5, 0x3ad1, 0x068b, 0x3ad8, 0x0448, 0x3ae0, 0x0295,
+    0x3983, 0x2eca, 0x3959, 0x2e6e, 0x3938, 0x2e1a, 0x391e, 0x2dcd, 0x3909, 0x2d84, 0x38fa, 0x2d41, 0x38ee, 0x2d01, 0x38e5, 0x2cc3,
+    0x38df, 0x2c88, 0x38dc, 0x2c50, 0x38da, 0x2c1a, 0x38db, 0x2bcb, 0x38dc, 0x2b65, 0x38df, 0x2b03, 0x38e4, 0x2aa6, 0x38e9, 0x2a4a,
+    0x38ef, 0x29f1, 0x38f5, 0x299c, 0x38fd, 0x294a, 0x3905, 0x28f9, 0x390d, 0x28ab, 0x3915, 0x2860, 0x391d, 0x2818, 0x3927, 0x27a9,
+    0x3931, 0x2727, 0x393c, 0x26a6, 0x3948, 0x262a, 0x3955, 0x25b4, 0x3961, 0x2544, 0x396e, 0x24d9, 0x397a, 0x2475, 0x3987, 0x2418,
+    0x3993, 0x2379, 0x399f, 0x22d0, 0x39ab, 0x2233, 0x39b6, 0x219e, 0x39c1, 0x2113, 0x39cb, 0x2090, 0x39d6, 0x2019, 0x39e1, 0x1f52,
+    0x39eb, 0x1e83, 0x39f6, 0x1dc3, 0x3a02, 0x1d17, 0x3a0c, 0x1c79, 0x3a17, 0x1bd2, 0x3a21, 0x1acc, 0x3a2b, 0x19e2, 0x3a35, 0x1914,
+    0x3a3f, 0x185a, 0x3a49, 0x176a, 0x3a52, 0x1639, 0x3a5b, 0x1533, 0x3a65, 0x144e, 0x3a6e, 0x1317, 0x3a76, 0x11c4, 0x3a7f, 0x10a4,
+    0x3a88, 0x0f69, 0x3a91, 0x0dcd, 0x3a99, 0x0c6b, 0x3aa1, 0x0aa4, 0x3aa9, 0x08d1, 0x3ab1, 0x06c4, 0x3ab9, 0x0484, 0x3ac1, 0x02ba,
+    0x398d, 0x2e5c, 0x3966, 0x2e07, 0x3946, 0x2db9, 0x392d, 0x2d70, 0x3918, 0x2d2d, 0x3908, 0x2cec, 0x38fc, 0x2cb0, 0x38f2, 0x2c76,
+    0x38eb, 0x2c3e, 0x38e6, 0x2c08, 0x38e4, 0x2baa, 0x38e2, 0x2b47, 0x38e2, 0x2ae8, 0x38e4, 0x2a8c, 0x38e7, 0x2a33, 0x38ea, 0x29de,
+    0x38ee, 0x298b, 0x38f3, 0x293a, 0x38f9, 0x28ee, 0x38ff, 0x28a4, 0x3905, 0x285c, 0x390c, 0x2816, 0x3914, 0x27a6, 0x391c, 0x2726,
+    0x3925, 0x26ad, 0x3931, 0x2639, 0x393c, 0x25c9, 0x3947, 0x255c, 0x3953, 0x24f4, 0x395e, 0x2491, 0x3969, 0x2433, 0x3974, 0x23b4,
+    0x397e, 0x230f, 0x3989, 0x2272, 0x3993, 0x21dc, 0x399d, 0x2152, 0x39a7, 0x20d1, 0x39b1, 0x2058, 0x39bc, 0x1fd0, 0x39c6, 0x1f00,
+    0x39d1, 0x1e41, 0x39dc, 0x1d8f, 0x39e6, 0x1ceb, 0x39f0, 0x1c54, 0x39fa, 0x1b9a, 0x3a03, 0x1aa0, 0x3a0d, 0x19c1, 0x3a17, 0x18f6,
+    0x3a20, 0x1843, 0x3a2a, 0x174a, 0x3a34, 0x1633, 0x3a3d, 0x153b, 0x3a45, 0x1456, 0x3a4e, 0x1323, 0x3a57, 0x11cf, 0x3a60, 0x10b7,
+    0x3a68, 0x0f81, 0x3a70, 0x0de4, 0x3a78, 0x0c92, 0x3a80, 0x0ad6, 0x3a88, 0x0904, 0x3a90, 0x0700, 0x3a98, 0x04a9, 0x3aa0, 0x02e0,
+    0x3996, 0x2df5, 0x3971, 0x2da6, 0x3952, 0x2d5e, 0x3939, 0x2d1a, 0x3925, 0x2cda, 0x3915, 0x2c9e, 0x3908, 0x2c65, 0x38fd, 0x2c2e,
+    0x38f6, 0x2bf2, 0x38f0, 0x2b8c, 0x38eb, 0x2b2b, 0x38e9, 0x2acd, 0x38e8, 0x2a74, 0x38e8, 0x2a1e, 0x38e8, 0x29ca, 0x38ea, 0x297a,
+    0x38ed, 0x292c, 0x38f0, 0x28e1, 0x38f4, 0x2899, 0x38f8, 0x2854, 0x38fd, 0x2813, 0x3904, 0x27a5, 0x390a, 0x2728, 0x3912, 0x26b0,
+    0x391c, 0x263c, 0x3926, 0x25d0, 0x3930, 0x2569, 0x393a, 0x2507, 0x3943, 0x24a6, 0x394d, 0x244b, 0x3957, 0x23e8, 0x3960, 0x2343,
+    0x3969, 0x22a7, 0x3972, 0x2213, 0x397b, 0x218b, 0x3984, 0x2109, 0x398e, 0x208f, 0x3998, 0x201f, 0x39a2, 0x1f6e, 0x39ac, 0x1eaa,
+    0x39b6, 0x1df8, 0x39c0, 0x1d53, 0x39c9, 0x1cba, 0x39d3, 0x1c2d, 0x39dc, 0x1b59, 0x39e5, 0x1a6e, 0x39ef, 0x199c, 0x39f8, 0x18da,
+    0x3a01, 0x182c, 0x3a0a, 0x171d, 0x3a13, 0x160f, 0x3a1b, 0x151f, 0x3a25, 0x1450, 0x3a2e, 0x132b, 0x3a36, 0x11de, 0x3a3d, 0x10bd,
+    0x3a45, 0x0f92, 0x3a4d, 0x0df8, 0x3a55, 0x0c9c, 0x3a5e, 0x0b09, 0x3a66, 0x0923, 0x3a6e, 0x075a, 0x3a76, 0x04e8, 0x3a7d, 0x0304,
+    0x399c, 0x2d95, 0x3979, 0x2d4c, 0x395c, 0x2d09, 0x3944, 0x2cc9, 0x3930, 0x2c8d, 0x3920, 0x2c54, 0x3912, 0x2c1e, 0x3907, 0x2bd5,
+    0x38fe, 0x2b70, 0x38f7, 0x2b10, 0x38f2, 0x2ab4, 0x38ee, 0x2a5d, 0x38ec, 0x2a09, 0x38ea, 0x29b8, 0x38ea, 0x2969, 0x38ea, 0x291d,
+    0x38eb, 0x28d5, 0x38ed, 0x288f, 0x38ef, 0x284b, 0x38f2, 0x280b, 0x38f6, 0x279a, 0x38fb, 0x2725, 0x3902, 0x26b2, 0x390a, 0x2642,
+    0x3912, 0x25d8, 0x391a, 0x2570, 0x3923, 0x250e, 0x392b, 0x24b2, 0x3933, 0x245b, 0x393c, 0x2407, 0x3944, 0x236e, 0x394c, 0x22d4,
+    0x3953, 0x2244, 0x395b, 0x21bc, 0x3964, 0x213b, 0x396d, 0x20c4, 0x3977, 0x2053, 0x3980, 0x1fd2, 0x3989, 0x1f0d, 0x3992, 0x1e57,
+    0x399a, 0x1dae, 0x39a3, 0x1d11, 0x39ac, 0x1c82, 0x39b5, 0x1c01, 0x39be, 0x1b0f, 0x39c6, 0x1a32, 0x39cf, 0x1967, 0x39d8, 0x18b3,
+    0x39e1, 0x1811, 0x39e9, 0x16fa, 0x39f1, 0x15ee, 0x39fa, 0x14ff, 0x3a02, 0x1433, 0x3a0a, 0x1303, 0x3a12, 0x11d5, 0x3a1b, 0x10bf,
+    0x3a23, 0x0fa6, 0x3a2a, 0x0e00, 0x3a33, 0x0cb3, 0x3a3b, 0x0b1d, 0x3a43, 0x094b, 0x3a4a, 0x0785, 0x3a52, 0x051e, 0x3a59, 0x0326,
+    0x39a1, 0x2d3b, 0x3980, 0x2cf8, 0x3964, 0x2cb9, 0x394d, 0x2c7d, 0x3939, 0x2c45, 0x3929, 0x2c0f, 0x391b, 0x2bb8, 0x390f, 0x2b56,
+    0x3906, 0x2af8, 0x38fe, 0x2a9d, 0x38f7, 0x2a46, 0x38f2, 0x29f4, 0x38ef, 0x29a5, 0x38ec, 0x2958, 0x38ea, 0x290f, 0x38e9, 0x28c8,
+    0x38e9, 0x2885, 0x38e9, 0x2843, 0x38ea, 0x2804, 0x38ec, 0x278f, 0x38ef, 0x2719, 0x38f5, 0x26aa, 0x38fb, 0x2641, 0x3902, 0x25db,
+    0x3908, 0x2577, 0x390f, 0x2518, 0x3916, 0x24bc, 0x391c, 0x2464, 0x3923, 0x2412, 0x392a, 0x238b, 0x3930, 0x22f7, 0x3937, 0x226a,
+    0x393f, 0x21e5, 0x3947, 0x2168, 0x394f, 0x20f1, 0x3957, 0x2081, 0x395f, 0x2018, 0x3967, 0x1f6d, 0x396f, 0x1eb4, 0x3977, 0x1e08,
+    0x397f, 0x1d69, 0x3987, 0x1cd7, 0x398f, 0x1c4f, 0x3997, 0x1ba2, 0x399f, 0x1abf, 0x39a8, 0x19f5, 0x39b0, 0x1937, 0x39b8, 0x188a,
+    0x39c0, 0x17d9, 0x39c9, 0x16c9, 0x39d0, 0x15cf, 0x39d8, 0x14f0, 0x39e0, 0x1424, 0x39e8, 0x12e4, 0x39ef, 0x11af, 0x39f7, 0x10ad,
+    0x39ff, 0x0f9e, 0x3a07, 0x0e10, 0x3a0f, 0x0cb6, 0x3a16, 0x0b36, 0x3a1d, 0x0955, 0x3a24, 0x07a4, 0x3a2c, 0x0527, 0x3a33, 0x033b,
+    0x39a5, 0x2ce8, 0x3985, 0x2ca9, 0x396b, 0x2c6e, 0x3954, 0x2c37, 0x3940, 0x2c02, 0x3930, 0x2b9e, 0x3922, 0x2b3c, 0x3915, 0x2adf,
+    0x390b, 0x2a87, 0x3902, 0x2a31, 0x38fb, 0x29e0, 0x38f5, 0x2992, 0x38f0, 0x2946, 0x38ec, 0x28ff, 0x38e9, 0x28bc, 0x38e7, 0x2879,
+    0x38e5, 0x2839, 0x38e4, 0x27f9, 0x38e5, 0x2784, 0x38e6, 0x2712, 0x38ea, 0x26a4, 0x38ee, 0x263a, 0x38f3, 0x25d6, 0x38f8, 0x2577,
+    0x38fd, 0x251c, 0x3903, 0x24c2, 0x3908, 0x246e, 0x390d, 0x241d, 0x3912, 0x239f, 0x3918, 0x230c, 0x391d, 0x2284, 0x3924, 0x2204,
+    0x392b, 0x2188, 0x3932, 0x2113, 0x3939, 0x20a5, 0x3940, 0x203e, 0x3947, 0x1fba, 0x394e, 0x1f04, 0x3955, 0x1e5a, 0x395c, 0x1dbc,
+    0x3964, 0x1d27, 0x396b, 0x1c9c, 0x3973, 0x1c1f, 0x397b, 0x1b55, 0x3982, 0x1a7d, 0x398a, 0x19b6, 0x3991, 0x1905, 0x3999, 0x1865,
+    0x39a0, 0x17a2, 0x39a7, 0x1695, 0x39af, 0x15a2, 0x39b7, 0x14d3, 0x39be, 0x1416, 0x39c5, 0x12dc, 0x39cc, 0x11a9, 0x39d3, 0x109f,
+    0x39da, 0x0f78, 0x39e2, 0x0e05, 0x39ea, 0x0cbb, 0x39f1, 0x0b47, 0x39f7, 0x096c, 0x39ff, 0x07d0, 0x3a06, 0x055c, 0x3a0d, 0x035c,
+    0x39a7, 0x2c9a, 0x3989, 0x2c60, 0x396f, 0x2c29, 0x3959, 0x2be9, 0x3946, 0x2b85, 0x3935, 0x2b25, 0x3927, 0x2ac9, 0x391a, 0x2a71,
+    0x390f, 0x2a1e, 0x3906, 0x29ce, 0x38fe, 0x2981, 0x38f7, 0x2937, 0x38f1, 0x28f0, 0x38ec, 0x28ad, 0x38e8, 0x286d, 0x38e4, 0x282f,
+    0x38e1, 0x27e7, 0x38e0, 0x2774, 0x38df, 0x2706, 0x38e1, 0x269c, 0x38e4, 0x2636, 0x38e7, 0x25d3, 0x38eb, 0x2574, 0x38ee, 0x251a,
+    0x38f2, 0x24c5, 0x38f6, 0x2474, 0x38fa, 0x2425, 0x38fe, 0x23b5, 0x3902, 0x2325, 0x3906, 0x229c, 0x390c, 0x221b, 0x3911, 0x21a1,
+    0x3917, 0x2131, 0x391d, 0x20c4, 0x3923, 0x205e, 0x3929, 0x1ffd, 0x392f, 0x1f4a, 0x3935, 0x1e9f, 0x393c, 0x1e03, 0x3942, 0x1d6f,
+    0x394a, 0x1ce8, 0x3951, 0x1c67, 0x3957, 0x1bdf, 0x395e, 0x1b02, 0x3965, 0x1a3b, 0x396c, 0x1981, 0x3973, 0x18d7, 0x3979, 0x183b,
+    0x3980, 0x1764, 0x3987, 0x1669, 0x398e, 0x1584, 0x3994, 0x14b1, 0x399b, 0x13f6, 0x39a2, 0x12b8, 0x39a9, 0x119f, 0x39b0, 0x10a0,
+    0x39b7, 0x0f83, 0x39bd, 0x0df9, 0x39c4, 0x0cb9, 0x39ca, 0x0b51, 0x39d1, 0x097e, 0x39d8, 0x07ee, 0x39df, 0x0571, 0x39e5, 0x0373,
+    0x39a7, 0x2c51, 0x398b, 0x2c1b, 0x3972, 0x2bcf, 0x395d, 0x2b6d, 0x394a, 0x2b0e, 0x3939, 0x2ab4, 0x392a, 0x2a5d, 0x391d, 0x2a0a,
+    0x3912, 0x29bb, 0x3908, 0x2970, 0x38ff, 0x2927, 0x38f7, 0x28e1, 0x38f0, 0x28a0, 0x38ea, 0x2860, 0x38e5, 0x2823, 0x38e0, 0x27d4,
+    0x38dd, 0x2766, 0x38db, 0x26f9, 0x38da, 0x2692, 0x38dc, 0x262e, 0x38de, 0x25cf, 0x38e0, 0x2573, 0x38e1, 0x251a, 0x38e4, 0x24c5,
+    0x38e6, 0x2475, 0x38e8, 0x2429, 0x38eb, 0x23c4, 0x38ee, 0x2339, 0x38f2, 0x22b5, 0x38f6, 0x2237, 0x38fa, 0x21be, 0x38ff, 0x214c,
+    0x3904, 0x20e0, 0x3909, 0x207c, 0x390d, 0x201d, 0x3913, 0x1f86, 0x3917, 0x1edd, 0x391d, 0x1e41, 0x3923, 0x1dad, 0x3929, 0x1d23,
+    0x392f, 0x1ca4, 0x3935, 0x1c2e, 0x393b, 0x1b80, 0x3941, 0x1ab1, 0x3947, 0x19f1, 0x394d, 0x1943, 0x3953, 0x18a7, 0x3959, 0x1813,
+    0x395f, 0x171d, 0x3965, 0x162b, 0x396b, 0x1559, 0x3971, 0x1497, 0x3978, 0x13cd, 0x397e, 0x128c, 0x3985, 0x1179, 0x398b, 0x108d,
+    0x3991, 0x0f75, 0x3997, 0x0e00, 0x399d, 0x0cb5, 0x39a4, 0x0b4b, 0x39aa, 0x0984, 0x39b0, 0x0807, 0x39b6, 0x058d, 0x39bd, 0x0385,
+    0x39a6, 0x2c0e, 0x398b, 0x2bb6, 0x3973, 0x2b56, 0x395e, 0x2af9, 0x394c, 0x2aa0, 0x393b, 0x2a4a, 0x392c, 0x29f8, 0x391f, 0x29aa,
+    0x3913, 0x295f, 0x3908, 0x2918, 0x38ff, 0x28d4, 0x38f6, 0x2893, 0x38ef, 0x2855, 0x38e8, 0x2819, 0x38e1, 0x27bf, 0x38dc, 0x2753,
+    0x38d8, 0x26ec, 0x38d6, 0x2687, 0x38d6, 0x2625, 0x38d6, 0x25c8, 0x38d6, 0x256e, 0x38d7, 0x2518, 0x38d8, 0x24c6, 0x38d9, 0x2477,
+    0x38d9, 0x242b, 0x38db, 0x23c9, 0x38dd, 0x2342, 0x38df, 0x22c4, 0x38e2, 0x224a, 0x38e5, 0x21d4, 0x38e9, 0x2167, 0x38ed, 0x20fd,
+    0x38f0, 0x2097, 0x38f4, 0x2038, 0x38f8, 0x1fbe, 0x38fc, 0x1f1a, 0x3900, 0x1e7c, 0x3906, 0x1de7, 0x390b, 0x1d5d, 0x3910, 0x1cdd,
+    0x3914, 0x1c64, 0x3919, 0x1bea, 0x391f, 0x1b1c, 0x3924, 0x1a62, 0x3929, 0x19b0, 0x392e, 0x190c, 0x3934, 0x1872, 0x3939, 0x17d4,
+    0x393e, 0x16d9, 0x3943, 0x15f2, 0x3948, 0x1523, 0x394e, 0x146a, 0x3955, 0x138f, 0x395a, 0x126a, 0x395f, 0x1158, 0x3965, 0x106c,
+    0x396a, 0x0f3f, 0x3970, 0x0de3, 0x3977, 0x0cb2, 0x397c, 0x0b45, 0x3982, 0x097e, 0x3987, 0x0803, 0x398e, 0x059c, 0x3993, 0x039f,
+    0x39a3, 0x2b9d, 0x398a, 0x2b3f, 0x3973, 0x2ae4, 0x395f, 0x2a8c, 0x394c, 0x2a38, 0x393c, 0x29e7, 0x392d, 0x299a, 0x391f, 0x2950,
+    0x3913, 0x2909, 0x3908, 0x28c7, 0x38fd, 0x2887, 0x38f4, 0x284a, 0x38ec, 0x280f, 0x38e4, 0x27ae, 0x38dd, 0x2743, 0x38d7, 0x26da,
+    0x38d2, 0x2678, 0x38d1, 0x261b, 0x38d0, 0x25c0, 0x38cf, 0x2567, 0x38ce, 0x2513, 0x38cd, 0x24c4, 0x38cd, 0x2477, 0x38cd, 0x242f,
+    0x38cd, 0x23d0, 0x38cd, 0x2349, 0x38ce, 0x22cb, 0x38d0, 0x2253, 0x38d2, 0x21e2, 0x38d5, 0x2177, 0x38d7, 0x210f, 0x38da, 0x20af,
+    0x38dc, 0x2052, 0x38df, 0x1ff3, 0x38e2, 0x1f4b, 0x38e6, 0x1ead, 0x38ea, 0x1e1c, 0x38ee, 0x1d94, 0x38f2, 0x1d12, 0x38f6, 0x1c99,
+    0x38fa, 0x1c2a, 0x38fe, 0x1b81, 0x3902, 0x1abd, 0x3906, 0x1a0b, 0x390b, 0x1966, 0x390f, 0x18d1, 0x3913, 0x1843, 0x3918, 0x177f,
+    0x391c, 0x1692, 0x3922, 0x15bb, 0x3927, 0x14f6, 0x392c, 0x1444, 0x3930, 0x1347, 0x3935, 0x1231, 0x393a, 0x113a, 0x393f, 0x1057,
+    0x3945, 0x0f1e, 0x394a, 0x0dc3, 0x394f, 0x0c9c, 0x3954, 0x0b3b, 0x3959, 0x097f, 0x395f, 0x080a, 0x3964, 0x05a0, 0x3969, 0x03a1,
+    0x399f, 0x2b27, 0x3987, 0x2acf, 0x3971, 0x2a79, 0x395d, 0x2a27, 0x394b, 0x29d7, 0x393b, 0x298b, 0x392c, 0x2942, 0x391e, 0x28fc,
+    0x3911, 0x28b9, 0x3905, 0x287a, 0x38fb, 0x283f, 0x38f1, 0x2806, 0x38e7, 0x279d, 0x38df, 0x2733, 0x38d8, 0x26cd, 0x38d1, 0x266b,
+    0x38ce, 0x260d, 0x38cb, 0x25b4, 0x38c9, 0x255f, 0x38c7, 0x250d, 0x38c5, 0x24be, 0x38c3, 0x2474, 0x38c2, 0x242d, 0x38c0, 0x23d3,
+    0x38c0, 0x2352, 0x38c0, 0x22d4, 0x38c0, 0x225a, 0x38c1, 0x21ea, 0x38c2, 0x2180, 0x38c3, 0x211b, 0x38c5, 0x20bd, 0x38c6, 0x2061,
+    0x38c8, 0x200c, 0x38ca, 0x1f77, 0x38cd, 0x1edd, 0x38d0, 0x1e4a, 0x38d3, 0x1dc0, 0x38d6, 0x1d40, 0x38d9, 0x1cc8, 0x38dc, 0x1c58,
+    0x38df, 0x1bdb, 0x38e2, 0x1b1a, 0x38e5, 0x1a65, 0x38e9, 0x19ba, 0x38ec, 0x191d, 0x38ef, 0x188e, 0x38f3, 0x180d, 0x38f7, 0x172a,
+    0x38fc, 0x164b, 0x3900, 0x157d, 0x3905, 0x14c7, 0x3909, 0x1421, 0x390d, 0x1311, 0x3911, 0x11fe, 0x3915, 0x110e, 0x391a, 0x103d,
+    0x391f, 0x0f04, 0x3923, 0x0dae, 0x3927, 0x0c85, 0x392c, 0x0b1a, 0x3931, 0x0970, 0x3935, 0x0804, 0x393a, 0x05a7, 0x393f, 0x03b5,
+    0x399a, 0x2ab9, 0x3983, 0x2a66, 0x396e, 0x2a16, 0x395b, 0x29c8, 0x3949, 0x297d, 0x3939, 0x2935, 0x392a, 0x28f0, 0x391b, 0x28ae,
+    0x390e, 0x286f, 0x3902, 0x2834, 0x38f7, 0x27f7, 0x38ec, 0x278b, 0x38e2, 0x2723, 0x38d9, 0x26bf, 0x38d1, 0x265f, 0x38cc, 0x2603,
+    0x38c8, 0x25aa, 0x38c4, 0x2555, 0x38c1, 0x2505, 0x38be, 0x24b9, 0x38bb, 0x2470, 0x38b8, 0x2429, 0x38b6, 0x23ce, 0x38b3, 0x234f,
+    0x38b2, 0x22d7, 0x38b1, 0x2264, 0x38b1, 0x21f5, 0x38b1, 0x2189, 0x38b1, 0x2124, 0x38b1, 0x20c6, 0x38b2, 0x206c, 0x38b2, 0x2018,
+    0x38b4, 0x1f91, 0x38b6, 0x1efa, 0x38b8, 0x1e6e, 0x38ba, 0x1de7, 0x38bc, 0x1d69, 0x38bd, 0x1cf1, 0x38bf, 0x1c80, 0x38c2, 0x1c18,
+    0x38c4, 0x1b6c, 0x38c6, 0x1ab5, 0x38c8, 0x1a09, 0x38cb, 0x196f, 0x38ce, 0x18dd, 0x38d1, 0x1854, 0x38d4, 0x17ae, 0x38d8, 0x16cf,
+    0x38dc, 0x1603, 0x38df, 0x1546, 0x38e2, 0x1494, 0x38e5, 0x13f1, 0x38e9, 0x12d5, 0x38ed, 0x11d3, 0x38f1, 0x10e9, 0x38f5, 0x101b,
+    0x38f8, 0x0ed1, 0x38fc, 0x0d9a, 0x3900, 0x0c7e, 0x3904, 0x0b03, 0x3908, 0x0965, 0x390c, 0x0802, 0x3910, 0x05ae, 0x3914, 0x03b7,
+    0x3994, 0x2a53, 0x397e, 0x2a05, 0x3969, 0x29b9, 0x3957, 0x296f, 0x3945, 0x2928, 0x3935, 0x28e4, 0x3926, 0x28a3, 0x3918, 0x2865,
+    0x390a, 0x282a, 0x38fd, 0x27e4, 0x38f2, 0x2779, 0x38e6, 0x2713, 0x38dc, 0x26b2, 0x38d3, 0x2653, 0x38cb, 0x25f8, 0x38c6, 0x25a1,
+    0x38c1, 0x254e, 0x38bc, 0x24fd, 0x38b8, 0x24b2, 0x38b4, 0x246b, 0x38b0, 0x2426, 0x38ac, 0x23c9, 0x38a9, 0x2349, 0x38a6, 0x22d2,
+    0x38a4, 0x2262, 0x38a3, 0x21f7, 0x38a2, 0x2191, 0x38a1, 0x212e, 0x38a0, 0x20cf, 0x389f, 0x2076, 0x389f, 0x2022, 0x389f, 0x1fa6,
+    0x38a0, 0x1f12, 0x38a1, 0x1e86, 0x38a2, 0x1e02, 0x38a3, 0x1d88, 0x38a4, 0x1d13, 0x38a5, 0x1ca4, 0x38a6, 0x1c3c, 0x38a7, 0x1bb5,
+    0x38a9, 0x1b01, 0x38aa, 0x1a57, 0x38ac, 0x19b8, 0x38ae, 0x1922, 0x38b0, 0x189c, 0x38b3, 0x181f, 0x38b6, 0x1753, 0x38b8, 0x1679,
+    0x38ba, 0x15b3, 0x38bd, 0x1506, 0x38c0, 0x1464, 0x38c2, 0x139e, 0x38c6, 0x128b, 0x38c9, 0x119d, 0x38cc, 0x10c4, 0x38ce, 0x0ffa,
+    0x38d1, 0x0e97, 0x38d4, 0x0d65, 0x38d8, 0x0c63, 0x38dc, 0x0af0, 0x38de, 0x094f, 0x38e2, 0x07eb, 0x38e5, 0x05a7, 0x38e9, 0x03c0,
+    0x398c, 0x29f3, 0x3977, 0x29aa, 0x3964, 0x2962, 0x3951, 0x291c, 0x3940, 0x28d9, 0x3930, 0x2899, 0x3921, 0x285b, 0x3912, 0x2821,
+    0x3905, 0x27d2, 0x38f8, 0x2769, 0x38eb, 0x2703, 0x38e0, 0x26a3, 0x38d5, 0x2647, 0x38cb, 0x25ee, 0x38c4, 0x2598, 0x38be, 0x2546,
+    0x38b9, 0x24f8, 0x38b3, 0x24ad, 0x38ae, 0x2466, 0x38a9, 0x2422, 0x38a4, 0x23c4, 0x38a0, 0x234a, 0x389c, 0x22d2, 0x3899, 0x2260,
+    0x3897, 0x21f6, 0x3894, 0x2191, 0x3892, 0x2132, 0x3890, 0x20d8, 0x388f, 0x2082, 0x388d, 0x202e, 0x388d, 0x1fbf, 0x388d, 0x1f2c,
+    0x388c, 0x1ea0, 0x388c, 0x1e1d, 0x388c, 0x1da1, 0x388c, 0x1d2b, 0x388c, 0x1cc0, 0x388c, 0x1c5b, 0x388c, 0x1bf6, 0x388d, 0x1b41,
+    0x388e, 0x1a97, 0x388e, 0x19fa, 0x3890, 0x1966, 0x3891, 0x18dd, 0x3893, 0x185b, 0x3895, 0x17c7, 0x3897, 0x16f2, 0x3898, 0x162b,
+    0x389a, 0x1570, 0x389b, 0x14c4, 0x389d, 0x142b, 0x38a0, 0x1343, 0x38a2, 0x1248, 0x38a4, 0x115c, 0x38a6, 0x1091, 0x38a8, 0x0fb3,
+    0x38ab, 0x0e68, 0x38ad, 0x0d3c, 0x38b0, 0x0c34, 0x38b2, 0x0ab8, 0x38b5, 0x093b, 0x38b8, 0x07cd, 0x38bb, 0x0591, 0x38be, 0x03b5,
+    0x3984, 0x299a, 0x3970, 0x2954, 0x395d, 0x2911, 0x394b, 0x28cf, 0x393a, 0x288f, 0x392a, 0x2852, 0x391b, 0x2818, 0x390c, 0x27c3,
+    0x38fe, 0x2759, 0x38f1, 0x26f5, 0x38e4, 0x2695, 0x38d8, 0x263a, 0x38cd, 0x25e3, 0x38c4, 0x258f, 0x38bd, 0x253e, 0x38b6, 0x24f1,
+    0x38b0, 0x24a8, 0x38aa, 0x2462, 0x38a3, 0x241e, 0x389e, 0x23bd, 0x3898, 0x2344, 0x3893, 0x22d2, 0x388f, 0x2264, 0x388c, 0x21f9,
+    0x3888, 0x2194, 0x3885, 0x2134, 0x3882, 0x20dc, 0x387f, 0x2087, 0x387d, 0x2038, 0x387c, 0x1fd8, 0x387b, 0x1f45, 0x3879, 0x1eba,
+    0x3878, 0x1e39, 0x3877, 0x1dbd, 0x3876, 0x1d49, 0x3875, 0x1cdb, 0x3874, 0x1c72, 0x3873, 0x1c14, 0x3873, 0x1b76, 0x3873, 0x1acf,
+    0x3873, 0x1a31, 0x3873, 0x199e, 0x3874, 0x1915, 0x3875, 0x1896, 0x3876, 0x181f, 0x3877, 0x1763, 0x3877, 0x1692, 0x3878, 0x15d9,
+    0x3879, 0x152c, 0x387b, 0x1490, 0x387c, 0x13f9, 0x387d, 0x12ef, 0x387e, 0x1202, 0x387f, 0x112b, 0x3881, 0x1061, 0x3883, 0x0f62,
+    0x3885, 0x0e2e, 0x3887, 0x0d1d, 0x3889, 0x0c24, 0x388a, 0x0a89, 0x388d, 0x0917, 0x388f, 0x07b3, 0x3891, 0x0589, 0x3893, 0x03ba,
+    0x397a, 0x2946, 0x3967, 0x2905, 0x3955, 0x28c5, 0x3943, 0x2886, 0x3932, 0x284a, 0x3922, 0x2810, 0x3913, 0x27b4, 0x3904, 0x274b,
+    0x38f6, 0x26e8, 0x38e9, 0x268a, 0x38dc, 0x262e, 0x38cf, 0x25d8, 0x38c4, 0x2584, 0x38bc, 0x2535, 0x38b4, 0x24e9, 0x38ad, 0x24a1,
+    0x38a6, 0x245d, 0x389f, 0x241b, 0x3898, 0x23b8, 0x3891, 0x233f, 0x388b, 0x22cd, 0x3886, 0x2262, 0x3882, 0x21fc, 0x387d, 0x219b,
+    0x3879, 0x213c, 0x3875, 0x20e2, 0x3872, 0x208d, 0x386e, 0x203e, 0x386c, 0x1fe6, 0x386a, 0x1f5a, 0x3868, 0x1ed3, 0x3866, 0x1e52,
+    0x3863, 0x1dd7, 0x3862, 0x1d66, 0x3860, 0x1cfa, 0x385e, 0x1c93, 0x385c, 0x1c32, 0x385b, 0x1baa, 0x3859, 0x1b01, 0x3859, 0x1a65,
+    0x3858, 0x19d1, 0x3859, 0x1949, 0x3859, 0x18c9, 0x3859, 0x1852, 0x3859, 0x17cd, 0x3859, 0x16fc, 0x3858, 0x163f, 0x3858, 0x158c,
+    0x3859, 0x14ea, 0x3859, 0x1455, 0x385a, 0x139a, 0x385a, 0x129f, 0x385b, 0x11bc, 0x385c, 0x10f2, 0x385d, 0x103c, 0x385f, 0x0f25,
+    0x385f, 0x0df5, 0x3860, 0x0cee, 0x3862, 0x0c08, 0x3863, 0x0a74, 0x3864, 0x08fd, 0x3866, 0x078b, 0x3867, 0x0575, 0x3869, 0x03ae,
+    0x3970, 0x28f8, 0x395d, 0x28ba, 0x394b, 0x287d, 0x393a, 0x2842, 0x392a, 0x2809, 0x391a, 0x27a5, 0x390b, 0x273f, 0x38fc, 0x26dc,
+    0x38ed, 0x267e, 0x38e0, 0x2625, 0x38d2, 0x25ce, 0x38c6, 0x257c, 0x38bb, 0x252d, 0x38b3, 0x24e2, 0x38ab, 0x249b, 0x38a3, 0x2458,
+    0x389b, 0x2417, 0x3893, 0x23b2, 0x388c, 0x233c, 0x3884, 0x22cb, 0x387e, 0x225f, 0x3879, 0x21fa, 0x3874, 0x219b, 0x386e, 0x2141,
+    0x386a, 0x20ea, 0x3865, 0x2096, 0x3861, 0x2045, 0x385e, 0x1ff4, 0x385b, 0x1f66, 0x3857, 0x1ee1, 0x3854, 0x1e64, 0x3851, 0x1dee,
+    0x384f, 0x1d7b, 0x384c, 0x1d10, 0x3849, 0x1cac, 0x3847, 0x1c4d, 0x3844, 0x1be6, 0x3842, 0x1b3c, 0x3841, 0x1a9b, 0x3840, 0x1a04,
+    0x383f, 0x197c, 0x383e, 0x18fb, 0x383d, 0x1883, 0x383c, 0x1814, 0x383b, 0x175a, 0x383a, 0x169d, 0x383a, 0x15eb, 0x3839, 0x1544,
+    0x3839, 0x14aa, 0x3838, 0x141d, 0x3838, 0x133d, 0x3838, 0x1250, 0x3838, 0x117a, 0x3839, 0x10b6, 0x3839, 0x1009, 0x383a, 0x0ee1,
+    0x383a, 0x0dc5, 0x383a, 0x0cc3, 0x383b, 0x0bbf, 0x383b, 0x0a3a, 0x383c, 0x08e6, 0x383d, 0x0763, 0x383e, 0x055e, 0x383f, 0x03ac,
+    0x3965, 0x28af, 0x3953, 0x2874, 0x3941, 0x283b, 0x3931, 0x2803, 0x3920, 0x2799, 0x3910, 0x2732, 0x3901, 0x26d1, 0x38f2, 0x2673,
+    0x38e4, 0x261b, 0x38d5, 0x25c6, 0x38c8, 0x2575, 0x38bc, 0x2527, 0x38b2, 0x24dc, 0x38a9, 0x2495, 0x38a0, 0x2453, 0x3897, 0x2413,
+    0x388f, 0x23ac, 0x3886, 0x2338, 0x387f, 0x22c9, 0x3877, 0x225e, 0x3871, 0x21f9, 0x386b, 0x2198, 0x3865, 0x213f, 0x385f, 0x20ea,
+    0x385a, 0x209b, 0x3855, 0x204d, 0x3851, 0x2002, 0x384c, 0x1f76, 0x3848, 0x1ef0, 0x3844, 0x1e72, 0x3840, 0x1dfb, 0x383d, 0x1d8d,
+    0x3839, 0x1d24, 0x3835, 0x1cbf, 0x3832, 0x1c60, 0x382f, 0x1c07, 0x382d, 0x1b6b, 0x382a, 0x1acd, 0x3829, 0x1a3a, 0x3827, 0x19ae,
+    0x3826, 0x192a, 0x3824, 0x18b2, 0x3822, 0x1842, 0x3820, 0x17b1, 0x381e, 0x16ed, 0x381c, 0x1638, 0x381b, 0x1594, 0x381a, 0x14ff,
+    0x3819, 0x1470, 0x3818, 0x13d6, 0x3818, 0x12e0, 0x3817, 0x1207, 0x3817, 0x113d, 0x3816, 0x1086, 0x3815, 0x0fb7, 0x3815, 0x0e8e,
+    0x3815, 0x0d87, 0x3814, 0x0c99, 0x3814, 0x0b7d, 0x3814, 0x0a01, 0x3814, 0x08ba, 0x3815, 0x073c, 0x3815, 0x0546, 0x3815, 0x0399,
+    0x3959, 0x286b, 0x3947, 0x2833, 0x3936, 0x27f9, 0x3926, 0x278e, 0x3916, 0x2728, 0x3906, 0x26c6, 0x38f6, 0x266a, 0x38e7, 0x2612,
+    0x38d9, 0x25be, 0x38ca, 0x256e, 0x38bd, 0x2521, 0x38b1, 0x24d7, 0x38a7, 0x2491, 0x389e, 0x244e, 0x3894, 0x240f, 0x388b, 0x23a5,
+    0x3882, 0x2332, 0x3879, 0x22c6, 0x3871, 0x225d, 0x3869, 0x21f9, 0x3863, 0x2199, 0x385c, 0x213f, 0x3855, 0x20e9, 0x384f, 0x2099,
+    0x3849, 0x204e, 0x3844, 0x2007, 0x383f, 0x1f85, 0x383a, 0x1f00, 0x3836, 0x1e82, 0x3831, 0x1e0b, 0x382c, 0x1d9a, 0x3828, 0x1d31,
+    0x3823, 0x1cce, 0x381f, 0x1c71, 0x381b, 0x1c19, 0x3818, 0x1b8b, 0x3815, 0x1af1, 0x3813, 0x1a62, 0x3811, 0x19d9, 0x380e, 0x195a,
+    0x380b, 0x18df, 0x3808, 0x186b, 0x3805, 0x1802, 0x3803, 0x173f, 0x3801, 0x168a, 0x37fe, 0x15df, 0x37fa, 0x1540, 0x37f6, 0x14b0,
+    0x37f3, 0x1431, 0x37f1, 0x136f, 0x37ee, 0x128d, 0x37ec, 0x11b8, 0x37ea, 0x10fe, 0x37e6, 0x1052, 0x37e4, 0x0f69, 0x37e2, 0x0e45,
+    0x37e0, 0x0d48, 0x37de, 0x0c68, 0x37de, 0x0b43, 0x37dd, 0x09d5, 0x37db, 0x0897, 0x37da, 0x0700, 0x37d9, 0x0524, 0x37d9, 0x0390,
+    0x394c, 0x282b, 0x393b, 0x27ec, 0x392a, 0x2784, 0x391a, 0x271f, 0x390a, 0x26bd, 0x38fa, 0x2661, 0x38eb, 0x260a, 0x38dc, 0x25b7,
+    0x38cd, 0x2567, 0x38be, 0x251b, 0x38b1, 0x24d2, 0x38a6, 0x248d, 0x389c, 0x244a, 0x3892, 0x240c, 0x3888, 0x239e, 0x387e, 0x232d,
+    0x3875, 0x22c1, 0x386b, 0x225a, 0x3863, 0x21f8, 0x385b, 0x219b, 0x3854, 0x2142, 0x384c, 0x20ec, 0x3845, 0x209b, 0x383e, 0x204e,
+    0x3839, 0x2008, 0x3833, 0x1f89, 0x382d, 0x1f0a, 0x3828, 0x1e90, 0x3822, 0x1e19, 0x381d, 0x1da8, 0x3817, 0x1d3e, 0x3812, 0x1cdb,
+    0x380d, 0x1c7e, 0x3809, 0x1c28, 0x3805, 0x1bac, 0x3801, 0x1b10, 0x37fc, 0x1a7c, 0x37f6, 0x19f5, 0x37ef, 0x1978, 0x37e8, 0x1903,
+    0x37e1, 0x1894, 0x37da, 0x182b, 0x37d3, 0x178b, 0x37ce, 0x16d3, 0x37c8, 0x1629, 0x37c3, 0x158a, 0x37be, 0x14f6, 0x37ba, 0x146d,
+    0x37b5, 0x13dc, 0x37b1, 0x12fe, 0x37ae, 0x122f, 0x37aa, 0x1172, 0x37a5, 0x10bb, 0x37a2, 0x1019, 0x379f, 0x0f13, 0x379c, 0x0e0c,
+    0x3798, 0x0d13, 0x3796, 0x0c38, 0x3794, 0x0af5, 0x3791, 0x09a8, 0x378f, 0x0877, 0x378c, 0x06d6, 0x378a, 0x050e, 0x3788, 0x037d,
+    0x393e, 0x27df, 0x392e, 0x277a, 0x391e, 0x2717, 0x390e, 0x26b6, 0x38fe, 0x265a, 0x38ee, 0x2603, 0x38de, 0x25b0, 0x38cf, 0x2561,
+    0x38c0, 0x2515, 0x38b2, 0x24cd, 0x38a4, 0x2489, 0x389a, 0x2447, 0x388f, 0x2408, 0x3885, 0x239a, 0x387a, 0x2328, 0x3870, 0x22bc,
+    0x3866, 0x2257, 0x385d, 0x21f5, 0x3854, 0x2199, 0x384c, 0x2142, 0x3844, 0x20ef, 0x383c, 0x209f, 0x3835, 0x2052, 0x382e, 0x200a,
+    0x3828, 0x1f8c, 0x3821, 0x1f0d, 0x381b, 0x1e95, 0x3814, 0x1e24, 0x380e, 0x1db6, 0x3808, 0x1d4d, 0x3802, 0x1cea, 0x37f9, 0x1c8c,
+    0x37ef, 0x1c34, 0x37e5, 0x1bc4, 0x37dd, 0x1b2c, 0x37d5, 0x1a9d, 0x37ce, 0x1a16, 0x37c5, 0x1994, 0x37bc, 0x191d, 0x37b4, 0x18ae,
+    0x37ab, 0x1849, 0x37a4, 0x17d2, 0x379d, 0x171e, 0x3796, 0x166d, 0x3790, 0x15cd, 0x378a, 0x153b, 0x3784, 0x14b1, 0x377e, 0x1432,
+    0x3779, 0x1375, 0x3774, 0x129a, 0x376e, 0x11d4, 0x3768, 0x1123, 0x3763, 0x107f, 0x375f, 0x0fc6, 0x375a, 0x0eb0, 0x3756, 0x0dbb,
+    0x3753, 0x0cdf, 0x374f, 0x0c10, 0x374a, 0x0aa9, 0x3746, 0x0966, 0x3743, 0x084e, 0x3740, 0x069b, 0x373c, 0x04e3, 0x373a, 0x036d,
+    0x3930, 0x276f, 0x3920, 0x270f, 0x3910, 0x26b0, 0x3900, 0x2654, 0x38f0, 0x25fc, 0x38e1, 0x25aa, 0x38d1, 0x255b, 0x38c2, 0x2510,
+    0x38b3, 0x24c8, 0x38a5, 0x2484, 0x3898, 0x2443, 0x388d, 0x2406, 0x3882, 0x2395, 0x3877, 0x2324, 0x386c, 0x22b9, 0x3862, 0x2253,
+    0x3857, 0x21f2, 0x384e, 0x2197, 0x3845, 0x2140, 0x383c, 0x20ef, 0x3834, 0x20a1, 0x382c, 0x2056, 0x3824, 0x200e, 0x381d, 0x1f93,
+    0x3816, 0x1f10, 0x380f, 0x1e98, 0x3807, 0x1e26, 0x3801, 0x1dbb, 0x37f4, 0x1d58, 0x37e7, 0x1cf8, 0x37db, 0x1c9b, 0x37cf, 0x1c43,
+    0x37c4, 0x1be2, 0x37ba, 0x1b48, 0x37b1, 0x1ab8, 0x37a8, 0x1a34, 0x379e, 0x19b6, 0x3794, 0x193f, 0x378a, 0x18cd, 0x3780, 0x1863,
+    0x3777, 0x1802, 0x376f, 0x1753, 0x3767, 0x16ac, 0x3760, 0x1610, 0x3758, 0x1579, 0x3751, 0x14ed, 0x374a, 0x146f, 0x3744, 0x13ed,
+    0x373d, 0x1313, 0x3736, 0x1246, 0x372e, 0x1186, 0x3728, 0x10db, 0x3722, 0x1041, 0x371d, 0x0f6c, 0x3717, 0x0e62, 0x3712, 0x0d70,
+    0x370d, 0x0c9b, 0x3708, 0x0bc5, 0x3702, 0x0a68, 0x36fd, 0x092b, 0x36f9, 0x081d, 0x36f5, 0x0667, 0x36f1, 0x04c3, 0x36ec, 0x0356,
+    0x3921, 0x2706, 0x3912, 0x26aa, 0x3902, 0x2650, 0x38f2, 0x25f9, 0x38e2, 0x25a5, 0x38d3, 0x2557, 0x38c3, 0x250c, 0x38b4, 0x24c5,
+    0x38a5, 0x2481, 0x3897, 0x2440, 0x388a, 0x2402, 0x387f, 0x2390, 0x3874, 0x2321, 0x3869, 0x22b6, 0x385d, 0x2251, 0x3852, 0x21f0,
+    0x3848, 0x2194, 0x383f, 0x213f, 0x3835, 0x20ed, 0x382c, 0x20a0, 0x3823, 0x2057, 0x381b, 0x2011, 0x3813, 0x1f9c, 0x380b, 0x1f1a,
+    0x3803, 0x1e9f, 0x37f7, 0x1e2a, 0x37e8, 0x1dc0, 0x37da, 0x1d5c, 0x37cb, 0x1cfe, 0x37be, 0x1ca6, 0x37b1, 0x1c52, 0x37a5, 0x1c01,
+    0x379a, 0x1b68, 0x3790, 0x1ad8, 0x3785, 0x1a4f, 0x3779, 0x19cf, 0x376e, 0x195a, 0x3762, 0x18eb, 0x3757, 0x1884, 0x374d, 0x1820,
+    0x3744, 0x1786, 0x373a, 0x16da, 0x3731, 0x163e, 0x3729, 0x15ad, 0x3721, 0x1526, 0x3719, 0x14a4, 0x3711, 0x1429, 0x3709, 0x1377,
+    0x3700, 0x12a9, 0x36f8, 0x11ec, 0x36f1, 0x113d, 0x36ea, 0x1099, 0x36e3, 0x1006, 0x36dd, 0x0f03, 0x36d7, 0x0e17, 0x36d0, 0x0d37,
+    0x36c9, 0x0c68, 0x36c2, 0x0b5f, 0x36bd, 0x0a25, 0x36b8, 0x0903, 0x36b2, 0x07f3, 0x36ac, 0x062a, 0x36a7, 0x049c, 0x36a2, 0x0343,
+    0x3912, 0x26a4, 0x3903, 0x264c, 0x38f3, 0x25f6, 0x38e3, 0x25a3, 0x38d4, 0x2554, 0x38c4, 0x2509, 0x38b5, 0x24c2, 0x38a5, 0x247e,
+    0x3896, 0x243d, 0x3888, 0x2400, 0x387c, 0x238b, 0x3871, 0x231d, 0x3865, 0x22b3, 0x3859, 0x224f, 0x384e, 0x21ef, 0x3843, 0x2194,
+    0x3838, 0x213d, 0x382e, 0x20eb, 0x3825, 0x209f, 0x381b, 0x2055, 0x3812, 0x2011, 0x380a, 0x1f9e, 0x3801, 0x1f22, 0x37f2, 0x1eaa,
+    0x37e1, 0x1e36, 0x37d1, 0x1dc8, 0x37c1, 0x1d61, 0x37b1, 0x1d03, 0x37a2, 0x1cab, 0x3794, 0x1c58, 0x3787, 0x1c0c, 0x377b, 0x1b83,
+    0x3770, 0x1af5, 0x3764, 0x1a6e, 0x3757, 0x19f0, 0x374a, 0x1977, 0x373d, 0x1907, 0x3731, 0x189e, 0x3726, 0x183c, 0x371b, 0x17c4,
+    0x3711, 0x1716, 0x3707, 0x1672, 0x36fd, 0x15dc, 0x36f3, 0x1550, 0x36ea, 0x14d2, 0x36e1, 0x145d, 0x36d8, 0x13da, 0x36cd, 0x1305,
+    0x36c5, 0x1247, 0x36bd, 0x1198, 0x36b5, 0x10f6, 0x36ad, 0x105f, 0x36a5, 0x0fa4, 0x369e, 0x0ea6, 0x3696, 0x0dc0, 0x368e, 0x0cf6,
+    0x3687, 0x0c37, 0x3680, 0x0b12, 0x3679, 0x09db, 0x3673, 0x08cd, 0x366c, 0x07b8, 0x3665, 0x05f6, 0x365f, 0x047a, 0x3659, 0x032d,
+    0x3902, 0x2648, 0x38f3, 0x25f4, 0x38e4, 0x25a2, 0x38d4, 0x2553, 0x38c5, 0x2507, 0x38b5, 0x24bf, 0x38a5, 0x247c, 0x3896, 0x243b,
+    0x3887, 0x23fd, 0x3879, 0x2388, 0x386d, 0x2319, 0x3861, 0x22b0, 0x3855, 0x224d, 0x3849, 0x21ed, 0x383e, 0x2193, 0x3833, 0x213d,
+    0x3828, 0x20ec, 0x381e, 0x209e, 0x3814, 0x2055, 0x380a, 0x2010, 0x3801, 0x1f9d, 0x37f0, 0x1f23, 0x37de, 0x1eaf, 0x37cc, 0x1e40,
+    0x37bb, 0x1dd6, 0x37aa, 0x1d6e, 0x3799, 0x1d0c, 0x3788, 0x1cb1, 0x3779, 0x1c5e, 0x376b, 0x1c11, 0x375e, 0x1b90, 0x3751, 0x1b0a,
+    0x3744, 0x1a88, 0x3737, 0x1a0a, 0x3728, 0x1994, 0x371a, 0x1924, 0x370d, 0x18ba, 0x3701, 0x1858, 0x36f5, 0x17f9, 0x36ea, 0x174b,
+    0x36df, 0x16ab, 0x36d4, 0x1613, 0x36c9, 0x1584, 0x36be, 0x1501, 0x36b4, 0x1486, 0x36a9, 0x1418, 0x369e, 0x1365, 0x3695, 0x12a3,
+    0x368c, 0x11ea, 0x3683, 0x1144, 0x367a, 0x10af, 0x3671, 0x1024, 0x3668, 0x0f45, 0x365f, 0x0e51, 0x3656, 0x0d75, 0x364e, 0x0caf,
+    0x3647, 0x0c03, 0x363f, 0x0ac3, 0x3637, 0x099b, 0x362f, 0x0893, 0x3627, 0x0755, 0x3620, 0x05be, 0x3619, 0x0450, 0x3612, 0x0315,
+    0x38f2, 0x25f1, 0x38e3, 0x25a1, 0x38d4, 0x2553, 0x38c4, 0x2507, 0x38b5, 0x24bf, 0x38a5, 0x247b, 0x3895, 0x243a, 0x3886, 0x23fa,
+    0x3877, 0x2387, 0x386a, 0x2317, 0x385e, 0x22ae, 0x3852, 0x224a, 0x3845, 0x21ec, 0x3839, 0x2192, 0x382d, 0x213d, 0x3822, 0x20ec,
+    0x3817, 0x20a0, 0x380c, 0x2056, 0x3802, 0x2010, 0x37f0, 0x1f9f, 0x37de, 0x1f24, 0x37cb, 0x1eb0, 0x37b8, 0x1e43, 0x37a6, 0x1ddc,
+    0x3794, 0x1d79, 0x3782, 0x1d1a, 0x3770, 0x1cbe, 0x3760, 0x1c68, 0x3751, 0x1c18, 0x3742, 0x1b9e, 0x3734, 0x1b14, 0x3726, 0x1a93,
+    0x3718, 0x1a1c, 0x3708, 0x19aa, 0x36f9, 0x193b, 0x36eb, 0x18d2, 0x36de, 0x1870, 0x36d1, 0x1812, 0x36c5, 0x177b, 0x36b9, 0x16db,
+    0x36ad, 0x1643, 0x36a1, 0x15b6, 0x3695, 0x1531, 0x368a, 0x14b6, 0x367e, 0x1444, 0x3672, 0x13b0, 0x3667, 0x12ef, 0x365e, 0x1242,
+    0x3654, 0x119a, 0x364a, 0x10f9, 0x363f, 0x1069, 0x3636, 0x0fcb, 0x362c, 0x0edd, 0x3622, 0x0e01, 0x3619, 0x0d31, 0x3610, 0x0c73,
+    0x3607, 0x0b93, 0x35ff, 0x0a6f, 0x35f6, 0x095c, 0x35ed, 0x085e, 0x35e5, 0x0705, 0x35dd, 0x0581, 0x35d5, 0x042c, 0x35ce, 0x02fd,
+    0x38e1, 0x25a0, 0x38d2, 0x2553, 0x38c3, 0x2508, 0x38b4, 0x24c0, 0x38a4, 0x247c, 0x3895, 0x243b, 0x3885, 0x23fa, 0x3875, 0x2385,
+    0x3867, 0x2317, 0x385a, 0x22ae, 0x384e, 0x224a, 0x3841, 0x21eb, 0x3834, 0x2191, 0x3828, 0x213d, 0x381c, 0x20ec, 0x3811, 0x20a0,
+    0x3806, 0x2058, 0x37f6, 0x2013, 0x37e1, 0x1fa2, 0x37cd, 0x1f26, 0x37b9, 0x1eb3, 0x37a6, 0x1e44, 0x3792, 0x1ddd, 0x377f, 0x1d7b,
+    0x376c, 0x1d20, 0x375a, 0x1cc9, 0x3749, 0x1c75, 0x3738, 0x1c24, 0x3728, 0x1bb0, 0x3719, 0x1b22, 0x370a, 0x1aa2, 0x36fa, 0x1a27,
+    0x36ea, 0x19b3, 0x36da, 0x1949, 0x36cb, 0x18e5, 0x36bd, 0x1884, 0x36af, 0x1828, 0x36a1, 0x17a4, 0x3694, 0x16fe, 0x3687, 0x166a,
+    0x367b, 0x15e0, 0x366e, 0x155d, 0x3662, 0x14e2, 0x3655, 0x146d, 0x3648, 0x1402, 0x363d, 0x1340, 0x3632, 0x1284, 0x3627, 0x11db,
+    0x361c, 0x1143, 0x3611, 0x10b5, 0x3606, 0x1028, 0x35fb, 0x0f57, 0x35f0, 0x0e75, 0x35e7, 0x0da9, 0x35de, 0x0ced, 0x35d4, 0x0c3c,
+    0x35ca, 0x0b35, 0x35c0, 0x0a12, 0x35b7, 0x091d, 0x35ae, 0x0834, 0x35a6, 0x06bb, 0x359d, 0x054b, 0x3594, 0x0405, 0x358b, 0x02e5,
+    0x38d0, 0x2554, 0x38c1, 0x250a, 0x38b2, 0x24c2, 0x38a3, 0x247d, 0x3893, 0x243c, 0x3884, 0x23fd, 0x3874, 0x2387, 0x3864, 0x2318,
+    0x3856, 0x22af, 0x3849, 0x224b, 0x383d, 0x21ec, 0x3830, 0x2191, 0x3823, 0x213c, 0x3816, 0x20ed, 0x380b, 0x20a1, 0x37ff, 0x2059,
+    0x37e8, 0x2015, 0x37d2, 0x1fa9, 0x37bc, 0x1f2d, 0x37a8, 0x1eb7, 0x3794, 0x1e48, 0x377f, 0x1ddf, 0x376b, 0x1d7d, 0x3757, 0x1d21,
+    0x3744, 0x1ccb, 0x3732, 0x1c7b, 0x3720, 0x1c2f, 0x3710, 0x1bc9, 0x3700, 0x1b3a, 0x36ef, 0x1ab2, 0x36df, 0x1a34, 0x36cd, 0x19c1,
+    0x36bc, 0x1954, 0x36ac, 0x18ed, 0x369d, 0x188f, 0x368e, 0x1837, 0x3680, 0x17c5, 0x3672, 0x1725, 0x3664, 0x168f, 0x3656, 0x15ff,
+    0x3649, 0x157c, 0x363c, 0x1505, 0x362e, 0x1494, 0x3621, 0x1429, 0x3615, 0x1386, 0x3609, 0x12ca, 0x35fd, 0x1221, 0x35f1, 0x1181,
+    0x35e5, 0x10ee, 0x35d9, 0x106a, 0x35ce, 0x0fde, 0x35c2, 0x0ef0, 0x35b8, 0x0e19, 0x35ae, 0x0d53, 0x35a3, 0x0ca6, 0x3599, 0x0c06,
+    0x358e, 0x0adf, 0x3584, 0x09c8, 0x357a, 0x08d1, 0x3571, 0x0801, 0x3567, 0x067f, 0x355e, 0x0516, 0x3555, 0x03de, 0x354b, 0x02cd,
+    0x38be, 0x250c, 0x38b0, 0x24c6, 0x38a1, 0x2481, 0x3891, 0x243f, 0x3882, 0x2401, 0x3872, 0x238b, 0x3863, 0x231b, 0x3853, 0x22b1,
+    0x3845, 0x224d, 0x3838, 0x21ee, 0x382b, 0x2194, 0x381e, 0x213e, 0x3811, 0x20ee, 0x3805, 0x20a2, 0x37f2, 0x205b, 0x37db, 0x2017,
+    0x37c3, 0x1fac, 0x37ad, 0x1f33, 0x3798, 0x1ebe, 0x3783, 0x1e4f, 0x376d, 0x1de4, 0x3758, 0x1d81, 0x3744, 0x1d23, 0x372f, 0x1ccd,
+    0x371c, 0x1c7d, 0x370a, 0x1c32, 0x36f8, 0x1bd6, 0x36e7, 0x1b4e, 0x36d6, 0x1aca, 0x36c4, 0x1a49, 0x36b2, 0x19d0, 0x36a0, 0x1961,
+    0x368f, 0x18fb, 0x367f, 0x189b, 0x366f, 0x1841, 0x3660, 0x17d9, 0x3651, 0x173e, 0x3643, 0x16ab, 0x3634, 0x161f, 0x3626, 0x159e,
+    0x3618, 0x1520, 0x360a, 0x14ae, 0x35fb, 0x1448, 0x35ef, 0x13ce, 0x35e2, 0x1315, 0x35d5, 0x1265, 0x35c9, 0x11c1, 0x35bb, 0x112c,
+    0x35af, 0x10a2, 0x35a3, 0x1023, 0x3597, 0x0f63, 0x358c, 0x0e8f, 0x3581, 0x0dc0, 0x3575, 0x0d09, 0x356a, 0x0c5d, 0x355e, 0x0b92,
+    0x3554, 0x0a81, 0x354a, 0x0984, 0x353f, 0x0898, 0x3535, 0x078c, 0x352a, 0x0624, 0x3521, 0x04dc, 0x3517, 0x03b5, 0x350e, 0x02b2,
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef BRDF_LUT_TABLE_H
+#define BRDF_LUT_TABLE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <util/brdf_lut_data.h> // (BRDF_LUT_SIZE, BRDF_LUT_DATA, generated by src/tools/brdflut)
+
+#include <algorithm>
+#include <cstddef>
+
+// The embedded split sum BRDF LUT on the CPU (no OpenGL, for the tools), see util/brdf_lut.h.
+
+// a texel of the embedded table (index = row * BRDF_LUT_SIZE + column)
+inline glm::vec2 brdfLUTTexel(size_t index)
+{
+    return glm::vec2(glm::unpackHalf1x16(BRDF_LUT_DATA[2 * index]), glm::unpackHalf1x16(BRDF_LUT_DATA[2 * index + 1]));
+}
+
+// largest difference (per channel) between the embedded table and a LUT of the same size given as RG floats (e.g. the
+// one brdf.fs renders, read back)
+float brdfLUTError(const float* lut)
+{
+    float maxError = 0.0f;
+    for (size_t i = 0; i < (size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE; i++)
+    {
+        glm::vec2 difference = glm::abs(brdfLUTTexel(i) - glm::vec2(lut[2 * i], lut[2 * i + 1]));
+        maxError = std::max(maxError, std::max(difference.x, difference.y));
+    }
+    return maxError;
+}
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/arena.h>
+#include <util/mesh.h>
+#include <util/model.h>
+#include <util/material.h>
+#include <util/shader.h>
+#include <util/uniform_ring.h>
+
+#include <vector>
+
+// layout of a command in the GL_DRAW_INDIRECT_BUFFER (see glMultiDrawElementsIndirect)
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// per draw data, read by the vertex shader from the shader storage buffer at DRAW_DATA_BINDING (std430 layout):
+//   struct DrawData { mat4 model; uint lod; uint material; uint pad0; uint pad1; };
+//   layout (std430, binding = 0) readonly buffer DrawDataBuffer { DrawData draws[]; };
+// The index of the draw is passed in the vertex attribute DRAW_ID_LOCATION (layout (location = 5) in uint aDrawId).
+struct DrawData {
+    glm::mat4 model;
+    GLuint lod;
+    GLuint material; // index into the material table
+    GLuint pad[2];
+};
+const GLuint DRAW_DATA_BINDING = 0;
+
+// calls emit(mesh, firstIndex, indexCount) for the index ranges of the (full detail) meshes of the model that survive
+// cluster culling (the culler has to be set up for this instance)
+template <class F>
+void forEachVisibleRange(const Model& model, const ClusterCuller& culler, ClusterCullStats& stats, F emit)
+{
+    if (!culler.insideFrustum(model.boundsCenter, model.boundsRadius))
+    {
+        for (const Mesh& mesh : model.meshes)
+        {
+            stats.clustersTotal += (unsigned int)mesh.meshlets.size();
+            stats.trianglesTotal += mesh.NumTriangles();
+        }
+        return;
+    }
+
+    std::vector<IndexRange> ranges;
+    for (const Mesh& mesh : model.meshes)
+    {
+        if (mesh.meshlets.empty())
+        {
+            unsigned int n = mesh.NumTriangles();
+            stats.trianglesTotal += n;
+            stats.trianglesInView += n;
+            stats.trianglesSubmitted += n;
+            emit(mesh, mesh.lods[0].indexOffset, mesh.lods[0].indexCount);
+            continue;
+        }
+        if (!culler.insideFrustum(mesh.boundsCenter, mesh.boundsRadius))
+        {
+            stats.clustersTotal += (unsigned int)mesh.meshlets.size();
+            stats.trianglesTotal += mesh.NumTriangles();
+            continue;
+        }
+        ranges.clear();
+        culler.cull(mesh.meshlets, ranges, stats);
+        for (const IndexRange& range : ranges)
+            emit(mesh, range.first, range.count);
+    }
+}
+
+// Collects the draws of a pass (ranges in the geometry arena plus their model matrix and material) on the CPU and submits
+// them with a single glMultiDrawElementsIndirect call: the materials are looked up in the shaders (see util/material.h),
+// so no state changes between draws. Build the list once and submit it as often as needed (e.g., once per pass).
+// Once the global uniform ring is set up, the commands and per draw data are streamed through it.
+class DrawList {
+public:
+    // statistics of the last Submit
+    unsigned int numDraws = 0;
+
+    void Clear()
+    {
+        commands.clear();
+        drawData.clear();
+        dirty = true;
+    }
+
+    // adds the mesh at the given level of detail. If material is NO_MATERIAL, the material of the mesh is used.
+    void Add(const Mesh& mesh, const glm::mat4& model, unsigned int lod = 0, unsigned int material = NO_MATERIAL)
+    {
+        const LodLevel& level = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+        AddRange(mesh, level.indexOffset, level.indexCount, model, lod, material != NO_MATERIAL ? material : mesh.material);
+    }
+
+    // adds all meshes of the model at the given level of detail
+    void Add(const Model& model, const glm::mat4& modelMatrix, unsigned int lod = 0, unsigned int material = NO_MATERIAL)
+    {
+        for (const Mesh& mesh : model.meshes)
+            Add(mesh, modelMatrix, lod, material);
+    }
+
+    // adds the clusters of the (full detail) meshes of the model that survive culling (the culler has to be set up for this instance)
+    void Add(const Model& model, const glm::mat4& modelMatrix, const ClusterCuller& culler, ClusterCullStats& stats)
+    {
+        forEachVisibleRange(model, culler, stats, [&](const Mesh& mesh, unsigned int first, unsigned int count) {
+            AddRange(mesh, first, count, modelMatrix, 0, mesh.material);
+        });
+    }
+
+    // adds a range of indices (relative to the mesh) of the mesh
+    void AddRange(const Mesh& mesh, unsigned int first, unsigned int count, const glm::mat4& model, unsigned int lod, unsigned int material)
+    {
+        GLuint drawId = (GLuint)commands.size();
+        // the draw id is fed through an instanced attribute: with baseInstance = drawId the (single) instance reads it
+        commands.push_back({ count, 1, mesh.firstIndex + first, mesh.baseVertex, drawId });
+        DrawData data = {};
+        data.model = model;
+        data.lod = lod;
+        data.material = material;
+        drawData.push_back(data);
+        dirty = true;
+    }
+
+    // uploads the commands (if they changed) and draws them with the given (already active) shader.
+    // Binding the materials can be skipped for passes that don't need them (e.g., a depth pass).
+    // Optionally only the draws [first, first + count) are submitted.
+    void Submit(bool useMaterials = true, size_t first = 0, size_t count = ~size_t(0))
+    {
+        numDraws = (unsigned int)commands.size();
+        count = std::min(count, commands.size() - std::min(first, commands.size()));
+        if (count == 0)
+            return;
+
+        GeometryArena& arena = geometryArena();
+        UniformRing& ring = uniformRing();
+        if (ring.Ready())
+        {
+            // the commands and draw data are written into this frame's region of the ring buffer (again, if they
+            // were written in an earlier frame)
+            if (dirty || ringFrame != ring.FrameNumber())
+            {
+                commandOffset = ring.Push(commands);
+                drawDataOffset = ring.Push(drawData);
+                arena.EnsureDrawIds(commands.size());
+                ringFrame = ring.FrameNumber();
+                dirty = false;
+            }
+            if (commandOffset < 0 || drawDataOffset < 0)
+                return;
+            glState().BindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.Buffer());
+            ring.Bind(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataOffset, drawData.size() * sizeof(DrawData));
+        }
+        else if (dirty)
+        {
+            if (!commandBuffer)
+            {
+                commandBuffer = createBuffer();
+                drawDataBuffer = createBuffer();
+            }
+            // (orphan the old storage, it might still be in use by the previous frame)
+            glState().BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            glState().BindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STREAM_DRAW);
+            arena.EnsureDrawIds(commands.size());
+            dirty = false;
+        }
+
+        GLintptr base = 0;
+        if (ring.Ready())
+            base = commandOffset;
+        else
+        {
+            glState().BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+        }
+        glState().BindVertexArray(arena.VertexArray(meshVertexFormat()));
+        if (useMaterials)
+            materialTable().Bind();
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(base + first * sizeof(DrawElementsIndirectCommand)), (GLsizei)count, 0);
+    }
+
+private:
+    vector<DrawElementsIndirectCommand> commands;
+    vector<DrawData> drawData;
+    GLBuffer commandBuffer, drawDataBuffer;
+    bool dirty = true;
+    // offsets of the commands and the draw data in the ring buffer (see util/uniform_ring.h) and the frame they were written in
+    GLintptr commandOffset = -1, drawDataOffset = -1;
+    unsigned long long ringFrame = 0;
+};
+
+#endif
@@ -1,7 +1,14 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
+#include <util/asset_pack.h>
+#include <util/async_io.h>
+
 #include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
 #include <cstdlib>
 //#include "root_directory.h" // This is a configuration file generated by CMake.
 const char *logl_root = "";
@@ -18,7 +25,87 @@ public:
     return (*pathBuilder)(path);
   }
 
+  // mounts an asset pack (see util/asset_pack.h): files in it are read from the memory mapped pack instead of the
+  // disk. Packs mounted later take precedence. Returns false if the pack doesn't exist or is invalid.
+  static bool mount(const std::string& packPath)
+  {
+    std::unique_ptr<AssetPack> pack(new AssetPack());
+    if (!pack->Open(packPath))
+      return false;
+    std::cout << "Mounted " << packPath << " (" << pack->NumEntries() << " entries)" << std::endl;
+    packs().insert(packs().begin(), std::move(pack));
+    return true;
+  }
+
+  static void unmountAll() { packs().clear(); }
+
+  // the packed entry of path (nullptr if no mounted pack has it)
+  static const PackEntry* findPacked(const std::string& path, const AssetPack** pack = nullptr)
+  {
+    if (packs().empty())
+      return nullptr;
+    uint64_t hash = hashName(normalizePackName(path));
+    for (const std::unique_ptr<AssetPack>& p : packs())
+    {
+      if (const PackEntry* entry = p->Find(hash))
+      {
+        if (pack)
+          *pack = p.get();
+        return entry;
+      }
+    }
+    return nullptr;
+  }
+
+  // reads the file at path from the mounted packs (zero copy if it is stored uncompressed), from the prefetched files or
+  // from disk. Thread safe once the packs are mounted.
+  static bool read(const std::string& path, FileData& out)
+  {
+    const AssetPack* pack;
+    if (const PackEntry* entry = findPacked(path, &pack))
+      return pack->Read(*entry, out);
+    // files prefetched with asyncIO().Prefetch (see util/async_io.h)
+    if (asyncIO().Take(path, out))
+      return true;
+
+    out = FileData();
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+      return false;
+    std::streamoff size = file.tellg();
+    out.storage.resize((size_t)size);
+    file.seekg(0);
+    if (!file.read((char*)out.storage.data(), size))
+      return false;
+    out.data = out.storage.data();
+    out.size = out.storage.size();
+    return true;
+  }
+
+  // like read, but only from the mounted packs (and only entries of the given type)
+  static bool readPacked(const std::string& path, uint32_t type, FileData& out)
+  {
+    const AssetPack* pack;
+    const PackEntry* entry = findPacked(path, &pack);
+    return entry && entry->type == type && pack->Read(*entry, out);
+  }
+
+  static bool readText(const std::string& path, std::string& out)
+  {
+    FileData file;
+    if (!read(path, file))
+      return false;
+    out.assign(file.Text());
+    return true;
+  }
+
 private:
+  static std::vector<std::unique_ptr<AssetPack>>& packs()
+  {
+    static std::vector<std::unique_ptr<AssetPack>> mounted;
+    return mounted;
+  }
+
   static std::string const & getRoot()
   {
 #pragma warning(suppress : 4996)
@@ -0,0 +1,119 @@
+#ifndef GL_HANDLES_H
+#define GL_HANDLES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <GLFW/glfw3.h>
+
+#include <util/glstate.h>
+
+// Move-only owners of OpenGL objects: the object is deleted when its handle goes out of scope (or is reset), so
+// copies can't silently share (and leak) GPU resources. Handles convert to the GL name, so they can be passed to
+// GL functions directly. Objects that outlive the context (e.g., locals of main after glfwTerminate) are dropped.
+template <class Traits>
+class GLHandle {
+public:
+    GLHandle() = default;
+    explicit GLHandle(GLuint id) : id(id) {} // takes ownership of id
+    ~GLHandle() { Reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+    GLHandle(GLHandle&& other) noexcept : id(other.id) { other.id = 0; }
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset(other.id);
+            other.id = 0;
+        }
+        return *this;
+    }
+
+    GLuint Get() const { return id; }
+    operator GLuint() const { return id; }
+    explicit operator bool() const { return id != 0; }
+
+    // deletes the current object and takes ownership of newId
+    void Reset(GLuint newId = 0)
+    {
+        if (id != 0 && glfwGetCurrentContext() != nullptr)
+            Traits::Delete(id);
+        id = newId;
+    }
+
+    // gives up ownership (the caller has to delete the object)
+    GLuint Release()
+    {
+        GLuint released = id;
+        id = 0;
+        return released;
+    }
+
+private:
+    GLuint id = 0;
+};
+
+struct GLBufferTraits       { static void Delete(GLuint id) { glState().DeleteBuffers(1, &id); } };
+struct GLVertexArrayTraits  { static void Delete(GLuint id) { glState().DeleteVertexArrays(1, &id); } };
+struct GLTextureTraits      { static void Delete(GLuint id) { glState().DeleteTextures(1, &id); } };
+struct GLFramebufferTraits  { static void Delete(GLuint id) { glState().DeleteFramebuffers(1, &id); } };
+struct GLRenderbufferTraits { static void Delete(GLuint id) { glDeleteRenderbuffers(1, &id); } };
+struct GLProgramTraits      { static void Delete(GLuint id) { glState().DeleteProgram(id); } };
+
+typedef GLHandle<GLBufferTraits>       GLBuffer;
+typedef GLHandle<GLVertexArrayTraits>  GLVertexArray;
+typedef GLHandle<GLTextureTraits>      GLTexture;
+typedef GLHandle<GLFramebufferTraits>  GLFramebuffer;
+typedef GLHandle<GLRenderbufferTraits> GLRenderbuffer;
+typedef GLHandle<GLProgramTraits>      GLProgram;
+
+// creation functions: with OpenGL 4.5 the objects are created with direct state access (they exist right away and
+// don't need to be bound first), otherwise only their names are generated
+// ------------------------------------------------------------------------
+GLBuffer createBuffer()
+{
+    GLuint id;
+    if (GLAD_GL_VERSION_4_5) glCreateBuffers(1, &id);
+    else glGenBuffers(1, &id);
+    return GLBuffer(id);
+}
+
+GLVertexArray createVertexArray()
+{
+    GLuint id;
+    if (GLAD_GL_VERSION_4_5) glCreateVertexArrays(1, &id);
+    else glGenVertexArrays(1, &id);
+    return GLVertexArray(id);
+}
+
+// (with direct state access the target of a texture is fixed at creation)
+GLTexture createTexture(GLenum target)
+{
+    GLuint id;
+    if (GLAD_GL_VERSION_4_5) glCreateTextures(target, 1, &id);
+    else glGenTextures(1, &id);
+    return GLTexture(id);
+}
+
+GLFramebuffer createFramebuffer()
+{
+    GLuint id;
+    if (GLAD_GL_VERSION_4_5) glCreateFramebuffers(1, &id);
+    else glGenFramebuffers(1, &id);
+    return GLFramebuffer(id);
+}
+
+GLRenderbuffer createRenderbuffer()
+{
+    GLuint id;
+    if (GLAD_GL_VERSION_4_5) glCreateRenderbuffers(1, &id);
+    else glGenRenderbuffers(1, &id);
+    return GLRenderbuffer(id);
+}
+
+GLProgram createProgram()
+{
+    return GLProgram(glCreateProgram());
+}
+
+#endif
@@ -0,0 +1,365 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <cstring>
+
+// A thin cache in front of the OpenGL state that is changed the most (program, VAO, buffer, texture unit, framebuffer,
+// blend, depth and cull state): calls that would not change anything are skipped. It only works if all code changes
+// this state through the cache (the util headers do); after raw GL calls (or third party code) call Invalidate().
+// Values start out unknown, so the first call for every piece of state is always issued.
+// Issued and skipped (elided) calls are counted per frame, see BeginFrame and lastFrame.
+class GLStateCache {
+public:
+    struct Counters {
+        unsigned int issued = 0;
+        unsigned int elided = 0;
+    };
+    Counters frame;     // calls of the current frame
+    Counters lastFrame; // calls of the previous frame (complete)
+
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+    static const unsigned int MAX_BUFFER_BINDINGS = 16; // indexed uniform/shader storage buffer bindings
+
+    GLStateCache() { Invalidate(); }
+
+    // starts counting a new frame
+    void BeginFrame()
+    {
+        lastFrame = frame;
+        frame = Counters();
+    }
+
+    // forgets everything (the next call for every piece of state is issued)
+    void Invalidate()
+    {
+        program = vao = drawFramebuffer = readFramebuffer = UNKNOWN;
+        activeTexture = UNKNOWN;
+        std::memset(buffers, 0xFF, sizeof(buffers));
+        std::memset(indexedBuffers, 0xFF, sizeof(indexedBuffers));
+        std::memset(textures, 0xFF, sizeof(textures));
+        std::memset(caps, 0xFF, sizeof(caps));
+        blendSrc = blendDst = depthFunc = cullFace = UNKNOWN;
+        depthMask = 0xFF;
+        viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+    }
+
+    // programs, vertex arrays and framebuffers
+    // ------------------------------------------------------------------------
+    void UseProgram(GLuint id)
+    {
+        if (update(program, id))
+            glUseProgram(id);
+    }
+
+    void BindVertexArray(GLuint id)
+    {
+        if (update(vao, id))
+            glBindVertexArray(id);
+    }
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void BindFramebuffer(GLenum target, GLuint id)
+    {
+        bool changed = false;
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+            changed |= drawFramebuffer != id;
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+            changed |= readFramebuffer != id;
+        if (!count(changed))
+            return;
+        if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+            drawFramebuffer = id;
+        if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+            readFramebuffer = id;
+        glBindFramebuffer(target, id);
+    }
+
+    // buffers
+    // ------------------------------------------------------------------------
+    // (the element array buffer is part of the VAO, so it is always bound)
+    void BindBuffer(GLenum target, GLuint id)
+    {
+        int t = bufferTarget(target);
+        if (t < 0)
+        {
+            count(true);
+            glBindBuffer(target, id);
+        }
+        else if (update(buffers[t], id))
+            glBindBuffer(target, id);
+    }
+
+    // binds the whole buffer to an indexed binding point (also changes the generic binding of the target)
+    void BindBufferBase(GLenum target, GLuint index, GLuint id)
+    {
+        int t = indexedTarget(target);
+        if (t < 0 || index >= MAX_BUFFER_BINDINGS)
+        {
+            count(true);
+            glBindBufferBase(target, index, id);
+            forgetBuffer(target);
+        }
+        else if (update(indexedBuffers[t][index], id))
+        {
+            glBindBufferBase(target, index, id);
+            buffers[bufferTarget(target)] = id;
+        }
+    }
+
+    // binds a range of a buffer to an indexed binding point (ranges are not cached, only forgotten)
+    void BindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        count(true);
+        glBindBufferRange(target, index, id, offset, size);
+        int t = indexedTarget(target);
+        if (t >= 0 && index < MAX_BUFFER_BINDINGS)
+        {
+            indexedBuffers[t][index] = UNKNOWN;
+            buffers[bufferTarget(target)] = id;
+        }
+    }
+
+    // textures
+    // ------------------------------------------------------------------------
+    // accepts GL_TEXTURE0 + i like glActiveTexture
+    void ActiveTexture(GLenum unit)
+    {
+        if (update(activeTexture, unit - GL_TEXTURE0))
+            glActiveTexture(unit);
+    }
+
+    // binds the texture to the active unit
+    void BindTexture(GLenum target, GLuint id)
+    {
+        int t = textureTarget(target);
+        if (t < 0 || activeTexture >= MAX_TEXTURE_UNITS)
+        {
+            // (unknown target or unit: the cached bindings of the unit are unknown already)
+            count(true);
+            glBindTexture(target, id);
+        }
+        else if (update(textures[activeTexture][t], id))
+            glBindTexture(target, id);
+    }
+
+    // binds the texture to the given unit (GL_TEXTURE0 + unit is only activated if the binding changes)
+    void BindTextureUnit(GLuint unit, GLenum target, GLuint id)
+    {
+        int t = textureTarget(target);
+        if (t >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][t] == id)
+        {
+            count(false);
+            return;
+        }
+        ActiveTexture(GL_TEXTURE0 + unit);
+        BindTexture(target, id);
+    }
+
+    // fixed function state
+    // ------------------------------------------------------------------------
+    void Enable(GLenum cap) { setCap(cap, true); }
+    void Disable(GLenum cap) { setCap(cap, false); }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+        if (!count(blendSrc != src || blendDst != dst))
+            return;
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    void DepthFunc(GLenum func)
+    {
+        if (update(depthFunc, func))
+            glDepthFunc(func);
+    }
+
+    void DepthMask(GLboolean flag)
+    {
+        if (!count(depthMask != flag))
+            return;
+        depthMask = flag;
+        glDepthMask(flag);
+    }
+
+    void CullFace(GLenum mode)
+    {
+        if (update(cullFace, mode))
+            glCullFace(mode);
+    }
+
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        if (!count(viewport[0] != x || viewport[1] != y || viewport[2] != width || viewport[3] != height))
+            return;
+        viewport[0] = x; viewport[1] = y; viewport[2] = width; viewport[3] = height;
+        glViewport(x, y, width, height);
+    }
+
+    // deleting objects
+    // ------------------------------------------------------------------------
+    // (GL unbinds deleted objects and may reuse their names, so the cache has to forget them)
+    void DeleteBuffers(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+        {
+            for (GLuint& b : buffers) if (b == ids[i]) b = 0;
+            for (auto& target : indexedBuffers)
+                for (GLuint& b : target) if (b == ids[i]) b = 0;
+        }
+        glDeleteBuffers(n, ids);
+    }
+
+    void DeleteTextures(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            for (auto& unit : textures)
+                for (GLuint& t : unit) if (t == ids[i]) t = 0;
+        glDeleteTextures(n, ids);
+    }
+
+    void DeleteVertexArrays(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            if (vao == ids[i]) vao = 0;
+        glDeleteVertexArrays(n, ids);
+    }
+
+    void DeleteFramebuffers(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+        {
+            if (drawFramebuffer == ids[i]) drawFramebuffer = 0;
+            if (readFramebuffer == ids[i]) readFramebuffer = 0;
+        }
+        glDeleteFramebuffers(n, ids);
+    }
+
+    // (a program in use is only deleted once it is no longer used, but its name could be reused afterwards)
+    void DeleteProgram(GLuint id)
+    {
+        if (program == id) program = UNKNOWN;
+        glDeleteProgram(id);
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+    enum { NUM_BUFFER_TARGETS = 8, NUM_INDEXED_TARGETS = 2, NUM_TEXTURE_TARGETS = 5, NUM_CAPS = 10 };
+
+    GLuint program, vao, drawFramebuffer, readFramebuffer;
+    GLuint activeTexture; // index of the unit
+    GLuint buffers[NUM_BUFFER_TARGETS];
+    GLuint indexedBuffers[NUM_INDEXED_TARGETS][MAX_BUFFER_BINDINGS];
+    GLuint textures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+    unsigned char caps[NUM_CAPS]; // 0 disabled, 1 enabled, 0xFF unknown
+    GLenum blendSrc, blendDst, depthFunc, cullFace;
+    unsigned char depthMask;
+    GLint viewport[4];
+
+    // counts the call and returns whether it has to be issued
+    bool count(bool changed)
+    {
+        if (changed) frame.issued++;
+        else frame.elided++;
+        return changed;
+    }
+
+    // stores value in cached and returns whether it changed
+    bool update(GLuint& cached, GLuint value)
+    {
+        if (!count(cached != value))
+            return false;
+        cached = value;
+        return true;
+    }
+
+    void setCap(GLenum cap, bool enable)
+    {
+        int c = capIndex(cap);
+        if (c < 0)
+            count(true);
+        else if (!count(caps[c] != (unsigned char)enable))
+            return;
+        else
+            caps[c] = enable;
+        if (enable) glEnable(cap);
+        else glDisable(cap);
+    }
+
+    void forgetBuffer(GLenum target)
+    {
+        int t = bufferTarget(target);
+        if (t >= 0)
+            buffers[t] = UNKNOWN;
+    }
+
+    static int bufferTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_COPY_READ_BUFFER: return 1;
+        case GL_COPY_WRITE_BUFFER: return 2;
+        case GL_DRAW_INDIRECT_BUFFER: return 3;
+        case GL_SHADER_STORAGE_BUFFER: return 4;
+        case GL_UNIFORM_BUFFER: return 5;
+        case GL_PIXEL_PACK_BUFFER: return 6;
+        case GL_PIXEL_UNPACK_BUFFER: return 7;
+        default: return -1; // GL_ELEMENT_ARRAY_BUFFER (VAO state) and the rest
+        }
+    }
+
+    static int indexedTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_SHADER_STORAGE_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        default: return -1;
+        }
+    }
+
+    static int textureTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        case GL_TEXTURE_2D_MULTISAMPLE: return 3;
+        case GL_TEXTURE_3D: return 4;
+        default: return -1;
+        }
+    }
+
+    static int capIndex(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_STENCIL_TEST: return 3;
+        case GL_SCISSOR_TEST: return 4;
+        case GL_MULTISAMPLE: return 5;
+        case GL_FRAMEBUFFER_SRGB: return 6;
+        case GL_TEXTURE_CUBE_MAP_SEAMLESS: return 7;
+        case GL_POLYGON_OFFSET_FILL: return 8;
+        case GL_PROGRAM_POINT_SIZE: return 9;
+        default: return -1;
+        }
+    }
+};
+
+// the state cache of the OpenGL context of the calling thread (one per thread: a context is current on one thread,
+// e.g., the main context on the render thread and the upload context on the upload thread, see util/upload_thread.h)
+GLStateCache& glState()
+{
+    static thread_local GLStateCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <string_view>
+#include <cstdint>
+
+// 64 bit FNV-1a hash of a name (constexpr, so keys of string literals can be computed at compile time).
+// Pass the hash of a prefix as seed to continue hashing (see assetKey in util/assets.h).
+constexpr uint64_t hashName(std::string_view name, uint64_t seed = 0xcbf29ce484222325ull)
+{
+    uint64_t hash = seed;
+    for (char c : name)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef HDR_DECODE_H
+#define HDR_DECODE_H
+
+#include <util/parallel.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// Loads Radiance HDR (.hdr, RGBE) images straight into GL_RGB9_E5 texels, 4 bytes per texel. stbi_loadf decodes the
+// whole image on one thread into 12 byte floats that the driver converts again on upload; here the scanlines are
+// decoded on all threads and every texel is converted once, with integer and SSE math (an RGBE texel already is a
+// shared exponent format, RGB9_E5 just has a bit more mantissa and a smaller exponent range, up to 65408).
+//
+// The scanlines are run length encoded with varying lengths, a first (sequential, cheap) pass only skips through the
+// runs to find where each scanline starts, the second pass decodes them in parallel.
+
+// a decoded HDR image: GL_RGB9_E5 texels (upload as GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV), the first row is the bottom
+// one if it was flipped (like stbi_set_flip_vertically_on_load(true))
+struct HdrImage {
+    int width = 0, height = 0;
+    std::vector<uint32_t> texels;
+};
+
+const int HDR_ROWS_PER_TASK = 16;
+
+// one RGBE texel (8 bit mantissas, value m * 2^(e - 136)) as RGB9_E5 (9 bit mantissas, value m * 2^(e5 - 24)): the
+// mantissas get one more bit and the exponent is rebased to e - 113, outside [0, 31] the mantissas are shifted instead
+// (denormals below, saturated above)
+inline uint32_t rgbeToRgb9e5(unsigned char r, unsigned char g, unsigned char b, unsigned char e)
+{
+    int e5 = std::min(std::max((int)e - 113, 0), 31);
+    float scale = std::ldexp(2.0f, (int)e - 113 - e5); // (the 2 is the extra bit)
+    uint32_t r9 = (uint32_t)std::min(r * scale, 511.0f);
+    uint32_t g9 = (uint32_t)std::min(g * scale, 511.0f);
+    uint32_t b9 = (uint32_t)std::min(b * scale, 511.0f);
+    return r9 | (g9 << 9) | (b9 << 18) | ((uint32_t)e5 << 27);
+}
+
+// converts a scanline given as four planes (r, g, b, e) to RGB9_E5
+inline void convertHdrScanline(const unsigned char* r, const unsigned char* g, const unsigned char* b, const unsigned char* e,
+                               int width, uint32_t* out)
+{
+    int x = 0;
+#ifdef HDR_USE_SSE
+    // four texels at a time, the same math as rgbeToRgb9e5 (the scale 2^s is built in the exponent bits of a float)
+    const __m128i zero = _mm_setzero_si128(), bias = _mm_set1_epi32(113), exponentBias = _mm_set1_epi32(128);
+    const __m128 zeroF = _mm_setzero_ps(), maxExponent = _mm_set1_ps(31.0f), maxMantissa = _mm_set1_ps(511.0f);
+    auto load = [&](const unsigned char* plane) {
+        int32_t bytes;
+        memcpy(&bytes, plane + x, 4);
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+    };
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i exponent = _mm_sub_epi32(load(e), bias);
+        __m128i e5 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_cvtepi32_ps(exponent), zeroF), maxExponent));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_sub_epi32(exponent, e5), exponentBias), 23)); // 2^(s + 1)
+        __m128i r9 = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(load(r)), scale), maxMantissa));
+        __m128i g9 = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(load(g)), scale), maxMantissa));
+        __m128i b9 = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(load(b)), scale), maxMantissa));
+        __m128i texels = _mm_or_si128(_mm_or_si128(r9, _mm_slli_epi32(g9, 9)), _mm_or_si128(_mm_slli_epi32(b9, 18), _mm_slli_epi32(e5, 27)));
+        _mm_storeu_si128((__m128i*)(out + x), texels);
+    }
+#endif
+    for (; x < width; x++)
+        out[x] = rgbeToRgb9e5(r[x], g[x], b[x], e[x]);
+}
+
+// reads a header line (without the newline), false at the end of the data
+inline bool hdrLine(const unsigned char* data, size_t size, size_t& position, std::string& line)
+{
+    line.clear();
+    while (position < size && data[position] != '\n')
+        line += (char)data[position++];
+    if (position >= size)
+        return false;
+    position++;
+    return true;
+}
+
+// skips an RLE scanline (one run per channel, see decodeHdrScanline), false if it is damaged
+inline bool skipHdrScanline(const unsigned char* data, size_t size, size_t& position, int width)
+{
+    position += 4; // (2, 2, width)
+    for (int channel = 0; channel < 4; channel++)
+    {
+        for (int x = 0; x < width;)
+        {
+            if (position >= size)
+                return false;
+            int count = data[position++];
+            if (count > 128)
+            {
+                count -= 128;
+                position++; // (the value of the run)
+            }
+            else
+                position += count; // (count values)
+            if (count == 0 || x + count > width)
+                return false;
+            x += count;
+        }
+    }
+    return position <= size;
+}
+
+// decodes the RLE scanline at data into the planes (r, g, b, e, width bytes each)
+inline void decodeHdrScanline(const unsigned char* data, int width, unsigned char* planes)
+{
+    data += 4;
+    for (int channel = 0; channel < 4; channel++)
+    {
+        unsigned char* plane = planes + (size_t)channel * width;
+        for (int x = 0; x < width;)
+        {
+            int count = *data++;
+            if (count > 128)
+            {
+                count -= 128;
+                memset(plane + x, *data++, count);
+            }
+            else
+            {
+                memcpy(plane + x, data, count);
+                data += count;
+            }
+            x += count;
+        }
+    }
+}
+
+// decodes the .hdr file in data. Returns false for what it doesn't support (other orientations than -Y +X, XYZE) or
+// damaged data, use stbi_loadf then.
+bool decodeHdr(const unsigned char* data, size_t size, HdrImage& image, bool flipVertically = true)
+{
+    size_t position = 0;
+    std::string line;
+    if (!hdrLine(data, size, position, line) || (line != "#?RADIANCE" && line != "#?RGBE"))
+        return false;
+    bool rgbe = false;
+    while (hdrLine(data, size, position, line) && !line.empty())
+        if (line == "FORMAT=32-bit_rle_rgbe")
+            rgbe = true;
+    int width = 0, height = 0;
+    if (!rgbe || !hdrLine(data, size, position, line) || line.compare(0, 3, "-Y ") != 0)
+        return false;
+    char* token = nullptr;
+    height = (int)strtol(line.c_str() + 3, &token, 10);
+    while (*token == ' ') token++;
+    if (strncmp(token, "+X ", 3) != 0)
+        return false;
+    width = (int)strtol(token + 3, nullptr, 10);
+    if (width <= 0 || height <= 0 || (size_t)width * height > ((size_t)1 << 30))
+        return false;
+
+    // where the scanlines start (new RLE scanlines need 8 <= width < 32768 and start with 2, 2 and the width)
+    auto isRle = [&](size_t at) {
+        return width >= 8 && width < 32768 && at + 4 <= size && data[at] == 2 && data[at + 1] == 2 &&
+               !(data[at + 2] & 0x80) && ((data[at + 2] << 8) | data[at + 3]) == width;
+    };
+    bool rle = isRle(position);
+    std::vector<size_t> scanlines(height);
+    for (int y = 0; y < height; y++)
+    {
+        scanlines[y] = position;
+        if (!rle)
+            position += (size_t)width * 4;
+        else if (!isRle(position) || !skipHdrScanline(data, size, position, width))
+            return false; // (a flat scanline in an RLE image, stbi handles those)
+    }
+    if (position > size)
+        return false;
+
+    // decode and convert bands of scanlines in parallel
+    image.width = width;
+    image.height = height;
+    image.texels.resize((size_t)width * height);
+    size_t tasks = (height + HDR_ROWS_PER_TASK - 1) / HDR_ROWS_PER_TASK;
+    parallelFor(tasks, [&](size_t task) {
+        std::vector<unsigned char> planes((size_t)width * 4);
+        unsigned char* r = planes.data();
+        unsigned char* g = r + width;
+        unsigned char* b = g + width;
+        unsigned char* e = b + width;
+        int last = std::min(height, (int)(task + 1) * HDR_ROWS_PER_TASK);
+        for (int y = (int)task * HDR_ROWS_PER_TASK; y < last; y++)
+        {
+            const unsigned char* scanline = data + scanlines[y];
+            if (rle)
+                decodeHdrScanline(scanline, width, planes.data());
+            else
+                for (int x = 0; x < width; x++)
+                {
+                    r[x] = scanline[4 * x];
+                    g[x] = scanline[4 * x + 1];
+                    b[x] = scanline[4 * x + 2];
+                    e[x] = scanline[4 * x + 3];
+                }
+            int row = flipVertically ? height - 1 - y : y;
+            convertHdrScanline(r, g, b, e, width, image.texels.data() + (size_t)row * width);
+        }
+    });
+    return true;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HDR_LOADER_H
+#define HDR_LOADER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/glstate.h>
+#include <util/hdr_decode.h> // (HdrImage, decodeHdr; no OpenGL, for the tools)
+
+// creates a (clamped, linear) GL_RGB9_E5 texture of the image
+unsigned int createHdrTexture(const HdrImage& image)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glState().BindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB9_E5, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, image.texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+#endif
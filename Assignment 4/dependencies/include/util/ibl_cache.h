@@ -0,0 +1,154 @@
+#ifndef IBL_CACHE_H
+#define IBL_CACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <util/glstate.h>
+#include <util/filesystem.h>
+#include <util/asset_pack.h> // (BlobWriter, BlobReader)
+#include <util/ibl_cache_image.h> // (the file format, IblCacheImage)
+
+#include <string>
+#include <iostream>
+
+// The precomputed maps of image based lighting. They only depend on the environment map and the bake parameters, so they
+// are baked once and then read from a cache file (see saveIblCache and loadIblCache).
+struct IblMaps {
+    unsigned int environment = 0; // the environment as a cube map (mipmapped)
+    unsigned int irradiance = 0;  // diffuse irradiance (cube map)
+    unsigned int prefilter = 0;   // specular radiance prefiltered per roughness in the mip levels (cube map)
+    unsigned int brdfLUT = 0;     // split sum BRDF scale and bias over (n.v, roughness) (2D)
+};
+
+struct IblCacheFormatInfo {
+    GLenum internalFormat, format, type;
+};
+const IblCacheFormatInfo IBL_CACHE_FORMATS[] = {
+    { GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV },
+    { GL_RG16F, GL_RG, GL_HALF_FLOAT },
+};
+
+static_assert(IBL_TEXTURE_2D == GL_TEXTURE_2D && IBL_TEXTURE_CUBE_MAP == GL_TEXTURE_CUBE_MAP, "IBL cache targets");
+
+// writes a texture (all defined mip levels, all faces) into the cache blob
+void writeIblCacheTexture(BlobWriter& out, GLenum target, unsigned int texture, IblCacheFormat format)
+{
+    const IblCacheFormatInfo& info = IBL_CACHE_FORMATS[format];
+    GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    unsigned int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    glState().BindTexture(target, texture);
+    GLint width = 0, height = 0;
+    glGetTexLevelParameteriv(faceTarget, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(faceTarget, 0, GL_TEXTURE_HEIGHT, &height);
+    GLint fullChain = 1, levels = 1;
+    while ((width | height) >> fullChain) fullChain++;
+    for (; levels < fullChain; levels++) // (the levels that were allocated)
+    {
+        GLint w = 0;
+        glGetTexLevelParameteriv(faceTarget, levels, GL_TEXTURE_WIDTH, &w);
+        if (w == 0) break;
+    }
+
+    out.Write((uint32_t)target);
+    out.Write((uint32_t)format);
+    out.Write((int32_t)width);
+    out.Write((int32_t)height);
+    out.Write((int32_t)levels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (GLint level = 0; level < levels; level++)
+    {
+        size_t bytes = (size_t)std::max(1, width >> level) * std::max(1, height >> level) * 4;
+        for (unsigned int face = 0; face < faces; face++)
+        {
+            size_t offset = out.bytes.size();
+            out.bytes.resize(offset + bytes);
+            glGetTexImage(faceTarget + face, level, info.format, info.type, out.bytes.data() + offset);
+        }
+    }
+}
+
+// creates a texture from the cache blob (immutable storage, clamped, trilinear if it has mip levels)
+bool readIblCacheTexture(BlobReader& in, GLenum target, unsigned int& texture)
+{
+    uint32_t storedTarget, format;
+    int32_t width, height, levels;
+    if (!in.Read(storedTarget) || !in.Read(format) || !in.Read(width) || !in.Read(height) || !in.Read(levels) ||
+        !validIblCacheHeader(storedTarget, target, format, width, height, levels))
+        return false;
+
+    const IblCacheFormatInfo& info = IBL_CACHE_FORMATS[format];
+    GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+    unsigned int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    glGenTextures(1, &texture);
+    glState().BindTexture(target, texture);
+    glTexStorage2D(target, levels, info.internalFormat, width, height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int32_t level = 0; level < levels; level++)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        for (unsigned int face = 0; face < faces; face++)
+        {
+            const unsigned char* pixels = in.ReadBytes((size_t)w * h * 4); // (no copy)
+            if (!pixels)
+            {
+                glDeleteTextures(1, &texture);
+                texture = 0;
+                return false;
+            }
+            glTexSubImage2D(faceTarget + face, level, 0, 0, w, h, info.format, info.type, pixels);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return true;
+}
+
+// reads the baked maps back and writes them to the cache file at path (creates its directory)
+bool saveIblCache(const std::string& path, uint64_t key, const IblMaps& maps)
+{
+    BlobWriter out;
+    out.Write(IBL_CACHE_MAGIC);
+    out.Write(IBL_CACHE_VERSION);
+    out.Write(key);
+    writeIblCacheTexture(out, GL_TEXTURE_CUBE_MAP, maps.environment, IBL_R11G11B10F);
+    writeIblCacheTexture(out, GL_TEXTURE_CUBE_MAP, maps.irradiance, IBL_R11G11B10F);
+    writeIblCacheTexture(out, GL_TEXTURE_CUBE_MAP, maps.prefilter, IBL_R11G11B10F);
+    writeIblCacheTexture(out, GL_TEXTURE_2D, maps.brdfLUT, IBL_RG16F);
+    return writeIblCacheFile(path, out);
+}
+
+// creates the maps from the cache file at path. Returns false (and creates nothing) if there is no cache file or if it
+// was baked with another key.
+bool loadIblCache(const std::string& path, uint64_t key, IblMaps& maps)
+{
+    FileData file;
+    if (!FileSystem::read(path, file))
+        return false;
+    BlobReader in(file.data, file.size);
+    uint32_t magic, version;
+    uint64_t storedKey;
+    if (!in.Read(magic) || !in.Read(version) || !in.Read(storedKey) ||
+        magic != IBL_CACHE_MAGIC || version != IBL_CACHE_VERSION || storedKey != key)
+        return false;
+
+    IblMaps loaded;
+    bool complete = readIblCacheTexture(in, GL_TEXTURE_CUBE_MAP, loaded.environment) &&
+                    readIblCacheTexture(in, GL_TEXTURE_CUBE_MAP, loaded.irradiance) &&
+                    readIblCacheTexture(in, GL_TEXTURE_CUBE_MAP, loaded.prefilter) &&
+                    readIblCacheTexture(in, GL_TEXTURE_2D, loaded.brdfLUT);
+    if (!complete)
+    {
+        std::cout << "The IBL cache " << path << " is damaged, baking again" << std::endl;
+        unsigned int textures[] = { loaded.environment, loaded.irradiance, loaded.prefilter, loaded.brdfLUT };
+        for (unsigned int texture : textures)
+            if (texture) glDeleteTextures(1, &texture);
+        return false;
+    }
+    maps = loaded;
+    return true;
+}
+
+#endif
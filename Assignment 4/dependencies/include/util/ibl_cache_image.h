@@ -0,0 +1,171 @@
+#ifndef IBL_CACHE_IMAGE_H
+#define IBL_CACHE_IMAGE_H
+
+#include <util/hash.h>
+#include <util/filesystem.h>
+#include <util/asset_pack.h> // (BlobWriter, BlobReader)
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// The file format of the IBL cache (see util/ibl_cache.h) and its maps on the CPU, without OpenGL, so bakers without a
+// GPU (src/tools/iblbake) can write it.
+
+const uint32_t IBL_CACHE_MAGIC = 0x434C4249; // "IBLC"
+const uint32_t IBL_CACHE_VERSION = 1;
+
+// Storage formats of the cache: the radiance maps as R11G11B10F (no sign bit, 6/5 bit mantissa, plenty for lighting),
+// the BRDF LUT as two halfs. Both take 4 bytes per texel. GL converts when the baked textures (RGB16F, RG16F) are read.
+enum IblCacheFormat : uint32_t { IBL_R11G11B10F, IBL_RG16F };
+
+// the texture targets of the maps as stored in the cache (the values of GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP)
+const uint32_t IBL_TEXTURE_2D = 0x0DE1;
+const uint32_t IBL_TEXTURE_CUBE_MAP = 0x8513;
+
+// the cache key: a hash of the sources of the bake (the contents of the environment map and of the shaders) and its
+// parameters (sizes, sample counts, ...). Any change to them bakes the maps again.
+uint64_t iblCacheKey(const std::vector<std::string_view>& sources, const std::vector<int>& parameters)
+{
+    uint64_t key = hashName("ibl");
+    for (std::string_view source : sources)
+        key = hashName(source, key);
+    for (int parameter : parameters)
+        key = hashName(std::string_view((const char*)&parameter, sizeof(parameter)), key);
+    return hashName(std::string_view((const char*)&IBL_CACHE_VERSION, sizeof(IBL_CACHE_VERSION)), key);
+}
+
+// A map in the storage format of the cache on the CPU (for bakers without a GPU, see src/tools/iblbake): the faces of
+// level 0, then the faces of level 1, ... 4 bytes per texel.
+struct IblCacheImage {
+    uint32_t target = IBL_TEXTURE_2D;
+    IblCacheFormat format = IBL_R11G11B10F;
+    int width = 0, height = 0, levels = 0;
+    std::vector<uint32_t> texels;
+
+    unsigned int Faces() const { return target == IBL_TEXTURE_CUBE_MAP ? 6 : 1; }
+    int Width(int level) const { return std::max(1, width >> level); }
+    int Height(int level) const { return std::max(1, height >> level); }
+    // index of the first texel of the face of the level
+    size_t Offset(int level, unsigned int face) const
+    {
+        size_t offset = 0;
+        for (int l = 0; l < level; l++)
+            offset += (size_t)Width(l) * Height(l) * Faces();
+        return offset + (size_t)Width(level) * Height(level) * face;
+    }
+    // the texel as floats (a RG16F texel has blue 0)
+    glm::vec3 Texel(size_t index) const
+    {
+        if (format == IBL_RG16F)
+            return glm::vec3(glm::unpackHalf1x16((glm::uint16)(texels[index] & 0xFFFF)), glm::unpackHalf1x16((glm::uint16)(texels[index] >> 16)), 0.0f);
+        return glm::unpackF2x11_1x10(texels[index]);
+    }
+    static uint32_t Pack(IblCacheFormat format, const glm::vec3& color)
+    {
+        if (format == IBL_RG16F)
+            return (uint32_t)glm::packHalf1x16(color.r) | ((uint32_t)glm::packHalf1x16(color.g) << 16);
+        return glm::packF2x11_1x10(glm::max(color, glm::vec3(0.0f))); // (no sign bit)
+    }
+};
+
+// checks the header of a map in the cache blob: the expected target, a known format, a positive (for cube maps square)
+// size and no more mip levels than the size has, so a damaged file can't make the readers allocate or upload levels
+// that don't exist (the cache is baked again then)
+bool validIblCacheHeader(uint32_t storedTarget, uint32_t target, uint32_t format, int32_t width, int32_t height, int32_t levels)
+{
+    if (storedTarget != target || format > IBL_RG16F || width <= 0 || height <= 0 || levels <= 0 ||
+        (target == IBL_TEXTURE_CUBE_MAP && width != height))
+        return false;
+    int32_t fullChain = 1; // (floor(log2(max(width, height))) + 1)
+    for (int32_t size = std::max(width, height); size > 1; size >>= 1)
+        fullChain++;
+    return levels <= fullChain;
+}
+
+// writes the map into the cache blob (the same layout writeIblCacheTexture writes)
+void writeIblCacheImage(BlobWriter& out, const IblCacheImage& image)
+{
+    out.Write((uint32_t)image.target);
+    out.Write((uint32_t)image.format);
+    out.Write((int32_t)image.width);
+    out.Write((int32_t)image.height);
+    out.Write((int32_t)image.levels);
+    size_t offset = out.bytes.size();
+    out.bytes.resize(offset + image.texels.size() * sizeof(uint32_t));
+    memcpy(out.bytes.data() + offset, image.texels.data(), image.texels.size() * sizeof(uint32_t));
+}
+
+// reads a map of the cache blob to the CPU
+bool readIblCacheImage(BlobReader& in, uint32_t target, IblCacheImage& image)
+{
+    uint32_t storedTarget, format;
+    int32_t width, height, levels;
+    if (!in.Read(storedTarget) || !in.Read(format) || !in.Read(width) || !in.Read(height) || !in.Read(levels) ||
+        !validIblCacheHeader(storedTarget, target, format, width, height, levels))
+        return false;
+    image.target = target;
+    image.format = (IblCacheFormat)format;
+    image.width = width;
+    image.height = height;
+    image.levels = levels;
+    size_t count = image.Offset(levels, 0);
+    const unsigned char* texels = in.ReadBytes(count * sizeof(uint32_t));
+    if (!texels)
+        return false;
+    image.texels.resize(count);
+    memcpy(image.texels.data(), texels, count * sizeof(uint32_t));
+    return true;
+}
+
+// writes the cache blob to the file at path (creates its directory)
+bool writeIblCacheFile(const std::string& path, const BlobWriter& out)
+{
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (!directory.empty())
+        std::filesystem::create_directories(directory, error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write((const char*)out.bytes.data(), out.bytes.size()))
+    {
+        std::cout << "Can't write the IBL cache " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// writes maps baked on the CPU (environment, irradiance, prefilter, BRDF LUT) to the cache file at path
+bool saveIblCacheImages(const std::string& path, uint64_t key, const IblCacheImage images[4])
+{
+    BlobWriter out;
+    out.Write(IBL_CACHE_MAGIC);
+    out.Write(IBL_CACHE_VERSION);
+    out.Write(key);
+    for (int i = 0; i < 4; i++)
+        writeIblCacheImage(out, images[i]);
+    return writeIblCacheFile(path, out);
+}
+
+// reads the maps of the cache file at path to the CPU, whatever its key (returned in key)
+bool loadIblCacheImages(const std::string& path, uint64_t& key, IblCacheImage images[4])
+{
+    FileData file;
+    if (!FileSystem::read(path, file))
+        return false;
+    BlobReader in(file.data, file.size);
+    uint32_t magic, version;
+    if (!in.Read(magic) || !in.Read(version) || !in.Read(key) || magic != IBL_CACHE_MAGIC || version != IBL_CACHE_VERSION)
+        return false;
+    return readIblCacheImage(in, IBL_TEXTURE_CUBE_MAP, images[0]) && readIblCacheImage(in, IBL_TEXTURE_CUBE_MAP, images[1]) &&
+           readIblCacheImage(in, IBL_TEXTURE_CUBE_MAP, images[2]) && readIblCacheImage(in, IBL_TEXTURE_2D, images[3]);
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef IBL_PREFILTER_H
+#define IBL_PREFILTER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+#include <util/shader.h>
+#include <util/sh.h> // (readCubemapLevel)
+#include <util/prefilter_samples.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Prefilters the environment for the specular part of image based lighting with a compute shader (src/ibl/prefilter.comp).
+// Like the fragment shader version it importance samples GGX around N = V = R, but:
+//  - one dispatch writes all six faces of a mip level (imageStore into the layered level),
+//  - the samples read the mip level of the environment whose texel covers the solid angle of the sample (filtered
+//    importance sampling, GPU Gems 3 chapter 20.4), so far fewer samples give the same smooth result,
+//  - the number of samples grows with the roughness (a sharp lobe needs few samples),
+//  - the sample directions and levels don't depend on the texel, they are computed once per level here.
+
+const GLuint PREFILTER_SAMPLES_BINDING = 0; // (shader storage buffer of prefilter.comp)
+
+// an empty prefilter map of levels mip levels (size texels per side at level 0). RGBA16F, RGB16F can't be an image.
+unsigned int createPrefilterMap(int size, int levels)
+{
+    unsigned int prefilterMap;
+    glGenTextures(1, &prefilterMap);
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, GL_RGBA16F, size, size);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return prefilterMap;
+}
+
+class PrefilterBaker {
+public:
+    explicit PrefilterBaker(const char* computePath) : shader(computePath) {}
+
+    // fills the first levels of prefilterMap (see createPrefilterMap) from the mipmapped environment cube map, level i
+    // with roughness i / (levels - 1)
+    void Bake(unsigned int environment, unsigned int prefilterMap, int levels)
+    {
+        GLint environmentSize = 0;
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, environment);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &environmentSize);
+        Prepare(environmentSize, levels);
+        for (int level = 0; level < levels; level++)
+            Dispatch(environment, prefilterMap, level);
+        // (the maps are sampled and read back afterwards)
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    }
+
+    // uploads the samples of levels levels for an environment with environmentSize texels per side (only if they
+    // changed), Dispatch uses them
+    void Prepare(int environmentSize, int levels)
+    {
+        if (sampleBuffer && environmentSize == preparedSize && levels == preparedLevels)
+            return;
+        // the samples of all levels in one buffer
+        std::vector<glm::vec4> samples;
+        first.clear();
+        count.clear();
+        for (int level = 0; level < levels; level++)
+        {
+            float roughness = levels > 1 ? (float)level / (float)(levels - 1) : 0.0f;
+            std::vector<glm::vec4> levelSamples = prefilterSamples(roughness, prefilterSampleCount(roughness), environmentSize);
+            first.push_back((GLint)samples.size());
+            count.push_back((GLint)levelSamples.size());
+            samples.insert(samples.end(), levelSamples.begin(), levelSamples.end());
+        }
+        if (!sampleBuffer)
+            sampleBuffer = createBuffer();
+        glState().BindBuffer(GL_SHADER_STORAGE_BUFFER, sampleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, samples.size() * sizeof(glm::vec4), samples.data(), GL_STATIC_DRAW);
+        preparedSize = environmentSize;
+        preparedLevels = levels;
+    }
+
+    // prefilters the faces [firstFace, firstFace + faceCount) of a level (after Prepare). The map needs a
+    // glMemoryBarrier before it is sampled.
+    void Dispatch(unsigned int environment, unsigned int prefilterMap, int level, int firstFace = 0, int faceCount = 6)
+    {
+        GLint size = 0;
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_WIDTH, &size);
+        glState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, PREFILTER_SAMPLES_BINDING, sampleBuffer);
+        shader.use();
+        shader.setInt("environmentMap", 0);
+        shader.setInt("size", size);
+        shader.setInt("firstFace", firstFace);
+        shader.setInt("firstSample", first[level]);
+        shader.setInt("sampleCount", count[level]);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, environment);
+        glBindImageTexture(0, prefilterMap, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute((size + 7) / 8, (size + 7) / 8, faceCount);
+    }
+
+    static unsigned int SampleCount(int levels) { return prefilterTotalSamples(levels); }
+
+private:
+    Shader shader;
+    GLBuffer sampleBuffer;
+    std::vector<GLint> first, count; // (sample range of every level)
+    int preparedSize = 0, preparedLevels = 0;
+};
+
+// difference between two prefilter maps per mip level: root mean square error (per channel) relative to the mean of b
+struct PrefilterError {
+    std::vector<float> relativeRmse;
+    float worst = 0.0f;
+};
+
+PrefilterError comparePrefilter(unsigned int a, unsigned int b, int levels)
+{
+    PrefilterError error;
+    for (int level = 0; level < levels; level++)
+    {
+        std::vector<float> facesA[6], facesB[6];
+        readCubemapLevel(a, level, facesA);
+        readCubemapLevel(b, level, facesB);
+        double squares = 0.0, mean = 0.0;
+        size_t n = 0;
+        for (int face = 0; face < 6; face++)
+        {
+            size_t count = std::min(facesA[face].size(), facesB[face].size());
+            for (size_t i = 0; i < count; i++)
+            {
+                double d = (double)facesA[face][i] - facesB[face][i];
+                squares += d * d;
+                mean += facesB[face][i];
+            }
+            n += count;
+        }
+        float relative = n && mean > 0.0 ? (float)(std::sqrt(squares / n) / (mean / n)) : 0.0f;
+        error.relativeRmse.push_back(relative);
+        error.worst = std::max(error.worst, relative);
+    }
+    return error;
+}
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef IBL_REBAKE_H
+#define IBL_REBAKE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+#include <util/shader.h>
+#include <util/sh.h>
+#include <util/ibl_prefilter.h>
+#include <util/hdr_loader.h>
+#include <util/primitives.h>
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <chrono> // for timing
+
+// default GPU time per frame spent by IblRebaker::Update
+const float DEFAULT_IBL_REBAKE_BUDGET_MS = 2.0f;
+
+// Bakes the IBL maps of a new (or rotated) environment over several frames, so changing the environment at runtime
+// doesn't stall a frame. The bake is cut into small steps: bands of rows of the HDR upload, one face of the cube map
+// conversion, the mipmaps, bands of rows of an irradiance face, one face of a prefilter level, the SH projection (read
+// back through a pixel buffer and a fence, so the CPU never waits for the GPU). Update runs steps until the estimated
+// cost of the next one would exceed the budget (but at least one step per frame). The cost of every kind of step is
+// measured with timer queries (and the CPU time of the call, for uploads), the results are read a few frames later.
+//
+// The maps are double buffered: the steps write the back maps while the front maps are rendered, when the last step is
+// done the two are swapped between two frames, so a frame always sees a complete set (environment, irradiance,
+// prefilter and SH). The steps need the formats the rebaker creates (RGB16F, the prefilter map RGBA16F for the image
+// stores); adopted maps in other formats (e.g., the R11G11B10F ones of the IBL cache) are replaced once they are the
+// back maps.
+class IblRebaker {
+public:
+    struct Stats {
+        bool busy = false;
+        unsigned int stepsDone = 0, stepCount = 0; // of the running bake
+        unsigned int stepsLastFrame = 0;
+        float estimatedLastFrameMs = 0.0f; // of the steps run in the last Update
+        float maxStepMs = 0.0f;            // most expensive step measured so far
+        // of the last completed bake
+        unsigned int completed = 0;
+        unsigned int lastFrames = 0;
+        float lastMs = 0.0f;    // from Start to the swap
+        float lastGpuMs = 0.0f; // measured cost of its steps
+    };
+
+    IblRebaker(Shader& equirectangularToCubemap, Shader& irradiance, PrefilterBaker& prefilter, int prefilterLevels = 5)
+        : equirectangularShader(equirectangularToCubemap), irradianceShader(irradiance), prefilterBaker(prefilter),
+          prefilterLevels(prefilterLevels)
+    {
+        estimates.assign(PREFILTER + prefilterLevels, 1.0f);
+        measured.assign(estimates.size(), false);
+    }
+
+    ~IblRebaker()
+    {
+        if (glfwGetCurrentContext() == nullptr)
+            return; // (dropped with the context)
+        if (shFence)
+            glDeleteSync(shFence);
+        if (!queries.empty())
+            glDeleteQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    // takes ownership of the maps baked (or loaded) at startup, they are the front maps until the first swap. source is
+    // the equirectangular HDR texture they were baked from (0 if they came from the cache: Start needs an image then,
+    // the caller decodes the source when it is first needed). The back maps get the sizes of these.
+    void Adopt(unsigned int environment, unsigned int irradiance, unsigned int prefilter, const SHCoefficients& sh,
+               unsigned int source = 0)
+    {
+        front.environment.Reset(environment);
+        front.irradiance.Reset(irradiance);
+        front.prefilter.Reset(prefilter);
+        front.sh = sh;
+        front.bakeFormats = internalFormat(environment) == GL_RGB16F && internalFormat(irradiance) == GL_RGB16F &&
+                            internalFormat(prefilter) == GL_RGBA16F;
+        sourceTexture.Reset(source);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, environment);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &environmentSize);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, irradiance);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &irradianceSize);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilter);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &prefilterSize);
+    }
+
+    // starts baking the maps of image (rotated by rotation radians about the y axis), or, without an image, of the
+    // current source with a new rotation (false if there is none). A bake that is still running is dropped.
+    bool Start(std::shared_ptr<HdrImage> image, float rotation = 0.0f)
+    {
+        if (!image)
+            image = uploading; // (a new rotation while the source is still being uploaded)
+        if (!image && !sourceTexture)
+            return false;
+        if (!back.bakeFormats)
+            createBackMaps();
+        if (shFence)
+        {
+            glDeleteSync(shFence);
+            shFence = 0;
+        }
+        steps.clear();
+        next = 0;
+        frames = 0;
+        gpuMs = 0.0f;
+        started = Clock::now();
+        generation++;
+
+        if (image)
+            addUploadSteps(std::move(image));
+        for (int face = 0; face < 6; face++)
+            steps.push_back({ CONVERT, [this, face, rotation] { convertFace(face, rotation); return true; } });
+        steps.push_back({ MIPMAPS, [this] {
+            glState().BindTexture(GL_TEXTURE_CUBE_MAP, back.environment);
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+            return true;
+        } });
+        steps.push_back({ SH_READ, [this] { readSHLevel(); return true; } });
+        for (int face = 0; face < 6; face++)
+            for (int y = 0; y < irradianceSize; y += IRRADIANCE_ROWS)
+                steps.push_back({ IRRADIANCE, [this, face, y] { convolveIrradiance(face, y); return true; } });
+        for (int level = 0; level < prefilterLevels; level++)
+            for (int face = 0; face < 6; face++)
+                steps.push_back({ PREFILTER + level, [this, level, face] {
+                    prefilterBaker.Prepare(environmentSize, prefilterLevels); // (only uploads the samples once)
+                    prefilterBaker.Dispatch(back.environment, back.prefilter, level, face, 1);
+                    return true;
+                } });
+        steps.push_back({ SH_PROJECT, [this] { return projectSH(); } });
+        return true;
+    }
+
+    // runs the next steps of the bake within budgetMs of (estimated) GPU time, call once per frame before rendering.
+    // Returns true if the new maps were swapped in (the framebuffer, viewport and texture bindings are changed).
+    bool Update(float budgetMs = DEFAULT_IBL_REBAKE_BUDGET_MS)
+    {
+        collectQueries();
+        stats.stepsLastFrame = 0;
+        stats.estimatedLastFrameMs = 0.0f;
+        if (!Busy())
+            return false;
+
+        frames++;
+        float spent = 0.0f;
+        while (next < steps.size())
+        {
+            Step& step = steps[next];
+            float cost = estimates[step.kind];
+            if (stats.stepsLastFrame > 0 && spent + cost > budgetMs)
+                break;
+            GLuint query = acquireQuery();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            auto start = Clock::now();
+            bool done = step.run();
+            float cpuMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+            glEndQuery(GL_TIME_ELAPSED);
+            if (!done)
+            {
+                freeQueries.push_back(query); // waits for the GPU (the SH read back), again in the next frame
+                break;
+            }
+            pending.push_back({ query, step.kind, cpuMs, generation });
+            spent += cost;
+            stats.stepsLastFrame++;
+            next++;
+        }
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+        stats.estimatedLastFrameMs = spent;
+        if (next < steps.size())
+            return false;
+
+        // (the prefilter map was written with image stores)
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        std::swap(front, back);
+        steps.clear();
+        swappedGeneration = generation;
+        stats.lastGpuMs = gpuMs; // (the rest is added when the queries of the last steps have their results)
+        next = 0;
+        stats.completed++;
+        stats.lastFrames = frames;
+        stats.lastMs = std::chrono::duration<float, std::milli>(Clock::now() - started).count();
+        return true;
+    }
+
+    bool Busy() const { return !steps.empty(); }
+
+    // the front maps (the ones to render with)
+    unsigned int Environment() const { return front.environment; }
+    unsigned int Irradiance() const { return front.irradiance; }
+    unsigned int Prefilter() const { return front.prefilter; }
+    const SHCoefficients& SH() const { return front.sh; }
+
+    Stats GetStats() const
+    {
+        Stats s = stats;
+        s.busy = Busy();
+        s.stepsDone = (unsigned int)next;
+        s.stepCount = (unsigned int)steps.size();
+        return s;
+    }
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // kinds of steps (their costs are estimated separately), PREFILTER + level for the prefilter levels
+    enum Kind { UPLOAD, CONVERT, MIPMAPS, SH_READ, SH_PROJECT, IRRADIANCE, PREFILTER };
+    static const int IRRADIANCE_ROWS = 8;
+    static const size_t UPLOAD_BYTES = 4 * 1024 * 1024; // per upload step
+    static const int SH_MAX_SIZE = 64;                   // (see projectCubemapSH)
+
+    struct Step {
+        int kind;
+        std::function<bool()> run; // false if it has to wait, it runs again in the next frame
+    };
+    struct Query {
+        GLuint query;
+        int kind;
+        float cpuMs;
+        unsigned int generation;
+    };
+    struct Maps {
+        GLTexture environment, irradiance, prefilter;
+        SHCoefficients sh;
+        bool bakeFormats = false; // (in the formats the steps write, see createBackMaps)
+    };
+
+    Shader& equirectangularShader;
+    Shader& irradianceShader;
+    PrefilterBaker& prefilterBaker;
+    int prefilterLevels;
+    GLint environmentSize = 512, irradianceSize = 32, prefilterSize = 128;
+
+    Maps front, back;
+    GLTexture sourceTexture;
+    std::shared_ptr<HdrImage> uploading; // (until its last upload step ran)
+    GLFramebuffer captureFBO;
+    GLBuffer shReadback;
+    GLsync shFence = 0;
+    int shSize = 0;
+
+    std::vector<Step> steps;
+    size_t next = 0;
+    unsigned int frames = 0;
+    unsigned int generation = 0, swappedGeneration = 0; // (of the bakes, queries of dropped bakes don't count)
+    float gpuMs = 0.0f;
+    Clock::time_point started;
+
+    std::vector<float> estimates; // ms per kind of step
+    std::vector<bool> measured;
+    std::vector<GLuint> queries, freeQueries;
+    std::vector<Query> pending;
+    Stats stats;
+
+    // (re)creates the back maps in the formats of the steps (the old ones are deleted)
+    void createBackMaps()
+    {
+        back.bakeFormats = true;
+        back.environment = createTexture(GL_TEXTURE_CUBE_MAP);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, back.environment);
+        int levels = 1;
+        while ((environmentSize >> levels) > 0) levels++;
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, GL_RGB16F, environmentSize, environmentSize);
+        setCubeParameters(GL_LINEAR_MIPMAP_LINEAR);
+
+        back.irradiance = createTexture(GL_TEXTURE_CUBE_MAP);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, back.irradiance);
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_RGB16F, irradianceSize, irradianceSize);
+        setCubeParameters(GL_LINEAR);
+
+        back.prefilter.Reset(createPrefilterMap(prefilterSize, prefilterLevels));
+
+        if (captureFBO)
+            return;
+        captureFBO = createFramebuffer();
+        // the SH are projected from the level with at most SH_MAX_SIZE texels per side
+        int level = 0;
+        while ((environmentSize >> level) > SH_MAX_SIZE) level++;
+        shSize = std::max(1, environmentSize >> level);
+        shReadback = createBuffer();
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, shReadback);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)6 * shSize * shSize * 3 * sizeof(float), nullptr, GL_STREAM_READ);
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // a new source texture and the steps that upload image into it, UPLOAD_BYTES at a time
+    void addUploadSteps(std::shared_ptr<HdrImage> image)
+    {
+        sourceTexture = createTexture(GL_TEXTURE_2D);
+        glState().BindTexture(GL_TEXTURE_2D, sourceTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB9_E5, image->width, image->height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        uploading = image;
+        int rows = std::max(1, (int)(UPLOAD_BYTES / ((size_t)image->width * 4)));
+        for (int y = 0; y < image->height; y += rows)
+        {
+            int count = std::min(rows, image->height - y);
+            bool last = y + count == image->height;
+            steps.push_back({ UPLOAD, [this, image, y, count, last]() mutable {
+                glState().BindTexture(GL_TEXTURE_2D, sourceTexture);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, image->width, count, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+                                image->texels.data() + (size_t)y * image->width);
+                if (last)
+                    uploading.reset(); // (the texels are freed with the steps)
+                return true;
+            } });
+        }
+    }
+
+    // the view of the capture camera for a face, in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + face
+    static glm::mat4 captureView(int face)
+    {
+        static const glm::vec3 targets[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        static const glm::vec3 ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+        return glm::lookAt(glm::vec3(0.0f), targets[face], ups[face]);
+    }
+
+    void renderFace(Shader& shader, GLuint cubemap, int face, int size)
+    {
+        shader.setMat4("projection", glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f));
+        shader.setMat4("view", captureView(face));
+        glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cubemap, 0);
+        glState().Viewport(0, 0, size, size);
+        primitives().Draw(PRIMITIVE_CUBE); // (no depth buffer, the cube covers every texel once)
+    }
+
+    // pbr: convert the HDR equirectangular environment map to a face of the cubemap equivalent
+    void convertFace(int face, float rotation)
+    {
+        equirectangularShader.use();
+        equirectangularShader.setInt("equirectangularMap", 0);
+        equirectangularShader.setFloat("rotation", rotation);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_2D, sourceTexture);
+        renderFace(equirectangularShader, back.environment, face, environmentSize);
+    }
+
+    // pbr: solve the diffuse integral for the rows [y, y + IRRADIANCE_ROWS) of a face of the irradiance map
+    void convolveIrradiance(int face, int y)
+    {
+        irradianceShader.use();
+        irradianceShader.setInt("environmentMap", 0);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, back.environment);
+        glScissor(0, y, irradianceSize, IRRADIANCE_ROWS);
+        glState().Enable(GL_SCISSOR_TEST);
+        renderFace(irradianceShader, back.irradiance, face, irradianceSize);
+        glState().Disable(GL_SCISSOR_TEST);
+    }
+
+    // reads the small level of the environment into the pixel buffer, projectSH picks it up once the fence is signaled
+    void readSHLevel()
+    {
+        int level = 0;
+        while ((environmentSize >> level) > shSize) level++;
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, back.environment);
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, shReadback);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        size_t faceBytes = (size_t)shSize * shSize * 3 * sizeof(float);
+        for (int face = 0; face < 6; face++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, (void*)(face * faceBytes));
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        shFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool projectSH()
+    {
+        if (shFence && glClientWaitSync(shFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(shFence);
+        shFence = 0;
+        size_t faceFloats = (size_t)shSize * shSize * 3;
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, shReadback);
+        const float* data = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 6 * faceFloats * sizeof(float), GL_MAP_READ_BIT);
+        if (data)
+        {
+            const float* faces[6];
+            for (int face = 0; face < 6; face++)
+                faces[face] = data + face * faceFloats;
+            back.sh = projectCubemapSH(faces, shSize);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glState().BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+
+    GLuint acquireQuery()
+    {
+        if (freeQueries.empty())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            queries.push_back(query);
+            return query;
+        }
+        GLuint query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+
+    // updates the cost estimates with the timer queries that have their results (in order, so stop at the first that
+    // doesn't)
+    void collectQueries()
+    {
+        size_t done = 0;
+        for (; done < pending.size(); done++)
+        {
+            Query& q = pending[done];
+            GLint available = 0;
+            glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &nanoseconds);
+            float cost = std::max(nanoseconds / 1e6f, q.cpuMs);
+            float& estimate = estimates[q.kind];
+            estimate = measured[q.kind] ? estimate + 0.25f * (cost - estimate) : cost;
+            measured[q.kind] = true;
+            stats.maxStepMs = std::max(stats.maxStepMs, cost);
+            if (q.generation == generation)
+                gpuMs += cost;
+            if (q.generation == swappedGeneration)
+                stats.lastGpuMs += cost;
+            freeQueries.push_back(q.query);
+        }
+        pending.erase(pending.begin(), pending.begin() + done);
+    }
+
+    static GLint internalFormat(GLuint cubemap)
+    {
+        GLint format = 0;
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        return format;
+    }
+
+    static void setCubeParameters(GLenum minFilter)
+    {
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+
+#endif
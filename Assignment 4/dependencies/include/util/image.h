@@ -0,0 +1,142 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stb_image.h>
+
+#include <util/filesystem.h>
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+// stb_image (v2.14) keeps the flip setting in a global, so decoding from several threads is serialized by this
+// mutex (the flip setting and the load have to happen together). Only the decoding is locked, not the upload.
+std::mutex& stbiMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+struct StbiFree {
+    void operator()(unsigned char* pixels) const { stbi_image_free(pixels); }
+};
+
+// a decoded image (8 bit per channel) in CPU memory
+struct ImageData {
+    int width = 0, height = 0, components = 0;
+    std::unique_ptr<unsigned char[], StbiFree> pixels;
+
+    explicit operator bool() const { return pixels != nullptr; }
+    size_t Bytes() const { return (size_t)width * height * components; }
+};
+
+// stbi_load through the FileSystem (the image may be in a mounted asset pack, see util/filesystem.h). The caller
+// holds the stbiMutex if the flip setting matters.
+unsigned char* loadImageFile(const std::string& path, int* width, int* height, int* components, int desiredComponents)
+{
+    FileData file;
+    if (!FileSystem::read(path, file))
+        return nullptr;
+    return stbi_load_from_memory(file.data, (int)file.size, width, height, components, desiredComponents);
+}
+
+// decodes the image at path (no OpenGL calls, so this can run on any thread). If desiredComponents is 0 the
+// channels of the file are kept. Leaves stbi_set_flip_vertically_on_load set to flip.
+ImageData decodeImage(const std::string& path, bool flip, int desiredComponents = 0)
+{
+    ImageData image;
+    std::lock_guard<std::mutex> lock(stbiMutex());
+    stbi_set_flip_vertically_on_load(flip);
+    image.pixels.reset(loadImageFile(path, &image.width, &image.height, &image.components, desiredComponents));
+    if (!image.pixels)
+        std::cout << "Failed to load image at path: " << path << std::endl;
+    else if (desiredComponents != 0)
+        image.components = desiredComponents;
+    return image;
+}
+
+// the first channel of image at (u, v) in [0, 1] (bilinear, clamped to the edges), fallback if there is no image
+inline unsigned char sampleFirstChannel(const ImageData& image, float u, float v, unsigned char fallback)
+{
+    if (!image)
+        return fallback;
+    float x = std::min(std::max(u * image.width - 0.5f, 0.0f), (float)(image.width - 1));
+    float y = std::min(std::max(v * image.height - 0.5f, 0.0f), (float)(image.height - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, image.width - 1), y1 = std::min(y0 + 1, image.height - 1);
+    float fx = x - x0, fy = y - y0;
+    auto at = [&](int px, int py) { return (float)image.pixels[((size_t)py * image.width + px) * image.components]; };
+    float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+    float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+    return (unsigned char)(top + (bottom - top) * fy + 0.5f);
+}
+
+// resamples an image with components 8 bit channels to newWidth x newHeight (bilinear, sampled at the texel centers)
+std::vector<unsigned char> resampleImage(const unsigned char* pixels, int width, int height, int components, int newWidth, int newHeight)
+{
+    std::vector<unsigned char> resampled((size_t)newWidth * newHeight * components);
+    for (int y = 0; y < newHeight; y++)
+    {
+        float sy = std::min(std::max((y + 0.5f) * height / newHeight - 0.5f, 0.0f), (float)(height - 1));
+        int y0 = (int)sy, y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < newWidth; x++)
+        {
+            float sx = std::min(std::max((x + 0.5f) * width / newWidth - 0.5f, 0.0f), (float)(width - 1));
+            int x0 = (int)sx, x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+            for (int c = 0; c < components; c++)
+            {
+                auto at = [&](int px, int py) { return (float)pixels[((size_t)py * width + px) * components + c]; };
+                float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+                float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+                resampled[((size_t)y * newWidth + x) * components + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return resampled;
+}
+
+// packs the first channel of three grey scale maps into one RGB image: r ambient occlusion, g roughness, b metallic
+// (the glTF order). The result has the size of the largest map, smaller ones are resampled bilinearly. A missing map
+// is constant (no occlusion, rough, not metallic). No OpenGL calls, so this can run on any thread.
+ImageData packOrm(const ImageData& ao, const ImageData& roughness, const ImageData& metallic)
+{
+    ImageData packed;
+    for (const ImageData* image : { &ao, &roughness, &metallic })
+    {
+        if (*image && (size_t)image->width * image->height > (size_t)packed.width * packed.height)
+        {
+            packed.width = image->width;
+            packed.height = image->height;
+        }
+    }
+    if (packed.width == 0)
+        return packed;
+    packed.components = 3;
+    packed.pixels.reset((unsigned char*)malloc(packed.Bytes())); // (freed by stbi_image_free, which is free)
+    const ImageData* sources[3] = { &ao, &roughness, &metallic };
+    const unsigned char fallbacks[3] = { 255, 255, 0 };
+    for (int c = 0; c < 3; c++)
+    {
+        const ImageData& source = *sources[c];
+        unsigned char* out = packed.pixels.get() + c;
+        if (source && source.width == packed.width && source.height == packed.height)
+        {
+            const unsigned char* in = source.pixels.get();
+            for (size_t i = 0, n = (size_t)packed.width * packed.height; i < n; i++)
+                out[3 * i] = in[i * source.components];
+            continue;
+        }
+        for (int y = 0; y < packed.height; y++)
+            for (int x = 0; x < packed.width; x++)
+                out[3 * ((size_t)y * packed.width + x)] =
+                    sampleFirstChannel(source, (x + 0.5f) / packed.width, (y + 0.5f) / packed.height, fallbacks[c]);
+    }
+    return packed;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+// A single level of detail of a mesh: a range in the (shared) index buffer of the mesh
+// and the geometric error (in object space units) introduced by simplifying down to it.
+struct LodLevel {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;
+};
+
+// default settings used when building LOD chains
+const unsigned int LOD_MAX_LEVELS = 5;       // including the full resolution level 0
+const float LOD_REDUCTION = 0.5f;            // triangle ratio between two consecutive levels
+const float LOD_MAX_RELATIVE_ERROR = 0.1f;   // maximum error of a single simplification step (relative to the mesh radius)
+
+// symmetric 4x4 matrix of the quadric error metric (Garland & Heckbert 1997) plus the accumulated weight,
+// so that the error can be normalized to a (weighted) mean squared distance.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double w = 0;
+
+    // adds the plane n.x + d = 0 (n normalized) with the given weight
+    void addPlane(const glm::dvec3& n, double d, double weight)
+    {
+        a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+        a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+        a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+        a33 += weight * d * d;
+        w += weight;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        w += q.w;
+    }
+
+    // weighted mean squared distance of p to all planes accumulated in this quadric
+    double error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                 + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                 + a22 * z * z + 2.0 * a23 * z
+                 + a33;
+        return w > 0.0 ? std::fabs(e) / w : 0.0;
+    }
+};
+
+// hash for welding vertices that share the exact same position (e.g., at uv seams)
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const
+    {
+        unsigned int h[3];
+        std::memcpy(h, &p[0], sizeof(h));
+        return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+    }
+};
+
+// utility function that simplifies a triangle mesh by collapsing edges in the order of their quadric error.
+// Vertices are never moved; an edge collapse moves one vertex onto the other, so the vertex buffer can be
+// shared between all levels of detail. Vertices are welded by position first, so uv seams don't tear open.
+// Returns the new index list and writes the resulting error (object space distance) to resultError.
+// ---------------------------------------------------
+std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& uvs,
+    const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float* resultError = nullptr)
+{
+    const size_t vertexCount = positions.size();
+    const size_t triangleCount = indices.size() / 3;
+
+    // 1. weld vertices with identical positions, simplification works on these "canonical" vertices
+    std::vector<unsigned int> remap(vertexCount);
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> firstVertexAt;
+    firstVertexAt.reserve(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++)
+        remap[i] = firstVertexAt.emplace(positions[i], i).first->second;
+
+    // members of every canonical vertex, used to pick the matching attribute vertex after a collapse
+    std::vector<std::vector<unsigned int>> members(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++)
+        members[remap[i]].push_back(i);
+
+    std::vector<unsigned int> tris(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        tris[i] = remap[indices[i]];
+
+    // 2. find border edges (edges used by a single triangle); border vertices may only slide along the border
+    std::unordered_map<unsigned long long, int> edgeUse;
+    edgeUse.reserve(indices.size());
+    auto edgeKey = [](unsigned int a, unsigned int b) {
+        if (a > b) std::swap(a, b);
+        return ((unsigned long long)a << 32) | b;
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int e = 0; e < 3; e++)
+            edgeUse[edgeKey(tris[t * 3 + e], tris[t * 3 + (e + 1) % 3])]++;
+
+    std::vector<bool> border(vertexCount, false);
+    for (auto const& eu : edgeUse)
+    {
+        if (eu.second == 1)
+        {
+            border[(unsigned int)(eu.first >> 32)] = true;
+            border[(unsigned int)(eu.first & 0xffffffffu)] = true;
+        }
+    }
+
+    // 3. accumulate the (area weighted) plane quadrics of all triangles at their vertices
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        glm::dvec3 p0 = positions[tris[t * 3 + 0]], p1 = positions[tris[t * 3 + 1]], p2 = positions[tris[t * 3 + 2]];
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(n);
+        if (area <= 0.0) continue;
+        n /= area;
+        double d = -glm::dot(n, p0);
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+            quadrics[a].addPlane(n, d, area);
+
+            // border edges get an additional perpendicular plane that keeps the outline in place
+            if (edgeUse[edgeKey(a, b)] == 1)
+            {
+                glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+                glm::dvec3 bn = glm::cross(edge, n);
+                double len = glm::length(bn);
+                if (len <= 0.0) continue;
+                bn /= len;
+                double bd = -glm::dot(bn, glm::dvec3(positions[a]));
+                quadrics[a].addPlane(bn, bd, area * 10.0);
+                quadrics[b].addPlane(bn, bd, area * 10.0);
+            }
+        }
+    }
+
+    // 4. iteratively collapse the cheapest edges
+    std::vector<unsigned int> collapsedInto(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++) collapsedInto[i] = i;
+    std::vector<bool> alive(triangleCount, true);
+    size_t aliveCount = triangleCount;
+    const double maxErrorSq = (double)maxError * (double)maxError;
+    double worstError = 0.0;
+
+    struct Collapse { unsigned int from, to; double cost; };
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1), adjacency;
+    std::vector<bool> locked(vertexCount);
+
+    while (aliveCount * 3 > targetIndexCount)
+    {
+        // edge usage of the current mesh (collapses create new edges)
+        edgeUse.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+            if (alive[t])
+                for (int e = 0; e < 3; e++)
+                    edgeUse[edgeKey(tris[t * 3 + e], tris[t * 3 + (e + 1) % 3])]++;
+
+        // vertex -> triangle adjacency of the current mesh
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (alive[t])
+                for (int e = 0; e < 3; e++) adjacencyOffset[tris[t * 3 + e] + 1]++;
+        for (size_t i = 0; i < vertexCount; i++) adjacencyOffset[i + 1] += adjacencyOffset[i];
+        adjacency.resize(adjacencyOffset[vertexCount]);
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (alive[t])
+                for (int e = 0; e < 3; e++) adjacency[fill[tris[t * 3 + e]]++] = (unsigned int)t;
+
+        // collect all valid collapses (cheaper direction of each edge)
+        candidates.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            if (!alive[t]) continue;
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+                if (a > b) continue; // every interior edge is visited twice, border edges are handled below
+                bool isBorderEdge = edgeUse[edgeKey(a, b)] == 1;
+                bool aToB = !border[a] || (border[b] && isBorderEdge);
+                bool bToA = !border[b] || (border[a] && isBorderEdge);
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                double costAB = aToB ? q.error(positions[b]) : DBL_MAX;
+                double costBA = bToA ? q.error(positions[a]) : DBL_MAX;
+                if (costAB == DBL_MAX && costBA == DBL_MAX) continue;
+                if (costAB <= costBA) candidates.push_back({ a, b, costAB });
+                else                  candidates.push_back({ b, a, costBA });
+            }
+            // border edges are only visited once, so also take the ones with a > b
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = tris[t * 3 + e], b = tris[t * 3 + (e + 1) % 3];
+                if (a < b || edgeUse[edgeKey(a, b)] != 1) continue;
+                if (!(border[a] && border[b])) continue;
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                double costAB = q.error(positions[b]);
+                double costBA = q.error(positions[a]);
+                if (costAB <= costBA) candidates.push_back({ a, b, costAB });
+                else                  candidates.push_back({ b, a, costBA });
+            }
+        }
+        if (candidates.empty()) break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        std::fill(locked.begin(), locked.end(), false);
+        size_t collapses = 0;
+        for (const Collapse& c : candidates)
+        {
+            if (aliveCount * 3 <= targetIndexCount || c.cost > maxErrorSq) break;
+            if (locked[c.from] || locked[c.to]) continue;
+
+            // reject collapses that flip (or degenerate) any remaining triangle around the moved vertex
+            bool flips = false;
+            for (unsigned int k = adjacencyOffset[c.from]; k < adjacencyOffset[c.from + 1] && !flips; k++)
+            {
+                unsigned int t = adjacency[k];
+                unsigned int i0 = tris[t * 3 + 0], i1 = tris[t * 3 + 1], i2 = tris[t * 3 + 2];
+                if (i0 == c.to || i1 == c.to || i2 == c.to) continue; // this triangle is removed by the collapse
+                glm::vec3 p0 = positions[i0], p1 = positions[i1], p2 = positions[i2];
+                glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+                if (i0 == c.from) p0 = positions[c.to];
+                if (i1 == c.from) p1 = positions[c.to];
+                if (i2 == c.from) p2 = positions[c.to];
+                glm::vec3 after = glm::cross(p1 - p0, p2 - p0);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips) continue;
+
+            // perform the collapse
+            quadrics[c.to].add(quadrics[c.from]);
+            collapsedInto[c.from] = c.to;
+            for (unsigned int k = adjacencyOffset[c.from]; k < adjacencyOffset[c.from + 1]; k++)
+            {
+                unsigned int t = adjacency[k];
+                for (int e = 0; e < 3; e++)
+                {
+                    locked[tris[t * 3 + e]] = true;
+                    if (tris[t * 3 + e] == c.from) tris[t * 3 + e] = c.to;
+                }
+                if (alive[t] && (tris[t * 3 + 0] == tris[t * 3 + 1] || tris[t * 3 + 1] == tris[t * 3 + 2] || tris[t * 3 + 2] == tris[t * 3 + 0]))
+                {
+                    alive[t] = false;
+                    aliveCount--;
+                }
+            }
+            for (unsigned int k = adjacencyOffset[c.to]; k < adjacencyOffset[c.to + 1]; k++)
+                for (int e = 0; e < 3; e++) locked[tris[adjacency[k] * 3 + e]] = true;
+
+            worstError = std::max(worstError, c.cost);
+            collapses++;
+        }
+        if (collapses == 0) break;
+    }
+
+    // 5. map the remaining triangles back to the original (attribute) vertices; a vertex that was collapsed
+    //    takes the member of its target position whose uv is closest to its own (keeps uv seams intact).
+    auto resolve = [&](unsigned int v) {
+        unsigned int c = remap[v];
+        unsigned int target = c;
+        while (collapsedInto[target] != target) target = collapsedInto[target];
+        if (target == c) return v;
+        unsigned int best = members[target][0];
+        float bestDist = FLT_MAX;
+        for (unsigned int m : members[target])
+        {
+            glm::vec2 d = uvs.empty() ? glm::vec2(0.0f) : uvs[m] - uvs[v];
+            float dist = glm::dot(d, d);
+            if (dist < bestDist) { bestDist = dist; best = m; }
+        }
+        return best;
+    };
+
+    std::vector<unsigned int> result;
+    result.reserve(aliveCount * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        if (!alive[t]) continue;
+        unsigned int i0 = resolve(indices[t * 3 + 0]), i1 = resolve(indices[t * 3 + 1]), i2 = resolve(indices[t * 3 + 2]);
+        if (i0 == i1 || i1 == i2 || i2 == i0) continue;
+        result.push_back(i0); result.push_back(i1); result.push_back(i2);
+    }
+
+    if (resultError) *resultError = (float)std::sqrt(worstError);
+    return result;
+}
+
+// utility function that builds a chain of LODs for a mesh. The indices of all coarser levels are appended
+// to the given index list, so a single index buffer holds all levels. Level 0 is the original mesh.
+// ---------------------------------------------------
+std::vector<LodLevel> buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& uvs,
+    std::vector<unsigned int>& indices, float meshRadius, unsigned int maxLevels = LOD_MAX_LEVELS)
+{
+    std::vector<LodLevel> lods;
+    lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+
+    std::vector<unsigned int> previous(indices);
+    float accumulatedError = 0.0f;
+    while (lods.size() < maxLevels && previous.size() > 3 * 32)
+    {
+        size_t target = (size_t)(previous.size() / 3 * LOD_REDUCTION) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> simplified = simplifyMesh(positions, uvs, previous, target, meshRadius * LOD_MAX_RELATIVE_ERROR, &error);
+
+        // stop if the simplifier cannot make enough progress anymore
+        if (simplified.empty() || simplified.size() > previous.size() * 0.85) break;
+
+        accumulatedError += error; // errors of consecutive steps add up (conservative)
+        lods.push_back({ (unsigned int)indices.size(), (unsigned int)simplified.size(), accumulatedError });
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+    return lods;
+}
+
+// projects an object space error at the given distance to the screen, in pixels
+// ---------------------------------------------------
+inline float projectedErrorInPixels(float error, float distance, float fovy, int viewportHeight)
+{
+    return error / std::max(distance, 0.0001f) * (float)viewportHeight / (2.0f * std::tan(fovy * 0.5f));
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+// A small implementation of the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+// used for the entries of asset packs (see util/asset_pack.h). The compressor is the simple greedy one (hash of the
+// next 4 bytes, no chains), decompression is what matters at runtime and runs at memcpy-like speed.
+// A block is a series of sequences: a token (literal length << 4 | (match length - 4)), the literals, a 2 byte
+// offset of the match (little endian) and, if a length in the token is 15, more bytes of it (255 until the last).
+// The last sequence only has literals.
+
+// largest possible size of a compressed block of size bytes
+size_t lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// compresses size bytes of src into dst and returns the compressed size (0 if dst is too small)
+size_t lz4Compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity)
+{
+    const unsigned int HASH_BITS = 14;
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5; // the last 5 bytes are always literals
+    const size_t MATCH_FIND_LIMIT = 12; // and the last match starts at least 12 bytes before the end
+    const size_t MAX_OFFSET = 65535;
+
+    std::vector<int64_t> table(size_t(1) << HASH_BITS, -1); // position of the last occurrence of a hash
+    auto read32 = [src](size_t i) { uint32_t v; std::memcpy(&v, src + i, 4); return v; };
+    auto hash = [](uint32_t v) { return (v * 2654435761u) >> (32 - HASH_BITS); };
+
+    size_t in = 0, anchor = 0, out = 0;
+    auto writeLength = [&](size_t length) {
+        // (the remainder of a length after the 15 in the token)
+        for (; length >= 255; length -= 255)
+        {
+            if (out >= capacity) return false;
+            dst[out++] = 255;
+        }
+        if (out >= capacity) return false;
+        dst[out++] = (unsigned char)length;
+        return true;
+    };
+    auto writeSequence = [&](size_t literals, size_t offset, size_t matchLength, bool last) {
+        if (out >= capacity) return false;
+        size_t matchCode = last ? 0 : matchLength - MIN_MATCH;
+        dst[out++] = (unsigned char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchCode, 15));
+        if (literals >= 15 && !writeLength(literals - 15))
+            return false;
+        if (out + literals > capacity) return false;
+        std::memcpy(dst + out, src + anchor, literals);
+        out += literals;
+        if (last)
+            return true;
+        if (out + 2 > capacity) return false;
+        dst[out++] = (unsigned char)(offset & 0xff);
+        dst[out++] = (unsigned char)(offset >> 8);
+        return matchCode < 15 || writeLength(matchCode - 15);
+    };
+
+    if (size >= MATCH_FIND_LIMIT + 1)
+    {
+        size_t matchLimit = size - LAST_LITERALS;
+        while (in + MATCH_FIND_LIMIT <= size)
+        {
+            uint32_t sequence = read32(in);
+            int64_t& slot = table[hash(sequence)];
+            int64_t candidate = slot;
+            slot = (int64_t)in;
+            if (candidate < 0 || in - (size_t)candidate > MAX_OFFSET || read32((size_t)candidate) != sequence)
+            {
+                in++;
+                continue;
+            }
+            size_t length = MIN_MATCH;
+            while (in + length < matchLimit && src[candidate + length] == src[in + length])
+                length++;
+            if (!writeSequence(in - anchor, in - (size_t)candidate, length, false))
+                return 0;
+            in += length;
+            anchor = in;
+        }
+    }
+    if (!writeSequence(size - anchor, 0, 0, true))
+        return 0;
+    return out;
+}
+
+// decompresses a block into exactly size bytes of dst. Returns false if the block is corrupt (never reads or writes
+// out of bounds).
+bool lz4Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t size)
+{
+    size_t in = 0, out = 0;
+    auto readLength = [&](size_t& length) {
+        unsigned char b;
+        do
+        {
+            if (in >= srcSize) return false;
+            b = src[in++];
+            length += b;
+        } while (b == 255);
+        return true;
+    };
+
+    while (in < srcSize)
+    {
+        unsigned int token = src[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > srcSize - in || literals > size - out)
+            return false;
+        std::memcpy(dst + out, src + in, literals);
+        in += literals;
+        out += literals;
+        if (in == srcSize)
+            break; // the last sequence
+
+        if (srcSize - in < 2)
+            return false;
+        size_t offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length))
+            return false;
+        length += 4;
+        if (length > size - out)
+            return false;
+        // (the match may overlap the bytes it produces, so it is copied byte by byte unless it is far enough back)
+        const unsigned char* match = dst + out - offset;
+        if (offset >= length)
+            std::memcpy(dst + out, match, length);
+        else
+            for (size_t i = 0; i < length; i++)
+                dst[out + i] = match[i];
+        out += length;
+    }
+    return out == size;
+}
+
+#endif
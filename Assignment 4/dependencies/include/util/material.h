@@ -0,0 +1,290 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+#include <util/image.h>
+#include <util/hash.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// reference to a texture in the material table: (pool << 16) | layer
+const GLuint NO_TEXTURE = 0xFFFFFFFF;
+const unsigned int NO_MATERIAL = 0xFFFFFFFF;
+
+// material parameters as stored in the shader storage buffer at MATERIAL_BINDING (std430 layout):
+//   struct MaterialData { uint diffuse; uint specular; uint normal; uint height; vec4 baseColor; };
+//   layout (std430, binding = 1) readonly buffer MaterialBuffer { MaterialData materials[]; };
+// Missing textures (NO_TEXTURE) fall back to the base color (diffuse), no specular and a flat normal.
+struct Material {
+    GLuint diffuse = NO_TEXTURE;
+    GLuint specular = NO_TEXTURE;
+    GLuint normal = NO_TEXTURE;
+    GLuint height = NO_TEXTURE;
+    glm::vec4 baseColor = glm::vec4(1.0f);
+};
+const GLuint MATERIAL_BINDING = 1;
+
+// The texture pools are bound to the texture units MATERIAL_TEXTURE_UNIT ... MATERIAL_TEXTURE_UNIT + MATERIAL_MAX_POOLS - 1:
+//   layout (binding = 8) uniform sampler2DArray materialTextures[8];
+const unsigned int MATERIAL_TEXTURE_UNIT = 8;
+const unsigned int MATERIAL_MAX_POOLS = 8;
+
+// Holds all materials of the scene. Textures of the same size are packed into the layers of one GL_TEXTURE_2D_ARRAY
+// (RGBA8, mipmapped) and the material parameters live in one shader storage buffer, so a draw only needs its
+// material index (see DrawData in util/draw_list.h) and all draws can share the same bindings.
+class MaterialTable {
+public:
+    // loads the image at path into the matching texture pool (only once per path) and returns its reference.
+    // Flipping follows the current stbi_set_flip_vertically_on_load setting.
+    GLuint LoadTexture(const std::string& path)
+    {
+        auto it = loadedTextures.find(hashName(path));
+        if (it != loadedTextures.end())
+            return it->second;
+
+        GLuint reference = NO_TEXTURE;
+        int width, height, nrComponents;
+        unsigned char* data;
+        {
+            std::lock_guard<std::mutex> lock(stbiMutex()); // (workers may be decoding with another flip setting)
+            data = loadImageFile(path, &width, &height, &nrComponents, 4);
+        }
+        if (data)
+        {
+            reference = AddTexture(data, width, height);
+            stbi_image_free(data);
+        }
+        else
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        loadedTextures[hashName(path)] = reference;
+        return reference;
+    }
+
+    // like LoadTexture(path), but with an image that was decoded before (RGBA, e.g., on a worker thread, see decodeImage)
+    GLuint LoadTexture(const std::string& path, const ImageData& image)
+    {
+        auto it = loadedTextures.find(hashName(path));
+        if (it != loadedTextures.end())
+            return it->second;
+
+        GLuint reference = NO_TEXTURE;
+        if (image && image.components == 4)
+            reference = AddTexture(image.pixels.get(), image.width, image.height);
+        else
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        loadedTextures[hashName(path)] = reference;
+        return reference;
+    }
+
+    // like LoadTexture(path), but with a texture that was uploaded before (e.g., by the upload thread, see
+    // util/upload_thread.h); the caller keeps ownership of texture
+    GLuint LoadTexture(const std::string& path, GLuint texture, int width, int height)
+    {
+        auto it = loadedTextures.find(hashName(path));
+        if (it != loadedTextures.end())
+            return it->second;
+
+        GLuint reference = texture ? AddTexture(texture, width, height) : NO_TEXTURE;
+        if (reference == NO_TEXTURE)
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        loadedTextures[hashName(path)] = reference;
+        return reference;
+    }
+
+    // adds an RGBA8 image to the matching texture pool and returns its reference
+    GLuint AddTexture(const unsigned char* rgba, int width, int height)
+    {
+        int p = reserveLayer(width, height);
+        if (p < 0)
+            return NO_TEXTURE;
+        TexturePool& pool = pools[p];
+        std::vector<unsigned char> resampled;
+        if (pool.width != width || pool.height != height)
+        {
+            resampled = resampleImage(rgba, width, height, 4, pool.width, pool.height);
+            rgba = resampled.data();
+        }
+        glState().BindTexture(GL_TEXTURE_2D_ARRAY, pool.id);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, pool.layers, pool.width, pool.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        pool.dirty = true;
+        return ((GLuint)p << 16) | (GLuint)pool.layers++;
+    }
+
+    // adds a GL_TEXTURE_2D (RGBA8 with the full mip chain) to the matching texture pool by copying it on the GPU and
+    // returns its reference. The pool's mipmaps stay valid (no glGenerateMipmap on the next Bind), unless the texture
+    // has to be resampled to the size of another pool (see reserveLayer), which reads it back once.
+    GLuint AddTexture(GLuint texture, int width, int height)
+    {
+        int p = reserveLayer(width, height);
+        if (p < 0)
+            return NO_TEXTURE;
+        TexturePool& pool = pools[p];
+        if (pool.width != width || pool.height != height)
+        {
+            std::vector<unsigned char> rgba((size_t)width * height * 4);
+            glState().BindTexture(GL_TEXTURE_2D, texture);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+            return AddTexture(rgba.data(), width, height);
+        }
+        int levels = numMipLevels(width, height);
+        for (int level = 0; level < levels; level++)
+            glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, pool.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, pool.layers,
+                               std::max(1, width >> level), std::max(1, height >> level), 1);
+        return ((GLuint)p << 16) | (GLuint)pool.layers++;
+    }
+
+    // adds a material and returns its index
+    unsigned int Create(const Material& material)
+    {
+        materials.push_back(material);
+        materialsDirty = true;
+        return (unsigned int)materials.size() - 1;
+    }
+
+    const Material& Get(unsigned int index) const { return materials[index]; }
+
+    // uploads pending changes and binds the texture pools and the material buffer
+    void Bind()
+    {
+        if (materialsDirty && !materials.empty())
+        {
+            if (!materialBuffer)
+                materialBuffer = createBuffer();
+            glState().BindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(Material), materials.data(), GL_STATIC_DRAW);
+            materialsDirty = false;
+        }
+        for (unsigned int p = 0; p < pools.size(); p++)
+        {
+            if (pools[p].dirty)
+            {
+                glState().ActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT + p);
+                glState().BindTexture(GL_TEXTURE_2D_ARRAY, pools[p].id);
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                pools[p].dirty = false;
+            }
+            else
+                glState().BindTextureUnit(MATERIAL_TEXTURE_UNIT + p, GL_TEXTURE_2D_ARRAY, pools[p].id);
+        }
+        // (the demos bind their own textures to the active unit)
+        glState().ActiveTexture(GL_TEXTURE0);
+        if (materialBuffer)
+            glState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, materialBuffer);
+    }
+
+    // number of mip levels of a full chain down to 1x1
+    static int numMipLevels(int width, int height)
+    {
+        int levels = 1;
+        while ((width | height) >> levels) levels++;
+        return levels;
+    }
+
+    // GPU memory of a texture (the layer with all its mip levels), 0 for NO_TEXTURE
+    size_t TextureBytes(GLuint reference) const
+    {
+        if (reference == NO_TEXTURE || (reference >> 16) >= pools.size())
+            return 0;
+        const TexturePool& pool = pools[reference >> 16];
+        size_t bytes = 0;
+        for (int level = 0; level < numMipLevels(pool.width, pool.height); level++)
+            bytes += (size_t)std::max(1, pool.width >> level) * std::max(1, pool.height >> level) * 4;
+        return bytes;
+    }
+
+    unsigned int NumMaterials() const { return (unsigned int)materials.size(); }
+    unsigned int NumPools() const { return (unsigned int)pools.size(); }
+    unsigned int NumTextures() const
+    {
+        unsigned int n = 0;
+        for (const TexturePool& pool : pools) n += pool.layers;
+        return n;
+    }
+
+private:
+    struct TexturePool {
+        GLTexture id;
+        int width = 0, height = 0;
+        int layers = 0;     // used layers
+        int capacity = 0;   // allocated layers
+        bool dirty = false; // mipmaps need to be regenerated
+    };
+    std::vector<TexturePool> pools;
+    std::vector<Material> materials;
+    std::unordered_map<uint64_t, GLuint> loadedTextures; // hashName(path) -> reference (no copies of the paths)
+    GLBuffer materialBuffer;
+    bool materialsDirty = true;
+
+    // returns the pool of textures of the given size (created if needed) with room for one more layer. Once all
+    // MATERIAL_MAX_POOLS pools are taken, a texture of a new size goes to the pool of the nearest size (in octaves of
+    // width and height) and has to be resampled to the size of that pool.
+    int reserveLayer(int width, int height)
+    {
+        unsigned int p = 0;
+        while (p < pools.size() && (pools[p].width != width || pools[p].height != height))
+            p++;
+        if (p == pools.size() && pools.size() == MATERIAL_MAX_POOLS)
+        {
+            auto distance = [&](const TexturePool& pool) {
+                return std::abs(std::log2((float)pool.width / width)) + std::abs(std::log2((float)pool.height / height));
+            };
+            p = 0;
+            for (unsigned int i = 1; i < pools.size(); i++)
+                if (distance(pools[i]) < distance(pools[p]))
+                    p = i;
+            std::cout << "MaterialTable: no free texture pool for a " << width << "x" << height << " texture, resampled to "
+                      << pools[p].width << "x" << pools[p].height << std::endl;
+        }
+        else if (p == pools.size())
+        {
+            pools.emplace_back();
+            pools.back().width = width;
+            pools.back().height = height;
+        }
+
+        TexturePool& pool = pools[p];
+        if (pool.layers == pool.capacity)
+            growPool(pool, std::max(4, pool.capacity * 2));
+        return (int)p;
+    }
+
+    // reallocates the array with more layers and copies the used layers (all mip levels) over
+    void growPool(TexturePool& pool, int capacity)
+    {
+        int levels = numMipLevels(pool.width, pool.height);
+        GLTexture id = createTexture(GL_TEXTURE_2D_ARRAY);
+        glState().BindTexture(GL_TEXTURE_2D_ARRAY, id);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, pool.width, pool.height, capacity);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (pool.id)
+        {
+            for (int level = 0; level < levels && pool.layers > 0; level++)
+                glCopyImageSubData(pool.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                                   std::max(1, pool.width >> level), std::max(1, pool.height >> level), pool.layers);
+        }
+        pool.id = std::move(id); // (deletes the old array)
+        pool.capacity = capacity;
+    }
+};
+
+// the (global) material table, created on first use (needs a current OpenGL context)
+MaterialTable& materialTable()
+{
+    static MaterialTable table;
+    return table;
+}
+
+#endif
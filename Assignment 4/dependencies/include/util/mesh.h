@@ -7,6 +7,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <util/shader.h>
+#include <util/lod.h>
+#include <util/meshlet.h>
+#include <util/arena.h>
+#include <util/material.h>
 
 #include <string>
 #include <vector>
@@ -25,110 +29,311 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// If false, a mesh frees its CPU copy of the vertices and indices once they are in the geometry arena. Only what drawing
+// and culling need stays (bounds, levels of detail, meshlets). Set it before loading the models.
+bool keepMeshGeometry = true;
+
+// resident memory of a mesh or a model (see Mesh::Memory and Model::Memory)
+struct MemoryUsage {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+
+    MemoryUsage& operator+=(const MemoryUsage& other)
+    {
+        cpuBytes += other.cpuBytes;
+        gpuBytes += other.gpuBytes;
+        return *this;
+    }
+};
+
+// vertex format of all meshes in the geometry arena (registered on first use)
+unsigned int meshVertexFormat()
+{
+    static unsigned int format = geometryArena().RegisterFormat({ {
+            { 0, 3, GL_FLOAT, (GLuint)offsetof(Vertex, Position) },
+            { 1, 3, GL_FLOAT, (GLuint)offsetof(Vertex, Normal) },
+            { 2, 2, GL_FLOAT, (GLuint)offsetof(Vertex, TexCoords) },
+            { 3, 3, GL_FLOAT, (GLuint)offsetof(Vertex, Tangent) },
+            { 4, 3, GL_FLOAT, (GLuint)offsetof(Vertex, Bitangent) } },
+        sizeof(Vertex) });
+    return format;
+}
+
+// The CPU side of a mesh: bounds, levels of detail and clusters are computed here, without any OpenGL calls, so mesh
+// data can be prepared on any thread. A Mesh is created from it on the thread of the OpenGL context.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    unsigned int         material = NO_MATERIAL;
+    vector<LodLevel>     lods;
+    vector<Meshlet>      meshlets;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    MeshData() = default;
+    MeshData(vector<Vertex> vertices, vector<unsigned int> indices, unsigned int material = NO_MATERIAL, bool generateLods = false, bool generateMeshlets = false)
+    {
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->material = material;
+
+        computeBounds();
+        if (generateLods)
+            buildLods();
+        else
+            lods.push_back({ 0, (unsigned int)this->indices.size(), 0.0f });
+        if (generateMeshlets)
+            buildClusters();
+    }
+
+    // size of the geometry in the geometry arena
+    size_t Bytes() const { return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int); }
+
+private:
+    // computes a bounding sphere around the vertices (center of the bounding box)
+    void computeBounds()
+    {
+        glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+        for (const Vertex& v : vertices)
+        {
+            minP = glm::min(minP, v.Position);
+            maxP = glm::max(maxP, v.Position);
+        }
+        boundsCenter = vertices.empty() ? glm::vec3(0.0f) : (minP + maxP) * 0.5f;
+        boundsRadius = 0.0f;
+        for (const Vertex& v : vertices)
+            boundsRadius = std::max(boundsRadius, glm::length(v.Position - boundsCenter));
+    }
+
+    // simplifies the mesh into a chain of coarser levels of detail (appended to the index list)
+    void buildLods()
+    {
+        vector<glm::vec3> positions(vertices.size());
+        vector<glm::vec2> uvs(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].Position;
+            uvs[i] = vertices[i].TexCoords;
+        }
+        lods = buildLodChain(positions, uvs, indices, boundsRadius);
+    }
+
+    // splits the full detail level into clusters (reorders its triangles)
+    void buildClusters()
+    {
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        meshlets = buildMeshlets(positions, indices, lods[0].indexOffset, lods[0].indexCount);
+    }
 };
 
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
+    vector<Vertex>       vertices; // (empty after the upload unless keepMeshGeometry is set)
     vector<unsigned int> indices;
-    vector<Texture>      textures;
-    unsigned int VAO;
+    unsigned int         material; // index into the material table (or NO_MATERIAL)
+    vector<LodLevel>     lods; // level 0 is the full mesh; the indices of all levels are stored one after another in 'indices'
+    vector<Meshlet>      meshlets; // clusters of level 0 (empty if not generated)
+    glm::vec3 boundsCenter;    // bounding sphere (object space)
+    float boundsRadius;
+    unsigned int VAO;          // VAO of the geometry arena
+    GLint baseVertex;          // location of the mesh's vertices and indices in the geometry arena
+    GLuint firstIndex;
+
+    // constructor (pass the vertices and indices with std::move to avoid copying them)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, unsigned int material = NO_MATERIAL, bool generateLods = false, bool generateMeshlets = false)
+        : Mesh(MeshData(std::move(vertices), std::move(indices), material, generateLods, generateMeshlets))
+    {
+    }
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // uploads mesh data that was prepared before (e.g., on a worker thread, see MeshData)
+    explicit Mesh(MeshData&& data)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        vertices = std::move(data.vertices);
+        indices = std::move(data.indices);
+        material = data.material;
+        lods = std::move(data.lods);
+        meshlets = std::move(data.meshlets);
+        boundsCenter = data.boundsCenter;
+        boundsRadius = data.boundsRadius;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
-    // render the mesh
-    void Draw(Shader shader) 
+    // like above, but the vertices and indices were already uploaded into a staging buffer (e.g., by the upload thread,
+    // see util/upload_thread.h) at the given byte offsets; they are copied into the geometry arena on the GPU
+    Mesh(MeshData&& data, GLuint stagingBuffer, GLintptr vertexOffset, GLintptr indexOffset)
+    {
+        vertices = std::move(data.vertices);
+        indices = std::move(data.indices);
+        material = data.material;
+        lods = std::move(data.lods);
+        meshlets = std::move(data.meshlets);
+        boundsCenter = data.boundsCenter;
+        boundsRadius = data.boundsRadius;
+
+        setupMesh(stagingBuffer, vertexOffset, indexOffset);
+    }
+
+    // meshes are move-only: they own their ranges in the geometry arena
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept { moveFrom(other); }
+    Mesh& operator=(Mesh&& other) noexcept
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        if (this != &other)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            Release();
+            moveFrom(other);
         }
-        
+        return *this;
+    }
+    ~Mesh() { Release(); }
+
+    // returns the vertices and indices to the geometry arena (the mesh can't be drawn afterwards)
+    void Release()
+    {
+        if (numVertices > 0)
+            geometryArena().FreeVertices(meshVertexFormat(), baseVertex, numVertices);
+        if (numIndices > 0)
+            geometryArena().FreeIndices(firstIndex, numIndices);
+        numVertices = numIndices = 0;
+        lods.clear();
+        meshlets.clear();
+    }
+
+    // render the mesh (optionally at a coarser level of detail). Materials are only available through a DrawList.
+    void Draw(unsigned int lod = 0)
+    {
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        const LodLevel& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        glState().BindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)((firstIndex + level.indexOffset) * sizeof(unsigned int)), baseVertex);
+    }
+
+    // render instances instances of the mesh (the per draw index of the arena VAO counts from baseInstance)
+    void DrawInstanced(GLsizei instances, GLuint baseInstance = 0, unsigned int lod = 0)
+    {
+        const LodLevel& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        geometryArena().EnsureDrawIds(baseInstance + instances);
+        glState().BindVertexArray(VAO);
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                                      (void*)((firstIndex + level.indexOffset) * sizeof(unsigned int)),
+                                                      instances, baseVertex, baseInstance);
+    }
+
+    // render the full detail mesh, but only the clusters that survive culling (the culler has to be set up for the instance)
+    void Draw(const ClusterCuller& culler, ClusterCullStats& stats)
+    {
+        if (meshlets.empty())
+        {
+            unsigned int n = NumTriangles();
+            stats.trianglesTotal += n;
+            stats.trianglesInView += n;
+            stats.trianglesSubmitted += n;
+            Draw();
+            return;
+        }
+
+        // reject the whole mesh first
+        if (!culler.insideFrustum(boundsCenter, boundsRadius))
+        {
+            stats.clustersTotal += (unsigned int)meshlets.size();
+            stats.trianglesTotal += NumTriangles();
+            return;
+        }
+
+        vector<IndexRange> ranges;
+        culler.cull(meshlets, ranges, stats);
+        if (ranges.empty())
+            return;
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        vector<GLsizei> counts(ranges.size());
+        vector<const void*> offsets(ranges.size());
+        vector<GLint> baseVertices(ranges.size(), baseVertex);
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            counts[i] = ranges[i].count;
+            offsets[i] = (const void*)((firstIndex + ranges[i].first) * sizeof(unsigned int));
+        }
+
+        glState().BindVertexArray(VAO);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+    }
+
+    // number of triangles drawn at the given level of detail
+    unsigned int NumTriangles(unsigned int lod = 0) const
+    {
+        return lods[std::min<size_t>(lod, lods.size() - 1)].indexCount / 3;
+    }
+
+    // CPU memory held by the mesh (with the CPU copy of the geometry, if it is kept) and its geometry in the arena
+    MemoryUsage Memory() const
+    {
+        MemoryUsage usage;
+        usage.cpuBytes = sizeof(Mesh) + vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) +
+                         lods.capacity() * sizeof(LodLevel) + meshlets.capacity() * sizeof(Meshlet);
+        usage.gpuBytes = numVertices * sizeof(Vertex) + numIndices * sizeof(unsigned int);
+        return usage;
+    }
+
+    // frees the CPU copy of the vertices and indices (they stay in the geometry arena)
+    void ReleaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+        lods.shrink_to_fit();
+        meshlets.shrink_to_fit();
     }
 
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    size_t numVertices = 0, numIndices = 0; // allocated in the geometry arena
 
-    // initializes all the buffer objects/arrays
+    // copies the vertices and indices into the geometry arena
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        GeometryArena& arena = geometryArena();
+        unsigned int format = meshVertexFormat();
+        VAO = arena.VertexArray(format);
+        baseVertex = arena.AllocateVertices(format, vertices.data(), vertices.size());
+        firstIndex = arena.AllocateIndices(indices.data(), indices.size());
+        numVertices = vertices.size();
+        numIndices = indices.size();
+        if (!keepMeshGeometry)
+            ReleaseGeometry();
+    }
+
+    void setupMesh(GLuint stagingBuffer, GLintptr vertexOffset, GLintptr indexOffset)
+    {
+        GeometryArena& arena = geometryArena();
+        unsigned int format = meshVertexFormat();
+        VAO = arena.VertexArray(format);
+        baseVertex = arena.AllocateVertices(format, stagingBuffer, vertexOffset, vertices.size());
+        firstIndex = arena.AllocateIndices(stagingBuffer, indexOffset, indices.size());
+        numVertices = vertices.size();
+        numIndices = indices.size();
+        if (!keepMeshGeometry)
+            ReleaseGeometry();
+    }
+
+    void moveFrom(Mesh& other)
+    {
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        material = other.material;
+        lods = std::move(other.lods);
+        meshlets = std::move(other.meshlets);
+        boundsCenter = other.boundsCenter;
+        boundsRadius = other.boundsRadius;
+        VAO = other.VAO;
+        baseVertex = other.baseVertex;
+        firstIndex = other.firstIndex;
+        numVertices = other.numVertices;
+        numIndices = other.numIndices;
+        other.numVertices = other.numIndices = 0; // the ranges belong to this mesh now
     }
 };
 #endif
@@ -0,0 +1,255 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+// A cluster of (at most MESHLET_MAX_TRIANGLES) neighbouring triangles of a mesh: a contiguous range in
+// the index buffer of the mesh together with a bounding sphere and a normal cone, both in object space.
+struct Meshlet {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    glm::vec3 center;   // bounding sphere
+    float radius;
+    glm::vec3 coneAxis; // average facing direction of the triangles
+    float coneCutoff;   // sine of the cone's half angle; > 1 if the cluster can't be backface culled
+};
+
+// a range of indices (e.g., the merged ranges of neighbouring clusters)
+struct IndexRange {
+    unsigned int first;
+    unsigned int count;
+};
+
+// default settings used when building clusters
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+const unsigned int MESHLET_FRONTIER_SCAN = 64; // number of candidate triangles considered when growing a cluster
+
+// splits the triangles in indices[indexOffset, indexOffset + indexCount) into clusters of neighbouring triangles.
+// The index range is reordered in place so that the triangles of each cluster are stored one after another.
+std::vector<Meshlet> buildMeshlets(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices,
+                                   unsigned int indexOffset, unsigned int indexCount, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+    std::vector<Meshlet> meshlets;
+    const unsigned int triangleCount = indexCount / 3;
+    const unsigned int* tri = &indices[indexOffset];
+    if (triangleCount == 0)
+        return meshlets;
+
+    // per triangle normal and centroid
+    std::vector<glm::vec3> normals(triangleCount), centroids(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = positions[tri[t * 3 + 0]];
+        const glm::vec3& p1 = positions[tri[t * 3 + 1]];
+        const glm::vec3& p2 = positions[tri[t * 3 + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        centroids[t] = (p0 + p1 + p2) / 3.0f;
+    }
+
+    // vertex -> triangles adjacency (compressed: offsets into one list)
+    std::vector<unsigned int> adjacencyOffsets(positions.size() + 1, 0);
+    for (unsigned int i = 0; i < triangleCount * 3; i++)
+        adjacencyOffsets[tri[i] + 1]++;
+    for (size_t v = 0; v < positions.size(); v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (unsigned int i = 0; i < triangleCount * 3; i++)
+            adjacency[fill[tri[i]]++] = i / 3;
+    }
+
+    // grow the clusters greedily: start at the first unassigned triangle and keep adding the neighbouring
+    // triangle that is closest to the cluster and faces the same direction the most.
+    std::vector<bool> assigned(triangleCount, false);
+    std::vector<unsigned int> order;
+    order.reserve(triangleCount);
+    std::vector<unsigned int> frontier;
+    unsigned int seed = 0;
+    while (order.size() < triangleCount)
+    {
+        while (assigned[seed]) seed++;
+
+        Meshlet meshlet;
+        meshlet.indexOffset = indexOffset + (unsigned int)order.size() * 3;
+        unsigned int first = (unsigned int)order.size();
+        glm::vec3 normalSum(0.0f), centroidSum(0.0f);
+
+        frontier.clear();
+        frontier.push_back(seed);
+        while (!frontier.empty() && order.size() - first < maxTriangles)
+        {
+            // pick the best candidate among the (most recently added part of the) frontier
+            glm::vec3 clusterCenter = first == order.size() ? centroids[frontier[0]] : centroidSum / float(order.size() - first);
+            glm::vec3 clusterNormal = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            size_t best = frontier.size() - 1;
+            float bestScore = FLT_MAX;
+            size_t scanEnd = frontier.size() > MESHLET_FRONTIER_SCAN ? frontier.size() - MESHLET_FRONTIER_SCAN : 0;
+            for (size_t i = frontier.size(); i-- > scanEnd; )
+            {
+                unsigned int t = frontier[i];
+                float score = glm::length(centroids[t] - clusterCenter) * (2.0f - glm::dot(normals[t], clusterNormal));
+                if (score < bestScore)
+                {
+                    bestScore = score;
+                    best = i;
+                }
+            }
+            unsigned int t = frontier[best];
+            frontier[best] = frontier.back();
+            frontier.pop_back();
+            if (assigned[t])
+                continue;
+
+            assigned[t] = true;
+            order.push_back(t);
+            normalSum += normals[t];
+            centroidSum += centroids[t];
+
+            // add the unassigned neighbours (sharing a vertex) to the frontier
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = tri[t * 3 + k];
+                for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+                    if (!assigned[adjacency[a]])
+                        frontier.push_back(adjacency[a]);
+            }
+        }
+        meshlet.indexCount = ((unsigned int)order.size() - first) * 3;
+
+        // bounding sphere (center of the bounding box)
+        glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+        for (unsigned int i = first; i < order.size(); i++)
+            for (int k = 0; k < 3; k++)
+            {
+                minP = glm::min(minP, positions[tri[order[i] * 3 + k]]);
+                maxP = glm::max(maxP, positions[tri[order[i] * 3 + k]]);
+            }
+        meshlet.center = (minP + maxP) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (unsigned int i = first; i < order.size(); i++)
+            for (int k = 0; k < 3; k++)
+                meshlet.radius = std::max(meshlet.radius, glm::length(positions[tri[order[i] * 3 + k]] - meshlet.center));
+
+        // normal cone: the average normal and the widest angle between it and any triangle normal
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 2.0f;
+        if (glm::length(normalSum) > 1e-3f)
+        {
+            glm::vec3 axis = glm::normalize(normalSum);
+            float minDot = 1.0f;
+            for (unsigned int i = first; i < order.size(); i++)
+                minDot = std::min(minDot, glm::dot(normals[order[i]], axis));
+            meshlet.coneAxis = axis;
+            // all normals are within the half angle a of the axis; the cluster is back facing if the view direction is
+            // within 90 - a degrees of the axis, i.e. dot(view, axis) >= cos(90 - a) = sin(a). Cones wider than 90 degrees can't be culled.
+            if (minDot > 0.0f)
+                meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+        meshlets.push_back(meshlet);
+    }
+
+    // finally store the triangles in cluster order
+    std::vector<unsigned int> reordered(triangleCount * 3);
+    for (unsigned int i = 0; i < triangleCount; i++)
+        for (int k = 0; k < 3; k++)
+            reordered[i * 3 + k] = tri[order[i] * 3 + k];
+    std::copy(reordered.begin(), reordered.end(), indices.begin() + indexOffset);
+
+    return meshlets;
+}
+
+// counters of the cluster culling, accumulated over all draws of a frame
+struct ClusterCullStats {
+    unsigned int clustersTotal = 0;
+    unsigned int clustersSubmitted = 0;
+    unsigned int trianglesTotal = 0;
+    unsigned int trianglesInView = 0;   // triangles of the clusters inside the view frustum
+    unsigned int trianglesSubmitted = 0; // triangles of the clusters that are also not back facing
+};
+
+// culls clusters against the view frustum and their normal cone. Set it up once per drawn instance: all tests
+// are done in object space, which avoids transforming the bounding data of every cluster.
+// Note: the cone test assumes the model matrix has no non-uniform scale.
+class ClusterCuller {
+public:
+    bool frustumCulling = true;
+    bool coneCulling = true;
+    // world space distance the camera may still move after culling (e.g., when it is late latched): the bounding
+    // spheres are grown by it in both tests, so nothing that becomes visible within it is culled
+    float margin = 0.0f;
+
+    // viewProjection * model maps object space to clip space; viewPos is the camera position in world space
+    void setup(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& viewPos)
+    {
+        objectMargin = margin / glm::length(glm::vec3(model[0])); // (in object space, the scale is uniform)
+        // extract the frustum planes from the (object space to clip space) matrix (Gribb & Hartmann)
+        glm::mat4 m = glm::transpose(viewProjection * model);
+        planes[0] = m[3] + m[0]; // left
+        planes[1] = m[3] - m[0]; // right
+        planes[2] = m[3] + m[1]; // bottom
+        planes[3] = m[3] - m[1]; // top
+        planes[4] = m[3] + m[2]; // near
+        planes[5] = m[3] - m[2]; // far
+        for (glm::vec4& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        cameraPos = glm::vec3(glm::inverse(model) * glm::vec4(viewPos, 1.0f));
+    }
+
+    bool insideFrustum(const glm::vec3& center, float radius) const
+    {
+        if (!frustumCulling)
+            return true;
+        for (const glm::vec4& plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius - objectMargin)
+                return false;
+        return true;
+    }
+
+    // conservative test whether every triangle of the cluster faces away from the camera
+    bool backFacing(const Meshlet& meshlet) const
+    {
+        if (!coneCulling || meshlet.coneCutoff > 1.0f)
+            return false;
+        glm::vec3 toCluster = meshlet.center - cameraPos;
+        return glm::dot(toCluster, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCluster) + meshlet.radius + objectMargin;
+    }
+
+    // appends the index ranges of the surviving clusters to ranges (neighbouring ranges are merged)
+    void cull(const std::vector<Meshlet>& meshlets, std::vector<IndexRange>& ranges, ClusterCullStats& stats) const
+    {
+        unsigned int end = ~0u; // end of the last emitted range
+        for (const Meshlet& meshlet : meshlets)
+        {
+            stats.clustersTotal++;
+            stats.trianglesTotal += meshlet.indexCount / 3;
+            if (!insideFrustum(meshlet.center, meshlet.radius))
+                continue;
+            stats.trianglesInView += meshlet.indexCount / 3;
+            if (backFacing(meshlet))
+                continue;
+            stats.clustersSubmitted++;
+            stats.trianglesSubmitted += meshlet.indexCount / 3;
+
+            if (meshlet.indexOffset == end)
+                ranges.back().count += meshlet.indexCount;
+            else
+                ranges.push_back({ meshlet.indexOffset, meshlet.indexCount });
+            end = meshlet.indexOffset + meshlet.indexCount;
+        }
+    }
+
+private:
+    glm::vec4 planes[6];
+    glm::vec3 cameraPos;
+    float objectMargin = 0.0f;
+};
+#endif
@@ -12,62 +12,395 @@
 
 #include <util/mesh.h>
 #include <util/shader.h>
+#include <util/image.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <set>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+struct ModelData;
+bool loadObj(const string& path, ModelData& data, bool loadTextures = false, bool lods = false, bool meshlets = false); // see util/obj_loader.h
+
+// the material of a model file: its texture paths and, optionally, the decoded textures (see ModelData::DecodeTextures)
+struct MaterialData {
+    enum { DIFFUSE, SPECULAR, NORMAL, HEIGHT, NUM_TEXTURES };
+    string textures[NUM_TEXTURES]; // empty if the material has no texture of the type
+    ImageData images[NUM_TEXTURES];
+    GLuint uploaded[NUM_TEXTURES] = {}; // textures uploaded by the upload thread (RGBA8 with all mip levels, the size of images)
+    glm::vec4 baseColor = glm::vec4(1.0f);
+};
+
+// The CPU side of a model file (see Model::Load): the meshes (see MeshData) and the materials they use. The material of a
+// mesh data is an index into materials. Nothing in here needs OpenGL, so it can be loaded on a worker thread.
+struct ModelData {
+    vector<MeshData> meshes;
+    vector<MaterialData> materials;
+    string directory;
+
+    // decodes the textures of the materials (RGBA), so creating the materials doesn't read files anymore
+    void DecodeTextures(bool flip = false)
+    {
+        for (MaterialData& material : materials)
+            for (int t = 0; t < MaterialData::NUM_TEXTURES; t++)
+                if (!material.textures[t].empty())
+                    material.images[t] = decodeImage(material.textures[t], flip, 4);
+    }
+
+    // size of the geometry and decoded textures
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const MeshData& mesh : meshes) bytes += mesh.Bytes();
+        for (const MaterialData& material : materials)
+            for (const ImageData& image : material.images) bytes += image.Bytes();
+        return bytes;
+    }
+};
+
+// Converted models, as stored in asset packs (see util/asset_pack.h): the meshes in the layout of MeshData (vertices,
+// indices, levels of detail, meshlets) and the texture paths of the materials, so loading a packed model is a few copies
+// instead of an import. The flags tell what the blob was built with; the levels of detail and meshlets are rebuilt from
+// the full detail indices if they don't match the request.
+const uint32_t MODEL_BLOB_MAGIC = 0x314c444d; // "MDL1"
+enum ModelBlobFlags : uint32_t {
+    MODEL_BLOB_TEXTURES = 1,
+    MODEL_BLOB_LODS = 2,
+    MODEL_BLOB_MESHLETS = 4
+};
+
+void writeModelData(const ModelData& data, uint32_t flags, BlobWriter& out)
+{
+    out.Write(MODEL_BLOB_MAGIC);
+    out.Write(flags);
+    out.WriteString(data.directory);
+    out.Write((uint32_t)data.materials.size());
+    for (const MaterialData& material : data.materials)
+    {
+        out.Write(material.baseColor);
+        for (const string& texture : material.textures)
+            out.WriteString(texture);
+    }
+    out.Write((uint32_t)data.meshes.size());
+    for (const MeshData& mesh : data.meshes)
+    {
+        out.Write(mesh.material);
+        out.Write(mesh.boundsCenter);
+        out.Write(mesh.boundsRadius);
+        out.WriteArray(mesh.vertices);
+        out.WriteArray(mesh.indices);
+        out.WriteArray(mesh.lods);
+        out.WriteArray(mesh.meshlets);
+    }
+}
+
+// reads a blob written by writeModelData. Fails if it is corrupt or the materials are requested but weren't packed.
+bool readModelData(const unsigned char* bytes, size_t size, bool loadTextures, bool lods, bool meshlets, ModelData& data)
+{
+    BlobReader in(bytes, size);
+    uint32_t magic, flags, count;
+    if (!in.Read(magic) || magic != MODEL_BLOB_MAGIC || !in.Read(flags) || !in.ReadString(data.directory))
+        return false;
+    if (loadTextures && !(flags & MODEL_BLOB_TEXTURES))
+        return false;
+    if (!in.Read(count))
+        return false;
+    data.materials.resize(count);
+    for (MaterialData& material : data.materials)
+    {
+        if (!in.Read(material.baseColor))
+            return false;
+        for (string& texture : material.textures)
+            if (!in.ReadString(texture))
+                return false;
+    }
+    if (!loadTextures)
+        data.materials.clear();
+
+    if (!in.Read(count))
+        return false;
+    bool rebuild = lods != ((flags & MODEL_BLOB_LODS) != 0) || meshlets != ((flags & MODEL_BLOB_MESHLETS) != 0);
+    data.meshes.resize(count);
+    for (MeshData& mesh : data.meshes)
+    {
+        if (!in.Read(mesh.material) || !in.Read(mesh.boundsCenter) || !in.Read(mesh.boundsRadius) ||
+            !in.ReadArray(mesh.vertices) || !in.ReadArray(mesh.indices) || !in.ReadArray(mesh.lods) || !in.ReadArray(mesh.meshlets))
+            return false;
+        if (mesh.lods.empty() || (size_t)mesh.lods[0].indexOffset + mesh.lods[0].indexCount > mesh.indices.size())
+            return false;
+        if (!loadTextures)
+            mesh.material = NO_MATERIAL;
+        if (rebuild)
+        {
+            const LodLevel& full = mesh.lods[0];
+            vector<unsigned int> indices(mesh.indices.begin() + full.indexOffset, mesh.indices.begin() + full.indexOffset + full.indexCount);
+            mesh = MeshData(std::move(mesh.vertices), std::move(indices), mesh.material, lods, meshlets);
+        }
+    }
+    return in.AtEnd();
+}
 
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<unsigned int> materials;	// material table index of every material of the file (the materials used by the meshes, see AddMaterials)
     vector<Mesh>    meshes;
     string directory;
-    bool gammaCorrection;
-    bool loadTexturesFromModel;
+    bool gammaCorrection = false;
+    bool loadTexturesFromModel = false;
+    bool generateLods = false;
+    bool generateMeshlets = false;
+    vector<float> lodErrors; // per level of detail: the largest error of all meshes (object space)
+    glm::vec3 boundsCenter = glm::vec3(0.0f); // bounding sphere of all meshes (object space)
+    float boundsRadius = 0.0f;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool loadTextures = false, bool gamma = false) : gammaCorrection(gamma), loadTexturesFromModel(loadTextures)
+    // constructor, expects a filepath to a 3D model. If lods is set, a chain of simplified meshes is built at load time,
+    // if meshlets is set, the meshes are split into clusters that can be culled individually.
+    Model(string const &path, bool loadTextures = false, bool gamma = false, bool lods = false, bool meshlets = false)
+        : Model(Load(path, loadTextures, lods, meshlets), gamma)
     {
-        loadModel(path);
+        loadTexturesFromModel = loadTextures;
+        generateLods = lods;
+        generateMeshlets = meshlets;
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    // creates the model from data loaded before (e.g., on a worker thread, see Load)
+    explicit Model(ModelData&& data, bool gamma = false) : gammaCorrection(gamma)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        AddMaterials(data);
+        for (MeshData& mesh : data.meshes)
+            AddMesh(std::move(mesh));
+        UpdateBounds();
     }
-    
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // an empty model: add the materials and meshes step by step (AddMaterials, AddMesh), then call UpdateBounds
+    Model() = default;
+
+    // reads a model from file into CPU memory (no OpenGL calls, safe on any thread): a converted model from a mounted
+    // asset pack, an OBJ file with the loader in util/obj_loader.h or any other format with ASSIMP (see Import).
+    // If lods is set, a chain of simplified meshes is built, if meshlets is set, the meshes are split into clusters.
+    static ModelData Load(string const &path, bool loadTextures = false, bool lods = false, bool meshlets = false)
+    {
+        ModelData data;
+        FileData packed;
+        if (FileSystem::readPacked(path, PACK_MODEL, packed))
+        {
+            if (readModelData(packed.data, packed.size, loadTextures, lods, meshlets, data))
+                return data;
+            data = ModelData();
+        }
+        if (isObjFile(path))
+        {
+            if (loadObj(path, data, loadTextures, lods, meshlets))
+                return data;
+            data = ModelData();
+        }
+        return Import(path, loadTextures, lods, meshlets);
+    }
+
+    // reads a model with supported ASSIMP extensions from file into CPU memory (like Load, but always with ASSIMP)
+    static ModelData Import(string const &path, bool loadTextures = false, bool lods = false, bool meshlets = false)
     {
+        ModelData data;
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        const aiScene* scene = nullptr;
+        // formats that don't reference other files are imported from memory, so a prefetched (see util/async_io.h) or
+        // packed file isn't read again
+        FileData file;
+        string extension = path.substr(path.find_last_of('.') + 1);
+        for (char& c : extension) c = (char)tolower((unsigned char)c);
+        if ((extension == "fbx" || extension == "glb" || extension == "ply" || extension == "stl" || extension == "3ds" ||
+             extension == "blend" || extension == "dae") && FileSystem::read(path, file))
+            scene = importer.ReadFileFromMemory(file.data, file.size, flags, extension.c_str());
+        else
+            scene = importer.ReadFile(path, flags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return data;
         }
         // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        data.directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        ImportSettings settings = { loadTextures, lods, meshlets };
+        vector<unsigned int> materialMap(loadTextures ? scene->mNumMaterials : 0, NO_MATERIAL);
+        processNode(scene->mRootNode, scene, settings, materialMap, data);
+        return data;
     }
 
+    // creates the materials of data in the (global) material table. Their textures are packed into the texture arrays
+    // of the table (the uploaded textures or the decoded images are used if there are any, see ModelData::DecodeTextures).
+    void AddMaterials(const ModelData& data)
+    {
+        directory = data.directory;
+        for (const MaterialData& md : data.materials)
+        {
+            Material m;
+            GLuint* textures[MaterialData::NUM_TEXTURES] = { &m.diffuse, &m.specular, &m.normal, &m.height };
+            for (int t = 0; t < MaterialData::NUM_TEXTURES; t++)
+            {
+                if (md.textures[t].empty())
+                    continue;
+                if (md.uploaded[t])
+                    *textures[t] = materialTable().LoadTexture(md.textures[t], md.uploaded[t], md.images[t].width, md.images[t].height);
+                else if (md.images[t])
+                    *textures[t] = materialTable().LoadTexture(md.textures[t], md.images[t]);
+                else
+                    *textures[t] = materialTable().LoadTexture(md.textures[t]);
+            }
+            m.baseColor = md.baseColor;
+            materials.push_back(materialTable().Create(m));
+        }
+    }
+
+    // uploads the mesh into the geometry arena (call AddMaterials first, the material of the mesh is mapped to the table)
+    void AddMesh(MeshData&& mesh)
+    {
+        if (mesh.material != NO_MATERIAL)
+            mesh.material = mesh.material < materials.size() ? materials[mesh.material] : NO_MATERIAL;
+        meshes.emplace_back(std::move(mesh));
+    }
+
+    // like above, but the geometry is copied from a staging buffer (see Mesh)
+    void AddMesh(MeshData&& mesh, GLuint stagingBuffer, GLintptr vertexOffset, GLintptr indexOffset)
+    {
+        if (mesh.material != NO_MATERIAL)
+            mesh.material = mesh.material < materials.size() ? materials[mesh.material] : NO_MATERIAL;
+        meshes.emplace_back(std::move(mesh), stagingBuffer, vertexOffset, indexOffset);
+    }
+
+    // combines the bounding spheres and the lod errors of all meshes
+    void UpdateBounds()
+    {
+        lodErrors.assign(1, 0.0f);
+        boundsRadius = 0.0f;
+        if (meshes.empty()) return;
+
+        glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+        for (const Mesh& mesh : meshes)
+        {
+            minP = glm::min(minP, mesh.boundsCenter - glm::vec3(mesh.boundsRadius));
+            maxP = glm::max(maxP, mesh.boundsCenter + glm::vec3(mesh.boundsRadius));
+            if (mesh.lods.size() > lodErrors.size()) lodErrors.resize(mesh.lods.size(), 0.0f);
+        }
+        boundsCenter = (minP + maxP) * 0.5f;
+        for (const Mesh& mesh : meshes)
+        {
+            boundsRadius = std::max(boundsRadius, glm::length(mesh.boundsCenter - boundsCenter) + mesh.boundsRadius);
+            // meshes with a shorter chain are drawn at their coarsest level, which has the largest error of that mesh
+            for (size_t lod = 0; lod < lodErrors.size(); lod++)
+                lodErrors[lod] = std::max(lodErrors[lod], mesh.lods[std::min(lod, mesh.lods.size() - 1)].error);
+        }
+    }
+
+    // models are move-only (like their meshes)
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = default;
+
+    // returns the geometry of all meshes to the geometry arena (the model can't be drawn afterwards)
+    void Release()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.Release();
+        meshes.clear();
+    }
+
+    // draws the model, and thus all its meshes (optionally at a coarser level of detail)
+    void Draw(unsigned int lod = 0)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(lod);
+    }
+
+    // draws instances instances of the model, one instanced draw per mesh (see Mesh::DrawInstanced)
+    void DrawInstanced(GLsizei instances, GLuint baseInstance = 0, unsigned int lod = 0)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(instances, baseInstance, lod);
+    }
+
+    // draws the full detail model, culling the clusters of its meshes (the culler has to be set up for this instance)
+    void Draw(const ClusterCuller& culler, ClusterCullStats& stats)
+    {
+        if (!culler.insideFrustum(boundsCenter, boundsRadius))
+        {
+            for (const Mesh& mesh : meshes)
+            {
+                stats.clustersTotal += (unsigned int)mesh.meshlets.size();
+                stats.trianglesTotal += mesh.NumTriangles();
+            }
+            return;
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(culler, stats);
+    }
+
+    // resident memory of the model: its meshes, the geometry in the arena and the texture layers of its materials (a
+    // texture shared with other models counts for each of them)
+    MemoryUsage Memory() const
+    {
+        MemoryUsage usage;
+        usage.cpuBytes = sizeof(Model) + directory.capacity() + materials.capacity() * sizeof(unsigned int) +
+                         lodErrors.capacity() * sizeof(float) + (meshes.capacity() - meshes.size()) * sizeof(Mesh);
+        for (const Mesh& mesh : meshes)
+            usage += mesh.Memory();
+        std::set<GLuint> textures;
+        for (unsigned int m : materials)
+        {
+            const Material& material = materialTable().Get(m);
+            for (GLuint texture : { material.diffuse, material.specular, material.normal, material.height })
+                if (textures.insert(texture).second)
+                    usage.gpuBytes += materialTable().TextureBytes(texture);
+        }
+        return usage;
+    }
+
+    unsigned int NumLods() const { return (unsigned int)lodErrors.size(); }
+
+    // number of triangles drawn at the given level of detail
+    unsigned int NumTriangles(unsigned int lod = 0) const
+    {
+        unsigned int n = 0;
+        for (const Mesh& mesh : meshes) n += mesh.NumTriangles(lod);
+        return n;
+    }
+
+    // selects the coarsest level of detail whose error, projected to the screen, stays below maxPixelError.
+    // fovy is the vertical field of view in radians and viewportHeight the height of the viewport in pixels.
+    unsigned int SelectLod(const glm::mat4& modelMatrix, const glm::vec3& viewPos, float fovy, int viewportHeight, float maxPixelError) const
+    {
+        // (conservative) uniform scale of the model matrix
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(boundsCenter, 1.0f));
+        float distance = glm::length(center - viewPos) - boundsRadius * scale; // distance to the closest point of the bounding sphere
+
+        for (unsigned int lod = NumLods() - 1; lod > 0; lod--)
+            if (projectedErrorInPixels(lodErrors[lod] * scale, distance, fovy, viewportHeight) <= maxPixelError)
+                return lod;
+        return 0;
+    }
+    
+private:
+    struct ImportSettings {
+        bool loadTextures;
+        bool lods;
+        bool meshlets;
+    };
+
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, const ImportSettings& settings, vector<unsigned int>& materialMap, ModelData& data)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -75,22 +408,21 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene, settings, materialMap, data));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, settings, materialMap, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, const ImportSettings& settings, vector<unsigned int>& materialMap, ModelData& data)
     {
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -139,66 +471,55 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        if (loadTexturesFromModel)
+        // process materials: each material of the file that is used by a mesh becomes an entry in data.materials (and
+        // later in the global material table, see AddMaterials). We assume the following convention for the texture types:
+        // diffuse: aiTextureType_DIFFUSE
+        // specular: aiTextureType_SPECULAR
+        // normal: aiTextureType_HEIGHT
+        // height: aiTextureType_AMBIENT
+        unsigned int material = NO_MATERIAL;
+        if (settings.loadTextures)
         {
-            // 1. diffuse maps
-            vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            // 2. specular maps
-            vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-            // 3. normal maps
-            std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-            // 4. height maps
-            std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-            textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+            if (materialMap[mesh->mMaterialIndex] == NO_MATERIAL)
+            {
+                aiMaterial* aiMat = scene->mMaterials[mesh->mMaterialIndex];
+                MaterialData m;
+                m.textures[MaterialData::DIFFUSE] = materialTexturePath(aiMat, aiTextureType_DIFFUSE, data.directory);
+                m.textures[MaterialData::SPECULAR] = materialTexturePath(aiMat, aiTextureType_SPECULAR, data.directory);
+                m.textures[MaterialData::NORMAL] = materialTexturePath(aiMat, aiTextureType_HEIGHT, data.directory);
+                m.textures[MaterialData::HEIGHT] = materialTexturePath(aiMat, aiTextureType_AMBIENT, data.directory);
+                aiColor4D color;
+                if (aiGetMaterialColor(aiMat, AI_MATKEY_COLOR_DIFFUSE, &color) == AI_SUCCESS)
+                    m.baseColor = glm::vec4(color.r, color.g, color.b, color.a);
+                materialMap[mesh->mMaterialIndex] = (unsigned int)data.materials.size();
+                data.materials.push_back(std::move(m));
+            }
+            material = materialMap[mesh->mMaterialIndex];
         }
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the mesh data (bounds, levels of detail and clusters are computed here already)
+        return MeshData(std::move(vertices), std::move(indices), material, settings.lods, settings.meshlets);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // true if the path has the extension .obj (any case), which the OBJ loader handles instead of assimp
+    static bool isObjFile(const string& path)
     {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
-        }
-        return textures;
+        size_t dot = path.find_last_of('.');
+        if (dot == string::npos || path.size() - dot != 4)
+            return false;
+        string extension = path.substr(dot + 1);
+        for (char& c : extension) c = (char)tolower((unsigned char)c);
+        return extension == "obj";
+    }
+
+    // returns the path of the first texture of the given type (empty if there is none)
+    static string materialTexturePath(aiMaterial *mat, aiTextureType type, const string& directory)
+    {
+        if (mat->GetTextureCount(type) == 0)
+            return string();
+        aiString str;
+        mat->GetTexture(type, 0, &str);
+        return directory + '/' + str.C_Str();
     }
 };
 
@@ -212,7 +533,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     glGenTextures(1, &textureID);
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data = loadImageFile(filename, &width, &height, &nrComponents, 0);
     if (data)
     {
         GLenum format;
@@ -222,9 +543,15 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
             format = GL_RGB;
         else if (nrComponents == 4)
             format = GL_RGBA;
+        // gamma: the texture is stored in sRGB, so it is linearized when sampled
+        GLenum internalFormat = format;
+        if (gamma && format == GL_RGB)
+            internalFormat = GL_SRGB;
+        else if (gamma && format == GL_RGBA)
+            internalFormat = GL_SRGB_ALPHA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glState().BindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -242,4 +569,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 
     return textureID;
 }
+// (the OBJ loader needs the definitions above)
+#include <util/obj_loader.h>
+
 #endif
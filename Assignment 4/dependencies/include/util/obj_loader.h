@@ -0,0 +1,601 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <util/mesh.h>
+#include <util/model.h>
+#include <util/asset_pack.h>
+#include <util/filesystem.h>
+#include <util/parallel.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+
+// A loader for Wavefront OBJ files (and their MTL materials) that is much faster than the generic ASSIMP import
+// (Model::Load uses it for .obj files):
+// - the file is read with FileSystem::read (from a mounted asset pack or a prefetched buffer if there is one), split
+//   into chunks on line boundaries and the chunks are parsed in parallel (with a float parser that doesn't go through
+//   the C locale)
+// - polygons are triangulated as fans, OBJ indices (1-based, or negative for relative ones) are resolved once the
+//   counts of all chunks are known
+// - the triangles are grouped into one mesh per material (in the order of first use, like ASSIMP), and the position,
+//   texture coordinate and normal triples are deduplicated with a hash map (ASSIMP keeps one vertex per face corner)
+// - missing normals are computed (area weighted, shared by all corners at a position); tangents and bitangents follow
+//   the MikkTSpace conventions: per triangle tangents weighted by the corner angle, accumulated per vertex (vertices
+//   with the same position, texture coordinate and normal), orthogonalized against the normal and the bitangent
+//   sign taken from the handedness of the texture space. Unlike MikkTSpace, vertices aren't split where the tangent
+//   frames of neighbouring triangles disagree.
+// The vertices match the ASSIMP import (aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace),
+// the textures of the materials are mapped like in Model::processMesh: map_Kd diffuse, map_Ks specular,
+// map_Bump/bump normal (or norm), map_Ka height.
+
+// parsing helpers
+// ------------------------------------------------------------------------
+inline bool objIsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* objSkipSpaces(const char* p, const char* end)
+{
+    while (p < end && objIsSpace(*p)) p++;
+    return p;
+}
+
+// parses a decimal float ([+-]digits[.digits][(e|E)[+-]digits]). Exact for up to 19 significant digits and powers of
+// ten up to 10^22 (what OBJ exporters write), returns nullptr if there is no number at p.
+inline const char* objParseFloat(const char* p, const char* end, float& out)
+{
+    static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                    1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    p = objSkipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+    const char* start = p;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits += mantissa != 0; }
+        else exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits += mantissa != 0; exponent--; }
+        }
+    }
+    if (p == start || (p == start + 1 && *start == '.'))
+        return nullptr;
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        int e = 0;
+        if (q < end && *q >= '0' && *q <= '9')
+        {
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                e = std::min(e * 10 + (*q - '0'), 10000);
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value = exponent >= -22 ? value / POW10[-exponent] : value * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * POW10[exponent] : value * std::pow(10.0, exponent);
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+inline const char* objParseInt(const char* p, const char* end, long long& out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    const char* start = p;
+    long long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+        value = std::min(value * 10 + (*p - '0'), 1ll << 40);
+    if (p == start)
+        return nullptr;
+    out = negative ? -value : value;
+    return p;
+}
+
+// the rest of the line without trailing spaces
+inline std::string_view objRestOfLine(const char* p, const char* end)
+{
+    p = objSkipSpaces(p, end);
+    const char* e = end;
+    while (e > p && objIsSpace(e[-1])) e--;
+    return std::string_view(p, e - p);
+}
+
+// a parsed chunk of an OBJ file
+// ------------------------------------------------------------------------
+// index of a face corner: 0-based into the whole file, or (with OBJ_LOCAL) relative to the first element of the chunk,
+// stored + OBJ_LOCAL_BIAS since a relative index can point before the chunk (into the elements of the previous ones)
+const uint32_t OBJ_MISSING = 0xffffffffu;
+const uint32_t OBJ_LOCAL = 0x80000000u;
+const uint32_t OBJ_LOCAL_BIAS = 0x40000000u;
+
+struct ObjCorner {
+    uint32_t position, texCoord, normal;
+};
+
+struct ObjChunk {
+    vector<glm::vec3> positions;
+    vector<glm::vec2> texCoords;
+    vector<glm::vec3> normals;
+    vector<ObjCorner> corners; // 3 per triangle
+    vector<std::pair<size_t, std::string>> materialSwitches; // (first triangle, usemtl name)
+    vector<std::string> libraries; // mtllib
+    size_t invalidFaces = 0;
+};
+
+// converts an OBJ index (1-based, negative: relative to the end) to an ObjCorner index. localCount is the number of
+// elements of the chunk so far; relative indices are resolved against the counts of the previous chunks later.
+inline uint32_t objIndex(long long index, size_t localCount)
+{
+    if (index > 0)
+        return index <= (long long)(OBJ_LOCAL - 1) ? (uint32_t)(index - 1) : OBJ_MISSING;
+    long long local = (long long)localCount + index;
+    if (index < 0 && local >= -(long long)OBJ_LOCAL_BIAS && local < (long long)OBJ_LOCAL_BIAS - 1)
+        return OBJ_LOCAL | (uint32_t)(local + OBJ_LOCAL_BIAS);
+    return OBJ_MISSING;
+}
+
+void parseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+{
+    vector<ObjCorner> polygon;
+    while (p < end)
+    {
+        const char* lineEnd = (const char*)std::memchr(p, '\n', end - p);
+        if (!lineEnd) lineEnd = end;
+        p = objSkipSpaces(p, lineEnd);
+
+        if (lineEnd - p >= 2 && p[0] == 'v' && objIsSpace(p[1]))
+        {
+            glm::vec3 v(0.0f);
+            const char* q = p + 2;
+            for (int i = 0; i < 3 && q; i++)
+                q = objParseFloat(q, lineEnd, v[i]);
+            chunk.positions.push_back(v);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && objIsSpace(p[2]))
+        {
+            glm::vec2 t(0.0f);
+            const char* q = objParseFloat(p + 3, lineEnd, t.x);
+            if (q) objParseFloat(q, lineEnd, t.y);
+            t.y = 1.0f - t.y; // (aiProcess_FlipUVs)
+            chunk.texCoords.push_back(t);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && objIsSpace(p[2]))
+        {
+            glm::vec3 n(0.0f);
+            const char* q = p + 3;
+            for (int i = 0; i < 3 && q; i++)
+                q = objParseFloat(q, lineEnd, n[i]);
+            chunk.normals.push_back(n);
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && objIsSpace(p[1]))
+        {
+            polygon.clear();
+            const char* q = objSkipSpaces(p + 2, lineEnd);
+            bool valid = true;
+            while (q < lineEnd)
+            {
+                // v, v/t, v//n or v/t/n
+                long long v = 0, t = 0, n = 0;
+                q = objParseInt(q, lineEnd, v);
+                if (!q) { valid = false; break; }
+                if (q < lineEnd && *q == '/')
+                {
+                    q++;
+                    if (q < lineEnd && *q != '/')
+                        q = objParseInt(q, lineEnd, t);
+                    if (q && q < lineEnd && *q == '/')
+                        q = objParseInt(q + 1, lineEnd, n);
+                    if (!q) { valid = false; break; }
+                }
+                ObjCorner corner;
+                corner.position = objIndex(v, chunk.positions.size());
+                corner.texCoord = t != 0 ? objIndex(t, chunk.texCoords.size()) : OBJ_MISSING;
+                corner.normal = n != 0 ? objIndex(n, chunk.normals.size()) : OBJ_MISSING;
+                valid = valid && corner.position != OBJ_MISSING;
+                polygon.push_back(corner);
+                q = objSkipSpaces(q, lineEnd);
+            }
+            if (valid && polygon.size() >= 3)
+            {
+                for (size_t i = 2; i < polygon.size(); i++)
+                    chunk.corners.insert(chunk.corners.end(), { polygon[0], polygon[i - 1], polygon[i] });
+            }
+            else
+                chunk.invalidFaces++;
+        }
+        else if (lineEnd - p > 7 && std::strncmp(p, "usemtl", 6) == 0 && objIsSpace(p[6]))
+            chunk.materialSwitches.emplace_back(chunk.corners.size() / 3, std::string(objRestOfLine(p + 7, lineEnd)));
+        else if (lineEnd - p > 7 && std::strncmp(p, "mtllib", 6) == 0 && objIsSpace(p[6]))
+            chunk.libraries.emplace_back(objRestOfLine(p + 7, lineEnd));
+        // (comments, o, g, s, l, p, ... are ignored)
+
+        p = lineEnd + 1;
+    }
+}
+
+// MTL files
+// ------------------------------------------------------------------------
+// the file name of a map_* statement (the options before it, like -bm 1 or -o 0 0 0, are skipped)
+inline std::string mtlMapFile(std::string_view rest)
+{
+    while (!rest.empty() && rest[0] == '-')
+    {
+        // the option and its arguments (numbers, on/off)
+        size_t space = rest.find_first_of(" \t");
+        if (space == std::string_view::npos)
+            return std::string();
+        rest = objRestOfLine(rest.data() + space, rest.data() + rest.size());
+        for (;;)
+        {
+            size_t next = rest.find_first_of(" \t");
+            if (next == std::string_view::npos)
+                break; // (the last token is the file name)
+            std::string_view token = rest.substr(0, next);
+            float unused;
+            bool argument = token == "on" || token == "off" ||
+                objParseFloat(token.data(), token.data() + token.size(), unused) == token.data() + token.size();
+            if (!argument)
+                break;
+            rest = objRestOfLine(rest.data() + next, rest.data() + rest.size());
+        }
+    }
+    return std::string(rest);
+}
+
+// reads the materials of an MTL file into materials (by name), texture paths are relative to directory
+void parseMtl(const std::string& path, const std::string& directory, std::unordered_map<std::string, MaterialData>& materials)
+{
+    FileData file;
+    if (!FileSystem::read(path, file))
+    {
+        std::cout << "OBJ: can't read the material library " << path << std::endl;
+        return;
+    }
+    const char* p = (const char*)file.data;
+    const char* end = p + file.size;
+    MaterialData* material = nullptr;
+    std::string normalMap; // (norm, used if there is no bump map)
+    auto finish = [&]() {
+        if (material && material->textures[MaterialData::NORMAL].empty() && !normalMap.empty())
+            material->textures[MaterialData::NORMAL] = directory + '/' + normalMap;
+        normalMap.clear();
+    };
+    while (p < end)
+    {
+        const char* lineEnd = (const char*)std::memchr(p, '\n', end - p);
+        if (!lineEnd) lineEnd = end;
+        p = objSkipSpaces(p, lineEnd);
+        const char* keyEnd = p;
+        while (keyEnd < lineEnd && !objIsSpace(*keyEnd)) keyEnd++;
+        std::string_view key(p, keyEnd - p);
+        std::string_view rest = objRestOfLine(keyEnd, lineEnd);
+
+        if (key == "newmtl")
+        {
+            finish();
+            material = &materials[std::string(rest)];
+        }
+        else if (material)
+        {
+            int texture = -1;
+            if (key == "map_Kd") texture = MaterialData::DIFFUSE;
+            else if (key == "map_Ks") texture = MaterialData::SPECULAR;
+            else if (key == "map_Bump" || key == "map_bump" || key == "bump") texture = MaterialData::NORMAL;
+            else if (key == "map_Ka") texture = MaterialData::HEIGHT;
+            else if (key == "norm") normalMap = mtlMapFile(rest);
+            else if (key == "Kd")
+            {
+                const char* q = rest.data();
+                for (int i = 0; i < 3 && q; i++)
+                    q = objParseFloat(q, rest.data() + rest.size(), material->baseColor[i]);
+            }
+            if (texture >= 0)
+            {
+                std::string file = mtlMapFile(rest);
+                if (!file.empty())
+                    material->textures[texture] = directory + '/' + file;
+            }
+        }
+        p = lineEnd + 1;
+    }
+    finish();
+}
+
+// mesh building
+// ------------------------------------------------------------------------
+// open addressing hash map from a face corner (position, texture coordinate and normal index) to its vertex
+class ObjVertexMap {
+public:
+    explicit ObjVertexMap(size_t maxVertices)
+    {
+        size_t capacity = 16;
+        while (capacity < maxVertices * 2) capacity *= 2;
+        keys.resize(capacity);
+        values.assign(capacity, OBJ_MISSING);
+        mask = capacity - 1;
+    }
+
+    // the vertex of the corner, or OBJ_MISSING after inserting it with vertex index next
+    uint32_t FindOrInsert(const ObjCorner& corner, uint32_t next)
+    {
+        uint64_t h = ((uint64_t)corner.position * 0x9e3779b97f4a7c15ull) ^ ((uint64_t)corner.texCoord * 0xc2b2ae3d27d4eb4full) ^
+                     ((uint64_t)corner.normal * 0x165667b19e3779f9ull);
+        for (size_t i = (size_t)(h ^ (h >> 29)) & mask;; i = (i + 1) & mask)
+        {
+            if (values[i] == OBJ_MISSING)
+            {
+                keys[i] = corner;
+                values[i] = next;
+                return OBJ_MISSING;
+            }
+            const ObjCorner& k = keys[i];
+            if (k.position == corner.position && k.texCoord == corner.texCoord && k.normal == corner.normal)
+                return values[i];
+        }
+    }
+
+private:
+    vector<ObjCorner> keys;
+    vector<uint32_t> values;
+    size_t mask;
+};
+
+// computes the tangents and bitangents of the vertices of the triangles (see the comment at the top)
+void computeObjTangents(vector<Vertex>& vertices, const vector<unsigned int>& indices)
+{
+    vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f)), bitangents(vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const Vertex* v[3] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+        glm::vec3 e1 = v[1]->Position - v[0]->Position, e2 = v[2]->Position - v[0]->Position;
+        glm::vec2 d1 = v[1]->TexCoords - v[0]->TexCoords, d2 = v[2]->TexCoords - v[0]->TexCoords;
+        float det = d1.x * d2.y - d2.x * d1.y;
+        if (std::fabs(det) < 1e-20f)
+            continue; // (degenerate texture space)
+        float r = 1.0f / det;
+        glm::vec3 t = (e1 * d2.y - e2 * d1.y) * r;
+        glm::vec3 b = (e2 * d1.x - e1 * d2.x) * r;
+        for (int c = 0; c < 3; c++)
+        {
+            // weighted by the angle of the triangle at the corner
+            glm::vec3 a = v[(c + 1) % 3]->Position - v[c]->Position, bEdge = v[(c + 2) % 3]->Position - v[c]->Position;
+            float la = glm::length(a), lb = glm::length(bEdge);
+            float angle = la > 0.0f && lb > 0.0f ? std::acos(glm::clamp(glm::dot(a, bEdge) / (la * lb), -1.0f, 1.0f)) : 0.0f;
+            tangents[indices[i + c]] += t * angle;
+            bitangents[indices[i + c]] += b * angle;
+        }
+    }
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        Vertex& vertex = vertices[i];
+        glm::vec3 n = vertex.Normal;
+        glm::vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+        if (glm::dot(t, t) < 1e-20f)
+        {
+            // no texture space: any direction perpendicular to the normal
+            t = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            t -= n * glm::dot(n, t);
+        }
+        t = glm::normalize(t);
+        float sign = glm::dot(glm::cross(n, t), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+        vertex.Tangent = t;
+        vertex.Bitangent = glm::cross(n, t) * sign;
+    }
+}
+
+// loading
+// ------------------------------------------------------------------------
+// loads an OBJ file into data (no OpenGL calls, safe on any thread). Returns false if the file can't be read.
+// The arguments are those of Model::Load.
+bool loadObj(const string& path, ModelData& data, bool loadTextures, bool lods, bool meshlets)
+{
+    // the file: from a mounted asset pack, a prefetched buffer (see util/async_io.h) or read
+    FileData file;
+    if (!FileSystem::read(path, file))
+        return false;
+    const char* text = (const char*)file.data;
+    size_t size = file.size;
+    data.directory = path.substr(0, path.find_last_of('/'));
+
+    // 1. parse chunks of at least 1 MB in parallel (chunks start after a line break)
+    const size_t MIN_CHUNK_SIZE = 1 << 20;
+    size_t numChunks = std::max<size_t>(1, std::min<size_t>(workerCount() * 4, size / MIN_CHUNK_SIZE));
+    vector<size_t> starts(numChunks + 1, size);
+    starts[0] = 0;
+    for (size_t i = 1; i < numChunks; i++)
+    {
+        const char* lineBreak = (const char*)std::memchr(text + size * i / numChunks, '\n', size - size * i / numChunks);
+        starts[i] = lineBreak ? std::max(starts[i - 1], (size_t)(lineBreak - text) + 1) : size;
+    }
+    vector<ObjChunk> chunks(numChunks);
+    parallelFor(numChunks, [&](size_t i) {
+        parseObjChunk(text + starts[i], text + starts[i + 1], chunks[i]);
+    });
+
+    // 2. concatenate the elements and resolve the indices
+    vector<size_t> positionBase(numChunks), texCoordBase(numChunks), normalBase(numChunks), triangleBase(numChunks);
+    size_t numPositions = 0, numTexCoords = 0, numNormals = 0, numTriangles = 0, invalidFaces = 0;
+    for (size_t i = 0; i < numChunks; i++)
+    {
+        positionBase[i] = numPositions; numPositions += chunks[i].positions.size();
+        texCoordBase[i] = numTexCoords; numTexCoords += chunks[i].texCoords.size();
+        normalBase[i] = numNormals; numNormals += chunks[i].normals.size();
+        triangleBase[i] = numTriangles; numTriangles += chunks[i].corners.size() / 3;
+        invalidFaces += chunks[i].invalidFaces;
+    }
+    vector<glm::vec3> positions(numPositions), normals(numNormals);
+    vector<glm::vec2> texCoords(numTexCoords);
+    vector<ObjCorner> corners(numTriangles * 3);
+    parallelFor(numChunks, [&](size_t i) {
+        ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i]);
+        std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordBase[i]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i]);
+        auto resolve = [](uint32_t index, size_t base, size_t count) {
+            if (index == OBJ_MISSING || !(index & OBJ_LOCAL))
+                return index < count ? index : OBJ_MISSING;
+            // (relative: may point into a previous chunk)
+            long long resolved = (long long)base + (long long)(index & ~OBJ_LOCAL) - (long long)OBJ_LOCAL_BIAS;
+            return resolved >= 0 && resolved < (long long)count ? (uint32_t)resolved : OBJ_MISSING;
+        };
+        ObjCorner* out = corners.data() + triangleBase[i] * 3;
+        for (const ObjCorner& corner : chunk.corners)
+        {
+            out->position = resolve(corner.position, positionBase[i], numPositions);
+            out->texCoord = resolve(corner.texCoord, texCoordBase[i], numTexCoords);
+            out->normal = resolve(corner.normal, normalBase[i], numNormals);
+            out++;
+        }
+        vector<ObjCorner>().swap(chunk.corners);
+        vector<glm::vec3>().swap(chunk.positions);
+        vector<glm::vec3>().swap(chunk.normals);
+        vector<glm::vec2>().swap(chunk.texCoords);
+    });
+
+    // 3. the materials and the triangles of every mesh (one per usemtl name, in the order of first use)
+    std::unordered_map<std::string, MaterialData> library;
+    vector<std::string> libraries;
+    for (const ObjChunk& chunk : chunks)
+        for (const std::string& name : chunk.libraries)
+            if (std::find(libraries.begin(), libraries.end(), name) == libraries.end())
+                libraries.push_back(name);
+    if (loadTextures)
+        for (const std::string& name : libraries)
+            parseMtl(data.directory + '/' + name, data.directory, library);
+
+    struct ObjMesh {
+        std::string material;
+        vector<std::pair<size_t, size_t>> triangles; // ranges [first, last)
+    };
+    vector<ObjMesh> objMeshes;
+    std::unordered_map<std::string, size_t> meshOfMaterial;
+    size_t current = 0, first = 0;
+    auto switchTo = [&](const std::string& material, size_t triangle) {
+        if (triangle > first && !objMeshes.empty())
+            objMeshes[current].triangles.push_back({ first, triangle });
+        auto it = meshOfMaterial.find(material);
+        if (it == meshOfMaterial.end())
+        {
+            it = meshOfMaterial.emplace(material, objMeshes.size()).first;
+            objMeshes.push_back({ material, {} });
+        }
+        current = it->second;
+        first = triangle;
+    };
+    switchTo(std::string(), 0); // (triangles before the first usemtl)
+    for (size_t i = 0; i < numChunks; i++)
+        for (const auto& materialSwitch : chunks[i].materialSwitches)
+            switchTo(materialSwitch.second, triangleBase[i] + materialSwitch.first);
+    if (numTriangles > first)
+        objMeshes[current].triangles.push_back({ first, numTriangles });
+
+    // normals of files without (some) normals: area weighted face normals, accumulated per position
+    vector<glm::vec3> positionNormals;
+    bool missingNormals = std::any_of(corners.begin(), corners.end(), [](const ObjCorner& c) { return c.normal == OBJ_MISSING; });
+    if (missingNormals)
+    {
+        positionNormals.assign(numPositions, glm::vec3(0.0f));
+        for (size_t i = 0; i < corners.size(); i += 3)
+        {
+            const ObjCorner* c = &corners[i];
+            if (c[0].position == OBJ_MISSING || c[1].position == OBJ_MISSING || c[2].position == OBJ_MISSING)
+                continue;
+            glm::vec3 n = glm::cross(positions[c[1].position] - positions[c[0].position], positions[c[2].position] - positions[c[0].position]);
+            for (int k = 0; k < 3; k++)
+                positionNormals[c[k].position] += n;
+        }
+        for (glm::vec3& n : positionNormals)
+            n = glm::dot(n, n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    for (const ObjMesh& objMesh : objMeshes)
+    {
+        if (objMesh.triangles.empty())
+            continue;
+        unsigned int material = NO_MATERIAL;
+        if (loadTextures)
+        {
+            material = (unsigned int)data.materials.size();
+            auto it = library.find(objMesh.material);
+            data.materials.push_back(it != library.end() ? std::move(it->second) : MaterialData());
+            if (it != library.end())
+                library.erase(it);
+        }
+        data.meshes.emplace_back();
+        data.meshes.back().material = material;
+    }
+
+    // 4. build the meshes in parallel: deduplicate the corners, tangents, bounds, levels of detail and meshlets
+    vector<const ObjMesh*> usedMeshes;
+    for (const ObjMesh& objMesh : objMeshes)
+        if (!objMesh.triangles.empty())
+            usedMeshes.push_back(&objMesh);
+    parallelFor(usedMeshes.size(), [&](size_t m) {
+        const ObjMesh& objMesh = *usedMeshes[m];
+        size_t meshCorners = 0;
+        for (const auto& range : objMesh.triangles)
+            meshCorners += (range.second - range.first) * 3;
+
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vertices.reserve(meshCorners / 2);
+        indices.reserve(meshCorners);
+        ObjVertexMap map(meshCorners);
+        for (const auto& range : objMesh.triangles)
+        {
+            for (size_t t = range.first; t < range.second; t++)
+            {
+                const ObjCorner* triangle = &corners[t * 3];
+                if (triangle[0].position == OBJ_MISSING || triangle[1].position == OBJ_MISSING || triangle[2].position == OBJ_MISSING)
+                    continue; // (the face referenced a vertex that isn't in the file)
+                for (int c = 0; c < 3; c++)
+                {
+                    const ObjCorner& corner = triangle[c];
+                    uint32_t index = map.FindOrInsert(corner, (uint32_t)vertices.size());
+                    if (index == OBJ_MISSING)
+                    {
+                        index = (uint32_t)vertices.size();
+                        Vertex vertex;
+                        vertex.Position = positions[corner.position];
+                        vertex.Normal = corner.normal != OBJ_MISSING ? normals[corner.normal] : positionNormals[corner.position];
+                        vertex.TexCoords = corner.texCoord != OBJ_MISSING ? texCoords[corner.texCoord] : glm::vec2(0.0f);
+                        vertices.push_back(vertex);
+                    }
+                    indices.push_back(index);
+                }
+            }
+        }
+        computeObjTangents(vertices, indices);
+        data.meshes[m] = MeshData(std::move(vertices), std::move(indices), data.meshes[m].material, lods, meshlets);
+    });
+
+    if (invalidFaces > 0)
+        std::cout << "OBJ: skipped " << invalidFaces << " invalid faces in " << path << std::endl;
+    return true;
+}
+
+#endif
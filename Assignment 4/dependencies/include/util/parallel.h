@@ -0,0 +1,83 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <system_error>
+#include <algorithm>
+
+// true on threads that already run in parallel with others (the AsyncLoader workers, the helpers of parallelFor):
+// parallelFor runs inline there by default, instead of every one of them starting a thread per core
+bool& parallelWorker()
+{
+    thread_local bool worker = false;
+    return worker;
+}
+
+// number of threads used by parallelFor by default (all cores, 1 on a parallel worker)
+unsigned int workerCount()
+{
+    if (parallelWorker())
+        return 1;
+    unsigned int cores = std::thread::hardware_concurrency(); // (0 if unknown)
+    return std::max(1u, cores);
+}
+
+// calls f(i) for every i in [0, count) on up to threads threads (the calling thread is one of them) and returns when
+// all calls are done. The items are handed out one by one, so they may differ in cost. If f throws, no further items
+// are started and the first exception is rethrown once all threads are done.
+template <class F>
+void parallelFor(size_t count, F f, unsigned int threads = workerCount())
+{
+    threads = (unsigned int)std::min<size_t>(threads, count);
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            f(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto work = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                    error = std::current_exception();
+                next = count;
+            }
+        }
+    };
+    std::vector<std::thread> helpers;
+    for (unsigned int t = 1; t < threads; t++)
+    {
+        try
+        {
+            helpers.emplace_back([&work] { parallelWorker() = true; work(); });
+        }
+        catch (const std::system_error&)
+        {
+            break; // (no more threads, the started ones do the work)
+        }
+    }
+    bool wasWorker = parallelWorker(); // (the calling thread is one of the workers while it takes items)
+    parallelWorker() = true;
+    work();
+    parallelWorker() = wasWorker;
+    for (std::thread& helper : helpers)
+        helper.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef PREFILTER_SAMPLES_H
+#define PREFILTER_SAMPLES_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// The sample schedule of the GGX prefilter (see util/ibl_prefilter.h), without OpenGL: the compute prefilter uploads
+// it, the CPU baker (src/tools/iblbake) uses the same samples.
+
+// samples per texel of a level with this roughness (roughness 0 is a mirror, a single sample)
+inline unsigned int prefilterSampleCount(float roughness)
+{
+    return roughness <= 0.0f ? 1u : 32u + (unsigned int)(96.0f * roughness);
+}
+
+// the GGX samples of a level: xyz the direction of the light in tangent space (z along the normal), w the mip level of
+// the environment (environmentSize texels per side at level 0) to read it from. Samples below the horizon are dropped.
+std::vector<glm::vec4> prefilterSamples(float roughness, unsigned int count, int environmentSize)
+{
+    const float PI = 3.14159265359f;
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float saTexel = 4.0f * PI / (6.0f * environmentSize * environmentSize);
+    std::vector<glm::vec4> samples;
+    samples.reserve(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Hammersley point (see prefilter.fs)
+        unsigned int bits = i;
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        glm::vec2 Xi((float)i / (float)count, (float)bits * 2.3283064365386963e-10f);
+
+        float phi = 2.0f * PI * Xi.x;
+        float cosTheta = std::sqrt((1.0f - Xi.y) / (1.0f + (a2 - 1.0f) * Xi.y));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 H(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+        glm::vec3 L = 2.0f * H.z * H - glm::vec3(0.0f, 0.0f, 1.0f); // (reflect V = N around H)
+        if (L.z <= 0.0f)
+            continue;
+
+        // pdf of L: D * NdotH / (4 * HdotV), with N = V the two dots are the same
+        float denom = cosTheta * cosTheta * (a2 - 1.0f) + 1.0f;
+        float pdf = a2 / (PI * denom * denom) / 4.0f + 0.0001f;
+        float saSample = 1.0f / (count * pdf + 0.0001f);
+        // (+1: a level above the one of the solid angle hides the pattern of the few samples)
+        float level = roughness <= 0.0f ? 0.0f : std::max(0.0f, 0.5f * std::log2(saSample / saTexel) + 1.0f);
+        samples.push_back(glm::vec4(glm::normalize(L), level));
+    }
+    return samples;
+}
+
+// samples per texel of all levels of a prefilter map with levels mip levels (the roughness goes from 0 to 1)
+inline unsigned int prefilterTotalSamples(int levels)
+{
+    unsigned int total = 0;
+    for (int level = 0; level < levels; level++)
+        total += prefilterSampleCount(levels > 1 ? (float)level / (float)(levels - 1) : 0.0f);
+    return total;
+}
+
+#endif
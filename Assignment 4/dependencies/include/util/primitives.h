@@ -0,0 +1,260 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/arena.h>
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// The procedural shapes of the demos (spheres, cubes, quads and planes). They are built once, on first use, into the
+// geometry arena (util/arena.h) as indexed triangle lists with a few levels of tessellation each, so all of them share
+// one VAO and any of them is drawn (with any number of instances) by a single glDrawElements* call:
+//
+//   primitives().Draw(PRIMITIVE_SPHERE);                 // full detail
+//   primitives().Draw(PRIMITIVE_SPHERE, 2, 49);          // 49 instances of the third level of detail
+//
+// The vertex layout is the one of the model shaders: position (location 0), normal (1), texture coordinates (2). The
+// per draw index of the arena (location 5, see DRAW_ID_LOCATION) is baseInstance + the instance, so instanced
+// shaders can read their per instance data with it (or with gl_InstanceID).
+//
+// Cube, quad and sphere span [-1, 1] (the quad in XY facing +z, a full screen quad in NDC), the plane spans [-1, 1] in
+// XZ facing +y. The front faces are counter clockwise.
+
+enum PrimitiveType { PRIMITIVE_SPHERE, PRIMITIVE_CUBE, PRIMITIVE_QUAD, PRIMITIVE_PLANE, NUM_PRIMITIVES };
+
+// segments per level of detail (level 0 is the finest; the sphere has as many rings as segments around)
+const std::vector<unsigned int> SPHERE_SEGMENTS = { 64, 32, 16, 8 };
+const std::vector<unsigned int> PLANE_SEGMENTS = { 32, 8, 1 };
+
+// binding of the shader storage buffer with the per instance data of instanced draws (e.g., the model matrices of
+// pbr.vs.glsl)
+const GLuint PRIMITIVE_INSTANCE_BINDING = 3;
+
+// size of the post-transform vertex cache the indices are ordered for (a FIFO, like the one of most GPUs)
+const unsigned int PRIMITIVE_CACHE_SIZE = 16;
+
+// interleaved vertex of the primitives
+struct PrimitiveVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+// the vertices and indices of one level of detail
+struct PrimitiveMesh {
+    std::vector<PrimitiveVertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+// appends the triangles of a grid of columns x rows quads whose vertex (x, y) is base + y * (columns + 1) + x. Every
+// quad a = (x, y), b = (x + 1, y), c = (x, y + 1), d = (x + 1, y + 1) gives the triangles (a, b, c) and (b, d, c);
+// collapsed edges (poles) leave out the triangles that would be degenerate: (a, b, c) in the first row if the first
+// row is a single point, (b, d, c) in the last row if the last one is.
+// The quads are not emitted row by row but in vertical bands that are narrow enough that the vertices of the previous
+// row are still in the vertex cache when the next row reuses them: every vertex is transformed about once instead of
+// twice for rows wider than the cache (see cacheMissRatio).
+void appendGridIndices(std::vector<unsigned int>& indices, unsigned int columns, unsigned int rows, unsigned int base,
+                       bool collapsedFirstRow = false, bool collapsedLastRow = false)
+{
+    // a band row needs its own and the previous row of vertices in the cache
+    const unsigned int band = std::max(1u, PRIMITIVE_CACHE_SIZE / 2 - 1);
+    for (unsigned int first = 0; first < columns; first += band)
+    {
+        unsigned int last = std::min(columns, first + band);
+        for (unsigned int y = 0; y < rows; y++)
+        {
+            for (unsigned int x = first; x < last; x++)
+            {
+                unsigned int a = base + y * (columns + 1) + x;
+                unsigned int b = a + 1;
+                unsigned int c = a + columns + 1;
+                unsigned int d = c + 1;
+                if (!(collapsedFirstRow && y == 0))
+                    indices.insert(indices.end(), { a, b, c });
+                if (!(collapsedLastRow && y == rows - 1))
+                    indices.insert(indices.end(), { b, d, c });
+            }
+        }
+    }
+}
+
+// average cache miss ratio (ACMR) of a triangle list: transformed vertices per triangle with a FIFO vertex cache of
+// cacheSize entries. 0.5 is the best a regular grid can get, 3 means no reuse at all.
+float cacheMissRatio(const std::vector<unsigned int>& indices, unsigned int cacheSize = PRIMITIVE_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    std::vector<unsigned int> cache;
+    size_t next = 0, misses = 0; // (next is the entry that is replaced next once the cache is full)
+    for (unsigned int index : indices)
+    {
+        if (std::find(cache.begin(), cache.end(), index) != cache.end())
+            continue;
+        misses++;
+        if (cache.size() < cacheSize)
+            cache.push_back(index);
+        else
+        {
+            cache[next] = index;
+            next = (next + 1) % cacheSize;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// UV sphere of radius 1 with segments segments around and segments rings (the texture wraps once around, v = 0 at the
+// north pole). The seam and the poles have a vertex per segment for the texture coordinates.
+PrimitiveMesh buildSphere(unsigned int segments)
+{
+    const float PI = 3.14159265359f;
+    PrimitiveMesh mesh;
+    for (unsigned int y = 0; y <= segments; ++y)
+    {
+        for (unsigned int x = 0; x <= segments; ++x)
+        {
+            float xSegment = (float)x / (float)segments;
+            float ySegment = (float)y / (float)segments;
+            glm::vec3 position(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI),
+                               std::cos(ySegment * PI),
+                               std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI));
+            mesh.vertices.push_back({ position, position, glm::vec2(xSegment, ySegment) });
+        }
+    }
+    appendGridIndices(mesh.indices, segments, segments, 0, true, true);
+    return mesh;
+}
+
+// grid of segments x segments quads: corner + s * u + t * v for s, t in [0, 1], facing u x v
+void appendGrid(PrimitiveMesh& mesh, unsigned int segments, const glm::vec3& corner, const glm::vec3& u, const glm::vec3& v)
+{
+    unsigned int base = (unsigned int)mesh.vertices.size();
+    glm::vec3 normal = glm::normalize(glm::cross(u, v));
+    for (unsigned int y = 0; y <= segments; ++y)
+    {
+        for (unsigned int x = 0; x <= segments; ++x)
+        {
+            glm::vec2 st((float)x / (float)segments, (float)y / (float)segments);
+            mesh.vertices.push_back({ corner + st.s * u + st.t * v, normal, st });
+        }
+    }
+    appendGridIndices(mesh.indices, segments, segments, base);
+}
+
+// cube of [-1, 1]^3, four vertices per face (for the normals and texture coordinates)
+PrimitiveMesh buildCube()
+{
+    PrimitiveMesh mesh;
+    const glm::vec3 X(1.0f, 0.0f, 0.0f), Y(0.0f, 1.0f, 0.0f), Z(0.0f, 0.0f, 1.0f);
+    // u and v of every face (u x v is its normal)
+    const glm::vec3 faces[6][2] = { { -Z, Y }, { Z, Y }, { X, -Z }, { X, Z }, { X, Y }, { -X, Y } };
+    for (const auto& face : faces)
+    {
+        glm::vec3 normal = glm::cross(face[0], face[1]);
+        appendGrid(mesh, 1, normal - face[0] - face[1], 2.0f * face[0], 2.0f * face[1]);
+    }
+    return mesh;
+}
+
+PrimitiveMesh buildQuad()
+{
+    PrimitiveMesh mesh;
+    appendGrid(mesh, 1, glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 2.0f, 0.0f));
+    return mesh;
+}
+
+// plane of segments x segments quads (texture coordinates from 0 at -x, +z to 1 at +x, -z)
+PrimitiveMesh buildPlane(unsigned int segments)
+{
+    PrimitiveMesh mesh;
+    appendGrid(mesh, segments, glm::vec3(-1.0f, 0.0f, 1.0f), glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -2.0f));
+    return mesh;
+}
+
+class Primitives {
+public:
+    // a level of detail of a primitive in the geometry arena
+    struct Level {
+        GLuint firstIndex = 0;
+        GLsizei indexCount = 0;
+        GLint baseVertex = 0;
+        unsigned int vertexCount = 0;
+        float cacheMissRatio = 0.0f; // (of its index order, see cacheMissRatio)
+    };
+
+    // draws instances instances of a level of detail of the primitive (clamped to the coarsest one). The per draw
+    // index of the arena VAO counts from baseInstance.
+    void Draw(PrimitiveType type, unsigned int lod = 0, GLsizei instances = 1, GLuint baseInstance = 0)
+    {
+        init();
+        const Level& level = Get(type, lod);
+        GeometryArena& arena = geometryArena();
+        arena.EnsureDrawIds(baseInstance + instances);
+        glState().BindVertexArray(arena.VertexArray(format));
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                                      (void*)(level.firstIndex * sizeof(unsigned int)), instances,
+                                                      level.baseVertex, baseInstance);
+    }
+
+    const Level& Get(PrimitiveType type, unsigned int lod = 0)
+    {
+        init();
+        const std::vector<Level>& lods = levels[type];
+        return lods[std::min<size_t>(lod, lods.size() - 1)];
+    }
+
+    unsigned int LevelCount(PrimitiveType type)
+    {
+        init();
+        return (unsigned int)levels[type].size();
+    }
+
+private:
+    std::vector<Level> levels[NUM_PRIMITIVES];
+    unsigned int format = 0;
+    bool built = false;
+
+    void init()
+    {
+        if (built)
+            return;
+        built = true;
+        format = geometryArena().RegisterFormat({ {
+                { 0, 3, GL_FLOAT, (GLuint)offsetof(PrimitiveVertex, Position) },
+                { 1, 3, GL_FLOAT, (GLuint)offsetof(PrimitiveVertex, Normal) },
+                { 2, 2, GL_FLOAT, (GLuint)offsetof(PrimitiveVertex, TexCoords) } },
+            sizeof(PrimitiveVertex) });
+        for (unsigned int segments : SPHERE_SEGMENTS)
+            add(PRIMITIVE_SPHERE, buildSphere(segments));
+        add(PRIMITIVE_CUBE, buildCube());
+        add(PRIMITIVE_QUAD, buildQuad());
+        for (unsigned int segments : PLANE_SEGMENTS)
+            add(PRIMITIVE_PLANE, buildPlane(segments));
+    }
+
+    void add(PrimitiveType type, const PrimitiveMesh& mesh)
+    {
+        GeometryArena& arena = geometryArena();
+        Level level;
+        level.baseVertex = arena.AllocateVertices(format, mesh.vertices.data(), mesh.vertices.size());
+        level.firstIndex = arena.AllocateIndices(mesh.indices.data(), mesh.indices.size());
+        level.indexCount = (GLsizei)mesh.indices.size();
+        level.vertexCount = (unsigned int)mesh.vertices.size();
+        level.cacheMissRatio = cacheMissRatio(mesh.indices);
+        levels[type].push_back(level);
+    }
+};
+
+// the primitives of the (main) OpenGL context, built on first use
+Primitives& primitives()
+{
+    static Primitives instance;
+    return instance;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/draw_list.h>
+#include <util/shader.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+// Collects the draw items of a pass and submits them sorted by a 64 bit key, so that items sharing a program and a VAO
+// end up next to each other (one glMultiDrawElementsIndirect per run) and, within a material, opaque items are drawn
+// front to back (helps early-z). The key (from the most to the least significant bits):
+//   | program (12) | VAO (8) | material (16) | depth (24) | unused (4) |
+class RenderQueue {
+public:
+    // state changes of the last Submit (sorted) and the ones the same items would have caused in submission order
+    struct Stats {
+        unsigned int items = 0;
+        unsigned int programChanges = 0;
+        unsigned int vaoChanges = 0;
+        unsigned int materialChanges = 0; // resolved in the shaders (material table), counted to compare the orders
+        unsigned int batches = 0;         // glMultiDrawElementsIndirect calls
+        unsigned int programChangesUnsorted = 0;
+        unsigned int materialChangesUnsorted = 0;
+    } stats;
+
+    // starts a new pass; the depth of the items is measured from viewPos (e.g., the camera or the light position)
+    void Begin(const glm::vec3& viewPos, float farPlane = 100.0f)
+    {
+        items.clear();
+        this->viewPos = viewPos;
+        this->farPlane = farPlane;
+    }
+
+    // adds the mesh at the given level of detail. If material is NO_MATERIAL, the material of the mesh is used.
+    void Add(const Shader& shader, const Mesh& mesh, const glm::mat4& model, unsigned int lod = 0, unsigned int material = NO_MATERIAL)
+    {
+        const LodLevel& level = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+        addItem(shader, mesh, level.indexOffset, level.indexCount, model, lod, material != NO_MATERIAL ? material : mesh.material);
+    }
+
+    // adds all meshes of the model at the given level of detail
+    void Add(const Shader& shader, const Model& model, const glm::mat4& modelMatrix, unsigned int lod = 0, unsigned int material = NO_MATERIAL)
+    {
+        for (const Mesh& mesh : model.meshes)
+            Add(shader, mesh, modelMatrix, lod, material);
+    }
+
+    // adds the clusters of the (full detail) meshes of the model that survive culling (the culler has to be set up for this instance)
+    void Add(const Shader& shader, const Model& model, const glm::mat4& modelMatrix, const ClusterCuller& culler, ClusterCullStats& stats)
+    {
+        forEachVisibleRange(model, culler, stats, [&](const Mesh& mesh, unsigned int first, unsigned int count) {
+            addItem(shader, mesh, first, count, modelMatrix, 0, mesh.material);
+        });
+    }
+
+    // sorts the items and draws them. Switches the program when needed (the per pass uniforms have to be set already).
+    void Submit(bool useMaterials = true)
+    {
+        stats = Stats();
+        stats.items = (unsigned int)items.size();
+        if (items.empty())
+            return;
+
+        // build the keys (program and VAO are mapped to small slots, numbered anew for every pass). Ids that do not
+        // fit their bits would silently mix up the runs, so they are asserted instead of masked.
+        programs.clear();
+        vaos.clear();
+        keys.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const Item& item = items[i];
+            uint64_t program = slot(programs, item.shader->ID);
+            uint64_t vao = slot(vaos, item.vao);
+            assert(program <= 0xFFF && "RenderQueue: more than 4096 programs in a pass");
+            assert(vao <= 0xFF && "RenderQueue: more than 256 VAOs in a pass");
+            // (NO_MATERIAL sorts last)
+            assert((item.material == NO_MATERIAL || item.material < 0xFFFF) && "RenderQueue: material index out of range");
+            uint64_t material = std::min<uint64_t>(item.material, 0xFFFF);
+            uint64_t depth = (uint64_t)(glm::clamp(item.depth / farPlane, 0.0f, 1.0f) * 0xFFFFFF);
+            keys[i].key = (program << 52) | (vao << 44) | (material << 28) | (depth << 4);
+            keys[i].index = (uint32_t)i;
+        }
+        radixSort(keys, scratch);
+
+        // submission order statistics (for comparison)
+        for (size_t i = 1; i < items.size(); i++)
+        {
+            stats.programChangesUnsorted += items[i].shader->ID != items[i - 1].shader->ID;
+            stats.materialChangesUnsorted += items[i].material != items[i - 1].material;
+        }
+
+        // fill the draw list in sorted order and submit one batch per run of equal program and VAO
+        drawList.Clear();
+        for (const SortKey& k : keys)
+        {
+            const Item& item = items[k.index];
+            drawList.AddRange(*item.mesh, item.first, item.count, item.model, item.lod, item.material);
+        }
+        size_t first = 0;
+        GLuint currentProgram = 0, currentVao = 0;
+        for (size_t i = 1; i <= keys.size(); i++)
+        {
+            if (i < keys.size())
+            {
+                const Item& a = items[keys[i - 1].index];
+                const Item& b = items[keys[i].index];
+                stats.materialChanges += a.material != b.material;
+                if (a.shader->ID == b.shader->ID && a.vao == b.vao)
+                    continue;
+            }
+            const Item& run = items[keys[first].index];
+            if (run.shader->ID != currentProgram)
+            {
+                glState().UseProgram(run.shader->ID);
+                currentProgram = run.shader->ID;
+                stats.programChanges++;
+            }
+            if (run.vao != currentVao)
+            {
+                currentVao = run.vao;
+                stats.vaoChanges++;
+            }
+            drawList.Submit(useMaterials, first, i - first);
+            stats.batches++;
+            first = i;
+        }
+    }
+
+private:
+    struct Item {
+        const Shader* shader;
+        const Mesh* mesh;
+        GLuint vao;
+        unsigned int material;
+        float depth;
+        unsigned int first, count; // index range (relative to the mesh)
+        glm::mat4 model;
+        unsigned int lod;
+    };
+    struct SortKey {
+        uint64_t key;
+        uint32_t index;
+    };
+    std::vector<Item> items;
+    std::vector<SortKey> keys, scratch;
+    std::vector<GLuint> programs, vaos; // slot -> GL name
+    DrawList drawList;
+    glm::vec3 viewPos = glm::vec3(0.0f);
+    float farPlane = 100.0f;
+
+    void addItem(const Shader& shader, const Mesh& mesh, unsigned int first, unsigned int count, const glm::mat4& model, unsigned int lod, unsigned int material)
+    {
+        // distance to the center of the mesh's bounding sphere
+        glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundsCenter, 1.0f));
+        items.push_back({ &shader, &mesh, mesh.VAO, material, glm::length(center - viewPos), first, count, model, lod });
+    }
+
+    static uint64_t slot(std::vector<GLuint>& names, GLuint name)
+    {
+        auto it = std::find(names.begin(), names.end(), name);
+        if (it != names.end())
+            return (uint64_t)(it - names.begin());
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    // least significant digit radix sort (8 bit digits, stable); digits that are equal for all keys are skipped
+    static void radixSort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch)
+    {
+        scratch.resize(keys.size());
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256];
+            std::memset(histogram, 0, sizeof(histogram));
+            for (const SortKey& k : keys)
+                histogram[(k.key >> shift) & 0xFF]++;
+            if (histogram[(keys[0].key >> shift) & 0xFF] == keys.size())
+                continue;
+            size_t offset = 0;
+            for (size_t& h : histogram)
+            {
+                size_t n = h;
+                h = offset;
+                offset += n;
+            }
+            for (const SortKey& k : keys)
+                scratch[histogram[(k.key >> shift) & 0xFF]++] = k;
+            keys.swap(scratch);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SH_H
+#define SH_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/sh_math.h> // (SHCoefficients, CUBE_FACE_AXES, evaluateSH, projectCubemapSH of floats)
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// The coefficients (see util/sh_math.h) are passed in the uniform block at SH_BINDING (std140):
+//   layout (std140, binding = 2) uniform SHData { vec4 shCoefficients[9]; };
+const GLuint SH_BINDING = 2;
+
+// reads back the faces of a cube map level (RGB float)
+int readCubemapLevel(GLuint cubemap, int level, std::vector<float> faces[6])
+{
+    GLint size = 0;
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, level, GL_TEXTURE_WIDTH, &size);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int face = 0; face < 6; face++)
+    {
+        faces[face].resize((size_t)size * size * 3);
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, faces[face].data());
+    }
+    return size;
+}
+
+// projects the level of a (mipmapped) cube map with at most maxSize texels per side onto the SH basis. The irradiance
+// is smooth, a small level is as good as the full environment.
+SHCoefficients projectCubemapSH(GLuint cubemap, int maxSize = 64)
+{
+    GLint size = 0;
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+    int level = 0;
+    while ((size >> level) > maxSize) level++;
+
+    std::vector<float> faces[6];
+    size = readCubemapLevel(cubemap, level, faces);
+    const float* data[6] = { faces[0].data(), faces[1].data(), faces[2].data(), faces[3].data(), faces[4].data(), faces[5].data() };
+    return projectCubemapSH(data, size);
+}
+
+// difference between the SH irradiance and an irradiance cube map (over all texels of its level 0)
+struct SHError {
+    float rmse = 0.0f;        // root mean square error (per channel)
+    float relativeRmse = 0.0f; // rmse / mean irradiance
+    float maxRelative = 0.0f;  // largest |difference| / irradiance (of the luminance)
+};
+
+SHError compareSH(const SHCoefficients& sh, GLuint irradianceCubemap)
+{
+    std::vector<float> faces[6];
+    int size = readCubemapLevel(irradianceCubemap, 0, faces);
+    const glm::vec3 luminance(0.2126f, 0.7152f, 0.0722f);
+    double squares = 0.0, mean = 0.0;
+    SHError error;
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < size; y++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                float u = (x + 0.5f) * 2.0f / size - 1.0f, v = (y + 0.5f) * 2.0f / size - 1.0f;
+                glm::vec3 n = glm::normalize(CUBE_FACE_AXES[face][0] + u * CUBE_FACE_AXES[face][1] + v * CUBE_FACE_AXES[face][2]);
+                const float* p = faces[face].data() + ((size_t)y * size + x) * 3;
+                glm::vec3 reference(p[0], p[1], p[2]);
+                glm::vec3 difference = evaluateSH(sh, n) - reference;
+                squares += glm::dot(difference, difference) / 3.0;
+                mean += (reference.x + reference.y + reference.z) / 3.0;
+                float l = glm::dot(reference, luminance);
+                if (l > 1e-4f)
+                    error.maxRelative = std::max(error.maxRelative, std::abs(glm::dot(difference, luminance)) / l);
+            }
+        }
+    }
+    double n = 6.0 * size * size;
+    if (n > 0)
+    {
+        error.rmse = (float)std::sqrt(squares / n);
+        error.relativeRmse = mean > 0.0 ? (float)(error.rmse / (mean / n)) : 0.0f;
+    }
+    return error;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef SH_MATH_H
+#define SH_MATH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Diffuse irradiance as L2 spherical harmonics (9 RGB coefficients, see Ramamoorthi and Hanrahan, "An Efficient
+// Representation for Irradiance Environment Maps"). The coefficients are stored premultiplied with the basis constants
+// and the cosine lobe (divided by PI like the irradiance cube map of the IBL demo), so the shader only evaluates
+//   E(n) = c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z^2 - 1) + c7 xz + c8 (x^2 - y^2)
+// The projection works on floats in memory (no OpenGL, for the tools), util/sh.h reads cube maps back for it.
+struct SHCoefficients {
+    glm::vec4 coefficients[9]; // (rgb, w unused)
+};
+
+// basis constants of the 9 functions and the cosine lobe per band (A0 = PI, A1 = 2 PI / 3, A2 = PI / 4) divided by PI
+const float SH_BASIS[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+const float SH_LOBE[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+// direction through the center of a cube map texel: major axis + u * uAxis + v * vAxis (u, v in [-1, 1], see the
+// cube map face selection in the OpenGL specification), faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+const glm::vec3 CUBE_FACE_AXES[6][3] = {
+    { glm::vec3( 1, 0, 0), glm::vec3( 0, 0, -1), glm::vec3(0, -1,  0) },
+    { glm::vec3(-1, 0, 0), glm::vec3( 0, 0,  1), glm::vec3(0, -1,  0) },
+    { glm::vec3( 0, 1, 0), glm::vec3( 1, 0,  0), glm::vec3(0,  0,  1) },
+    { glm::vec3( 0,-1, 0), glm::vec3( 1, 0,  0), glm::vec3(0,  0, -1) },
+    { glm::vec3( 0, 0, 1), glm::vec3( 1, 0,  0), glm::vec3(0, -1,  0) },
+    { glm::vec3( 0, 0,-1), glm::vec3(-1, 0,  0), glm::vec3(0, -1,  0) },
+};
+
+// the premultiplied basis (see above) in direction n (normalized)
+inline void shBasis(const glm::vec3& n, float basis[9])
+{
+    basis[0] = 1.0f;
+    basis[1] = n.y;
+    basis[2] = n.z;
+    basis[3] = n.x;
+    basis[4] = n.x * n.y;
+    basis[5] = n.y * n.z;
+    basis[6] = 3.0f * n.z * n.z - 1.0f;
+    basis[7] = n.x * n.z;
+    basis[8] = n.x * n.x - n.y * n.y;
+}
+
+// irradiance / PI in direction n (the same as the shader)
+glm::vec3 evaluateSH(const SHCoefficients& sh, const glm::vec3& n)
+{
+    float basis[9];
+    shBasis(n, basis);
+    glm::vec3 e(0.0f);
+    for (int i = 0; i < 9; i++)
+        e += glm::vec3(sh.coefficients[i]) * basis[i];
+    return e;
+}
+
+// projects a cube map (6 faces of size x size RGB float texels, rows from t = 0) onto the SH basis. Every texel is
+// weighted by its solid angle; with SSE 4 texels of a row are projected at once.
+SHCoefficients projectCubemapSH(const float* const faces[6], int size)
+{
+    // (sum over the texels of radiance * Y_i(direction) * solid angle, per channel)
+    double sums[9][3] = {};
+    double totalWeight = 0.0;
+    const float texel = 2.0f / size;
+    for (int face = 0; face < 6; face++)
+    {
+        const glm::vec3& major = CUBE_FACE_AXES[face][0];
+        const glm::vec3& uAxis = CUBE_FACE_AXES[face][1];
+        const glm::vec3& vAxis = CUBE_FACE_AXES[face][2];
+        for (int y = 0; y < size; y++)
+        {
+            float v = (y + 0.5f) * texel - 1.0f;
+            const float* row = faces[face] + (size_t)y * size * 3;
+            float rowSums[9][3] = {};
+            float rowWeight = 0.0f;
+            int x = 0;
+#ifdef SH_USE_SSE
+            __m128 acc[9][3];
+            for (int i = 0; i < 9; i++)
+                for (int c = 0; c < 3; c++)
+                    acc[i][c] = _mm_setzero_ps();
+            __m128 accWeight = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f), three = _mm_set1_ps(3.0f), texelArea = _mm_set1_ps(texel * texel);
+            const __m128 baseX = _mm_set1_ps(major.x + v * vAxis.x), baseY = _mm_set1_ps(major.y + v * vAxis.y), baseZ = _mm_set1_ps(major.z + v * vAxis.z);
+            const __m128 uX = _mm_set1_ps(uAxis.x), uY = _mm_set1_ps(uAxis.y), uZ = _mm_set1_ps(uAxis.z);
+            for (; x + 4 <= size; x += 4)
+            {
+                __m128 u = _mm_set_ps((x + 3.5f) * texel - 1.0f, (x + 2.5f) * texel - 1.0f, (x + 1.5f) * texel - 1.0f, (x + 0.5f) * texel - 1.0f);
+                __m128 dx = _mm_add_ps(baseX, _mm_mul_ps(u, uX));
+                __m128 dy = _mm_add_ps(baseY, _mm_mul_ps(u, uY));
+                __m128 dz = _mm_add_ps(baseZ, _mm_mul_ps(u, uZ));
+                // |d|^2 = 1 + u^2 + v^2, the solid angle of the texel is texelArea / |d|^3
+                __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                __m128 length = _mm_sqrt_ps(length2);
+                __m128 inverseLength = _mm_div_ps(one, length);
+                __m128 weight = _mm_div_ps(texelArea, _mm_mul_ps(length2, length));
+                dx = _mm_mul_ps(dx, inverseLength);
+                dy = _mm_mul_ps(dy, inverseLength);
+                dz = _mm_mul_ps(dz, inverseLength);
+
+                __m128 basis[9] = {
+                    one, dy, dz, dx,
+                    _mm_mul_ps(dx, dy), _mm_mul_ps(dy, dz), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one),
+                    _mm_mul_ps(dx, dz), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))
+                };
+                const float* p = row + x * 3;
+                __m128 radiance[3] = {
+                    _mm_mul_ps(weight, _mm_set_ps(p[9], p[6], p[3], p[0])),
+                    _mm_mul_ps(weight, _mm_set_ps(p[10], p[7], p[4], p[1])),
+                    _mm_mul_ps(weight, _mm_set_ps(p[11], p[8], p[5], p[2]))
+                };
+                for (int i = 0; i < 9; i++)
+                    for (int c = 0; c < 3; c++)
+                        acc[i][c] = _mm_add_ps(acc[i][c], _mm_mul_ps(basis[i], radiance[c]));
+                accWeight = _mm_add_ps(accWeight, weight);
+            }
+            float lanes[4];
+            for (int i = 0; i < 9; i++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    _mm_storeu_ps(lanes, acc[i][c]);
+                    rowSums[i][c] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+                }
+            }
+            _mm_storeu_ps(lanes, accWeight);
+            rowWeight += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+            for (; x < size; x++) // (all texels without SSE)
+            {
+                float u = (x + 0.5f) * texel - 1.0f;
+                glm::vec3 d = major + u * uAxis + v * vAxis;
+                float length2 = glm::dot(d, d);
+                float weight = texel * texel / (length2 * std::sqrt(length2));
+                float basis[9];
+                shBasis(d / std::sqrt(length2), basis);
+                const float* p = row + x * 3;
+                for (int i = 0; i < 9; i++)
+                    for (int c = 0; c < 3; c++)
+                        rowSums[i][c] += basis[i] * weight * p[c];
+                rowWeight += weight;
+            }
+            for (int i = 0; i < 9; i++)
+                for (int c = 0; c < 3; c++)
+                    sums[i][c] += rowSums[i][c];
+            totalWeight += rowWeight;
+        }
+    }
+
+    // the solid angles of the texels add up to a bit less than 4 PI, normalize them. The premultiplied basis (see
+    // shBasis) already contains one basis constant, the projection needs the second one.
+    SHCoefficients sh;
+    double normalization = 4.0 * 3.14159265358979 / totalWeight;
+    for (int i = 0; i < 9; i++)
+    {
+        float scale = (float)normalization * SH_BASIS[i] * SH_BASIS[i] * SH_LOBE[i];
+        sh.coefficients[i] = glm::vec4((float)sums[i][0] * scale, (float)sums[i][1] * scale, (float)sums[i][2] * scale, 0.0f);
+    }
+    return sh;
+}
+
+#endif
@@ -2,9 +2,14 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+#include <util/filesystem.h>
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -15,8 +20,10 @@ private:
     std::string vPath = "";
     std::string fPath = "";
     std::string gPath = "";
+    std::string cPath = "";
+    std::string defines = ""; // (#define lines inserted after the #version of every stage)
 public:
-    unsigned int ID;
+    GLProgram ID; // (move-only, the program is deleted with the shader)
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
@@ -27,15 +34,37 @@ public:
         
         loadAndCompile(vPath, fPath, gPath, ID);
     }
+
+    // constructor of a variant of the shaders: every name in defines is #defined (e.g., "PACKED_ORM" or "SAMPLES 16")
+    // in all stages, right after their #version line
+    // ------------------------------------------------------------------------
+    Shader(const std::vector<std::string>& defineNames, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        for (const std::string& name : defineNames)
+            defines += "#define " + name + "\n";
+        if (vertexPath) vPath = std::string(vertexPath);
+        if (fragmentPath) fPath = std::string(fragmentPath);
+        if (geometryPath) gPath = std::string(geometryPath);
+
+        loadAndCompile(vPath, fPath, gPath, ID);
+    }
+
+    // constructor of a compute shader (dispatch it with glDispatchCompute after use)
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath)
+    {
+        cPath = std::string(computePath);
+        loadAndCompileCompute(cPath, ID);
+    }
      
     // try to reload and recompile the shder
     // ------------------------------------------------------------------------
     void reload()
     {
-        unsigned int newID;
-        if (loadAndCompile(vPath, fPath, gPath, newID))
+        GLProgram newID;
+        if (cPath.empty() ? loadAndCompile(vPath, fPath, gPath, newID) : loadAndCompileCompute(cPath, newID))
         {
-           ID = newID;
+           ID = std::move(newID); // deletes the previous program
         }
         else
         {
@@ -47,7 +76,7 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        glState().UseProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -137,7 +166,22 @@ private:
         return success;
     }
 
-    bool loadAndCompile(std::string vertexPath, std::string fragmentPath, std::string geometryPath, unsigned int &ID)
+    // inserts the defines after the #version line (the #line keeps the line numbers of the errors those of the file)
+    // ------------------------------------------------------------------------
+    void addDefines(std::string& code) const
+    {
+        if (defines.empty())
+            return;
+        size_t version = code.find("#version");
+        size_t line = version == std::string::npos ? 0 : code.find('\n', version);
+        if (line == std::string::npos)
+            return;
+        size_t at = version == std::string::npos ? 0 : line + 1;
+        int lineNumber = 1 + (int)std::count(code.begin(), code.begin() + at, '\n');
+        code.insert(at, defines + "#line " + std::to_string(lineNumber) + "\n");
+    }
+
+    bool loadAndCompile(std::string vertexPath, std::string fragmentPath, std::string geometryPath, GLProgram &program)
     {
         bool success = true;
 
@@ -145,43 +189,16 @@ private:
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if (!geometryPath.empty())
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        // (read through the FileSystem, so shaders in a mounted asset pack are found there)
+        if (!FileSystem::readText(vertexPath, vertexCode) || !FileSystem::readText(fragmentPath, fragmentCode) ||
+            (!geometryPath.empty() && !FileSystem::readText(geometryPath, geometryCode)))
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
             return false;
         }
+        addDefines(vertexCode);
+        addDefines(fragmentCode);
+        addDefines(geometryCode);
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -207,13 +224,13 @@ private:
             success = success && checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        program = createProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
         if (!geometryPath.empty())
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        success = success && checkCompileErrors(ID, "PROGRAM");
+            glAttachShader(program, geometry);
+        glLinkProgram(program);
+        success = success && checkCompileErrors(program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -224,5 +241,27 @@ private:
         return success;
     }
 
+    bool loadAndCompileCompute(std::string computePath, GLProgram &program)
+    {
+        std::string computeCode;
+        if (!FileSystem::readText(computePath, computeCode))
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            return false;
+        }
+        addDefines(computeCode);
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        bool success = checkCompileErrors(compute, "COMPUTE");
+        program = createProgram();
+        glAttachShader(program, compute);
+        glLinkProgram(program);
+        success = success && checkCompileErrors(program, "PROGRAM");
+        glDeleteShader(compute);
+        return success;
+    }
+
 };
 #endif
@@ -2,6 +2,7 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <util/glstate.h>
 
 #include <string>
 #include <fstream>
@@ -72,7 +73,7 @@ public:
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        glState().UseProgram(ID); 
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
@@ -0,0 +1,194 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <util/glstate.h>
+#include <util/gl_handles.h>
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <chrono> // for timing
+
+// per frame constants as stored in the uniform buffer at FRAME_DATA_BINDING (std140 layout):
+//   layout (std140, binding = 0) uniform FrameData { mat4 view; mat4 projection; mat4 viewProjection; vec4 viewPos; vec4 time; };
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos;
+    glm::vec4 time; // x: seconds since start, y: delta time
+};
+const GLuint FRAME_DATA_BINDING = 0;
+
+// One buffer split into UNIFORM_RING_FRAMES regions; every frame writes its constants (frame data, lights, per draw
+// data, ...) linearly into the next region and binds them with glBindBufferRange. A fence per region makes sure the
+// GPU is done with a region before it is overwritten, so nothing is ever orphaned or synchronized by the driver.
+// With OpenGL 4.4 (glBufferStorage) the buffer is persistently mapped (coherent) and data is written with a
+// plain memcpy, otherwise every write is a glBufferSubData into the (fenced, so unused) region.
+const unsigned int UNIFORM_RING_FRAMES = 3;
+
+class UniformRing {
+public:
+    // statistics of the last frame
+    struct Stats {
+        size_t bytesUsed = 0;
+        unsigned int allocations = 0;
+        unsigned int fenceWaits = 0; // the CPU got ahead of the GPU by UNIFORM_RING_FRAMES frames
+        float fenceWaitMs = 0.0f;
+    } stats, lastStats;
+
+    // allocates the buffer (bytesPerFrame per region), needs a current OpenGL context
+    void Init(size_t bytesPerFrame)
+    {
+        if (buffer)
+            return;
+        GLint uniformAlignment = 256, storageAlignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+        alignment = (size_t)std::max(uniformAlignment, storageAlignment);
+        regionSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+        size_t size = regionSize * UNIFORM_RING_FRAMES;
+
+        buffer = createBuffer();
+        glState().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        persistent = GLAD_GL_VERSION_4_4 != 0;
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+            persistent = mapped != nullptr;
+        }
+        if (!persistent)
+        {
+            std::cout << "UniformRing: persistent mapping not available, using glBufferSubData" << std::endl;
+            buffer = createBuffer(); // (a buffer with immutable storage can't be resized)
+            glState().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        }
+    }
+
+    bool Ready() const { return (bool)buffer; }
+    bool Persistent() const { return persistent; }
+    GLuint Buffer() const { return buffer; }
+    size_t BytesPerFrame() const { return regionSize; }
+    // increases every frame (allocations of an older frame are no longer valid)
+    unsigned long long FrameNumber() const { return frameNumber; }
+
+    // moves on to the next region and waits until the GPU is done with it
+    void BeginFrame()
+    {
+        lastStats = stats;
+        stats = Stats();
+        frameNumber++;
+        region = frameNumber % UNIFORM_RING_FRAMES;
+        head = region * regionSize;
+
+        GLsync& fence = fences[region];
+        if (fence != 0)
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+                stats.fenceWaits++;
+                stats.fenceWaitMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // marks the end of the commands that read the current region (call after the last draw of the frame)
+    void EndFrame()
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // copies size bytes into the current region and returns their offset in the buffer (aligned for uniform and
+    // shader storage buffer bindings). Returns -1 if the region is full.
+    GLintptr Push(const void* data, size_t size)
+    {
+        size_t end = (region + 1) * regionSize;
+        if (head + size > end)
+        {
+            std::cout << "UniformRing: out of space (" << regionSize << " bytes per frame)" << std::endl;
+            return -1;
+        }
+        GLintptr offset = (GLintptr)head;
+        if (persistent)
+            std::memcpy(mapped + head, data, size);
+        else
+        {
+            glState().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        }
+        head = std::min(end, (head + size + alignment - 1) / alignment * alignment);
+        stats.bytesUsed += size;
+        stats.allocations++;
+        return offset;
+    }
+
+    template <class T>
+    GLintptr Push(const T& value) { return Push(&value, sizeof(T)); }
+
+    template <class T>
+    GLintptr Push(const std::vector<T>& values) { return Push(values.data(), values.size() * sizeof(T)); }
+
+    // binds size bytes at offset (as returned by Push) to the indexed binding point of target
+    // (GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER)
+    void Bind(GLenum target, GLuint index, GLintptr offset, size_t size)
+    {
+        if (offset >= 0)
+            glState().BindBufferRange(target, index, buffer, offset, (GLsizeiptr)size);
+    }
+
+    // pushes value and binds it
+    template <class T>
+    GLintptr PushAndBind(GLenum target, GLuint index, const T& value)
+    {
+        GLintptr offset = Push(value);
+        Bind(target, index, offset, sizeof(T));
+        return offset;
+    }
+
+private:
+    GLBuffer buffer;
+    unsigned char* mapped = nullptr;
+    bool persistent = false;
+    size_t alignment = 256;
+    size_t regionSize = 0;
+    size_t head = 0;
+    unsigned int region = 0;
+    unsigned long long frameNumber = 0;
+    GLsync fences[UNIFORM_RING_FRAMES] = {};
+};
+
+// the (global) ring buffer for per frame data. Call Init once (after the window is created), then
+// BeginFrame/EndFrame around the commands of every frame. Until Init is called the helpers in util/
+// (e.g., the DrawList) upload their data into buffers of their own.
+UniformRing& uniformRing()
+{
+    static UniformRing ring;
+    return ring;
+}
+
+// pushes the per frame constants of the camera and binds them to FRAME_DATA_BINDING
+void bindFrameData(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, float time = 0.0f, float deltaTime = 0.0f)
+{
+    FrameData data;
+    data.view = view;
+    data.projection = projection;
+    data.viewProjection = projection * view;
+    data.viewPos = glm::vec4(viewPos, 1.0f);
+    data.time = glm::vec4(time, deltaTime, 0.0f, 0.0f);
+    uniformRing().PushAndBind(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, data);
+}
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <GLFW/glfw3.h>
+
+#include <util/glstate.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <chrono> // for timing
+
+// state of a job on the upload thread. done is set on the main thread (in UploadThread::Update) once the GPU has
+// finished the job, from then on the objects it created can be used by the main context.
+struct UploadTicket {
+    std::atomic<bool> done{ false };
+    std::atomic<bool> failed{ false }; // the upload thread isn't running, the job was dropped
+    float uploadMs = 0.0f;            // time the job took on the upload thread
+    size_t bytes = 0;                 // bytes the job uploaded
+};
+
+// Creates OpenGL objects on a second thread. The thread owns a context (of a hidden window) that shares its objects with
+// the main window, so buffer and texture uploads (and mipmap generation) don't stall the render loop. A job ends with a
+// fence; the main thread polls the fences in Update and marks the tickets done, only then it may use the objects.
+// The upload context has its own state, so the jobs bind through glState() like everywhere else (the cache is per
+// thread). Objects that hold other objects (VAOs, FBOs) are not shared, create those on the main thread.
+class UploadThread {
+public:
+    // runs on the upload thread (with its context current) and returns the number of bytes it uploaded
+    typedef std::function<size_t()> Job;
+
+    struct Stats {
+        unsigned int queued = 0;   // jobs waiting for the upload thread
+        unsigned int fenced = 0;   // jobs waiting for the GPU
+        unsigned int completed = 0;
+        size_t bytes = 0;          // uploaded since the start
+        float lastUploadMs = 0.0f; // time on the upload thread
+        float maxUploadMs = 0.0f;
+    };
+
+    ~UploadThread() { Stop(); }
+
+    // creates the upload context sharing with the context of shared and starts the thread (call on the main thread,
+    // GLFW windows can only be created there). Returns false if the context couldn't be created, Enqueue fails then.
+    bool Start(GLFWwindow* shared)
+    {
+        if (thread.joinable())
+            return true;
+        // (the other hints are still the ones of the main window, so the contexts match)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        context = glfwCreateWindow(1, 1, "upload", NULL, shared);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (context == NULL)
+        {
+            std::cout << "UploadThread: failed to create the upload context, uploading on the main thread" << std::endl;
+            return false;
+        }
+        stopping = false;
+        thread = std::thread([this] { work(); });
+        return true;
+    }
+
+    // finishes the queued jobs, stops the thread and destroys its context (call on the main thread before glfwTerminate)
+    void Stop()
+    {
+        if (!thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        thread.join();
+        fenced.insert(fenced.end(), submitted.begin(), submitted.end());
+        submitted.clear();
+        for (Fenced& f : fenced)
+        {
+            glDeleteSync(f.fence);
+            f.ticket->done = true;
+        }
+        fenced.clear();
+        glfwDestroyWindow(context);
+        context = nullptr;
+    }
+
+    bool Running() const { return thread.joinable(); }
+
+    // queues a job, the ticket is done once its objects can be used on the main thread
+    std::shared_ptr<UploadTicket> Enqueue(Job job)
+    {
+        auto ticket = std::make_shared<UploadTicket>();
+        if (!Running())
+        {
+            ticket->failed = true;
+            return ticket;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back({ std::move(job), ticket });
+        }
+        wakeUp.notify_one();
+        return ticket;
+    }
+
+    // publishes the jobs the GPU has finished (call once per frame on the main thread, does not wait)
+    void Update()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Fenced& f : submitted)
+                fenced.push_back(std::move(f));
+            submitted.clear();
+        }
+        // (the fences are signaled in order)
+        while (!fenced.empty())
+        {
+            GLenum result = glClientWaitSync(fenced.front().fence, 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(fenced.front().fence);
+            fenced.front().ticket->done = true;
+            fenced.pop_front();
+        }
+    }
+
+    Stats GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats s = stats;
+        s.queued = (unsigned int)jobs.size();
+        s.fenced = (unsigned int)(submitted.size() + fenced.size());
+        return s;
+    }
+
+private:
+    struct Queued {
+        Job job;
+        std::shared_ptr<UploadTicket> ticket;
+    };
+    struct Fenced {
+        GLsync fence;
+        std::shared_ptr<UploadTicket> ticket;
+    };
+
+    GLFWwindow* context = nullptr;
+    std::thread thread;
+    mutable std::mutex mutex; // guards everything below but fenced (main thread only)
+    std::condition_variable wakeUp;
+    std::deque<Queued> jobs;
+    std::vector<Fenced> submitted;
+    bool stopping = false;
+    Stats stats;
+    std::deque<Fenced> fenced;
+
+    void work()
+    {
+        glfwMakeContextCurrent(context);
+        for (;;)
+        {
+            Queued queued;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    break; // (stopping)
+                queued = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            size_t bytes = 0;
+            try
+            {
+                bytes = queued.job();
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << "UploadThread: upload failed: " << e.what() << std::endl;
+            }
+            queued.job = nullptr; // (releases what the job holds here, not on the main thread)
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush(); // (the fence has to reach the GPU, the main thread doesn't flush this context)
+            float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            queued.ticket->uploadMs = ms;
+            queued.ticket->bytes = bytes;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            submitted.push_back({ fence, std::move(queued.ticket) });
+            stats.completed++;
+            stats.bytes += bytes;
+            stats.lastUploadMs = ms;
+            stats.maxUploadMs = std::max(stats.maxUploadMs, ms);
+        }
+        glFinish();
+        glfwMakeContextCurrent(NULL);
+    }
+};
+
+// the (global) upload thread, not running until Start is called
+UploadThread& uploadThread()
+{
+    static UploadThread upload;
+    return upload;
+}
+
+#endif
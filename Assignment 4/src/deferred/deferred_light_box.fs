@@ -1,10 +1,10 @@
-#version 330 core
+#version 430 core
 layout (location = 0) out vec4 FragColor;
 
-uniform vec3 lightColor;
+flat in vec3 LightColor;
 uniform float alpha;
 
 void main()
 {           
-    FragColor = vec4(lightColor, alpha);
+    FragColor = vec4(LightColor, alpha);
 }
\ No newline at end of file
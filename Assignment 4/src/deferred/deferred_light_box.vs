@@ -1,13 +1,33 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+flat out vec3 LightColor;
+
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 time;
+};
+
+struct Light {
+    vec4 Position;
+    vec4 Color;
+};
+const int MAX_LIGHTS = 128;
+layout (std140, binding = 1) uniform LightData {
+    Light lights[MAX_LIGHTS];
+    int numLights;
+};
+
+uniform float scale;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    // one instance per light
+    LightColor = lights[gl_InstanceID].Color.rgb;
+    gl_Position = viewProjection * vec4(lights[gl_InstanceID].Position.xyz + aPos * scale, 1.0);
+}
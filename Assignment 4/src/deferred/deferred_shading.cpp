@@ -9,8 +9,11 @@
 #include <util/shader.h>
 #include <util/camera.h>
 #include <util/model.h>
+#include <util/render_queue.h>
+#include <util/uniform_ring.h>
 #include <util/assets.h>
 #include <util/window.h>
+#include <util/primitives.h>
 
 #include <iostream>
 
@@ -20,8 +23,6 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 //unsigned int loadTexture(const char *path, bool gammaCorrection);
-void renderQuad();
-void renderCube();
 
 // settings
 int SCR_WIDTH = 1280;
@@ -41,6 +42,18 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 
+// lights as stored in the uniform buffer at binding 1 (std140 layout, see deferred_shading.fs)
+const unsigned int MAX_LIGHTS = 128;
+struct LightData {
+    struct {
+        glm::vec4 position;
+        glm::vec4 color;
+    } lights[MAX_LIGHTS];
+    GLint numLights;
+    GLint pad[3];
+};
+const GLuint LIGHT_DATA_BINDING = 1;
+
 const char* APP_NAME = "Assignment4";
 int main()
 {
@@ -51,6 +64,19 @@ int main()
     int numLights = 32;
     float lightboxAlpha = 0.5;
     float gamma = 1.6;
+    // Settings for the level of detail selection
+    int gridSize = 3; // gridSize x gridSize instances of the model
+    bool useLods = true;
+    bool showLods = false;
+    float lodPixelError = 1.0f;
+    // Settings for the cluster culling (of the full detail level)
+    bool clusterCulling = true;
+    ClusterCuller culler;
+    // sample the input again right before the geometry is submitted
+    bool lateLatch = true;
+    // how far culling looks past the frame start camera when it is late latched (the camera may still turn and move)
+    const float LATE_LATCH_FOV_MARGIN = 5.0f; // degrees
+    const float LATE_LATCH_MARGIN = 0.25f;    // world units
 
     // glfw: initialize and configure
 // ------------------------------
@@ -74,7 +100,9 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
+    // per frame constants, lights and per draw data are streamed through a (triple buffered) ring buffer
+    uniformRing().Init(4 * 1024 * 1024);
 
     // build and compile shaders
     // -------------------------
@@ -88,45 +116,37 @@ int main()
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     // * backback * 
     //stbi_set_flip_vertically_on_load(true);
-    Model myModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"), true);
+    // (the LOD chain and the clusters of every mesh are generated at load time)
+    Model myModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"), true, false, true, true);
 
     // * Z2 (NASA space suite) * turn of flipping (stbi_set_flip_vertically_on_load) for the space suite!
-    //Model myModel(FileSystem::getPath("resources/objects/Z2/Z2.obj"), true);
+    //Model myModel(FileSystem::getPath("resources/objects/Z2/Z2.obj"), true, false, true, true);
     std::vector<glm::vec3> objectPositions;
-    objectPositions.push_back(glm::vec3(-3.0,  -0.5, -3.0));
-    objectPositions.push_back(glm::vec3( 0.0,  -0.5, -3.0));
-    objectPositions.push_back(glm::vec3( 3.0,  -0.5, -3.0));
-    objectPositions.push_back(glm::vec3(-3.0,  -0.5,  0.0));
-    objectPositions.push_back(glm::vec3( 0.0,  -0.5,  0.0));
-    objectPositions.push_back(glm::vec3( 3.0,  -0.5,  0.0));
-    objectPositions.push_back(glm::vec3(-3.0,  -0.5,  3.0));
-    objectPositions.push_back(glm::vec3( 0.0,  -0.5,  3.0));
-    objectPositions.push_back(glm::vec3( 3.0,  -0.5,  3.0));
 
 
     // configure g-buffer framebuffer
     // ------------------------------
     unsigned int gBuffer;
     glGenFramebuffers(1, &gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
     unsigned int gPosition, gNormal, gAlbedoSpec;
     // position color buffer
     glGenTextures(1, &gPosition);
-    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glState().BindTexture(GL_TEXTURE_2D, gPosition);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
     // normal color buffer
     glGenTextures(1, &gNormal);
-    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glState().BindTexture(GL_TEXTURE_2D, gNormal);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
     // color + specular color buffer
     glGenTextures(1, &gAlbedoSpec);
-    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glState().BindTexture(GL_TEXTURE_2D, gAlbedoSpec);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -143,11 +163,11 @@ int main()
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // lighting info
     // -------------
-    const unsigned int NR_LIGHTS = 128; // up to 128 (in shader)
+    const unsigned int NR_LIGHTS = MAX_LIGHTS; // up to 128 (in shader)
     std::vector<glm::vec3> lightPositions;
     std::vector<glm::vec3> lightColors;
     std::vector<glm::vec4> lightDirs;
@@ -179,6 +199,11 @@ int main()
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedoSpec", 2);
 
+    LightData lightData = {};
+    unsigned int trianglesDrawn = 0;
+    ClusterCullStats cullStats;
+    RenderQueue renderQueue;
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -188,6 +213,8 @@ int main()
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        glState().BeginFrame();
+        uniformRing().BeginFrame();
 
         // Poll and handle events (inputs, window resize, etc.)
         glfwPollEvents();
@@ -212,6 +239,26 @@ int main()
                 ImGui::SliderInt("number of lights", &numLights, 1.0f, 128.0f);
                 ImGui::SliderFloat("lightbox alpha", &lightboxAlpha, 0.0f, 1.0f );
 
+                ImGui::SliderInt("instance grid", &gridSize, 1, 30);
+                ImGui::Checkbox("use LODs", &useLods);
+                ImGui::SliderFloat("LOD pixel error", &lodPixelError, 0.25f, 16.0f);
+                ImGui::Checkbox("color by LOD", &showLods);
+                ImGui::Text("triangles: %u (full detail: %u)", trianglesDrawn, myModel.NumTriangles() * (unsigned int)objectPositions.size());
+                ImGui::Checkbox("cluster culling", &clusterCulling);
+                if (clusterCulling) {
+                    ImGui::Checkbox("frustum culling", &culler.frustumCulling);
+                    ImGui::SameLine();
+                    ImGui::Checkbox("cone culling", &culler.coneCulling);
+                    ImGui::Text("clusters: %u / %u", cullStats.clustersSubmitted, cullStats.clustersTotal);
+                    ImGui::Text("triangles in view: %u, submitted: %u", cullStats.trianglesInView, cullStats.trianglesSubmitted);
+                }
+                ImGui::Text("draws: %u, multi-draw calls: %u", renderQueue.stats.items, renderQueue.stats.batches);
+                ImGui::Text("program changes: %u, material changes: %u (unsorted: %u)", renderQueue.stats.programChanges, renderQueue.stats.materialChanges, renderQueue.stats.materialChangesUnsorted);
+                ImGui::Text("GL state calls: %u issued, %u elided", glState().lastFrame.issued, glState().lastFrame.elided);
+                ImGui::Text("uniform ring: %.1f KB per frame%s, fence waits: %u (%.2f ms)", uniformRing().lastStats.bytesUsed / 1024.0f,
+                            uniformRing().Persistent() ? " (persistent)" : "", uniformRing().lastStats.fenceWaits, uniformRing().lastStats.fenceWaitMs);
+                ImGui::Checkbox("late latch camera", &lateLatch);
+
                 ImGui::Checkbox("display GBuffers", &displayGBuffers);
                 if (displayGBuffers)
                     ImGui::SliderInt("show GBuffer", &gBufferToDisplay, 0, 2);
@@ -232,6 +279,15 @@ int main()
             ImGui::Render();
         }
 
+        // place the instances on a regular grid (3 units apart)
+        if (objectPositions.size() != (size_t)gridSize * gridSize)
+        {
+            objectPositions.clear();
+            for (int z = 0; z < gridSize; z++)
+                for (int x = 0; x < gridSize; x++)
+                    objectPositions.push_back(glm::vec3((x - (gridSize - 1) * 0.5f) * 3.0f, -0.5f, (z - (gridSize - 1) * 0.5f) * 3.0f));
+        }
+
         // render
         // ------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -239,95 +295,116 @@ int main()
 
         // 1. geometry pass: render scene's geometry/color data into gbuffer
         // -----------------------------------------------------------------
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, gBuffer);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
             glm::mat4 view = camera.GetViewMatrix();
+            // culling uses the camera of the start of the frame; with late latching against a wider frustum (and grown
+            // bounds), so the clusters the latched camera turns or moves towards are still drawn
+            glm::mat4 cullProjection = projection;
+            if (lateLatch)
+                cullProjection = glm::perspective(glm::radians(camera.Zoom + LATE_LATCH_FOV_MARGIN), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            culler.margin = lateLatch ? LATE_LATCH_MARGIN : 0.0f;
             glm::mat4 model = glm::mat4(1.0f);
             shaderGeometryPass.use();
-            shaderGeometryPass.setMat4("projection", projection);
-            shaderGeometryPass.setMat4("view", view);
+            shaderGeometryPass.setBool("showLod", showLods);
+            trianglesDrawn = 0;
+            cullStats = ClusterCullStats();
+            renderQueue.Begin(camera.Position);
             for (unsigned int i = 0; i < objectPositions.size(); i++)
             {
                 model = glm::mat4(1.0f);
                 model = glm::translate(model, objectPositions[i]);
                 model = glm::scale(model, glm::vec3(0.5f));
-                shaderGeometryPass.setMat4("model", model);
-                myModel.Draw(shaderGeometryPass);
+                // pick the level of detail from the projected (screen space) error
+                unsigned int lod = useLods ? myModel.SelectLod(model, camera.Position, glm::radians(camera.Zoom), SCR_HEIGHT, lodPixelError) : 0;
+                if (clusterCulling && lod == 0)
+                {
+                    // only the clusters inside the frustum and facing the camera are drawn (clusters exist for level 0 only)
+                    unsigned int submitted = cullStats.trianglesSubmitted;
+                    culler.setup(cullProjection * view, model, camera.Position);
+                    renderQueue.Add(shaderGeometryPass, myModel, model, culler, cullStats);
+                    trianglesDrawn += cullStats.trianglesSubmitted - submitted;
+                }
+                else
+                {
+                    renderQueue.Add(shaderGeometryPass, myModel, model, lod);
+                    trianglesDrawn += myModel.NumTriangles(lod);
+                }
             }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (lateLatch)
+            {
+                // late latching: the culling and the LOD selection above used the camera of the start of the frame, the
+                // view written into the frame constants is taken from the newest input (which shortens the input to
+                // display latency)
+                glfwPollEvents();
+                float now = glfwGetTime();
+                deltaTime = now - lastFrame;
+                lastFrame = now;
+                processInput(window);
+                view = camera.GetViewMatrix();
+            }
+            bindFrameData(view, projection, camera.Position, currentFrame, deltaTime);
+            // all instances (and clusters) are sorted (by state, then front to back) and drawn from the geometry arena with multi-draw-indirect
+            renderQueue.Submit();
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // the G-buffer textures are read by both the debug view and the lighting pass
+        glState().BindTextureUnit(0, GL_TEXTURE_2D, gPosition);
+        glState().BindTextureUnit(1, GL_TEXTURE_2D, gNormal);
+        glState().BindTextureUnit(2, GL_TEXTURE_2D, gAlbedoSpec);
 
         if (displayGBuffers)
         {
             shaderDebug.use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, gPosition);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, gNormal);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
             shaderDebug.setInt("fboAttachment", gBufferToDisplay);
-            renderQuad();
+            primitives().Draw(PRIMITIVE_QUAD);
         }
         else
         {
             // 2. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
             // -----------------------------------------------------------------------------------------------------------------------
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            shaderLightingPass.use();
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, gPosition);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, gNormal);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-            // send light relevant uniforms
-            for (unsigned int i = 0; i < lightPositions.size(); i++)
+            // the lights are written into the ring buffer once and read by the lighting pass and the light boxes
+            for (unsigned int i = 0; i < (unsigned int)numLights; i++)
             {
                 glm::vec3 pos = lightPositions[i];
                 if (animateLights) pos += glm::vec3(lightDirs[i]) * std::sinf(currentFrame + lightDirs[i].w);
-                shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Position", pos);
-                shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+                lightData.lights[i].position = glm::vec4(pos, 1.0f);
+                lightData.lights[i].color = glm::vec4(lightColors[i], 1.0f);
             }
-            shaderLightingPass.setVec3("viewPos", camera.Position);
-            shaderLightingPass.setInt("numLights", numLights);
+            lightData.numLights = numLights;
+            uniformRing().PushAndBind(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, lightData);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shaderLightingPass.use();
             shaderLightingPass.setFloat("gamma", gamma);
             // finally render quad
-            renderQuad();
+            primitives().Draw(PRIMITIVE_QUAD);
 
             // 2.5. copy content of geometry's depth buffer to default framebuffer's depth buffer
             // ----------------------------------------------------------------------------------
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
+            glState().BindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+            glState().BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
             // blit to default framebuffer. Note that this may or may not work as the internal formats of both the FBO and default framebuffer have to match.
             // the internal formats are implementation defined. This works on all of my systems, but if it doesn't on yours you'll likely have to write to the 		
             // depth buffer in another shader stage (or somehow see to match the default framebuffer's internal format with the FBO's internal format).
             glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
             // 3. render lights on top of scene
             // --------------------------------
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_BACK);
+            glState().Enable(GL_BLEND);
+            glState().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glState().Enable(GL_CULL_FACE);
+            glState().CullFace(GL_BACK);
             shaderLightBox.use();
-            shaderLightBox.setMat4("projection", projection);
-            shaderLightBox.setMat4("view", view);
             shaderLightBox.setFloat("alpha", lightboxAlpha);
-            for (unsigned int i = 0; i < numLights; i++)
-            {
-                glm::vec3 pos = lightPositions[i];
-                if (animateLights) pos += glm::vec3(lightDirs[i]) * std::sinf(currentFrame + lightDirs[i].w);
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, pos);
-                model = glm::scale(model, glm::vec3(0.125f));
-                shaderLightBox.setMat4("model", model);
-                shaderLightBox.setVec3("lightColor", lightColors[i]);
-                renderCube();
-            }
-            glDisable(GL_BLEND);
+            shaderLightBox.setFloat("scale", 0.125f);
+            // one instance per light (position and color are read from the light buffer)
+            primitives().Draw(PRIMITIVE_CUBE, 0, numLights);
+            glState().Disable(GL_BLEND);
         }
+        uniformRing().EndFrame();
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -340,113 +417,6 @@ int main()
     return 0;
 }
 
-// renderCube() renders a 1x1 3D cube in NDC.
-// -------------------------------------------------
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
-void renderCube()
-{
-    // initialize (if necessary)
-    if (cubeVAO == 0)
-    {
-        float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-            // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-            // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-             1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-        };
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex attributes
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-    }
-    // render Cube
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-}
-
-
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -470,7 +440,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    glState().Viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
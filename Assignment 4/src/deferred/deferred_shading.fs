@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
 in vec2 TexCoords;
@@ -8,14 +8,23 @@ uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
 uniform float gamma;
 
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 time;
+};
+
 struct Light {
-    vec3 Position;
-    vec3 Color;
+    vec4 Position;
+    vec4 Color;
 };
 const int MAX_LIGHTS = 128;
-uniform Light lights[MAX_LIGHTS];
-uniform vec3 viewPos;
-uniform int numLights;
+layout (std140, binding = 1) uniform LightData {
+    Light lights[MAX_LIGHTS];
+    int numLights;
+};
 
 void main()
 {             
@@ -27,19 +36,19 @@ void main()
 
     // then calculate lighting as usual
     vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
-    vec3 viewDir  = normalize(viewPos - FragPos);
+    vec3 viewDir  = normalize(viewPos.xyz - FragPos);
 
     for(int i = 0; i < numLights; ++i)
     {
         // diffuse
-        vec3 lightDir = normalize(lights[i].Position - FragPos);
-        vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lights[i].Color;
+        vec3 lightDir = normalize(lights[i].Position.xyz - FragPos);
+        vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lights[i].Color.rgb;
         // specular
         vec3 halfwayDir = normalize(lightDir + viewDir);  
         float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-        vec3 specular = lights[i].Color * spec * Specular;
+        vec3 specular = lights[i].Color.rgb * spec * Specular;
         // attenuation
-        float distance = length(lights[i].Position - FragPos);
+        float distance = length(lights[i].Position.xyz - FragPos);
         float attenuation = 1.0 / (1.0 + distance * distance);
         diffuse *= attenuation;
         specular *= attenuation;
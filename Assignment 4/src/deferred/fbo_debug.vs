@@ -1,7 +1,7 @@
 // vertex shader
 #version 330 core
 layout (location = 0) in vec2 position;
-layout (location = 1) in vec2 texCoords;
+layout (location = 2) in vec2 texCoords;
 
 out vec2 TexCoords;
 
@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 layout (location = 0) out vec3 gPosition;
 layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec4 gAlbedoSpec;
@@ -6,23 +6,60 @@ layout (location = 2) out vec4 gAlbedoSpec;
 in mat3 TBN;
 in vec2 TexCoords;
 in vec3 FragPos;
+flat in uint Lod;
+flat in uint Material;
 
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_specular1;
-uniform sampler2D texture_normal1;
+// material table (see util/material.h)
+struct MaterialData {
+    uint diffuse; // texture references: (pool << 16) | layer, 0xFFFFFFFF if not set
+    uint specular;
+    uint normal;
+    uint height;
+    vec4 baseColor;
+};
+layout (std430, binding = 1) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+layout (binding = 8) uniform sampler2DArray materialTextures[8];
+
+vec4 sampleMaterialTexture(uint reference, vec2 uv, vec4 fallback)
+{
+    if (reference == 0xFFFFFFFFu)
+        return fallback;
+    vec3 coord = vec3(uv, float(reference & 0xFFFFu));
+    // (the pool is the same for all fragments of a draw, so a switch over constant indices is fine)
+    switch (reference >> 16)
+    {
+        case 0u: return texture(materialTextures[0], coord);
+        case 1u: return texture(materialTextures[1], coord);
+        case 2u: return texture(materialTextures[2], coord);
+        case 3u: return texture(materialTextures[3], coord);
+        case 4u: return texture(materialTextures[4], coord);
+        case 5u: return texture(materialTextures[5], coord);
+        case 6u: return texture(materialTextures[6], coord);
+        default: return texture(materialTextures[7], coord);
+    }
+}
+
+// debug view: tint the albedo by the level of detail
+uniform bool showLod;
+const vec3 lodColors[5] = vec3[](vec3(1.0, 1.0, 1.0), vec3(0.2, 1.0, 0.2), vec3(0.2, 0.4, 1.0), vec3(1.0, 1.0, 0.2), vec3(1.0, 0.2, 0.2));
 
 void main()
 {    
     // store the fragment position vector in the first gbuffer texture
     gPosition = FragPos;
     // also store the per-fragment normals into the gbuffer
-    gNormal = texture(texture_normal1, TexCoords).rgb;
+    MaterialData material = materials[Material];
+    gNormal = sampleMaterialTexture(material.normal, TexCoords, vec4(0.5, 0.5, 1.0, 1.0)).rgb;
     gNormal = gNormal * 2.0 - 1.0;
     gNormal = TBN * gNormal;
     //gNormal = normalize(gNormal).rgb;
     gNormal = normalize(gNormal);
     // and the diffuse per-fragment color
-    gAlbedoSpec.rgb = texture(texture_diffuse1, TexCoords).rgb;
+    gAlbedoSpec.rgb = sampleMaterialTexture(material.diffuse, TexCoords, material.baseColor).rgb;
+    if (showLod)
+        gAlbedoSpec.rgb = mix(gAlbedoSpec.rgb, lodColors[min(Lod, 4u)], 0.7);
     // store specular intensity in gAlbedoSpec's alpha component
-    gAlbedoSpec.a = texture(texture_specular1, TexCoords).r;
+    gAlbedoSpec.a = sampleMaterialTexture(material.specular, TexCoords, vec4(0.0)).r;
 }
\ No newline at end of file
@@ -1,20 +1,43 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+layout (location = 5) in uint aDrawId;
 
 out vec3 FragPos;
 out vec2 TexCoords;
 out mat3 TBN;
+flat out uint Lod;
+flat out uint Material;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per draw data of the draw list (see util/draw_list.h)
+struct DrawData {
+    mat4 model;
+    uint lod;
+    uint material;
+    uint pad0;
+    uint pad1;
+};
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+// per frame constants (see util/uniform_ring.h)
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 time;
+};
 
 void main()
 {
+    mat4 model = draws[aDrawId].model;
+    Lod = draws[aDrawId].lod;
+    Material = draws[aDrawId].material;
     vec4 worldPos = model * vec4(aPos, 1.0);
     FragPos = worldPos.xyz; 
     TexCoords = aTexCoords;
@@ -26,5 +49,5 @@ void main()
     vec3 N = normalize(normalMatrix * aNormal);
     TBN = mat3(T, B, N);
 
-    gl_Position = projection * view * worldPos;
+    gl_Position = viewProjection * worldPos;
 }
\ No newline at end of file
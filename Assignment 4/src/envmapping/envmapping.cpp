@@ -45,7 +45,7 @@ bool rightButtonDown = false;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-unsigned int cubeTexture;
+AssetHandle<Tex> cubeTexture;
 int cubeTextureID;
 int shaderMode = 0;
 bool rotateModel = false;
@@ -125,7 +125,7 @@ AssetManager skyboxes({
 void loadCubemap() {
 
 	glGenTextures(1, &cubeTexture);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTexture);
+	glState().BindTexture(GL_TEXTURE_CUBE_MAP, cubeTexture);
 
 	std::string faces[6] = { "right", "left","top","bottom","front","back" };
 
@@ -157,6 +157,10 @@ int main() {
 	// glfw: initialize and configure
 	// ------------------------------
 	InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME);
+	// the assets of the demo are read from its pack if there is one (see src/tools/packer), otherwise from their files
+	FileSystem::mount("../resources/packs/envmapping.pack");
+	// create the OpenGL objects of the assets on a second (shared) context, see util/upload_thread.h
+	uploadThread().Start(window);
 
 	SetCursorPosCallback(mouse_callback);
 	SetMouseButtonCallback(mouse_button_callback);
@@ -164,21 +168,24 @@ int main() {
 	SetFramebufferSizeCallback(framebuffer_size_callback);
 
 	skyboxes.SetActiveGroup("beach");
-	cubeTexture = skyboxes.GetActiveAsset<Tex>("cubemap");
+	cubeTexture = skyboxes.FindActiveTexture("cubemap");
 
 	Shader skyboxShader("../src/envmapping/skybox.vert", "../src/envmapping/skybox.frag");
 	Shader myShader("../src/envmapping/model.vert", "../src/envmapping/model.frag");
 	models.SetActiveGroup("sphere");
-	Model myModel = models.GetActiveAsset<Model>("model");
+	AssetHandle<Model> myModel = models.FindActiveModel("model");
 	auto modelTransformation = models.GetActiveAsset<glm::mat4>("transformation");
-	Model skyboxCube = models.GetAsset<Model>("cube","model");
+	AssetHandle<Model> skyboxCube = models.FindModel("cube","model");
+	// the other groups are streamed in the background when they are selected (placeholders are shown until then)
+	models.SetAsync(true);
+	skyboxes.SetAsync(true);
 	//Model myModel("objects/torus/torus.obj");
 	//Model myModel("objects/sphere/sphere.obj");
 	//Model myModel("objects/cyborg/cyborg.obj");
 
 	myShader.use();
 	
-	glEnable(GL_DEPTH_TEST);
+	glState().Enable(GL_DEPTH_TEST);
 	
 	myShader.setInt("cubeTex", 0);
 	skyboxShader.setInt("skybox", 0);
@@ -196,6 +203,10 @@ int main() {
 		// input
 		// -----
 		processInput(window);
+
+		// create the GPU resources of assets that finished loading in the background (within the upload budget)
+		asyncLoader().Update();
+
 		if (gui) {
 			// Start the Dear ImGui frame
 			ImGui_ImplOpenGL3_NewFrame();
@@ -218,7 +229,7 @@ int main() {
 					if (models.GetActiveGroupId() != item_current)
 					{
 						models.SetActiveGroup(item_current);
-						myModel = models.GetActiveAsset<Model>("model");
+						myModel = models.FindActiveModel("model");
 						modelTransformation = models.GetActiveAsset<glm::mat4>("transformation");
 					}
 				}
@@ -235,11 +246,16 @@ int main() {
 					if (skyboxes.GetActiveGroupId() != item_current)
 					{
 						skyboxes.SetActiveGroup(item_current);
-						cubeTexture = skyboxes.GetActiveAsset<Tex>("cubemap");
-						glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTexture);
+						cubeTexture = skyboxes.FindActiveTexture("cubemap");
 					}
 				}
 
+				AsyncLoader::Stats loads = asyncLoader().GetStats();
+				ImGui::Text("loading: %u queued, %u decoding, %u uploading (%.2f MB this frame)", loads.queued, loads.loading, loads.uploading, loads.bytesUploaded / (1024.0f * 1024.0f));
+				ImGui::Text("load latency: last %.0f ms, avg %.0f ms, max %.0f ms", loads.lastLatencyMs, loads.averageLatencyMs, loads.maxLatencyMs);
+				UploadThread::Stats gpu = uploadThread().GetStats();
+				ImGui::Text("upload thread: %u queued, %u fenced, last %.1f ms, max %.1f ms", gpu.queued, gpu.fenced, gpu.lastUploadMs, gpu.maxUploadMs);
+
 				const char* mode_combo[] = { "reflection","refraction" };
 				ImGui::Combo("reflect/refract", &shaderMode, mode_combo, 2);
 
@@ -276,20 +292,26 @@ int main() {
 		myShader.setVec3("cameraPos", camera.Position);
 		myShader.setInt("mode", shaderMode);
 
-		myModel.Draw(myShader);
+		// (the handles resolve to the placeholders while the assets are loading)
+		glState().BindTextureUnit(0, GL_TEXTURE_CUBE_MAP, skyboxes.Get(cubeTexture));
+		models.Get(myModel).Draw();
 
 		// draw the skybox
-		glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+		glState().DepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
 		skyboxShader.use();
 		skyboxShader.setMat4("projection", projection);
 		skyboxShader.setMat4("view", view);
-		skyboxCube.Draw(skyboxShader);
-		glDepthFunc(GL_LESS);  // change depth function so depth test passes when values are equal to depth buffer's content
+		models.Get(skyboxCube).Draw();
+		glState().DepthFunc(GL_LESS);  // change depth function so depth test passes when values are equal to depth buffer's content
 
 		if (gui) ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		glfwSwapBuffers(window);
 	}
 
+	// destroy the loaded models and textures while the OpenGL context still exists
+	modelRegistry().Clear();
+	textureRegistry().Clear();
+	uploadThread().Stop();
 	glfwTerminate();
 	return 0;
 }
@@ -317,7 +339,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	// make sure the viewport matches the new window dimensions; note that width and 
 	// height will be significantly larger than specified on retina displays.
-	glViewport(0, 0, width, height);
+	glState().Viewport(0, 0, width, height);
 	SCR_WIDTH = width; SCR_HEIGHT = height;
 }
 
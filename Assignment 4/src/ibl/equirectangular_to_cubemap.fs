@@ -3,6 +3,7 @@ out vec4 FragColor;
 in vec3 WorldPos;
 
 uniform sampler2D equirectangularMap;
+uniform float rotation; // about the y axis (radians)
 
 const vec2 invAtan = vec2(0.1591, 0.3183);
 vec2 SampleSphericalMap(vec3 v)
@@ -15,7 +16,9 @@ vec2 SampleSphericalMap(vec3 v)
 
 void main()
 {		
-    vec2 uv = SampleSphericalMap(normalize(WorldPos));
+    vec3 v = normalize(WorldPos);
+    v = vec3(cos(rotation) * v.x - sin(rotation) * v.z, v.y, sin(rotation) * v.x + cos(rotation) * v.z);
+    vec2 uv = SampleSphericalMap(v);
     vec3 color = texture(equirectangularMap, uv).rgb;
     
     FragColor = vec4(color, 1.0);
@@ -12,8 +12,16 @@
 #include <util/model.h>
 #include <util/assets.h>
 #include <util/window.h>
+#include <util/ibl_cache.h>
+#include <util/sh.h>
+#include <util/ibl_prefilter.h>
+#include <util/brdf_lut.h>
+#include <util/hdr_loader.h>
+#include <util/ibl_rebake.h>
+#include <util/primitives.h>
 
 #include <iostream>
+#include <chrono> // for timing
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -21,9 +29,9 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-void renderSphere();
-void renderCube();
-void renderQuad();
+unsigned int bakePrefilterReference(Shader& prefilterShader, unsigned int envCubemap);
+std::shared_ptr<HdrImage> decodeEnvironment(const std::string& path);
+float compareBrdfLUT(Shader& brdfShader);
 
 // --- ASSETS ---
 // models and textures used in this tutorial
@@ -102,13 +110,19 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME);
+    // the assets of the demo are read from its pack if there is one (see src/tools/packer), otherwise from their files
+    FileSystem::mount("../resources/packs/ibl.pack");
+    // create the OpenGL objects of the assets on a second (shared) context, see util/upload_thread.h
+    uploadThread().Start(window);
+    // the demo doesn't need the vertices and indices on the CPU once they are uploaded
+    keepMeshGeometry = false;
 
 
     // OpenGL is initialized now, so we can use OpenGL functions (glFoo ...)
     // ------------------------------
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     //glDebugMessageCallback(MessageCallback, 0);
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    glState().Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
     SetCursorPosCallback(mouse_callback);
     SetMouseButtonCallback(mouse_button_callback);
@@ -117,52 +131,79 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
     // set depth function to less than AND equal for skybox depth trick.
-    glDepthFunc(GL_LEQUAL);
+    glState().DepthFunc(GL_LEQUAL);
     // enable seamless cubemap sampling for lower mip levels in the pre-filter map.
-    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    glState().Enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // build and compile shaders
     // -------------------------
-    Shader pbrShader("../src/ibl/pbr.vs", "../src/ibl/pbr.fs");
+    // read the files of the scene in one batch (see util/async_io.h), the loads below take the buffers
+    asyncIO().Prefetch({ "../src/ibl/pbr.vs", "../src/ibl/pbr.fs", "../src/ibl/cubemap.vs", "../src/ibl/equirectangular_to_cubemap.fs",
+                         "../src/ibl/irradiance_convolution.fs", "../src/ibl/prefilter.fs", "../src/ibl/prefilter.comp", "../src/ibl/brdf.vs", "../src/ibl/brdf.fs",
+                         "../src/ibl/background.vs", "../src/ibl/background.fs", "../resources/textures/hdr/newport_loft.hdr",
+                         "../resources/cache/newport_loft.ibl" });
+    assets.Prefetch("sphere");
+    // (the PACKED_ORM variant reads ambient occlusion, roughness and metallic from one texture, see AssetManager::FindOrmTexture)
+    Shader separatePbrShader("../src/ibl/pbr.vs", "../src/ibl/pbr.fs");
+    Shader ormPbrShader({ "PACKED_ORM" }, "../src/ibl/pbr.vs", "../src/ibl/pbr.fs");
     Shader equirectangularToCubemapShader("../src/ibl/cubemap.vs", "../src/ibl/equirectangular_to_cubemap.fs");
     Shader irradianceShader("../src/ibl/cubemap.vs", "../src/ibl/irradiance_convolution.fs");
-    Shader prefilterShader("../src/ibl/cubemap.vs", "../src/ibl/prefilter.fs");
-    Shader brdfShader("../src/ibl/brdf.vs", "../src/ibl/brdf.fs");
+    Shader prefilterShader("../src/ibl/cubemap.vs", "../src/ibl/prefilter.fs"); // (reference for the compute prefilter)
+    PrefilterBaker prefilterBaker("../src/ibl/prefilter.comp");
+    Shader brdfShader("../src/ibl/brdf.vs", "../src/ibl/brdf.fs"); // (reference for the embedded BRDF LUT)
     Shader backgroundShader("../src/ibl/background.vs", "../src/ibl/background.fs");
 
-    pbrShader.use();
-    pbrShader.setInt("irradianceMap", 0);
-    pbrShader.setInt("prefilterMap", 1);
-    pbrShader.setInt("brdfLUT", 2);
-    pbrShader.setInt("albedoMap", 3);
-    pbrShader.setInt("normalMap", 4);
-    pbrShader.setInt("metallicMap", 5);
-    pbrShader.setInt("roughnessMap", 6);
-    pbrShader.setInt("aoMap", 7);
+    auto setPbrSamplers = [&]() {
+        for (Shader* shader : { &separatePbrShader, &ormPbrShader })
+        {
+            shader->use();
+            shader->setInt("irradianceMap", 0);
+            shader->setInt("prefilterMap", 1);
+            shader->setInt("brdfLUT", 2);
+            shader->setInt("albedoMap", 3);
+            shader->setInt("normalMap", 4);
+        }
+        separatePbrShader.use();
+        separatePbrShader.setInt("metallicMap", 5);
+        separatePbrShader.setInt("roughnessMap", 6);
+        separatePbrShader.setInt("aoMap", 7);
+        ormPbrShader.use();
+        ormPbrShader.setInt("ormMap", 5);
+    };
+    setPbrSamplers();
+    bool packedOrm = true;
+    // GPU memory of the packed texture and of the separate maps (each measured once it is loaded, 0 until then)
+    size_t separateBytes = 0, packedBytes = 0;
+    AssetHandle<Tex> measuredOrm;
 
     backgroundShader.use();
     backgroundShader.setInt("environmentMap", 0);
 
     // loaded model
     // -------------------------
+    // (the first group is loaded right away, the others are streamed in the background when they are selected)
     assets.SetActiveGroup("sphere");
-    Model loadedModel = assets.GetActiveAsset<Model>("model"); // new Model(FileSystem::getPath("resources/objects/cerberus/Cerberus_LP.FBX").c_str());
+    AssetHandle<Model> loadedModel = assets.FindActiveModel("model"); // new Model(FileSystem::getPath("resources/objects/cerberus/Cerberus_LP.FBX").c_str());
     glm::mat4 modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
     //loadedModel = backpack.getModel();
 
     // load PBR material textures
     // --------------------------
-    unsigned int albedoMap = assets.GetActiveAsset<Tex>("albedo"); //loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_A.tga").c_str());
-    unsigned int normalMap = assets.GetActiveAsset<Tex>("normal"); //     = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_N.tga").c_str());
-    unsigned int metallicMap = assets.GetActiveAsset<Tex>("metallness"); //   = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_M.tga").c_str());
-    unsigned int roughnessMap = assets.GetActiveAsset<Tex>("roughness"); //  = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_R.tga").c_str());
-    unsigned int aoMap = assets.GetActiveAsset<Tex>("ao"); //        = loadTexture(FileSystem::getPath("resources/textures/pbr/rusted_iron/ao.png").c_str());
+    AssetHandle<Tex> albedoMap = assets.FindActiveTexture("albedo"); //loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_A.tga").c_str());
+    AssetHandle<Tex> normalMap = assets.FindActiveTexture("normal"); //     = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_N.tga").c_str());
+    AssetHandle<Tex> ormMap = assets.FindActiveOrmTexture();
+    // the separate metallic, roughness and AO maps, only loaded when the packed ORM texture is turned off (for the
+    // comparison)
+    AssetHandle<Tex> metallicMap, roughnessMap, aoMap;
+    auto loadSeparateMaps = [&]() {
+        metallicMap = assets.FindActiveTexture("metallness"); //   = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_M.tga").c_str());
+        roughnessMap = assets.FindActiveTexture("roughness"); //  = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_R.tga").c_str());
+        aoMap = assets.FindActiveTexture("ao"); //        = loadTexture(FileSystem::getPath("resources/textures/pbr/rusted_iron/ao.png").c_str());
+        separateBytes = 0;
+    };
+    assets.SetAsync(true);
 
     // lights
     // ------
@@ -179,222 +220,267 @@ int main()
         glm::vec3(300.0f, 300.0f, 300.0f)
     };
 
-    // pbr: setup framebuffer
-    // ----------------------
-    unsigned int captureFBO;
-    unsigned int captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-    // pbr: load the HDR environment map
-    // ---------------------------------
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float *data = stbi_loadf("../resources/textures/hdr/newport_loft.hdr", &width, &height, &nrComponents, 0);
-    unsigned int hdrTexture;
-    if (data)
+    // pbr: load the precomputed maps from the cache (see util/ibl_cache.h), or bake them and cache them for the next launch.
+    // The key covers the environment map, the bake shaders, the BRDF LUT and the sizes, so changing any of them bakes again.
+    // ----------------------------------------------------------------------------------------------------------------
+    FileData hdrFile;
+    if (!FileSystem::read("../resources/textures/hdr/newport_loft.hdr", hdrFile))
+        std::cout << "Failed to read HDR image." << std::endl;
+    std::vector<std::string> bakeShaders(4);
+    const char* bakeShaderPaths[] = { "../src/ibl/cubemap.vs", "../src/ibl/equirectangular_to_cubemap.fs", "../src/ibl/irradiance_convolution.fs",
+                                      "../src/ibl/prefilter.comp" };
+    for (size_t i = 0; i < bakeShaders.size(); i++)
+        FileSystem::readText(bakeShaderPaths[i], bakeShaders[i]);
+    std::string_view brdfLUTData((const char*)BRDF_LUT_DATA, sizeof(BRDF_LUT_DATA));
+    uint64_t iblKey = iblCacheKey({ hdrFile.Text(), bakeShaders[0], bakeShaders[1], bakeShaders[2], bakeShaders[3], brdfLUTData },
+                                  { 512, 32, 128, 5, (int)PrefilterBaker::SampleCount(5), BRDF_LUT_SIZE }); // (environment, irradiance, prefilter size, levels and samples, BRDF LUT)
+    const std::string iblCachePath = "../resources/cache/newport_loft.ibl";
+
+    unsigned int envCubemap = 0, irradianceMap = 0, prefilterMap = 0, brdfLUTTexture = 0;
+    unsigned int hdrTexture = 0; // (kept for re-bakes with another rotation)
+    IblMaps iblMaps;
+    auto iblStart = std::chrono::high_resolution_clock::now();
+    bool iblCached = loadIblCache(iblCachePath, iblKey, iblMaps);
+    float iblSaveMs = 0.0f;
+    float irradianceBakeMs = -1.0f; // (of the irradiance cube map, if it was baked)
+    float prefilterBakeMs = -1.0f;  // (of the prefilter map, if it was baked)
+    float hdrLoadMs = -1.0f;        // (decode and upload of the HDR environment map, if it was baked)
+    if (iblCached)
     {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        envCubemap = iblMaps.environment;
+        irradianceMap = iblMaps.irradiance;
+        prefilterMap = iblMaps.prefilter;
+        brdfLUTTexture = iblMaps.brdfLUT;
     }
     else
     {
-        std::cout << "Failed to load HDR image." << std::endl;
-    }
-
-    // pbr: setup cubemap to render to and attach to framebuffer
-    // ---------------------------------------------------------
-    unsigned int envCubemap;
-    glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
-    // ----------------------------------------------------------------------------------------------
-    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 captureViews[] =
-    {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-    };
-
-    // pbr: convert HDR equirectangular environment map to cubemap equivalent
-    // ----------------------------------------------------------------------
-    equirectangularToCubemapShader.use();
-    equirectangularToCubemapShader.setInt("equirectangularMap", 0);
-    equirectangularToCubemapShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
-
-    glViewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        equirectangularToCubemapShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // pbr: setup framebuffer
+        // ----------------------
+        unsigned int captureFBO;
+        unsigned int captureRBO;
+        glGenFramebuffers(1, &captureFBO);
+        glGenRenderbuffers(1, &captureRBO);
+
+        glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
 
-        renderCube();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // pbr: load the HDR environment map (decoded in parallel straight to RGB9_E5, see util/hdr_loader.h; stb_image
+        // loads the files it doesn't support)
+        // ------------------------------------------------------------------------------------------------------------
+        auto hdrStart = std::chrono::high_resolution_clock::now();
+        {
+            HdrImage hdrImage;
+            if (decodeHdr(hdrFile.data, hdrFile.size, hdrImage))
+                hdrTexture = createHdrTexture(hdrImage);
+        }
+        if (!hdrTexture)
+        {
+            stbi_set_flip_vertically_on_load(true);
+            int width, height, nrComponents;
+            float *data = hdrFile.data ? stbi_loadf_from_memory(hdrFile.data, (int)hdrFile.size, &width, &height, &nrComponents, 3) : nullptr;
+            if (data)
+            {
+                glGenTextures(1, &hdrTexture);
+                glState().BindTexture(GL_TEXTURE_2D, hdrTexture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data); // note how we specify the texture's data value to be float
 
-    // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
-    // --------------------------------------------------------------------------------
-    unsigned int irradianceMap;
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                stbi_image_free(data);
+            }
+            else
+            {
+                std::cout << "Failed to load HDR image." << std::endl;
+            }
+        }
+        hdrLoadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - hdrStart).count();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
-
-    // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
-    // -----------------------------------------------------------------------------
-    irradianceShader.use();
-    irradianceShader.setInt("environmentMap", 0);
-    irradianceShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glViewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        irradianceShader.setMat4("view", captureViews[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // pbr: setup cubemap to render to and attach to framebuffer
+        // ---------------------------------------------------------
+        glGenTextures(1, &envCubemap);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // pbr: set up projection and view matrices for capturing data onto the 6 cubemap face directions
+        // ----------------------------------------------------------------------------------------------
+        glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+        glm::mat4 captureViews[] =
+        {
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+            glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+        };
 
-        renderCube();
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // pbr: convert HDR equirectangular environment map to cubemap equivalent
+        // ----------------------------------------------------------------------
+        equirectangularToCubemapShader.use();
+        equirectangularToCubemapShader.setInt("equirectangularMap", 0);
+        equirectangularToCubemapShader.setMat4("projection", captureProjection);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_2D, hdrTexture);
 
-    // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
-    // --------------------------------------------------------------------------------
-    unsigned int prefilterMap;
-    glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        glState().Viewport(0, 0, 512, 512); // don't forget to configure the viewport to the capture dimensions.
+        glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            equirectangularToCubemapShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
-    // ----------------------------------------------------------------------------------------------------
-    prefilterShader.use();
-    prefilterShader.setInt("environmentMap", 0);
-    prefilterShader.setMat4("projection", captureProjection);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+            primitives().Draw(PRIMITIVE_CUBE);
+        }
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+        // pbr: create an irradiance cubemap, and re-scale capture FBO to irradiance scale.
+        // --------------------------------------------------------------------------------
+        glFinish(); // (for the timing of the irradiance bake)
+        auto irradianceStart = std::chrono::high_resolution_clock::now();
+        glGenTextures(1, &irradianceMap);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 32, 32, 0, GL_RGB, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    unsigned int maxMipLevels = 5;
-    for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
-    {
-        // reisze framebuffer according to mip-level size.
-        unsigned int mipWidth = 128 * std::pow(0.5, mip);
-        unsigned int mipHeight = 128 * std::pow(0.5, mip);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
         glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
-
-        float roughness = (float)mip / (float)(maxMipLevels - 1);
-        prefilterShader.setFloat("roughness", roughness);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
+
+        // pbr: solve diffuse integral by convolution to create an irradiance (cube)map.
+        // -----------------------------------------------------------------------------
+        irradianceShader.use();
+        irradianceShader.setInt("environmentMap", 0);
+        irradianceShader.setMat4("projection", captureProjection);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+        glState().Viewport(0, 0, 32, 32); // don't forget to configure the viewport to the capture dimensions.
+        glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
         for (unsigned int i = 0; i < 6; ++i)
         {
-            prefilterShader.setMat4("view", captureViews[i]);
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
-
+            irradianceShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            renderCube();
+
+            primitives().Draw(PRIMITIVE_CUBE);
         }
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glFinish();
+        irradianceBakeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - irradianceStart).count();
+
+        // pbr: prefilter the environment per roughness into the mip levels of a cube map with a compute shader that
+        // writes all faces of a level at once (see util/ibl_prefilter.h, bakePrefilterReference is the version this
+        // tutorial started with).
+        // ----------------------------------------------------------------------------------------------------------
+        auto prefilterStart = std::chrono::high_resolution_clock::now();
+        prefilterMap = createPrefilterMap(128, 5);
+        prefilterBaker.Bake(envCubemap, prefilterMap, 5);
+        glFinish();
+        prefilterBakeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - prefilterStart).count();
+
+        // pbr: the 2D LUT of the BRDF equations used, integrated once (see util/brdf_lut.h)
+        // ---------------------------------------------------------------------------------
+        brdfLUTTexture = createBrdfLUT();
+
+        glDeleteFramebuffers(1, &captureFBO);
+        glDeleteRenderbuffers(1, &captureRBO);
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // pbr: generate a 2D LUT from the BRDF equations used.
-    // ----------------------------------------------------
-    unsigned int brdfLUTTexture;
-    glGenTextures(1, &brdfLUTTexture);
-
-    // pre-allocate enough memory for the LUT texture.
-    glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 512, 512, 0, GL_RG, GL_FLOAT, 0);
-    // be sure to set wrapping mode to GL_CLAMP_TO_EDGE
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // then re-configure capture framebuffer object and render screen-space quad with BRDF shader.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brdfLUTTexture, 0);
-
-    glViewport(0, 0, 512, 512);
-    brdfShader.use();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    renderQuad();
+    glFinish(); // (for the timing)
+    float iblMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - iblStart).count();
+    if (!iblCached && hdrFile.data)
+    {
+        auto saveStart = std::chrono::high_resolution_clock::now();
+        saveIblCache(iblCachePath, iblKey, { envCubemap, irradianceMap, prefilterMap, brdfLUTTexture });
+        iblSaveMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - saveStart).count();
+    }
+    std::cout << "IBL maps " << (iblCached ? "loaded from the cache" : "baked") << " in " << iblMs << " ms" << std::endl;
+
+    // pbr: project the environment onto L2 spherical harmonics (see util/sh.h), an alternative to the irradiance map
+    // ---------------------------------------------------------------------------------------------------------------
+    auto shStart = std::chrono::high_resolution_clock::now();
+    SHCoefficients sh = projectCubemapSH(envCubemap);
+    float shBakeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - shStart).count();
+    SHError shError = compareSH(sh, irradianceMap);
+    std::cout << "SH irradiance projected in " << shBakeMs << " ms, error against the irradiance map: rmse " << shError.rmse
+              << " (" << shError.relativeRmse * 100.0f << "%), max " << shError.maxRelative * 100.0f << "%" << std::endl;
+    GLBuffer shBuffer = createBuffer();
+    glState().BindBuffer(GL_UNIFORM_BUFFER, shBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(SHCoefficients), &sh, GL_STATIC_DRAW);
+    bool useSH = false;
+
+    // pbr: bakes the maps again over several frames when the environment changes at runtime (see util/ibl_rebake.h),
+    // the maps above are the front maps until the first swap
+    // ---------------------------------------------------------------------------------------------------------------
+    IblRebaker iblRebaker(equirectangularToCubemapShader, irradianceShader, prefilterBaker);
+    // (if the maps came from the cache there is no source texture, the HDR file is only decoded when the first re-bake
+    // needs it, see loadEnvironment)
+    iblRebaker.Adopt(envCubemap, irradianceMap, prefilterMap, sh, hdrTexture);
+    char environmentPath[256] = "../resources/textures/hdr/newport_loft.hdr";
+    float environmentRotation = 0.0f; // (degrees)
+    bool animateEnvironment = false;
+    float rebakeBudgetMs = DEFAULT_IBL_REBAKE_BUDGET_MS;
+    // decodes the HDR file on a worker and starts the re-bake with it
+    bool environmentLoading = false; // (until the decoded file is handed to the rebaker)
+    auto loadEnvironment = [&](const std::string& path) {
+        environmentLoading = true;
+        asyncLoader().Request(path, [path, &iblRebaker, &environmentRotation, &environmentLoading, &animateEnvironment]() -> AsyncLoader::UploadStep {
+            std::shared_ptr<HdrImage> image = decodeEnvironment(path);
+            if (!image) // (the rotation stops rather than decoding the file again every frame)
+                return [&environmentLoading, &animateEnvironment](size_t&) { environmentLoading = animateEnvironment = false; return true; };
+            return [image, &iblRebaker, &environmentRotation, &environmentLoading](size_t&) {
+                iblRebaker.Start(image, glm::radians(environmentRotation));
+                environmentLoading = false;
+                return true;
+            };
+        });
+    };
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // timings and error of the last comparison of the compute prefilter with the fragment shader one
+    float referencePrefilterMs = -1.0f, computePrefilterMs = -1.0f;
+    PrefilterError prefilterError;
+    float embeddedLUTError = -1.0f; // (of the embedded BRDF LUT against brdf.fs)
 
 
     // initialize static shader uniforms before rendering
     // --------------------------------------------------
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    pbrShader.use();
-    pbrShader.setMat4("projection", projection);
+    for (Shader* shader : { &separatePbrShader, &ormPbrShader })
+    {
+        shader->use();
+        shader->setMat4("projection", projection);
+    }
     backgroundShader.use();
     backgroundShader.setMat4("projection", projection);
 
     // then before rendering, configure the viewport to the original framebuffer's screen dimensions
     int scrWidth, scrHeight;
     glfwGetFramebufferSize(window, &scrWidth, &scrHeight);
-    glViewport(0, 0, scrWidth, scrHeight);
+    glState().Viewport(0, 0, scrWidth, scrHeight);
 
     // render loop
     // -----------
@@ -412,6 +498,28 @@ int main()
         // input
         // -----
         processInput(window);
+
+        // create the GPU resources of assets that finished loading in the background (within the upload budget)
+        asyncLoader().Update();
+
+        // continue the re-bake of the IBL maps (within its GPU time budget) and render with the new maps once it is done
+        if (animateEnvironment && !iblRebaker.Busy() && !environmentLoading)
+        {
+            environmentRotation = (float)std::fmod(glfwGetTime() * 10.0, 360.0) - 180.0f;
+            // (without the source texture, e.g., the maps came from the cache, the file is decoded first)
+            if (!iblRebaker.Start(nullptr, glm::radians(environmentRotation)))
+                loadEnvironment(environmentPath);
+        }
+        if (iblRebaker.Update(rebakeBudgetMs))
+        {
+            envCubemap = iblRebaker.Environment();
+            irradianceMap = iblRebaker.Irradiance();
+            prefilterMap = iblRebaker.Prefilter();
+            sh = iblRebaker.SH();
+            glState().BindBuffer(GL_UNIFORM_BUFFER, shBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SHCoefficients), &sh);
+        }
+
         if (gui) {
             // Start the Dear ImGui frame
             ImGui_ImplOpenGL3_NewFrame();
@@ -441,17 +549,116 @@ int main()
                 if (assets.GetActiveGroupId() != item_current)
                 {
                     assets.SetActiveGroup(item_current);
+                    assets.Prefetch(assets.GetActiveGroup());
                     // loaded model and (PBR) texutes
                     // -------------------------
-                    loadedModel = assets.GetActiveAsset<Model>("model");
+                    loadedModel = assets.FindActiveModel("model");
                     modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
-                    albedoMap = assets.GetActiveAsset<Tex>("albedo");
-                    normalMap = assets.GetActiveAsset<Tex>("normal");
-                    metallicMap = assets.GetActiveAsset<Tex>("metallness");
-                    roughnessMap = assets.GetActiveAsset<Tex>("roughness");
-                    aoMap = assets.GetActiveAsset<Tex>("ao");
+                    albedoMap = assets.FindActiveTexture("albedo");
+                    normalMap = assets.FindActiveTexture("normal");
+                    ormMap = assets.FindActiveOrmTexture();
+                    if (packedOrm)
+                        metallicMap = roughnessMap = aoMap = AssetHandle<Tex>();
+                    else
+                        loadSeparateMaps();
 
                 }
+                AsyncLoader::Stats loads = asyncLoader().GetStats();
+                ImGui::Text("loading: %u queued, %u decoding, %u uploading (%.2f MB this frame)", loads.queued, loads.loading, loads.uploading, loads.bytesUploaded / (1024.0f * 1024.0f));
+                ImGui::Text("load latency: last %.0f ms, avg %.0f ms, max %.0f ms", loads.lastLatencyMs, loads.averageLatencyMs, loads.maxLatencyMs);
+                MemoryUsage memory = assets.Get(loadedModel).Memory();
+                ImGui::Text("model memory: %.2f MB CPU, %.2f MB GPU", memory.cpuBytes / (1024.0f * 1024.0f), memory.gpuBytes / (1024.0f * 1024.0f));
+                if (ImGui::Checkbox("packed ORM texture", &packedOrm) && !packedOrm && !aoMap.Valid())
+                    loadSeparateMaps();
+                if (measuredOrm != ormMap && assets.Ready(ormMap))
+                {
+                    packedBytes = textureMemory(assets.Get(ormMap));
+                    measuredOrm = ormMap;
+                }
+                if (separateBytes == 0 && aoMap.Valid() && assets.Ready(aoMap) && assets.Ready(roughnessMap) && assets.Ready(metallicMap))
+                    separateBytes = textureMemory(assets.Get(aoMap)) + textureMemory(assets.Get(roughnessMap)) + textureMemory(assets.Get(metallicMap));
+                // (+ 3 for the IBL maps)
+                ImGui::Text("samplers per draw: %d (%s)", packedOrm ? 6 : 8, packedOrm ? "albedo, normal, ORM" : "albedo, normal, metallic, roughness, AO");
+                // (the separate maps stay loaded once the comparison loaded them, so they are counted as long as they are)
+                if (measuredOrm == ormMap && separateBytes > 0)
+                    ImGui::Text("AO/roughness/metallic: %.2f MB packed + %.2f MB separate for the comparison (packing saves %.2f MB)",
+                                packedBytes / (1024.0f * 1024.0f), separateBytes / (1024.0f * 1024.0f),
+                                ((float)separateBytes - (float)packedBytes) / (1024.0f * 1024.0f));
+                else if (measuredOrm == ormMap)
+                    ImGui::Text("AO/roughness/metallic: %.2f MB packed (separate maps not loaded)", packedBytes / (1024.0f * 1024.0f));
+                if (iblCached)
+                    ImGui::Text("IBL maps: loaded from the cache in %.1f ms", iblMs);
+                else
+                    ImGui::Text("IBL maps: baked in %.1f ms (cache written in %.1f ms)", iblMs, iblSaveMs);
+                ImGui::Checkbox("SH irradiance", &useSH);
+                if (irradianceBakeMs >= 0.0f)
+                    ImGui::Text("irradiance bake: cube map %.2f ms, SH %.2f ms", irradianceBakeMs, shBakeMs);
+                else
+                    ImGui::Text("irradiance bake: cube map cached, SH %.2f ms", shBakeMs);
+                ImGui::Text("SH error: rmse %.4f (%.1f%%), max %.1f%%", shError.rmse, shError.relativeRmse * 100.0f, shError.maxRelative * 100.0f);
+                if (hdrLoadMs >= 0.0f)
+                    ImGui::Text("HDR environment: loaded in %.1f ms", hdrLoadMs);
+                if (prefilterBakeMs >= 0.0f)
+                    ImGui::Text("prefilter bake: %.2f ms (compute, %u samples over 5 levels)", prefilterBakeMs, PrefilterBaker::SampleCount(5));
+                else
+                    ImGui::Text("prefilter bake: cached");
+                // bakes the prefilter map again with both versions (the same environment) and compares them
+                if (ImGui::Button("compare prefilter bakes")) {
+                    glFinish();
+                    auto referenceStart = std::chrono::high_resolution_clock::now();
+                    unsigned int reference = bakePrefilterReference(prefilterShader, envCubemap);
+                    glFinish();
+                    referencePrefilterMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - referenceStart).count();
+                    auto computeStart = std::chrono::high_resolution_clock::now();
+                    unsigned int computed = createPrefilterMap(128, 5);
+                    prefilterBaker.Bake(envCubemap, computed, 5);
+                    glFinish();
+                    computePrefilterMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - computeStart).count();
+                    prefilterError = comparePrefilter(computed, reference, 5);
+                    glDeleteTextures(1, &reference);
+                    glDeleteTextures(1, &computed);
+                    std::cout << "prefilter: fragment " << referencePrefilterMs << " ms, compute " << computePrefilterMs << " ms ("
+                              << referencePrefilterMs / computePrefilterMs << "x), relative rmse per level:";
+                    for (float e : prefilterError.relativeRmse)
+                        std::cout << " " << e * 100.0f << "%";
+                    std::cout << std::endl;
+                }
+                if (referencePrefilterMs >= 0.0f)
+                {
+                    ImGui::Text("fragment %.2f ms, compute %.2f ms (%.1fx)", referencePrefilterMs, computePrefilterMs, referencePrefilterMs / computePrefilterMs);
+                    ImGui::Text("compute vs fragment: relative rmse %.2f%% (worst level)", prefilterError.worst * 100.0f);
+                }
+                if (ImGui::Button("compare BRDF LUT")) {
+                    embeddedLUTError = compareBrdfLUT(brdfShader);
+                    std::cout << "embedded BRDF LUT: max difference to brdf.fs " << embeddedLUTError << std::endl;
+                }
+                if (embeddedLUTError >= 0.0f)
+                    ImGui::Text("embedded BRDF LUT (%dx%d): max difference to brdf.fs %.5f", BRDF_LUT_SIZE, BRDF_LUT_SIZE, embeddedLUTError);
+
+                // changing the environment bakes the maps again over the next frames
+                ImGui::InputText("environment", environmentPath, sizeof(environmentPath));
+                if (ImGui::Button("load environment"))
+                    loadEnvironment(environmentPath);
+                if (ImGui::SliderFloat("environment rotation", &environmentRotation, -180.0f, 180.0f))
+                {
+                    // (without the source texture, e.g., the maps came from the cache, the file is decoded first)
+                    if (!iblRebaker.Start(nullptr, glm::radians(environmentRotation)) && !environmentLoading)
+                        loadEnvironment(environmentPath);
+                }
+                ImGui::Checkbox("rotate environment", &animateEnvironment);
+                ImGui::SliderFloat("re-bake budget (ms)", &rebakeBudgetMs, 0.25f, 16.0f);
+                IblRebaker::Stats rebake = iblRebaker.GetStats();
+                if (rebake.busy)
+                    ImGui::Text("re-bake: step %u of %u, %u steps (%.2f ms) this frame", rebake.stepsDone, rebake.stepCount,
+                                rebake.stepsLastFrame, rebake.estimatedLastFrameMs);
+                if (rebake.completed > 0)
+                    ImGui::Text("last re-bake: %u frames, %.0f ms, %.1f ms GPU (largest step %.2f ms)", rebake.lastFrames, rebake.lastMs,
+                                rebake.lastGpuMs, rebake.maxStepMs);
+                UploadThread::Stats gpu = uploadThread().GetStats();
+                ImGui::Text("upload thread: %u queued, %u fenced, last %.1f ms, max %.1f ms", gpu.queued, gpu.fenced, gpu.lastUploadMs, gpu.maxUploadMs);
+                AsyncIO::Stats reads = asyncIO().GetStats();
+                ImGui::Text("file reads (%s): %u files in %.0f ms, depth %u, latency avg %.0f ms, max %.0f ms", AsyncIO::BackendName(reads.backend),
+                            reads.files, reads.batchMs, reads.maxQueueDepth, reads.averageLatencyMs, reads.maxLatencyMs);
 
  
                 const char * bg_combo [] = { "environment","irradiance","prefilter" };
@@ -459,16 +666,9 @@ int main()
 
                 // a Button to reload the shader (so you don't need to recompile the cpp all the time)
                 if (ImGui::Button("reload shaders")) {
-                    pbrShader.reload();
-                    pbrShader.use();
-                    pbrShader.setInt("irradianceMap", 0);
-                    pbrShader.setInt("prefilterMap", 1);
-                    pbrShader.setInt("brdfLUT", 2);
-                    pbrShader.setInt("albedoMap", 3);
-                    pbrShader.setInt("normalMap", 4);
-                    pbrShader.setInt("metallicMap", 5);
-                    pbrShader.setInt("roughnessMap", 6);
-                    pbrShader.setInt("aoMap", 7);
+                    separatePbrShader.reload();
+                    ormPbrShader.reload();
+                    setPbrSamplers();
                 }
 
                 ImGui::End();
@@ -481,17 +681,18 @@ int main()
         if (gui) ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
+        glState().Viewport(0, 0, display_w, display_h);
         glClearColor(0.0, 0.0, 0.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         // configure global opengl state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glState().Enable(GL_DEPTH_TEST);
+        glState().Disable(GL_BLEND);
 
         // render scene, supplying the convoluted irradiance map to the final shader.
         // ------------------------------------------------------------------------------------------
+        Shader& pbrShader = packedOrm ? ormPbrShader : separatePbrShader;
         pbrShader.use();
         glm::mat4 model = glm::mat4(1.0f);
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
@@ -505,34 +706,44 @@ int main()
         pbrShader.setFloat("Roughness", glm::clamp(roughness, 0.05f, 1.0f)); //  we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off  on direct lighting.
         pbrShader.setFloat("gamma", gamma);
         pbrShader.setFloat("useTextures", useTextures ? 1.0f : 0.0f);
+        pbrShader.setBool("useSH", useSH);
+        glState().BindBufferBase(GL_UNIFORM_BUFFER, SH_BINDING, shBuffer);
 
         // bind pre-computed IBL data
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, brdfLUTTexture);
+        glState().ActiveTexture(GL_TEXTURE0);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+        glState().ActiveTexture(GL_TEXTURE1);
+        glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+        glState().ActiveTexture(GL_TEXTURE2);
+        glState().BindTexture(GL_TEXTURE_2D, brdfLUTTexture);
 
         if (useTextures)
         {
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, albedoMap);
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, normalMap);
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_2D, metallicMap);
-            glActiveTexture(GL_TEXTURE6);
-            glBindTexture(GL_TEXTURE_2D, roughnessMap);
-            glActiveTexture(GL_TEXTURE7);
-            glBindTexture(GL_TEXTURE_2D, aoMap);
+            glState().ActiveTexture(GL_TEXTURE3);
+            glState().BindTexture(GL_TEXTURE_2D, assets.Get(albedoMap));
+            glState().ActiveTexture(GL_TEXTURE4);
+            glState().BindTexture(GL_TEXTURE_2D, assets.Get(normalMap));
+            if (packedOrm)
+            {
+                glState().ActiveTexture(GL_TEXTURE5);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(ormMap));
+            }
+            else
+            {
+                glState().ActiveTexture(GL_TEXTURE5);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(metallicMap));
+                glState().ActiveTexture(GL_TEXTURE6);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(roughnessMap));
+                glState().ActiveTexture(GL_TEXTURE7);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(aoMap));
+            }
         }
 
 
 
         model = (glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f))) * modelTransformation;
         pbrShader.setMat4("model", model);
-        loadedModel.Draw(pbrShader);
+        assets.Get(loadedModel).Draw();
 
         // render light source (simply re-render sphere at light positions)
         // this looks a bit off as we use the same shader, but it'll make their positions obvious and 
@@ -548,30 +759,30 @@ int main()
             model = glm::translate(model, newPos);
             model = glm::scale(model, glm::vec3(0.5f));
             pbrShader.setMat4("model", model);
-            renderSphere();
+            primitives().Draw(PRIMITIVE_SPHERE);
         }
 
         // render skybox (render as last to prevent overdraw)
         backgroundShader.use();
         backgroundShader.setFloat("gamma", gamma);
         backgroundShader.setMat4("view", view);
-        glActiveTexture(GL_TEXTURE0);
+        glState().ActiveTexture(GL_TEXTURE0);
         if (bg_texture == 0) {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+            glState().BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
         } 
         else if (bg_texture == 1) {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
+            glState().BindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
         }
         else {
-            glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+            glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
         }
-        //glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap); // display irradiance map
-        //glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap); // display prefilter map
-        renderCube();
+        //glState().BindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap); // display irradiance map
+        //glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap); // display prefilter map
+        primitives().Draw(PRIMITIVE_CUBE);
 
         // render BRDF map to screen
         //brdfShader.Use();
-        //renderQuad();
+        //primitives().Draw(PRIMITIVE_QUAD);
 
 
 
@@ -583,6 +794,10 @@ int main()
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // destroy the loaded models and textures while the OpenGL context still exists
+    modelRegistry().Clear();
+    textureRegistry().Clear();
+    uploadThread().Stop();
     glfwTerminate();
     return 0;
 }
@@ -610,7 +825,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    glState().Viewport(0, 0, width, height);
     SCR_WIDTH = width; SCR_HEIGHT = height;
 }
 
@@ -659,207 +874,143 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(yoffset);
 }
  
-// renders (and builds at first invocation) a sphere
-// -------------------------------------------------
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere()
+// decodeEnvironment() decodes an HDR environment map to RGB9_E5 texels (no OpenGL calls, so this can run on a worker).
+// stb_image decodes the files util/hdr_loader.h doesn't support. Returns nullptr if the file can't be loaded.
+// ---------------------------------------------------------------------------------------------------------------------
+std::shared_ptr<HdrImage> decodeEnvironment(const std::string& path)
 {
-    if (sphereVAO == 0)
+    FileData file;
+    auto image = std::make_shared<HdrImage>();
+    if (!FileSystem::read(path, file))
     {
-        glGenVertexArrays(1, &sphereVAO);
+        std::cout << "Failed to read HDR image " << path << std::endl;
+        return nullptr;
+    }
+    if (decodeHdr(file.data, file.size, *image))
+        return image;
 
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
+    std::lock_guard<std::mutex> lock(stbiMutex());
+    stbi_set_flip_vertically_on_load(true);
+    int nrComponents;
+    float *data = stbi_loadf_from_memory(file.data, (int)file.size, &image->width, &image->height, &nrComponents, 3);
+    if (!data)
+    {
+        std::cout << "Failed to load HDR image " << path << std::endl;
+        return nullptr;
+    }
+    image->texels.resize((size_t)image->width * image->height);
+    for (size_t i = 0; i < image->texels.size(); i++)
+        image->texels[i] = glm::packF3x9_E1x5(glm::vec3(data[3 * i], data[3 * i + 1], data[3 * i + 2]));
+    stbi_image_free(data);
+    return image;
+}
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uv;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
+// bakePrefilterReference() prefilters the environment with the fragment shader (1024 samples per texel, one draw per
+// face and level) into a new cube map. The compute prefilter is compared against it.
+// ---------------------------------------------------------------------------------------------------------------------
+unsigned int bakePrefilterReference(Shader& prefilterShader, unsigned int envCubemap)
+{
+    unsigned int captureFBO;
+    unsigned int captureRBO;
+    glGenFramebuffers(1, &captureFBO);
+    glGenRenderbuffers(1, &captureRBO);
 
-        const unsigned int X_SEGMENTS = 64;
-        const unsigned int Y_SEGMENTS = 64;
-        const float PI = 3.14159265359;
-        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
-        {
-            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-            {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                uv.push_back(glm::vec2(xSegment, ySegment));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
-            }
-        }
+    glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    glm::mat4 captureViews[] =
+    {
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
+    };
 
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
-        {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
-            {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
-            }
-            else
-            {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                }
-            }
-            oddRow = !oddRow;
-        }
-        indexCount = indices.size();
+    // pbr: create a pre-filter cubemap, and re-scale capture FBO to pre-filter scale.
+    // --------------------------------------------------------------------------------
+    unsigned int prefilterMap;
+    glGenTextures(1, &prefilterMap);
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // be sure to set minifcation filter to mip_linear 
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // generate mipmaps for the cubemap so OpenGL automatically allocates the required memory.
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    // pbr: run a quasi monte-carlo simulation on the environment lighting to create a prefilter (cube)map.
+    // ----------------------------------------------------------------------------------------------------
+    prefilterShader.use();
+    prefilterShader.setInt("environmentMap", 0);
+    prefilterShader.setMat4("projection", captureProjection);
+    glState().ActiveTexture(GL_TEXTURE0);
+    glState().BindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
+
+    glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
+    unsigned int maxMipLevels = 5;
+    for (unsigned int mip = 0; mip < maxMipLevels; ++mip)
+    {
+        // reisze framebuffer according to mip-level size.
+        unsigned int mipWidth = 128 * std::pow(0.5, mip);
+        unsigned int mipHeight = 128 * std::pow(0.5, mip);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
+        glState().Viewport(0, 0, mipWidth, mipHeight);
 
-        std::vector<float> data;
-        for (unsigned int i = 0; i < positions.size(); ++i)
+        float roughness = (float)mip / (float)(maxMipLevels - 1);
+        prefilterShader.setFloat("roughness", roughness);
+        for (unsigned int i = 0; i < 6; ++i)
         {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-            if (uv.size() > 0)
-            {
-                data.push_back(uv[i].x);
-                data.push_back(uv[i].y);
-            }
-            if (normals.size() > 0)
-            {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
-            }
+            prefilterShader.setMat4("view", captureViews[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            primitives().Draw(PRIMITIVE_CUBE);
         }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 2 + 3) * sizeof(float);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(5 * sizeof(float)));
     }
+    glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+    glDeleteFramebuffers(1, &captureFBO);
+    glDeleteRenderbuffers(1, &captureRBO);
+    return prefilterMap;
 }
 
-// renderCube() renders a 1x1 3D cube in NDC.
-// -------------------------------------------------
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
-void renderCube()
+// compareBrdfLUT() renders the BRDF LUT with brdf.fs at the size of the embedded one (util/brdf_lut.h) and returns the
+// largest difference between the two.
+// ---------------------------------------------------------------------------------------------------------------------
+float compareBrdfLUT(Shader& brdfShader)
 {
-    // initialize (if necessary)
-    if (cubeVAO == 0)
-    {
-        float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-            // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-            // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-             1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-        };
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex attributes
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-    }
-    // render Cube
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-}
+    unsigned int lut;
+    glGenTextures(1, &lut);
+    glState().BindTexture(GL_TEXTURE_2D, lut);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 0, GL_RG, GL_FLOAT, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    unsigned int captureFBO;
+    glGenFramebuffers(1, &captureFBO);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lut, 0);
+    glState().Viewport(0, 0, BRDF_LUT_SIZE, BRDF_LUT_SIZE);
+    brdfShader.use();
+    glClear(GL_COLOR_BUFFER_BIT);
+    primitives().Draw(PRIMITIVE_QUAD); // (no depth buffer, the depth test passes)
+    glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &captureFBO);
+
+    std::vector<float> rendered((size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE * 2);
+    glState().BindTexture(GL_TEXTURE_2D, lut);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, rendered.data());
+    glDeleteTextures(1, &lut);
+    return brdfLUTError(rendered.data());
 }
 
 /*
@@ -882,7 +1033,7 @@ unsigned int loadTexture(char const * path)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().BindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
@@ -14,14 +14,24 @@ uniform float gamma;
 uniform float useTextures;
 uniform sampler2D albedoMap;
 uniform sampler2D normalMap;
+#ifdef PACKED_ORM
+// r ambient occlusion, g roughness, b metallic in one texture (see AssetManager::FindOrmTexture)
+uniform sampler2D ormMap;
+#else
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
+#endif
 
 // IBL
 uniform samplerCube irradianceMap;
 uniform samplerCube prefilterMap;
 uniform sampler2D brdfLUT;
+// irradiance as L2 spherical harmonics (see util/sh.h), replaces irradianceMap if useSH is set
+layout (std140, binding = 2) uniform SHData {
+    vec4 shCoefficients[9];
+};
+uniform bool useSH;
 
 // lights
 uniform vec3 lightPositions[4];
@@ -97,6 +107,20 @@ vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }   
 // ----------------------------------------------------------------------------
+// irradiance (divided by PI, like the irradiance map) around the normal n from the premultiplied SH coefficients
+vec3 irradianceSH(vec3 n)
+{
+    return shCoefficients[0].rgb
+         + shCoefficients[1].rgb * n.y
+         + shCoefficients[2].rgb * n.z
+         + shCoefficients[3].rgb * n.x
+         + shCoefficients[4].rgb * (n.x * n.y)
+         + shCoefficients[5].rgb * (n.y * n.z)
+         + shCoefficients[6].rgb * (3.0 * n.z * n.z - 1.0)
+         + shCoefficients[7].rgb * (n.x * n.z)
+         + shCoefficients[8].rgb * (n.x * n.x - n.y * n.y);
+}
+// ----------------------------------------------------------------------------
 void main()
 {		
     vec3 N = normalize(Normal);
@@ -109,9 +133,16 @@ void main()
     if (useTextures > 0)
     {
         albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
+#ifdef PACKED_ORM
+        vec3 orm = texture(ormMap, TexCoords).rgb;
+        ao = orm.r;
+        roughness = orm.g;
+        metallic = orm.b;
+#else
         metallic = texture(metallicMap, TexCoords).r;
         roughness = texture(roughnessMap, TexCoords).r;
         ao = texture(aoMap, TexCoords).r;
+#endif
 
         N = getNormalFromMap();
     }
@@ -169,7 +200,7 @@ void main()
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;	  
     
-    vec3 irradiance = texture(irradianceMap, N).rgb;
+    vec3 irradiance = useSH ? max(irradianceSH(N), vec3(0.0)) : texture(irradianceMap, N).rgb;
     vec3 diffuse      = irradiance * albedo;
     
     // sample both the pre-filter map and the BRDF lut and combine them together as per the Split-Sum approximation to get the IBL specular part.
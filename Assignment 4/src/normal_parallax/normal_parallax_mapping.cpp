@@ -119,12 +119,14 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME );
+    // the assets of the demo are read from its pack if there is one (see src/tools/packer), otherwise from their files
+    FileSystem::mount("../resources/packs/normal_parallax.pack");
 
 
     // OpenGL is initialized now, so we can load assets and so on ...
     // ------------------------------
     RenderFunc renderPrimitive = objMan.GetAsset<RenderFunc>("quad","func");
-    auto renderModel = objMan.GetAsset<Model>("sphere", "model");
+    Model& renderModel = objMan.GetModel("sphere", "model");
     unsigned int diffuseMap, normalMap, heightMap; 
     bool animateLight = true;
     float lightAngle = 0.0f;
@@ -136,14 +138,14 @@ int main()
     //glEnable(GL_DEBUG_OUTPUT);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     //glDebugMessageCallback(MessageCallback, 0);
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    glState().Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
     SetFramebufferSizeCallback(framebuffer_size_callback);
     SetCursorPosCallback(mouse_callback);
     SetScrollCallback(scroll_callback);
     SetMouseButtonCallback(mouse_button_callback);
     SetFramebufferSizeCallback([](GLFWwindow *window, int w, int h) {
         SCR_WIDTH = w; SCR_HEIGHT = h;
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glState().Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         });
    
     // build and compile shaders
@@ -255,15 +257,15 @@ int main()
         if (gui) ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
+        glState().Viewport(0, 0, display_w, display_h);
         glClearColor(bgColor.r, bgColor.g, bgColor.b, bgColor.a);
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
         
 
         // configure global opengl state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glState().Enable(GL_DEPTH_TEST);
+        glState().Disable(GL_BLEND);
 
         // animate light
         // -------------
@@ -292,17 +294,17 @@ int main()
             shader.setVec3("lightPos", lightPos);
             shader.setFloat("heightScale", heightScale); // adjust with Q and E keys or the widget
             //std::cout << heightScale << std::endl;
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, diffuseMap);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, normalMap);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, heightMap);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, diffuseMap);
+            glState().ActiveTexture(GL_TEXTURE1);
+            glState().BindTexture(GL_TEXTURE_2D, normalMap);
+            glState().ActiveTexture(GL_TEXTURE2);
+            glState().BindTexture(GL_TEXTURE_2D, heightMap);
             renderPrimitive();
 
             model = glm::translate(model,positions.at(countShaders)*2.0f);
             shader.setMat4("model", model);
-            renderModel.Draw(shader);
+            renderModel.Draw();
 
             countShaders++;
         }
@@ -313,13 +315,16 @@ int main()
         model = glm::scale(model, glm::vec3(0.1f));
         shaders.at(0).use();
         shaders.at(0).setMat4("model", model);
-        renderModel.Draw(shaders.at(0));
+        renderModel.Draw();
 
         // do some things needed for window management. e.g., swap buffers, draw GUI, poll events ....
         if (gui) ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
     }
 
+    // destroy the loaded models and textures while the OpenGL context still exists
+    modelRegistry().Clear();
+    textureRegistry().Clear();
     DestroyWindow();
     return 0;
 }
@@ -440,8 +445,8 @@ void renderQuad(void)
         // configure plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glState().BindVertexArray(quadVAO);
+        glState().BindBuffer(GL_ARRAY_BUFFER, quadVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
@@ -454,9 +459,8 @@ void renderQuad(void)
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(11 * sizeof(float)));
     }
-    glBindVertexArray(quadVAO);
+    glState().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
 
@@ -499,7 +503,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    glState().Viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
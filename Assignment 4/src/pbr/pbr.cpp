@@ -19,6 +19,7 @@
 #include <util/model.h>
 #include <util/window.h>
 #include <util/assets.h>
+#include <util/primitives.h>
 
 
 
@@ -76,7 +77,15 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-void renderSphere();
+
+// per instance data of the instanced draws, as read by pbr.vs.glsl from the buffer at PRIMITIVE_INSTANCE_BINDING (std430)
+struct PbrInstance {
+    glm::mat4 model;
+    glm::vec4 albedoMetallic; // rgb albedo, a metallic
+    glm::vec4 roughnessAO;    // r roughness, g ambient occlusion
+};
+std::vector<PbrInstance> buildMaterialSweep(int rows, int columns, float extent, const glm::mat4& transformation,
+                                            const glm::vec3& albedo, bool hues);
 
 // settings
 int SCR_WIDTH = 1280;
@@ -112,13 +121,19 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME);
+    // the assets of the demo are read from its pack if there is one (see src/tools/packer), otherwise from their files
+    FileSystem::mount("../resources/packs/pbr.pack");
+    // create the OpenGL objects of the assets on a second (shared) context, see util/upload_thread.h
+    uploadThread().Start(window);
+    // the demo doesn't need the vertices and indices on the CPU once they are uploaded
+    keepMeshGeometry = false;
 
 
     // OpenGL is initialized now, so we can use OpenGL functions (glFoo ...)
     // ------------------------------
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     //glDebugMessageCallback(MessageCallback, 0);
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    glState().Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
     SetCursorPosCallback(mouse_callback);
     SetMouseButtonCallback(mouse_button_callback);  
@@ -127,36 +142,62 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
 
 
     // loaded model
     // -------------------------
+    // (the first group is loaded right away, the others are streamed in the background when they are selected)
     assets.SetActiveGroup("sphere");
-    Model loadedModel = assets.GetActiveAsset<Model>("model"); // new Model(FileSystem::getPath("resources/objects/cerberus/Cerberus_LP.FBX").c_str());
+    // read the files of the scene in one batch (see util/async_io.h), the loads below take the buffers
+    asyncIO().Prefetch({ "../src/pbr/pbr.vs.glsl", "../src/pbr/pbr.fs.glsl" });
+    assets.Prefetch("sphere");
+    AssetHandle<Model> loadedModel = assets.FindActiveModel("model"); // new Model(FileSystem::getPath("resources/objects/cerberus/Cerberus_LP.FBX").c_str());
     glm::mat4 modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
     //loadedModel = backpack.getModel();
 
     // load PBR material textures
     // --------------------------
-    unsigned int albedoMap = assets.GetActiveAsset<Tex>("albedo"); //loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_A.tga").c_str());
-    unsigned int normalMap = assets.GetActiveAsset<Tex>("normal"); //     = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_N.tga").c_str());
-    unsigned int metallicMap = assets.GetActiveAsset<Tex>("metallness"); //   = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_M.tga").c_str());
-    unsigned int roughnessMap = assets.GetActiveAsset<Tex>("roughness"); //  = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_R.tga").c_str());
-    unsigned int aoMap = assets.GetActiveAsset<Tex>("ao"); //        = loadTexture(FileSystem::getPath("resources/textures/pbr/rusted_iron/ao.png").c_str());
+    AssetHandle<Tex> albedoMap = assets.FindActiveTexture("albedo"); //loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_A.tga").c_str());
+    AssetHandle<Tex> normalMap = assets.FindActiveTexture("normal"); //     = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_N.tga").c_str());
+    // (the separate metallic, roughness and AO maps are only loaded when the packed ORM texture is turned off, see
+    // loadSeparateMaps below)
+    AssetHandle<Tex> metallicMap, roughnessMap, aoMap;
+    // (ambient occlusion, roughness and metallic packed into one texture, see AssetManager::FindOrmTexture)
+    AssetHandle<Tex> ormMap = assets.FindActiveOrmTexture();
+    assets.SetAsync(true);
 
 
 
     // build and compile shaders
     // -------------------------
-    Shader shader("../src/pbr/pbr.vs.glsl", "../src/pbr/pbr.fs.glsl");
-
-    shader.use();
-    shader.setInt("albedoMap", 0);
-    shader.setInt("normalMap", 1);
-    shader.setInt("metallicMap", 2);
-    shader.setInt("roughnessMap", 3);
-    shader.setInt("aoMap", 4);
+    // (the PACKED_ORM variant reads the packed texture: 3 samplers per draw instead of 5)
+    Shader separateShader("../src/pbr/pbr.vs.glsl", "../src/pbr/pbr.fs.glsl");
+    Shader ormShader({ "PACKED_ORM" }, "../src/pbr/pbr.vs.glsl", "../src/pbr/pbr.fs.glsl");
+    bool packedOrm = true;
+    auto setSamplers = [&]() {
+        separateShader.use();
+        separateShader.setInt("albedoMap", 0);
+        separateShader.setInt("normalMap", 1);
+        separateShader.setInt("metallicMap", 2);
+        separateShader.setInt("roughnessMap", 3);
+        separateShader.setInt("aoMap", 4);
+        ormShader.use();
+        ormShader.setInt("albedoMap", 0);
+        ormShader.setInt("normalMap", 1);
+        ormShader.setInt("ormMap", 2);
+    };
+    setSamplers();
+    // GPU memory of the packed texture and of the separate maps (each measured once it is loaded, 0 until then)
+    size_t separateBytes = 0, packedBytes = 0;
+    AssetHandle<Tex> measuredOrm;
+    // loads the separate maps of the active group for the comparison with the packed texture
+    auto loadSeparateMaps = [&]() {
+        metallicMap = assets.FindActiveTexture("metallness"); //   = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_M.tga").c_str());
+        roughnessMap = assets.FindActiveTexture("roughness"); //  = loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_R.tga").c_str());
+        aoMap = assets.FindActiveTexture("ao"); //        = loadTexture(FileSystem::getPath("resources/textures/pbr/rusted_iron/ao.png").c_str());
+        separateBytes = 0;
+    };
 
 
 
@@ -176,22 +217,42 @@ int main()
         glm::vec3(300.0f, 300.0f, 300.0f),
         glm::vec3(300.0f, 300.0f, 300.0f)
     };
-    int nrRows = 7;
-    int nrColumns = 7;
-    float spacing = 2.5;
+    const unsigned int numLights = sizeof(lightPositions) / sizeof(lightPositions[0]);
+    // material sweep (a stress test of the shading): a grid of sweepRows x sweepColumns instances of the sphere or of
+    // the model, drawn with one instanced draw (one per mesh of the model) that reads the transformation and the
+    // material of every instance from the instance buffer
+    bool materialSweep = false;
+    bool sweepModels = false; // instances of the loaded model instead of spheres
+    bool sweepHues = false;   // albedo hues across the grid instead of the albedo color
+    int sweepRows = 7;
+    int sweepColumns = 7;
+    const float SWEEP_EXTENT = 17.5f; // size of the grid (7 spheres 2.5 apart), more instances are smaller
+    int sphereLod = 0;
+    // the instances: the light markers first, then the sweep (only rebuilt when its settings change)
+    GLBuffer instanceBuffer = createBuffer();
+    size_t instanceCapacity = 0;
+    bool sweepDirty = true;
+    GLsizei sweepInstances = 0;
+    // GPU time of the sweep draw, read back SWEEP_QUERIES frames later (so it doesn't wait for the GPU)
+    const int SWEEP_QUERIES = 4;
+    GLuint sweepQueries[SWEEP_QUERIES];
+    glGenQueries(SWEEP_QUERIES, sweepQueries);
+    bool sweepQueryIssued[SWEEP_QUERIES] = {};
+    unsigned int sweepFrame = 0;
+    float sweepGpuMs = 0.0f;
 
     // initialize static shader uniforms before rendering
     // --------------------------------------------------
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    shader.use();
-    shader.setMat4("projection", projection);
+    separateShader.use();
+    separateShader.setMat4("projection", projection);
+    ormShader.use();
+    ormShader.setMat4("projection", projection);
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
-        glEnable(GL_DEPTH_TEST);
-
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
@@ -204,6 +265,10 @@ int main()
         // input
         // -----
         processInput(window);
+
+        // create the GPU resources of assets that finished loading in the background (within the upload budget)
+        asyncLoader().Update();
+
         if (gui) {
             // Start the Dear ImGui frame
             ImGui_ImplOpenGL3_NewFrame();
@@ -217,7 +282,7 @@ int main()
                 ImGui::SliderFloat("gamma", &gamma, 0.1f, 5.0f);   // Edit 1 float using a slider from 0.0f to 1.0f
                 ImGui::Checkbox("use textures", &useTextures);
                 if (!useTextures) {
-                    ImGui::ColorEdit3("albedo", (float*)&albedo.x); // Edit 3 floats representing a color
+                    sweepDirty |= ImGui::ColorEdit3("albedo", (float*)&albedo.x); // Edit 3 floats representing a color
                     ImGui::SliderFloat("roughness", &roughness, 0.05f, 1.0f);
                     ImGui::SliderFloat("matallic", &metallic, 0, 1);
                 }
@@ -232,26 +297,72 @@ int main()
                 if (assets.GetActiveGroupId() != item_current)
                 {
                     assets.SetActiveGroup(item_current);
+                    assets.Prefetch(assets.GetActiveGroup());
                     // loaded model and (PBR) texutes
                     // -------------------------
-                    loadedModel = assets.GetActiveAsset<Model>("model"); 
+                    loadedModel = assets.FindActiveModel("model");
                     modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
-                    albedoMap = assets.GetActiveAsset<Tex>("albedo"); 
-                    normalMap = assets.GetActiveAsset<Tex>("normal"); 
-                    metallicMap = assets.GetActiveAsset<Tex>("metallness"); 
-                    roughnessMap = assets.GetActiveAsset<Tex>("roughness"); 
-                    aoMap = assets.GetActiveAsset<Tex>("ao"); 
-
+                    albedoMap = assets.FindActiveTexture("albedo");
+                    normalMap = assets.FindActiveTexture("normal");
+                    ormMap = assets.FindActiveOrmTexture();
+                    if (packedOrm)
+                        metallicMap = roughnessMap = aoMap = AssetHandle<Tex>();
+                    else
+                        loadSeparateMaps();
+                    sweepDirty = true;
+                }
+                AsyncLoader::Stats loads = asyncLoader().GetStats();
+                ImGui::Text("loading: %u queued, %u decoding, %u uploading (%.2f MB this frame)", loads.queued, loads.loading, loads.uploading, loads.bytesUploaded / (1024.0f * 1024.0f));
+                ImGui::Text("load latency: last %.0f ms, avg %.0f ms, max %.0f ms", loads.lastLatencyMs, loads.averageLatencyMs, loads.maxLatencyMs);
+                MemoryUsage memory = assets.Get(loadedModel).Memory();
+                ImGui::Text("model memory: %.2f MB CPU, %.2f MB GPU", memory.cpuBytes / (1024.0f * 1024.0f), memory.gpuBytes / (1024.0f * 1024.0f));
+                UploadThread::Stats gpu = uploadThread().GetStats();
+                ImGui::Text("upload thread: %u queued, %u fenced, last %.1f ms, max %.1f ms", gpu.queued, gpu.fenced, gpu.lastUploadMs, gpu.maxUploadMs);
+                AsyncIO::Stats reads = asyncIO().GetStats();
+                ImGui::Text("file reads (%s): %u files in %.0f ms, depth %u, latency avg %.0f ms, max %.0f ms", AsyncIO::BackendName(reads.backend),
+                            reads.files, reads.batchMs, reads.maxQueueDepth, reads.averageLatencyMs, reads.maxLatencyMs);
+                ImGui::SliderInt("sphere detail", &sphereLod, 0, (int)primitives().LevelCount(PRIMITIVE_SPHERE) - 1);
+                const Primitives::Level& sphereLevel = primitives().Get(PRIMITIVE_SPHERE, sphereLod);
+                ImGui::Text("sphere: %u triangles, %u vertices, ACMR %.2f", (unsigned int)sphereLevel.indexCount / 3,
+                            sphereLevel.vertexCount, sphereLevel.cacheMissRatio);
+                // (see buildMaterialSweep)
+                sweepDirty |= ImGui::Checkbox("material sweep", &materialSweep);
+                if (materialSweep)
+                {
+                    sweepDirty |= ImGui::SliderInt("sweep rows", &sweepRows, 1, 100);
+                    sweepDirty |= ImGui::SliderInt("sweep columns", &sweepColumns, 1, 100);
+                    sweepDirty |= ImGui::Checkbox("instances of the model", &sweepModels);
+                    sweepDirty |= ImGui::Checkbox("albedo hues", &sweepHues);
+                    if (useTextures)
+                        ImGui::Text("(the sweep ignores the textures, every instance keeps its material)");
+                    Model& sweepModel = assets.Get(loadedModel);
+                    double triangles = (double)sweepInstances * (sweepModels ? sweepModel.NumTriangles() : sphereLevel.indexCount / 3);
+                    ImGui::Text("sweep: %d instances, %.2f M triangles, %d draw calls, %.2f ms GPU (%.1f k instances/ms)", sweepInstances,
+                                triangles / 1e6, sweepModels ? (int)sweepModel.meshes.size() : 1, sweepGpuMs,
+                                sweepGpuMs > 0.0f ? sweepInstances / sweepGpuMs / 1000.0f : 0.0f);
                 }
+                if (ImGui::Checkbox("packed ORM texture", &packedOrm) && !packedOrm && !aoMap.Valid())
+                    loadSeparateMaps();
+                if (measuredOrm != ormMap && assets.Ready(ormMap))
+                {
+                    packedBytes = textureMemory(assets.Get(ormMap));
+                    measuredOrm = ormMap;
+                }
+                if (separateBytes == 0 && aoMap.Valid() && assets.Ready(aoMap) && assets.Ready(roughnessMap) && assets.Ready(metallicMap))
+                    separateBytes = textureMemory(assets.Get(aoMap)) + textureMemory(assets.Get(roughnessMap)) + textureMemory(assets.Get(metallicMap));
+                ImGui::Text("material samplers per draw: %d (%s)", packedOrm ? 3 : 5, packedOrm ? "albedo, normal, ORM" : "albedo, normal, metallic, roughness, AO");
+                // (the separate maps stay loaded once the comparison loaded them, so they are counted as long as they are)
+                if (measuredOrm == ormMap && separateBytes > 0)
+                    ImGui::Text("AO/roughness/metallic: %.2f MB packed + %.2f MB separate for the comparison (packing saves %.2f MB)",
+                                packedBytes / (1024.0f * 1024.0f), separateBytes / (1024.0f * 1024.0f),
+                                ((float)separateBytes - (float)packedBytes) / (1024.0f * 1024.0f));
+                else if (measuredOrm == ormMap)
+                    ImGui::Text("AO/roughness/metallic: %.2f MB packed (separate maps not loaded)", packedBytes / (1024.0f * 1024.0f));
                 // a Button to reload the shader (so you don't need to recompile the cpp all the time)
                 if (ImGui::Button("reload shaders")) {
-                    shader.reload();
-                    shader.use();
-                    shader.setInt("albedoMap", 0);
-                    shader.setInt("normalMap", 1);
-                    shader.setInt("metallicMap", 2);
-                    shader.setInt("roughnessMap", 3);
-                    shader.setInt("aoMap", 4);
+                    separateShader.reload();
+                    ormShader.reload();
+                    setSamplers();
                 }
 
                 ImGui::End();
@@ -264,15 +375,16 @@ int main()
         if (gui) ImGui::Render();
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
+        glState().Viewport(0, 0, display_w, display_h);
         glClearColor(0.0, 0.0, 0.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
         // configure global opengl state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
+        glState().Enable(GL_DEPTH_TEST);
+        glState().Disable(GL_BLEND);
 
+        Shader& shader = packedOrm ? ormShader : separateShader;
         shader.use();
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         shader.setMat4("projection", projection);
@@ -285,30 +397,43 @@ int main()
         shader.setFloat("Roughness", glm::clamp(roughness, 0.05f, 1.0f)); //  we clamp the roughness to 0.05 - 1.0 as perfectly smooth surfaces (roughness of 0.0) tend to look a bit off  on direct lighting.
         shader.setFloat("gamma", gamma);
         shader.setFloat("useTextures", useTextures ? 1.0f : 0.0f);
+        shader.setBool("instanced", false);
 
         if (useTextures)
         {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, albedoMap);
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, normalMap);
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, metallicMap);
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, roughnessMap);
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, aoMap);
+            glState().ActiveTexture(GL_TEXTURE0);
+            glState().BindTexture(GL_TEXTURE_2D, assets.Get(albedoMap));
+            glState().ActiveTexture(GL_TEXTURE1);
+            glState().BindTexture(GL_TEXTURE_2D, assets.Get(normalMap));
+            if (packedOrm)
+            {
+                glState().ActiveTexture(GL_TEXTURE2);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(ormMap));
+            }
+            else
+            {
+                glState().ActiveTexture(GL_TEXTURE2);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(metallicMap));
+                glState().ActiveTexture(GL_TEXTURE3);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(roughnessMap));
+                glState().ActiveTexture(GL_TEXTURE4);
+                glState().BindTexture(GL_TEXTURE_2D, assets.Get(aoMap));
+            }
         }
         
         auto model = (glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f))) * modelTransformation;
-        shader.setMat4("model", model);
-        shader.setFloat("roughness", 0.05f);
-        loadedModel.Draw(shader);
+        if (!materialSweep)
+        {
+            shader.setMat4("model", model);
+            shader.setFloat("roughness", 0.05f);
+            assets.Get(loadedModel).Draw();
+        }
 
         // render light source (simply re-render sphere at light positions)
         // this looks a bit off as we use the same shader, but it'll make their positions obvious and 
         // keeps the codeprint small.
-        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); ++i)
+        std::vector<PbrInstance> lights;
+        for (unsigned int i = 0; i < numLights; ++i)
         {
             glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
             newPos = lightPositions[i];
@@ -318,8 +443,57 @@ int main()
             model = glm::mat4(1.0f);
             model = glm::translate(model, newPos);
             model = glm::scale(model, glm::vec3(0.5f));
-            shader.setMat4("model", model);
-            renderSphere();
+            lights.push_back({ model, glm::vec4(albedo, metallic), glm::vec4(glm::clamp(roughness, 0.05f, 1.0f), 1.0f, 0.0f, 0.0f) });
+        }
+        glState().BindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+        if (sweepDirty)
+        {
+            std::vector<PbrInstance> sweep;
+            if (materialSweep)
+                sweep = buildMaterialSweep(sweepRows, sweepColumns, SWEEP_EXTENT, sweepModels ? modelTransformation : glm::mat4(1.0f), albedo, sweepHues);
+            sweepInstances = (GLsizei)sweep.size();
+            size_t size = (numLights + sweep.size()) * sizeof(PbrInstance);
+            if (size > instanceCapacity)
+            {
+                glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+                instanceCapacity = size;
+            }
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, numLights * sizeof(PbrInstance), sweep.size() * sizeof(PbrInstance), sweep.data());
+            sweepDirty = false;
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lights.size() * sizeof(PbrInstance), lights.data());
+        glState().BindBufferBase(GL_SHADER_STORAGE_BUFFER, PRIMITIVE_INSTANCE_BINDING, instanceBuffer);
+        shader.setBool("instanced", true);
+        primitives().Draw(PRIMITIVE_SPHERE, sphereLod, numLights);
+
+        // the material sweep, in one draw (per mesh)
+        if (materialSweep && sweepInstances > 0)
+        {
+            // (the query of this slot was issued SWEEP_QUERIES frames ago, it's skipped if the GPU isn't done with it yet)
+            int slot = sweepFrame % SWEEP_QUERIES;
+            GLint available = 1;
+            if (sweepQueryIssued[slot])
+            {
+                glGetQueryObjectiv(sweepQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint64 nanoseconds = 0;
+                    glGetQueryObjectui64v(sweepQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+                    sweepGpuMs = nanoseconds / 1e6f;
+                }
+            }
+            if (available)
+                glBeginQuery(GL_TIME_ELAPSED, sweepQueries[slot]);
+            if (sweepModels)
+                assets.Get(loadedModel).DrawInstanced(sweepInstances, numLights);
+            else
+                primitives().Draw(PRIMITIVE_SPHERE, sphereLod, sweepInstances, numLights);
+            if (available)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                sweepQueryIssued[slot] = true;
+                sweepFrame++;
+            }
         }
 
 
@@ -329,12 +503,50 @@ int main()
         glfwSwapBuffers(window);
     }
 
+    glDeleteQueries(SWEEP_QUERIES, sweepQueries);
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // destroy the loaded models and textures while the OpenGL context still exists
+    modelRegistry().Clear();
+    textureRegistry().Clear();
+    uploadThread().Stop();
     glfwTerminate();
     return 0;
 }
 
+// buildMaterialSweep() places rows x columns instances in a grid of the given size (in the XY plane at z = -2),
+// metallic grows from 0 in the bottom row to 1 in the top one, roughness from 0.05 in the left column to 1 in the right
+// one. The albedo is the given color or, with hues, a hue that changes across the grid.
+// ---------------------------------------------------------------------------------------------------------------------
+std::vector<PbrInstance> buildMaterialSweep(int rows, int columns, float extent, const glm::mat4& transformation,
+                                            const glm::vec3& albedo, bool hues)
+{
+    const float PI = 3.14159265359f;
+    float spacing = extent / std::max(rows, columns);
+    std::vector<PbrInstance> instances;
+    instances.reserve((size_t)rows * columns);
+    for (int row = 0; row < rows; ++row)
+    {
+        float metallic = rows > 1 ? (float)row / (float)(rows - 1) : 0.0f;
+        for (int col = 0; col < columns; ++col)
+        {
+            float roughness = glm::clamp(columns > 1 ? (float)col / (float)(columns - 1) : 0.0f, 0.05f, 1.0f);
+            glm::vec3 color = albedo;
+            if (hues)
+            {
+                float t = (float)(row + col) / (float)(rows + columns);
+                color = 0.5f + 0.5f * glm::cos(2.0f * PI * (t + glm::vec3(0.0f, 1.0f / 3.0f, 2.0f / 3.0f)));
+            }
+            glm::vec3 position((col - (columns - 1) * 0.5f) * spacing, (row - (rows - 1) * 0.5f) * spacing, -2.0f);
+            // (a sphere of radius 1 fills 0.8 of its cell)
+            glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.4f * spacing)) * transformation;
+            instances.push_back({ model, glm::vec4(color, metallic), glm::vec4(roughness, 1.0f, 0.0f, 0.0f) });
+        }
+    }
+    return instances;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -358,7 +570,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    glState().Viewport(0, 0, width, height);
     SCR_WIDTH = width; SCR_HEIGHT = height;
 }
 
@@ -405,102 +617,3 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(yoffset);
 }
-
-// renders (and builds at first invocation) a sphere
-// -------------------------------------------------
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere()
-{
-    if (sphereVAO == 0)
-    {
-        glGenVertexArrays(1, &sphereVAO);
-
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uv;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
-
-        const unsigned int X_SEGMENTS = 64;
-        const unsigned int Y_SEGMENTS = 64;
-        const float PI = 3.14159265359;
-        for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
-        {
-            for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-            {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                uv.push_back(glm::vec2(xSegment, ySegment));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
-            }
-        }
-
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
-        {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
-            {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
-            }
-            else
-            {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y       * (X_SEGMENTS + 1) + x);
-                }
-            }
-            oddRow = !oddRow;
-        }
-        indexCount = indices.size();
-
-        std::vector<float> data;
-        for (std::size_t i = 0; i < positions.size(); ++i)
-        {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-            if (normals.size() > 0)
-            {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
-            }
-            if (uv.size() > 0)
-            {
-                data.push_back(uv[i].x);
-                data.push_back(uv[i].y);
-            }
-        }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        float stride = (3 + 2 + 3) * sizeof(float);
-        // make sure that this matches the layout in the vertex shader!
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    }
-
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
-}
-
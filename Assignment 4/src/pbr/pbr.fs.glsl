@@ -5,20 +5,29 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 WorldPos;
 in vec3 Normal;
+flat in vec4 InstanceAlbedoMetallic;
+flat in vec2 InstanceRoughnessAO;
 
 // material parameters
 uniform vec3 Albedo;
 uniform float Metallic;
 uniform float Roughness;
 uniform float AO;
+// (instanced draws take them from the instance, see pbr.vs.glsl)
+uniform bool instanced;
 uniform float gamma;
 // material parameters from Textures
 uniform float useTextures;
 uniform sampler2D albedoMap;
 uniform sampler2D normalMap;
+#ifdef PACKED_ORM
+// r ambient occlusion, g roughness, b metallic in one texture (see AssetManager::FindOrmTexture)
+uniform sampler2D ormMap;
+#else
 uniform sampler2D metallicMap;
 uniform sampler2D roughnessMap;
 uniform sampler2D aoMap;
+#endif
 
 // lights
 uniform vec3 lightPositions[4];
@@ -94,17 +103,25 @@ void main()
 {
     vec3 N = normalize(Normal);
     vec3 V = normalize(camPos - WorldPos);
-    vec3 albedo = Albedo;
-    float metallic = Metallic;
-    float roughness = Roughness;
-    float ao = AO;
+    vec3 albedo = instanced ? InstanceAlbedoMetallic.rgb : Albedo;
+    float metallic = instanced ? InstanceAlbedoMetallic.a : Metallic;
+    float roughness = instanced ? InstanceRoughnessAO.x : Roughness;
+    float ao = instanced ? InstanceRoughnessAO.y : AO;
 
-    if (useTextures > 0)
+    // (the instances of the material sweep keep their own materials, the textures would give all of them the same one)
+    if (useTextures > 0 && !instanced)
     {
         albedo = pow(texture(albedoMap, TexCoords).rgb, vec3(2.2));
+#ifdef PACKED_ORM
+        vec3 orm = texture(ormMap, TexCoords).rgb;
+        ao = orm.r;
+        roughness = orm.g;
+        metallic = orm.b;
+#else
         metallic = texture(metallicMap, TexCoords).r;
         roughness = texture(roughnessMap, TexCoords).r;
         ao = texture(aoMap, TexCoords).r;
+#endif
 
         N = getNormalFromMap();
     }
@@ -2,22 +2,48 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawId; // (baseInstance + instance, see util/arena.h)
 
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
+flat out vec4 InstanceAlbedoMetallic;
+flat out vec2 InstanceRoughnessAO;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+// instanced draws read the model matrix and the material of the instance from the buffer at PRIMITIVE_INSTANCE_BINDING
+// instead (see PbrInstance in pbr.cpp)
+uniform bool instanced;
+struct Instance {
+    mat4 model;
+    vec4 albedoMetallic; // rgb albedo, a metallic
+    vec4 roughnessAO;    // r roughness, g ambient occlusion
+};
+layout (std430, binding = 3) readonly buffer InstanceBuffer { Instance instances[]; };
 
 void main()
 {
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
+    if (instanced)
+    {
+        // (the instances are only translated and uniformly scaled, their model matrix is a normal matrix)
+        mat4 M = instances[aDrawId].model;
+        InstanceAlbedoMetallic = instances[aDrawId].albedoMetallic;
+        InstanceRoughnessAO = instances[aDrawId].roughnessAO.rg;
+        WorldPos = vec3(M * vec4(aPos, 1.0));
+        Normal = mat3(M) * aNormal;
+    }
+    else
+    {
+        InstanceAlbedoMetallic = vec4(0.0);
+        InstanceRoughnessAO = vec2(0.0);
+        WorldPos = vec3(model * vec4(aPos, 1.0));
 
-    mat4 normalMatrix = transpose(inverse(model)); // better do this on the CPU only once!
-    Normal = mat3(normalMatrix) * aNormal;
+        mat4 normalMatrix = transpose(inverse(model)); // better do this on the CPU only once!
+        Normal = mat3(normalMatrix) * aNormal;
+    }
 
     gl_Position =  projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
@@ -1,15 +1,45 @@
-#version 330 core
+#version 430 core
 layout (location = 0) out vec4 gFragColor;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
+flat in uint Material;
 
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_specular1;
+// material table (see util/material.h)
+struct MaterialData {
+    uint diffuse; // texture references: (pool << 16) | layer, 0xFFFFFFFF if not set
+    uint specular;
+    uint normal;
+    uint height;
+    vec4 baseColor;
+};
+layout (std430, binding = 1) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+layout (binding = 8) uniform sampler2DArray materialTextures[8];
+
+vec4 sampleMaterialTexture(uint reference, vec2 uv, vec4 fallback)
+{
+    if (reference == 0xFFFFFFFFu)
+        return fallback;
+    vec3 coord = vec3(uv, float(reference & 0xFFFFu));
+    // (the pool is the same for all fragments of a draw, so a switch over constant indices is fine)
+    switch (reference >> 16)
+    {
+        case 0u: return texture(materialTextures[0], coord);
+        case 1u: return texture(materialTextures[1], coord);
+        case 2u: return texture(materialTextures[2], coord);
+        case 3u: return texture(materialTextures[3], coord);
+        case 4u: return texture(materialTextures[4], coord);
+        case 5u: return texture(materialTextures[5], coord);
+        case 6u: return texture(materialTextures[6], coord);
+        default: return texture(materialTextures[7], coord);
+    }
+}
 
 void main()
 {    
     // the diffuse color
-    gFragColor.rgba = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
+    gFragColor.rgba = vec4(sampleMaterialTexture(materials[Material].diffuse, TexCoords, materials[Material].baseColor).rgb, 1.0);
 }
\ No newline at end of file
@@ -9,8 +9,11 @@
 #include <util/shader.h>
 #include <util/camera.h>
 #include <util/model.h>
+#include <util/render_queue.h>
+#include <util/uniform_ring.h>
 #include <util/assets.h>
 #include <util/window.h>
+#include <util/primitives.h>
 
 #include <iostream>
 
@@ -20,8 +23,6 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 //unsigned int loadTexture(const char *path, bool gammaCorrection);
-void renderQuad();
-void renderCube();
 
 // settings
 int SCR_WIDTH = 1024;
@@ -67,7 +68,9 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
+    // per frame constants and per draw data are streamed through a (triple buffered) ring buffer
+    uniformRing().Init(1024 * 1024);
 
     // build and compile shaders
     // -------------------------
@@ -93,6 +96,7 @@ int main()
     // load models
     // -----------
     Model myModel(FileSystem::getPath("resources/objects/buddha2/buddha.obj"), true);
+    RenderQueue renderQueue;
 
     // shader configuration
     // --------------------
@@ -106,11 +110,11 @@ int main()
     // -------------------------
     unsigned int framebuffer;
     glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     // create a color attachment texture
     unsigned int textureColorbuffer;
     glGenTextures(1, &textureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
+    glState().BindTexture(GL_TEXTURE_2D, textureColorbuffer);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -124,7 +128,7 @@ int main()
     // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
     // render loop
     // -----------
@@ -135,6 +139,8 @@ int main()
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        glState().BeginFrame();
+        uniformRing().BeginFrame();
 
         // Poll and handle events (inputs, window resize, etc.)
         glfwPollEvents();
@@ -169,6 +175,7 @@ int main()
 
                 ImGui::SliderFloat("kernel size", &kernelSize, 0.1, 20);
                 ImGui::Checkbox("show wireframe", &showWireframe);
+                ImGui::Text("GL state calls: %u issued, %u elided", glState().lastFrame.issued, glState().lastFrame.elided);
 
                 // a Button to reload the shader (so you don't need to recompile the cpp all the time)
                 if (ImGui::Button("reload shaders")) {
@@ -189,8 +196,8 @@ int main()
         // render
         // ------
         // bind to framebuffer and draw scene as we normally would to color texture 
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
+        glState().BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glState().Enable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
 
         // make sure we clear the framebuffer's content
         glClearColor(bgColor.r, bgColor.g, bgColor.b, bgColor.a);
@@ -201,15 +208,15 @@ int main()
         if (rotateModel) model = glm::rotate(model, currentFrame, glm::vec3(0, 1, 0));
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        modelShader.setMat4("model", model);
-        modelShader.setMat4("view", view);
-        modelShader.setMat4("projection", projection);
-        // draw the model
-        myModel.Draw(modelShader);
+        bindFrameData(view, projection, camera.Position, currentFrame, deltaTime);
+        // draw the model (its meshes sorted by material and depth)
+        renderQueue.Begin(camera.Position);
+        renderQueue.Add(modelShader, myModel, model);
+        renderQueue.Submit();
 
         // now bind back to default framebuffer and draw a quad plane with the attached framebuffer color texture
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().Disable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
         // clear all relevant buffers
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear color to white (not really necessery actually, since we won't be able to see behind the quad anyways)
         glClear(GL_COLOR_BUFFER_BIT);
@@ -222,8 +229,9 @@ int main()
         auto randomNumber = ((double)rand() / (RAND_MAX));
         activeShader->setFloat("randomNumber", randomNumber);
         activeShader->setFloat("timer", currentFrame);
-        glBindTexture(GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
-        renderQuad();
+        glState().BindTextureUnit(0, GL_TEXTURE_2D, textureColorbuffer);	// use the color attachment texture as the texture of the quad plane
+        primitives().Draw(PRIMITIVE_QUAD);
+        uniformRing().EndFrame();
 
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -237,37 +245,6 @@ int main()
     return 0;
 }
 
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -291,7 +268,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    glState().Viewport(0, 0, width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -10,10 +10,14 @@
 #include <util/shader.h>
 #include <util/camera.h>
 #include <util/model.h>
+#include <util/render_queue.h>
+#include <util/uniform_ring.h>
 #include <util/assets.h>
 #include <util/window.h>
+#include <util/primitives.h>
 
 #include <iostream>
+#include <memory>
 
 // --- ASSETS ---
 // models and textures used in this tutorial
@@ -55,10 +59,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void mouse_button_callback(GLFWwindow * window, int button, int action, int mods);
 void processInput(GLFWwindow *window);
-void renderScene(const Shader &shader);
-//void renderCube();
-void renderQuad();
-void renderFloor();
+void buildScene(RenderQueue &queue, const Shader &shader);
+Mesh createFloor();
 
 // settings
 int SCR_WIDTH = 1024;
@@ -77,8 +79,11 @@ bool rightButtonDown = false;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// global textures
-unsigned int floorTexture;
+// scene objects (geometry lives in the geometry arena, textures in the material table)
+std::unique_ptr<Mesh> floorMesh;
+AssetHandle<Model> cubeModel, activeModel;
+const glm::mat4* activeTransformation;
+unsigned int floorMaterial, cubeMaterial, modelMaterial;
 
 const char* APP_NAME = "shadow_mapping";
 int main()
@@ -94,6 +99,8 @@ int main()
     // glfw: initialize and configure
     // ------------------------------
     InitWindowAndGUI(SCR_WIDTH, SCR_HEIGHT, APP_NAME);
+    // the assets of the demo are read from its pack if there is one (see src/tools/packer), otherwise from their files
+    FileSystem::mount("../resources/packs/shadow_mapping.pack");
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE); // avoid resizing the window!
 
     SetCursorPosCallback(mouse_callback);
@@ -103,7 +110,9 @@ int main()
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
+    glState().Enable(GL_DEPTH_TEST);
+    // per frame constants and per draw data are streamed through a (triple buffered) ring buffer
+    uniformRing().Init(1024 * 1024);
 
     // loaded model(s) and textures
     // -------------------------
@@ -117,9 +126,24 @@ int main()
 
 
 
-    // load texture for the floor!
+    // create the materials (the textures end up in the texture arrays of the material table)
     // -------------
-    floorTexture = loadTexture("../resources/textures/toy_box_diffuse.png");
+    Material material;
+    material.diffuse = materialTable().LoadTexture("../resources/textures/toy_box_diffuse.png");
+    floorMaterial = materialTable().Create(material);
+    material.diffuse = materialTable().LoadTexture(assets.GetAsset<const char*>("cube", "albedo"));
+    cubeMaterial = materialTable().Create(material);
+    material.diffuse = materialTable().LoadTexture(assets.GetActiveAsset<const char*>("albedo"));
+    modelMaterial = materialTable().Create(material);
+
+    // resolve the models once (buildScene only uses the handles) and create the floor
+    floorMesh = std::make_unique<Mesh>(createFloor());
+    cubeModel = assets.FindModel("cube", "model");
+    activeModel = assets.FindModel(assets.GetActiveGroup(), "model");
+    activeTransformation = &assets.GetActiveAsset<glm::mat4>("transformation");
+
+    // one render queue per pass (sorted front to back as seen from the light and from the camera)
+    RenderQueue depthQueue, sceneQueue;
 
     // configure depth map FBO
     // -----------------------
@@ -129,7 +153,7 @@ int main()
     // create depth texture
     unsigned int depthMap;
     glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
+    glState().BindTexture(GL_TEXTURE_2D, depthMap);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -138,17 +162,16 @@ int main()
     float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
     glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
     // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
     // shader configuration
     // --------------------
     shader.use();
-    shader.setInt("diffuseTexture", 0);
     shader.setInt("shadowMap", 1);
     debugDepthQuad.use();
     debugDepthQuad.setInt("depthMap", 0);
@@ -166,6 +189,8 @@ int main()
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        glState().BeginFrame();
+        uniformRing().BeginFrame();
 
         // Poll and handle events (inputs, window resize, etc.)
         glfwPollEvents();
@@ -189,6 +214,10 @@ int main()
                 ImGui::SliderFloat("shadow bias", &shadowBias, 0.000001, 0.1);
                 ImGui::Checkbox("soft shadow", &usePCF);
                 ImGui::Checkbox("show shadowmap", &showShadowMap);
+                ImGui::Text("draws: %u, multi-draw calls: %u (depth pass: %u)", sceneQueue.stats.items, sceneQueue.stats.batches, depthQueue.stats.batches);
+                ImGui::Text("program changes: %u, material changes: %u (unsorted: %u)", sceneQueue.stats.programChanges, sceneQueue.stats.materialChanges, sceneQueue.stats.materialChangesUnsorted);
+                ImGui::Text("GL state calls: %u issued, %u elided", glState().lastFrame.issued, glState().lastFrame.elided);
+                ImGui::Text("materials: %u, textures: %u in %u array(s)", materialTable().NumMaterials(), materialTable().NumTextures(), materialTable().NumPools());
 
 
                 //ImGui::SliderFloat("kernel size", &kernelSize, 0.1, 20);
@@ -232,45 +261,45 @@ int main()
         simpleDepthShader.use();
         simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
 
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+        glState().Viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        glState().BindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
         glClear(GL_DEPTH_BUFFER_BIT);
-        renderScene(simpleDepthShader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // reset viewport
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        depthQueue.Begin(lightPos);
+        buildScene(depthQueue, simpleDepthShader);
+        depthQueue.Submit(false); // no materials needed
+        glState().BindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 2. render scene as normal using the generated depth/shadow map  
         // --------------------------------------------------------------
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glState().Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         shader.use();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
+        bindFrameData(view, projection, camera.Position, currentFrame, deltaTime);
         // set light uniforms
-        shader.setVec3("viewPos", camera.Position);
         shader.setVec3("lightPos", lightPos);
         shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
         // other settings
         shader.setBool("usePCF", usePCF);
         shader.setFloat("bias", shadowBias);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        renderScene(shader);
+        glState().BindTextureUnit(1, GL_TEXTURE_2D, depthMap);
+        sceneQueue.Begin(camera.Position);
+        buildScene(sceneQueue, shader);
+        sceneQueue.Submit();
 
         // render Depth map to quad for visual debugging
         // ---------------------------------------------
-        debugDepthQuad.use();
-        debugDepthQuad.setFloat("near_plane", near_plane);
-        debugDepthQuad.setFloat("far_plane", far_plane);
-        debugDepthQuad.setBool("orthographic_proj", orthographicLight);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        if(showShadowMap) renderQuad();
+        if (showShadowMap)
+        {
+            debugDepthQuad.use();
+            debugDepthQuad.setFloat("near_plane", near_plane);
+            debugDepthQuad.setFloat("far_plane", far_plane);
+            debugDepthQuad.setBool("orthographic_proj", orthographicLight);
+            glState().BindTextureUnit(0, GL_TEXTURE_2D, depthMap);
+            primitives().Draw(PRIMITIVE_QUAD);
+        }
+        uniformRing().EndFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -278,199 +307,67 @@ int main()
         glfwSwapBuffers(window);
     }
 
+    // destroy the loaded models and textures while the OpenGL context still exists
+    modelRegistry().Clear();
+    textureRegistry().Clear();
+    floorMesh.reset();
     glfwTerminate();
     return 0;
 }
 
-// renders the 3D scene
-// --------------------
-void renderScene(const Shader &shader)
+// adds the draws of the 3D scene to the queue
+// --------------------------------------------
+void buildScene(RenderQueue &queue, const Shader &shader)
 {
+    const Model& cube = AssetManager::Get(cubeModel);
     auto model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, floorTexture);
-    renderFloor();
+    queue.Add(shader, *floorMesh, model, 0, floorMaterial);
 
     // (loaded) cubes
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-2.0f, 1.5f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, assets.GetAsset<Tex>("cube", "albedo"));
-    assets.GetAsset<Model>("cube","model").Draw(shader);
+    queue.Add(shader, cube, model, 0, cubeMaterial);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
     model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    assets.GetAsset<Model>("cube", "model").Draw(shader);
+    queue.Add(shader, cube, model, 0, cubeMaterial);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
     model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
     model = glm::scale(model, glm::vec3(0.25));
-    shader.setMat4("model", model);
-    assets.GetAsset<Model>("cube", "model").Draw(shader);
+    queue.Add(shader, cube, model, 0, cubeMaterial);
 
     // a loaded model   
-    const glm::mat4 &modelTransformation = assets.GetActiveAsset<glm::mat4>("transformation");
-    unsigned int albedoMap = assets.GetActiveAsset<Tex>("albedo"); //loadTexture(FileSystem::getPath("resources/objects/cerberus/Textures/Cerberus_A.tga").c_str());
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, albedoMap);
-    shader.setMat4("model", modelTransformation);
-    assets.GetActiveAsset<Model>("model").Draw(shader);
+    queue.Add(shader, AssetManager::Get(activeModel), *activeTransformation, 0, modelMaterial);
 }
 
 
-// renderFloor() renders a plane 25x25 at y = -0.5
-// -------------------------------------------------
-unsigned int planeVAO;
-void renderFloor()
+// createFloor() creates a plane 25x25 at y = -0.5 (as a mesh in the geometry arena)
+// ---------------------------------------------------------------------------------
+Mesh createFloor()
 {
-    // initialize (if necessary)
-    if (planeVAO == 0)
+    vector<Vertex> vertices(4);
+    float corners[4][4] = {
+        // x       z       u      v
+        {  25.0f,  25.0f, 25.0f,  0.0f },
+        { -25.0f,  25.0f,  0.0f,  0.0f },
+        { -25.0f, -25.0f,  0.0f, 25.0f },
+        {  25.0f, -25.0f, 25.0f, 25.0f }
+    };
+    for (int i = 0; i < 4; i++)
     {
-        // set up vertex data (and buffer(s)) and configure vertex attributes
-        // ------------------------------------------------------------------
-        float planeVertices[] = {
-            // positions            // normals         // texcoords
-             25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-            -25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
-            -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-
-             25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-            -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-             25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
-        };
-        // plane VAO
-        unsigned int planeVBO;
-        glGenVertexArrays(1, &planeVAO);
-        glGenBuffers(1, &planeVBO);
-        glBindVertexArray(planeVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindVertexArray(0);
+        vertices[i].Position = glm::vec3(corners[i][0], -0.5f, corners[i][1]);
+        vertices[i].Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        vertices[i].TexCoords = glm::vec2(corners[i][2], corners[i][3]);
+        vertices[i].Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+        vertices[i].Bitangent = glm::vec3(0.0f, 0.0f, -1.0f);
     }
-
-    // draw plane
-    glBindVertexArray(planeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
+    vector<unsigned int> indices = { 0, 1, 2, 0, 2, 3 };
+    return Mesh(vertices, indices);
 }
 
 
-// renderCube() renders a 1x1 3D cube in NDC.
-// -------------------------------------------------
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
-void renderCube()
-{
-    // initialize (if necessary)
-    if (cubeVAO == 0)
-    {
-        float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-            // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-            // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-             1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-        };
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex attributes
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-    }
-    // render Cube
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-}
-
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
-
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -496,7 +393,7 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // height will be significantly larger than specified on retina displays.
     if (width > 0 && height > 0)
     {
-        glViewport(0, 0, width, height);
+        glState().Viewport(0, 0, width, height);
         SCR_WIDTH = width;
         SCR_HEIGHT = height;
     }
@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
 in VS_OUT {
@@ -7,12 +7,52 @@ in VS_OUT {
     vec2 TexCoords;
     vec4 FragPosLightSpace;
 } fs_in;
+flat in uint Material;
+
+// material table (see util/material.h)
+struct MaterialData {
+    uint diffuse; // texture references: (pool << 16) | layer, 0xFFFFFFFF if not set
+    uint specular;
+    uint normal;
+    uint height;
+    vec4 baseColor;
+};
+layout (std430, binding = 1) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+layout (binding = 8) uniform sampler2DArray materialTextures[8];
+
+vec4 sampleMaterialTexture(uint reference, vec2 uv, vec4 fallback)
+{
+    if (reference == 0xFFFFFFFFu)
+        return fallback;
+    vec3 coord = vec3(uv, float(reference & 0xFFFFu));
+    // (the pool is the same for all fragments of a draw, so a switch over constant indices is fine)
+    switch (reference >> 16)
+    {
+        case 0u: return texture(materialTextures[0], coord);
+        case 1u: return texture(materialTextures[1], coord);
+        case 2u: return texture(materialTextures[2], coord);
+        case 3u: return texture(materialTextures[3], coord);
+        case 4u: return texture(materialTextures[4], coord);
+        case 5u: return texture(materialTextures[5], coord);
+        case 6u: return texture(materialTextures[6], coord);
+        default: return texture(materialTextures[7], coord);
+    }
+}
+
+// per frame constants (see util/uniform_ring.h)
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 time;
+};
 
-uniform sampler2D diffuseTexture;
 uniform sampler2D shadowMap;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 uniform bool usePCF;
 uniform float bias;
 
@@ -59,7 +99,7 @@ float ShadowCalculation(vec4 fragPosLightSpace)
 
 void main()
 {           
-    vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+    vec3 color = sampleMaterialTexture(materials[Material].diffuse, fs_in.TexCoords, materials[Material].baseColor).rgb;
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightColor = vec3(0.3);
     // ambient
@@ -69,7 +109,7 @@ void main()
     float diff = max(dot(lightDir, normal), 0.0);
     vec3 diffuse = diff * lightColor;
     // specular
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0.0;
     vec3 halfwayDir = normalize(lightDir + viewDir);  
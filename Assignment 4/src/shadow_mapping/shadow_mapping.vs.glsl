@@ -1,7 +1,8 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawId;
 
 out vec2 TexCoords;
 
@@ -11,17 +12,37 @@ out VS_OUT {
     vec2 TexCoords;
     vec4 FragPosLightSpace;
 } vs_out;
+flat out uint Material;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// per frame constants (see util/uniform_ring.h)
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 time;
+};
 uniform mat4 lightSpaceMatrix;
 
+// per draw data of the draw list (see util/draw_list.h)
+struct DrawData {
+    mat4 model;
+    uint lod;
+    uint material;
+    uint pad0;
+    uint pad1;
+};
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
 void main()
 {
+    mat4 model = draws[aDrawId].model;
+    Material = draws[aDrawId].material;
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
     vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
     vs_out.TexCoords = aTexCoords;
     vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -1,10 +1,23 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aDrawId;
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+
+// per draw data of the draw list (see util/draw_list.h)
+struct DrawData {
+    mat4 model;
+    uint lod;
+    uint material;
+    uint pad0;
+    uint pad1;
+};
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
 
 void main()
 {
+    mat4 model = draws[aDrawId].model;
     gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
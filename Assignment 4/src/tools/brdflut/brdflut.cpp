@@ -0,0 +1,165 @@
+// Generates the split sum BRDF LUT (the scale and bias of F0 over n.v and roughness, see src/ibl/brdf.fs) once, as a
+// header with a table of RG16F texels (util/brdf_lut_data.h) the demos upload at startup (util/brdf_lut.h). The LUT
+// depends on nothing of the scene.
+//
+//   brdflut <output.h> [size]   integrates the LUT (size x size texels, default 64) and writes the header
+//   brdflut --check             integrates the LUT at the size of the embedded one and compares the two
+//
+// Run it from the directory the demos run from: brdflut ../dependencies/include/util/brdf_lut_data.h
+// --check exits with 2 if a texel differs by more than the tolerance (a few half float steps).
+#include <util/parallel.h>
+#include <util/brdf_lut_table.h> // (no OpenGL)
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <chrono> // for timing
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRDFLUT_USE_SSE
+#include <emmintrin.h>
+#endif
+
+const unsigned int BRDF_SAMPLE_COUNT = 1024; // (of brdf.fs)
+const float PI = 3.14159265359f;
+const float TOLERANCE = 2e-3f;
+
+// brdf.fs: the split sum scale (x) and bias (y) over n.v (columns) and roughness (rows). The half vectors only depend on
+// the roughness, a row computes them once; the texels of the row then sum four samples at a time.
+std::vector<glm::vec2> integrateBRDF(int size)
+{
+    std::vector<glm::vec2> lut((size_t)size * size);
+    parallelFor((size_t)size, [&](size_t row) {
+        float roughness = (row + 0.5f) / size;
+        float a = roughness * roughness;
+        float k = (roughness * roughness) / 2.0f; // (the k of IBL)
+        // H in world space (N = z): with the tangent space of ImportanceSampleGGX for N = z, x is the sin(phi) part.
+        // V has no y, so only x and z of H matter.
+        std::vector<float> hx(BRDF_SAMPLE_COUNT), hz(BRDF_SAMPLE_COUNT);
+        for (unsigned int i = 0; i < BRDF_SAMPLE_COUNT; i++)
+        {
+            unsigned int bits = i;
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            glm::vec2 Xi((float)i / (float)BRDF_SAMPLE_COUNT, (float)bits * 2.3283064365386963e-10f);
+            float phi = 2.0f * PI * Xi.x;
+            float cosTheta = std::sqrt((1.0f - Xi.y) / (1.0f + (a * a - 1.0f) * Xi.y));
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            hx[i] = std::sin(phi) * sinTheta;
+            hz[i] = cosTheta;
+        }
+
+        for (int column = 0; column < size; column++)
+        {
+            float NdotV = (column + 0.5f) / size;
+            float vx = std::sqrt(1.0f - NdotV * NdotV);
+            float g1v = NdotV / (NdotV * (1.0f - k) + k);
+            float A = 0.0f, B = 0.0f;
+            unsigned int i = 0;
+#ifdef BRDFLUT_USE_SSE
+            __m128 sumA = _mm_setzero_ps(), sumB = _mm_setzero_ps();
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+            const __m128 VX = _mm_set1_ps(vx), VZ = _mm_set1_ps(NdotV), K = _mm_set1_ps(k), oneMinusK = _mm_set1_ps(1.0f - k);
+            const __m128 G1V = _mm_set1_ps(g1v);
+            for (; i + 4 <= BRDF_SAMPLE_COUNT; i += 4)
+            {
+                __m128 HX = _mm_loadu_ps(&hx[i]), HZ = _mm_loadu_ps(&hz[i]);
+                __m128 VdotH = _mm_max_ps(_mm_add_ps(_mm_mul_ps(VX, HX), _mm_mul_ps(VZ, HZ)), zero);
+                __m128 NdotL = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, VdotH), HZ), VZ); // (z of L = 2 (v.h) h - v)
+                __m128 mask = _mm_cmpgt_ps(NdotL, zero);
+                __m128 G = _mm_mul_ps(_mm_div_ps(NdotL, _mm_add_ps(_mm_mul_ps(NdotL, oneMinusK), K)), G1V);
+                __m128 G_Vis = _mm_div_ps(_mm_mul_ps(G, VdotH), _mm_mul_ps(HZ, VZ));
+                __m128 t = _mm_sub_ps(one, VdotH);
+                __m128 t2 = _mm_mul_ps(t, t);
+                __m128 Fc = _mm_mul_ps(_mm_mul_ps(t2, t2), t);
+                sumA = _mm_add_ps(sumA, _mm_and_ps(mask, _mm_mul_ps(_mm_sub_ps(one, Fc), G_Vis)));
+                sumB = _mm_add_ps(sumB, _mm_and_ps(mask, _mm_mul_ps(Fc, G_Vis)));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, sumA);
+            A = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            _mm_storeu_ps(lanes, sumB);
+            B = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+            for (; i < BRDF_SAMPLE_COUNT; i++)
+            {
+                float VdotH = std::max(vx * hx[i] + NdotV * hz[i], 0.0f);
+                float NdotL = 2.0f * VdotH * hz[i] - NdotV;
+                if (NdotL > 0.0f)
+                {
+                    float G = NdotL / (NdotL * (1.0f - k) + k) * g1v;
+                    float G_Vis = (G * VdotH) / (hz[i] * NdotV);
+                    float Fc = std::pow(1.0f - VdotH, 5.0f);
+                    A += (1.0f - Fc) * G_Vis;
+                    B += Fc * G_Vis;
+                }
+            }
+            lut[row * size + column] = glm::vec2(A, B) / (float)BRDF_SAMPLE_COUNT;
+        }
+    });
+    return lut;
+}
+
+bool writeHeader(const std::string& path, const std::vector<glm::vec2>& lut, int size)
+{
+    std::ofstream out(path, std::ios::trunc);
+    out << "// generated by src/tools/brdflut (brdflut <this file> " << size << "), don't edit\n";
+    out << "#ifndef BRDF_LUT_DATA_H\n#define BRDF_LUT_DATA_H\n\n#include <cstdint>\n\n";
+    out << "// the split sum BRDF LUT of src/ibl/brdf.fs: RG16F texels (scale and bias of F0), columns n.v, rows roughness\n";
+    out << "const int BRDF_LUT_SIZE = " << size << ";\n";
+    out << "const uint16_t BRDF_LUT_DATA[" << size << " * " << size << " * 2] = {\n";
+    char value[8];
+    for (size_t i = 0; i < lut.size(); i++)
+    {
+        snprintf(value, sizeof(value), "0x%04x", glm::packHalf1x16(lut[i].x));
+        out << (i % 8 == 0 ? "    " : " ") << value << ",";
+        snprintf(value, sizeof(value), "0x%04x", glm::packHalf1x16(lut[i].y));
+        out << " " << value << (i % 8 == 7 || i + 1 == lut.size() ? ",\n" : ",");
+    }
+    out << "};\n\n#endif\n";
+    if (!out)
+    {
+        std::cout << "Can't write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: brdflut <output.h> [size] | brdflut --check" << std::endl;
+        return 1;
+    }
+    bool check = std::string(argv[1]) == "--check";
+    int size = check ? BRDF_LUT_SIZE : (argc > 2 ? std::max(2, std::atoi(argv[2])) : 64);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<glm::vec2> lut = integrateBRDF(size);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << size << " x " << size << " integrated in " << std::fixed << std::setprecision(1) << ms << " ms" << std::endl;
+    if (!check)
+        return writeHeader(argv[1], lut, size) ? 0 : 1;
+
+    // the embedded LUT against the integrated one
+    float maxError = 0.0f;
+    for (size_t i = 0; i < lut.size(); i++)
+    {
+        glm::vec2 difference = glm::abs(brdfLUTTexel(i) - lut[i]);
+        maxError = std::max(maxError, std::max(difference.x, difference.y));
+    }
+    std::cout << "embedded LUT: max error " << std::setprecision(5) << maxError << (maxError <= TOLERANCE ? " (ok)" : " (TOO LARGE)") << std::endl;
+    return maxError <= TOLERANCE ? 0 : 2;
+}
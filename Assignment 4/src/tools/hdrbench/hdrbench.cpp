@@ -0,0 +1,241 @@
+// Compares loading a Radiance HDR image with stbi_loadf (plus the float to half conversion of the RGB16F upload, which
+// the driver would do) with the parallel RGB9_E5 decoder of util/hdr_loader.h.
+//
+//   hdrbench <file.hdr> [runs] [--stb | --fast]
+//   hdrbench --generate <width> <file.hdr>
+//
+// Prints the best and average time of both, the memory they need at their peak (file, output and temporary buffers)
+// and the largest difference between the two (relative to the brightest channel of the texel). With --stb or --fast
+// only one of them runs, the peak resident size of the process (Linux) then is the one of that loader.
+// --generate writes a run length encoded test map of width x width / 2 texels (sky gradient, clouds and a sun), for
+// 4k and 8k maps: hdrbench --generate 8192 sky8k.hdr
+#include <stb_image.h>
+
+#include <util/filesystem.h>
+#include <util/hdr_decode.h> // (no OpenGL)
+
+// (the demos get the implementation from util/assets.h)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <chrono> // for timing
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+struct Result {
+    double bestMs = 1e30, averageMs = 0.0;
+    size_t peakBytes = 0;
+};
+
+void print(const char* name, const Result& r)
+{
+    std::cout << std::left << std::setw(6) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << r.bestMs << " ms best" << std::setw(10) << r.averageMs << " ms avg"
+              << std::setw(10) << r.peakBytes / (1024.0 * 1024.0) << " MB peak" << std::endl;
+}
+
+// an RGB9_E5 texel as floats
+glm::vec3 unpackRgb9e5(uint32_t texel)
+{
+    float scale = std::ldexp(1.0f, (int)(texel >> 27) - 24);
+    return glm::vec3(texel & 511, (texel >> 9) & 511, (texel >> 18) & 511) * scale;
+}
+
+// the RGBE texel of a color (like Radiance's float2rgbe)
+void toRgbe(const glm::vec3& color, unsigned char* rgbe)
+{
+    float v = std::max(color.r, std::max(color.g, color.b));
+    if (v < 1e-32f)
+    {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+    }
+    int e;
+    float m = std::frexp(v, &e) * 256.0f / v;
+    rgbe[0] = (unsigned char)(color.r * m);
+    rgbe[1] = (unsigned char)(color.g * m);
+    rgbe[2] = (unsigned char)(color.b * m);
+    rgbe[3] = (unsigned char)(e + 128);
+}
+
+// writes an RLE scanline channel: runs of 4 or more equal values, literals of up to 128 values otherwise
+void writeRleChannel(std::vector<unsigned char>& out, const unsigned char* values, int width)
+{
+    int x = 0;
+    while (x < width)
+    {
+        int run = 1;
+        while (x + run < width && run < 127 && values[x + run] == values[x]) run++;
+        if (run >= 4)
+        {
+            out.push_back((unsigned char)(128 + run));
+            out.push_back(values[x]);
+            x += run;
+            continue;
+        }
+        // literal up to the next run of 4
+        int start = x, count = 0;
+        while (x < width && count < 128)
+        {
+            if (x + 3 < width && values[x] == values[x + 1] && values[x] == values[x + 2] && values[x] == values[x + 3])
+                break;
+            x++;
+            count++;
+        }
+        out.push_back((unsigned char)count);
+        out.insert(out.end(), values + start, values + start + count);
+    }
+}
+
+bool generate(int width, const std::string& path)
+{
+    int height = width / 2;
+    std::vector<unsigned char> data;
+    std::string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(height) + " +X " + std::to_string(width) + "\n";
+    data.insert(data.end(), header.begin(), header.end());
+    std::vector<unsigned char> planes((size_t)width * 4);
+    const glm::vec3 sun = glm::normalize(glm::vec3(0.3f, 0.6f, 0.5f));
+    for (int y = 0; y < height; y++)
+    {
+        float theta = 3.14159265f * (y + 0.5f) / height; // (0 at the top)
+        for (int x = 0; x < width; x++)
+        {
+            float phi = 6.28318531f * (x + 0.5f) / width;
+            glm::vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            glm::vec3 color = d.y > 0.0f ? glm::mix(glm::vec3(0.9f, 0.95f, 1.0f), glm::vec3(0.2f, 0.4f, 0.9f), d.y)
+                                         : glm::vec3(0.25f, 0.22f, 0.2f) * (1.0f + 0.1f * std::sin(40.0f * phi));
+            float clouds = std::sin(13.0f * phi) * std::sin(7.0f * theta + 3.0f * phi);
+            if (d.y > 0.0f && clouds > 0.6f) color = glm::vec3(1.5f);
+            if (glm::dot(d, sun) > 0.9995f) color = glm::vec3(20000.0f, 18000.0f, 15000.0f);
+            unsigned char rgbe[4];
+            toRgbe(color, rgbe);
+            for (int c = 0; c < 4; c++)
+                planes[(size_t)c * width + x] = rgbe[c];
+        }
+        data.push_back(2);
+        data.push_back(2);
+        data.push_back((unsigned char)(width >> 8));
+        data.push_back((unsigned char)(width & 255));
+        for (int c = 0; c < 4; c++)
+            writeRleChannel(data, planes.data() + (size_t)c * width, width);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write((const char*)data.data(), data.size()))
+    {
+        std::cout << "Can't write " << path << std::endl;
+        return false;
+    }
+    std::cout << "wrote " << path << " (" << width << " x " << height << ", " << data.size() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 4 && std::string(argv[1]) == "--generate")
+        return generate(std::max(8, std::atoi(argv[2])), argv[3]) ? 0 : 1;
+    if (argc < 2)
+    {
+        std::cout << "usage: hdrbench <file.hdr> [runs] [--stb | --fast] | hdrbench --generate <width> <file.hdr>" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    int runs = 5;
+    bool runStb = true, runFast = true;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--stb") runFast = false;
+        else if (option == "--fast") runStb = false;
+        else runs = std::max(1, std::atoi(argv[i]));
+    }
+
+    FileData file;
+    if (!FileSystem::read(path, file))
+    {
+        std::cout << "Can't read " << path << std::endl;
+        return 1;
+    }
+
+    Result stb, fast;
+    std::vector<float> reference; // (of the last stb run)
+    HdrImage image;
+    int width = 0, height = 0;
+    for (int run = 0; run < runs; run++)
+    {
+        if (runStb)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            stbi_set_flip_vertically_on_load(true);
+            int components;
+            float* data = stbi_loadf_from_memory(file.data, (int)file.size, &width, &height, &components, 3);
+            if (!data)
+            {
+                std::cout << "stb_image can't load " << path << std::endl;
+                return 1;
+            }
+            std::vector<uint16_t> halfs((size_t)width * height * 3); // (what the RGB16F upload of the floats does)
+            for (size_t i = 0; i < halfs.size(); i++)
+                halfs[i] = glm::packHalf1x16(data[i]);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            stb.bestMs = std::min(stb.bestMs, ms);
+            stb.averageMs += ms / runs;
+            // file, floats, halfs and the scanline
+            stb.peakBytes = file.size + (size_t)width * height * (12 + 6) + (size_t)width * 4;
+            if (run == runs - 1)
+                reference.assign(data, data + (size_t)width * height * 3);
+            stbi_image_free(data);
+        }
+        if (runFast)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (!decodeHdr(file.data, file.size, image))
+            {
+                std::cout << "decodeHdr can't load " << path << " (stbi_loadf is used then)" << std::endl;
+                return 1;
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            fast.bestMs = std::min(fast.bestMs, ms);
+            fast.averageMs += ms / runs;
+            // file, texels, the scanline offsets and a scanline per thread
+            fast.peakBytes = file.size + image.texels.size() * 4 + (size_t)image.height * sizeof(size_t) +
+                             (size_t)workerCount() * image.width * 4;
+            width = image.width;
+            height = image.height;
+        }
+    }
+
+    std::cout << path << " (" << width << " x " << height << "), " << runs << " runs, " << workerCount() << " threads" << std::endl;
+    if (runStb) print("stb", stb);
+    if (runFast) print("fast", fast);
+    if (runStb && runFast)
+    {
+        std::cout << "speedup " << std::setprecision(2) << stb.bestMs / fast.bestMs << "x, memory "
+                  << (double)stb.peakBytes / fast.peakBytes << "x less" << std::endl;
+        float maxError = 0.0f;
+        for (size_t i = 0; i < image.texels.size(); i++)
+        {
+            glm::vec3 expected(reference[3 * i], reference[3 * i + 1], reference[3 * i + 2]);
+            float brightest = std::max(expected.r, std::max(expected.g, expected.b));
+            if (brightest > 0.0f && brightest < 65000.0f) // (RGB9_E5 saturates above)
+                maxError = std::max(maxError, glm::length(unpackRgb9e5(image.texels[i]) - expected) / brightest);
+        }
+        std::cout << "max difference " << std::setprecision(4) << maxError * 100.0f << "% of the texel" << std::endl;
+    }
+#ifdef __linux__
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::cout << "process peak resident size " << std::setprecision(1) << usage.ru_maxrss / 1024.0 << " MB" << std::endl;
+#endif
+    return 0;
+}
@@ -0,0 +1,435 @@
+// Bakes the maps of image based lighting on the CPU, for machines without a GPU: the environment cube map (from the
+// equirectangular HDR image), the irradiance map and the GGX prefiltered mip chain, the same maps src/ibl/ibl.cpp bakes
+// with its shaders (the split sum BRDF LUT is the embedded one of util/brdf_lut.h). They are written as the IBL cache
+// (see util/ibl_cache.h) with the key the demo computes, so the demo loads them instead of baking.
+//
+//   iblbake <environment.hdr> <output.ibl> [--shaders <dir>] [--runs <n>] [--reference <gpu.ibl>]
+//
+//   --shaders    directory of the bake shaders of the demo, part of the cache key (default ../src/ibl)
+//   --runs       bakes n times and prints the best and average time of each step (default 1)
+//   --reference  compares the maps with a cache the demo baked on the GPU (relative root mean square error per map)
+//
+// Run it from the directory the demos run from, e.g.
+//   iblbake ../resources/textures/hdr/newport_loft.hdr ../resources/cache/newport_loft.ibl
+// The work is split into tiles of 16 x 16 texels over all cores, the sampling loops use SSE where available.
+#include <stb_image.h>
+
+// (no OpenGL: only the CPU parts of the shared headers, the baker runs without a GPU and doesn't link glad)
+#include <util/filesystem.h>
+#include <util/parallel.h>
+#include <util/ibl_cache_image.h>
+#include <util/prefilter_samples.h> // (prefilterSamples, the sample schedule of the compute prefilter)
+#include <util/sh_math.h>           // (CUBE_FACE_AXES)
+#include <util/brdf_lut_table.h>
+
+// (the demos get the implementation from util/assets.h)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono> // for timing
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IBLBAKE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// the sizes of src/ibl/ibl.cpp (they are part of the cache key)
+const int ENVIRONMENT_SIZE = 512;
+const int IRRADIANCE_SIZE = 32;
+const int PREFILTER_SIZE = 128;
+const int PREFILTER_LEVELS = 5;
+const float PI = 3.14159265359f;
+const int TILE = 16;
+
+// a cube map on the CPU: per level the six faces one after the other, a texel is RGB (and an unused w, for SSE)
+struct CubeMap {
+    int size = 0;
+    std::vector<std::vector<glm::vec4>> levels;
+
+    int Size(int level) const { return std::max(1, size >> level); }
+    glm::vec4* Face(int level, int face) { return levels[level].data() + (size_t)face * Size(level) * Size(level); }
+    const glm::vec4* Face(int level, int face) const { return levels[level].data() + (size_t)face * Size(level) * Size(level); }
+    void Allocate(int faceSize, int levelCount)
+    {
+        size = faceSize;
+        levels.resize(levelCount);
+        for (int level = 0; level < levelCount; level++)
+            levels[level].assign((size_t)6 * Size(level) * Size(level), glm::vec4(0.0f));
+    }
+};
+
+// calls f(face, x, y) for every texel of faces images of size x size texels, a tile of TILE x TILE texels per task
+template <class F>
+void forEachTexel(int faces, int size, F f)
+{
+    int tiles = (size + TILE - 1) / TILE;
+    parallelFor((size_t)faces * tiles * tiles, [&](size_t task) {
+        int face = (int)(task / ((size_t)tiles * tiles));
+        int tile = (int)(task % ((size_t)tiles * tiles));
+        int x0 = (tile % tiles) * TILE, y0 = (tile / tiles) * TILE;
+        for (int y = y0; y < std::min(y0 + TILE, size); y++)
+            for (int x = x0; x < std::min(x0 + TILE, size); x++)
+                f(face, x, y);
+    });
+}
+
+// bilinear lookup (clamped to the edges) at s, t in [0, 1], like GL_LINEAR with GL_CLAMP_TO_EDGE
+inline glm::vec4 bilinear(const glm::vec4* texels, int width, int height, float s, float t)
+{
+    float x = glm::clamp(s * width - 0.5f, 0.0f, (float)(width - 1));
+    float y = glm::clamp(t * height - 0.5f, 0.0f, (float)(height - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+    float fx = x - x0, fy = y - y0;
+    const glm::vec4& a = texels[(size_t)y0 * width + x0];
+    const glm::vec4& b = texels[(size_t)y0 * width + x1];
+    const glm::vec4& c = texels[(size_t)y1 * width + x0];
+    const glm::vec4& d = texels[(size_t)y1 * width + x1];
+#ifdef IBLBAKE_USE_SSE
+    __m128 ta = _mm_loadu_ps(&a.x), tb = _mm_loadu_ps(&b.x), tc = _mm_loadu_ps(&c.x), td = _mm_loadu_ps(&d.x);
+    __m128 wx = _mm_set1_ps(fx);
+    __m128 top = _mm_add_ps(ta, _mm_mul_ps(_mm_sub_ps(tb, ta), wx));
+    __m128 bottom = _mm_add_ps(tc, _mm_mul_ps(_mm_sub_ps(td, tc), wx));
+    glm::vec4 result;
+    _mm_storeu_ps(&result.x, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(fy))));
+    return result;
+#else
+    return glm::mix(glm::mix(a, b, fx), glm::mix(c, d, fx), fy);
+#endif
+}
+
+// the face of direction d and the texture coordinates in it (the table of the GL specification, see CUBE_FACE_AXES)
+inline void cubeFace(const glm::vec3& d, int& face, float& s, float& t)
+{
+    glm::vec3 a = glm::abs(d);
+    float sc, tc, ma;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0f ? 0 : 1;
+        sc = d.x > 0.0f ? -d.z : d.z;
+        tc = -d.y;
+        ma = a.x;
+    }
+    else if (a.y >= a.z)
+    {
+        face = d.y > 0.0f ? 2 : 3;
+        sc = d.x;
+        tc = d.y > 0.0f ? d.z : -d.z;
+        ma = a.y;
+    }
+    else
+    {
+        face = d.z > 0.0f ? 4 : 5;
+        sc = d.z > 0.0f ? d.x : -d.x;
+        tc = -d.y;
+        ma = a.z;
+    }
+    if (ma <= 0.0f)
+        ma = 1.0f; // (a zero direction, any texel will do)
+    s = 0.5f * (sc / ma + 1.0f);
+    t = 0.5f * (tc / ma + 1.0f);
+}
+
+// trilinear lookup of the cube map in direction d, like textureLod (but not seamless across the faces)
+glm::vec4 sampleCube(const CubeMap& cube, const glm::vec3& d, float lod)
+{
+    int face;
+    float s, t;
+    cubeFace(d, face, s, t);
+    lod = glm::clamp(lod, 0.0f, (float)(cube.levels.size() - 1));
+    int level = (int)lod;
+    float f = lod - level;
+    glm::vec4 color = bilinear(cube.Face(level, face), cube.Size(level), cube.Size(level), s, t);
+    if (f > 0.0f)
+        color = glm::mix(color, bilinear(cube.Face(level + 1, face), cube.Size(level + 1), cube.Size(level + 1), s, t), f);
+    return color;
+}
+
+// direction through the center of a texel of a face
+inline glm::vec3 texelDirection(int face, int x, int y, int size)
+{
+    float u = (x + 0.5f) / size * 2.0f - 1.0f;
+    float v = (y + 0.5f) / size * 2.0f - 1.0f;
+    return glm::normalize(CUBE_FACE_AXES[face][0] + u * CUBE_FACE_AXES[face][1] + v * CUBE_FACE_AXES[face][2]);
+}
+
+// equirectangular_to_cubemap.fs, then the mip chain (2 x 2 box filter like glGenerateMipmap)
+CubeMap equirectangularToCubemap(const std::vector<glm::vec4>& hdr, int width, int height, int size)
+{
+    CubeMap cube;
+    int levels = 1;
+    while (size >> levels) levels++;
+    cube.Allocate(size, levels);
+    forEachTexel(6, size, [&](int face, int x, int y) {
+        glm::vec3 v = texelDirection(face, x, y, size);
+        glm::vec2 uv = glm::vec2(std::atan2(v.z, v.x), std::asin(v.y)) * glm::vec2(0.1591f, 0.3183f) + 0.5f;
+        cube.Face(0, face)[(size_t)y * size + x] = bilinear(hdr.data(), width, height, uv.x, uv.y);
+    });
+    for (int level = 1; level < levels; level++)
+    {
+        int levelSize = cube.Size(level), parentSize = cube.Size(level - 1);
+        forEachTexel(6, levelSize, [&](int face, int x, int y) {
+            const glm::vec4* parent = cube.Face(level - 1, face);
+            int x0 = std::min(2 * x, parentSize - 1), x1 = std::min(2 * x + 1, parentSize - 1);
+            int y0 = std::min(2 * y, parentSize - 1), y1 = std::min(2 * y + 1, parentSize - 1);
+            cube.Face(level, face)[(size_t)y * levelSize + x] = 0.25f * (parent[(size_t)y0 * parentSize + x0] + parent[(size_t)y0 * parentSize + x1] +
+                                                                         parent[(size_t)y1 * parentSize + x0] + parent[(size_t)y1 * parentSize + x1]);
+        });
+    }
+    return cube;
+}
+
+// irradiance_convolution.fs: a Riemann sum over the hemisphere, steps of 0.025 in phi and theta. The steps are the same
+// for every texel, they are computed once. The shader samples with texture(), its level follows from how much the
+// directions change from pixel to pixel: about the level with as many texels as the irradiance map, that one is used.
+CubeMap convolveIrradiance(const CubeMap& environment, int size)
+{
+    std::vector<glm::vec4> steps; // xyz direction in tangent space, w weight (cos(theta) sin(theta))
+    const float sampleDelta = 0.025f;
+    for (float phi = 0.0f; phi < 2.0f * PI; phi += sampleDelta)
+        for (float theta = 0.0f; theta < 0.5f * PI; theta += sampleDelta)
+            steps.push_back(glm::vec4(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta),
+                                      std::cos(theta) * std::sin(theta)));
+
+    float level = std::max(0.0f, std::log2((float)environment.size / size));
+    CubeMap cube;
+    cube.Allocate(size, 1);
+    forEachTexel(6, size, [&](int face, int x, int y) {
+        glm::vec3 N = texelDirection(face, x, y, size);
+        // (the tangent space of the shader, right and up aren't normalized there either)
+        glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 right = glm::cross(up, N);
+        up = glm::cross(N, right);
+#ifdef IBLBAKE_USE_SSE
+        __m128 irradiance = _mm_setzero_ps();
+        for (const glm::vec4& step : steps)
+        {
+            glm::vec4 color = sampleCube(environment, step.x * right + step.y * up + step.z * N, level);
+            irradiance = _mm_add_ps(irradiance, _mm_mul_ps(_mm_loadu_ps(&color.x), _mm_set1_ps(step.w)));
+        }
+        glm::vec4 sum;
+        _mm_storeu_ps(&sum.x, irradiance);
+#else
+        glm::vec4 sum(0.0f);
+        for (const glm::vec4& step : steps)
+            sum += sampleCube(environment, step.x * right + step.y * up + step.z * N, level) * step.w;
+#endif
+        cube.Face(0, face)[(size_t)y * size + x] = PI * sum * (1.0f / (float)steps.size());
+    });
+    return cube;
+}
+
+// the compute prefilter (src/ibl/prefilter.comp) with the same samples (see util/ibl_prefilter.h)
+CubeMap prefilterEnvironment(const CubeMap& environment, int size, int levels)
+{
+    CubeMap cube;
+    cube.Allocate(size, levels);
+    for (int level = 0; level < levels; level++)
+    {
+        float roughness = levels > 1 ? (float)level / (float)(levels - 1) : 0.0f;
+        std::vector<glm::vec4> samples = prefilterSamples(roughness, prefilterSampleCount(roughness), environment.size);
+        int levelSize = cube.Size(level);
+        forEachTexel(6, levelSize, [&](int face, int x, int y) {
+            glm::vec3 N = texelDirection(face, x, y, levelSize);
+            glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+            glm::vec3 bitangent = glm::cross(N, tangent);
+#ifdef IBLBAKE_USE_SSE
+            __m128 prefiltered = _mm_setzero_ps();
+            float totalWeight = 0.0f;
+            for (const glm::vec4& s : samples)
+            {
+                glm::vec4 color = sampleCube(environment, tangent * s.x + bitangent * s.y + N * s.z, s.w);
+                prefiltered = _mm_add_ps(prefiltered, _mm_mul_ps(_mm_loadu_ps(&color.x), _mm_set1_ps(s.z)));
+                totalWeight += s.z;
+            }
+            glm::vec4 sum;
+            _mm_storeu_ps(&sum.x, prefiltered);
+#else
+            glm::vec4 sum(0.0f);
+            float totalWeight = 0.0f;
+            for (const glm::vec4& s : samples)
+            {
+                sum += sampleCube(environment, tangent * s.x + bitangent * s.y + N * s.z, s.w) * s.z;
+                totalWeight += s.z;
+            }
+#endif
+            cube.Face(level, face)[(size_t)y * levelSize + x] = sum / totalWeight;
+        });
+    }
+    return cube;
+}
+
+IblCacheImage cacheImage(const CubeMap& cube)
+{
+    IblCacheImage image;
+    image.target = IBL_TEXTURE_CUBE_MAP;
+    image.format = IBL_R11G11B10F;
+    image.width = image.height = cube.size;
+    image.levels = (int)cube.levels.size();
+    for (const std::vector<glm::vec4>& level : cube.levels)
+        for (const glm::vec4& texel : level)
+            image.texels.push_back(IblCacheImage::Pack(IBL_R11G11B10F, glm::vec3(texel)));
+    return image;
+}
+
+// the embedded BRDF LUT (already half floats)
+IblCacheImage brdfLUTImage()
+{
+    IblCacheImage image;
+    image.target = IBL_TEXTURE_2D;
+    image.format = IBL_RG16F;
+    image.width = image.height = BRDF_LUT_SIZE;
+    image.levels = 1;
+    for (size_t i = 0; i < (size_t)BRDF_LUT_SIZE * BRDF_LUT_SIZE; i++)
+        image.texels.push_back((uint32_t)BRDF_LUT_DATA[2 * i] | ((uint32_t)BRDF_LUT_DATA[2 * i + 1] << 16));
+    return image;
+}
+
+// root mean square error of a level of a (per channel) relative to the mean of b, -1 if the maps differ in size
+float relativeRmse(const IblCacheImage& a, const IblCacheImage& b, int level)
+{
+    if (a.target != b.target || a.width != b.width || a.height != b.height || level >= a.levels || level >= b.levels)
+        return -1.0f;
+    size_t first = a.Offset(level, 0), count = (size_t)a.Width(level) * a.Height(level) * a.Faces();
+    int channels = a.format == IBL_RG16F ? 2 : 3;
+    double squares = 0.0, mean = 0.0;
+    for (size_t i = first; i < first + count; i++)
+    {
+        glm::vec3 d = a.Texel(i) - b.Texel(i), r = b.Texel(i);
+        for (int c = 0; c < channels; c++)
+        {
+            squares += (double)d[c] * d[c];
+            mean += r[c];
+        }
+    }
+    size_t n = count * channels;
+    return mean > 0.0 ? (float)(std::sqrt(squares / n) / (mean / n)) : 0.0f;
+}
+
+struct Timing {
+    const char* name;
+    double bestMs = 1e30, averageMs = 0.0;
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: iblbake <environment.hdr> <output.ibl> [--shaders <dir>] [--runs <n>] [--reference <gpu.ibl>]" << std::endl;
+        return 1;
+    }
+    std::string hdrPath = argv[1], outputPath = argv[2], shaderDirectory = "../src/ibl", referencePath;
+    int runs = 1;
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (option == "--shaders") shaderDirectory = argv[i + 1];
+        else if (option == "--runs") runs = std::max(1, std::atoi(argv[i + 1]));
+        else if (option == "--reference") referencePath = argv[i + 1];
+        else std::cout << "unknown option " << option << std::endl;
+    }
+
+    // the key of the demo (see src/ibl/ibl.cpp, keep the two in sync): the HDR file, the bake shaders, the BRDF LUT and
+    // the parameters
+    FileData hdrFile;
+    if (!FileSystem::read(hdrPath, hdrFile))
+    {
+        std::cout << "Failed to read HDR image " << hdrPath << std::endl;
+        return 1;
+    }
+    const char* bakeShaderNames[] = { "cubemap.vs", "equirectangular_to_cubemap.fs", "irradiance_convolution.fs", "prefilter.comp" };
+    std::vector<std::string> bakeShaders(4);
+    for (size_t i = 0; i < bakeShaders.size(); i++)
+        if (!FileSystem::readText(shaderDirectory + "/" + bakeShaderNames[i], bakeShaders[i]))
+            std::cout << "Can't read the bake shader " << bakeShaderNames[i] << ", the demo won't accept the cache" << std::endl;
+    std::string_view brdfLUTData((const char*)BRDF_LUT_DATA, sizeof(BRDF_LUT_DATA));
+    uint64_t key = iblCacheKey({ hdrFile.Text(), bakeShaders[0], bakeShaders[1], bakeShaders[2], bakeShaders[3], brdfLUTData },
+                               { ENVIRONMENT_SIZE, IRRADIANCE_SIZE, PREFILTER_SIZE, PREFILTER_LEVELS,
+                                 (int)prefilterTotalSamples(PREFILTER_LEVELS), BRDF_LUT_SIZE });
+
+    // the HDR image as RGB(A) floats, flipped like the demo loads it
+    stbi_set_flip_vertically_on_load(true);
+    int width, height, nrComponents;
+    float* data = stbi_loadf_from_memory(hdrFile.data, (int)hdrFile.size, &width, &height, &nrComponents, 3);
+    if (!data)
+    {
+        std::cout << "Failed to load HDR image." << std::endl;
+        return 1;
+    }
+    std::vector<glm::vec4> hdr((size_t)width * height);
+    for (size_t i = 0; i < hdr.size(); i++)
+        hdr[i] = glm::vec4(data[3 * i], data[3 * i + 1], data[3 * i + 2], 0.0f);
+    stbi_image_free(data);
+
+#ifdef IBLBAKE_USE_SSE
+    const char* simd = "SSE";
+#else
+    const char* simd = "scalar";
+#endif
+    std::cout << hdrPath << " (" << width << " x " << height << "), " << runs << " runs, " << workerCount() << " threads, " << simd << std::endl;
+
+    Timing timings[] = { { "cubemap" }, { "irradiance" }, { "prefilter" }, { "total" } };
+    auto time = [&](Timing& timing, const std::function<void()>& step) {
+        auto start = std::chrono::high_resolution_clock::now();
+        step();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        timing.bestMs = std::min(timing.bestMs, ms);
+        timing.averageMs += ms / runs;
+        return ms;
+    };
+    CubeMap environment, irradiance, prefilter;
+    for (int run = 0; run < runs; run++)
+    {
+        double total = time(timings[0], [&] { environment = equirectangularToCubemap(hdr, width, height, ENVIRONMENT_SIZE); });
+        total += time(timings[1], [&] { irradiance = convolveIrradiance(environment, IRRADIANCE_SIZE); });
+        total += time(timings[2], [&] { prefilter = prefilterEnvironment(environment, PREFILTER_SIZE, PREFILTER_LEVELS); });
+        timings[3].bestMs = std::min(timings[3].bestMs, total);
+        timings[3].averageMs += total / runs;
+    }
+    for (const Timing& t : timings)
+        std::cout << std::left << std::setw(12) << t.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << t.bestMs << " ms best" << std::setw(10) << t.averageMs << " ms avg" << std::endl;
+
+    IblCacheImage images[4] = { cacheImage(environment), cacheImage(irradiance), cacheImage(prefilter), brdfLUTImage() };
+    if (!saveIblCacheImages(outputPath, key, images))
+        return 1;
+    std::cout << "wrote " << outputPath << std::endl;
+
+    // compare with the maps the demo baked on the GPU
+    if (!referencePath.empty())
+    {
+        uint64_t referenceKey;
+        IblCacheImage reference[4];
+        if (!loadIblCacheImages(referencePath, referenceKey, reference))
+        {
+            std::cout << "Can't read the reference " << referencePath << std::endl;
+            return 1;
+        }
+        if (referenceKey != key)
+            std::cout << "(the reference was baked from other sources or parameters)" << std::endl;
+        const char* names[] = { "environment", "irradiance", "prefilter", "brdf lut" };
+        std::cout << std::setprecision(2);
+        for (int map = 0; map < 4; map++)
+        {
+            std::cout << std::left << std::setw(12) << names[map] << std::right << " relative rmse";
+            for (int level = 0; level < (map == 2 ? PREFILTER_LEVELS : 1); level++)
+            {
+                float error = relativeRmse(images[map], reference[map], level);
+                if (error < 0.0f)
+                    std::cout << " (the sizes differ)";
+                else
+                    std::cout << " " << error * 100.0f << "%";
+            }
+            std::cout << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Compares the OBJ loader (util/obj_loader.h) with the ASSIMP import of the same file.
+//
+//   objbench <file.obj> [runs] [--textures]
+//
+// Prints the best and average time of both over the runs, the vertex and triangle counts (ASSIMP keeps one vertex per
+// face corner, the OBJ loader deduplicates them) and the bounding boxes, which have to agree.
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <util/model.h>
+#include <util/obj_loader.h>
+
+// (the demos get the implementation from util/assets.h)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono> // for timing
+
+struct Result {
+    double bestMs = 1e30, averageMs = 0.0;
+    size_t meshes = 0, vertices = 0, triangles = 0;
+    glm::vec3 minP = glm::vec3(FLT_MAX), maxP = glm::vec3(-FLT_MAX);
+};
+
+Result measure(const std::function<ModelData()>& load, int runs)
+{
+    Result result;
+    for (int run = 0; run < runs; run++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        ModelData data = load();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        result.bestMs = std::min(result.bestMs, ms);
+        result.averageMs += ms / runs;
+
+        if (run == 0)
+        {
+            result.meshes = data.meshes.size();
+            for (const MeshData& mesh : data.meshes)
+            {
+                result.vertices += mesh.vertices.size();
+                result.triangles += mesh.indices.size() / 3;
+                for (const Vertex& v : mesh.vertices)
+                {
+                    result.minP = glm::min(result.minP, v.Position);
+                    result.maxP = glm::max(result.maxP, v.Position);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void print(const char* name, const Result& r)
+{
+    std::cout << std::left << std::setw(8) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << r.bestMs << " ms best" << std::setw(10) << r.averageMs << " ms avg"
+        << std::setw(6) << r.meshes << " meshes" << std::setw(10) << r.vertices << " vertices"
+        << std::setw(10) << r.triangles << " triangles" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: objbench <file.obj> [runs] [--textures]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    int runs = 5;
+    bool textures = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--textures") textures = true;
+        else runs = std::max(1, std::atoi(argv[i]));
+    }
+
+    std::cout << path << ", " << runs << " runs, " << workerCount() << " threads" << std::endl;
+    Result obj = measure([&] { ModelData data; loadObj(path, data, textures); return data; }, runs);
+    Result assimp = measure([&] { return Model::Import(path, textures); }, runs);
+    print("obj", obj);
+    print("assimp", assimp);
+    std::cout << "speedup " << std::setprecision(2) << assimp.bestMs / obj.bestMs << "x" << std::endl;
+
+    float tolerance = 1e-4f * std::max(1.0f, glm::length(assimp.maxP - assimp.minP));
+    bool boundsMatch = glm::all(glm::lessThanEqual(glm::abs(obj.minP - assimp.minP), glm::vec3(tolerance))) &&
+                       glm::all(glm::lessThanEqual(glm::abs(obj.maxP - assimp.maxP), glm::vec3(tolerance)));
+    bool trianglesMatch = obj.triangles == assimp.triangles;
+    std::cout << "bounds " << (boundsMatch ? "match" : "DIFFER") << ", triangles " << (trianglesMatch ? "match" : "DIFFER") << std::endl;
+    return boundsMatch && trianglesMatch ? 0 : 2;
+}
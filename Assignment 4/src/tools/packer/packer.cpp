@@ -0,0 +1,149 @@
+// Bundles the assets of a group into a single asset pack (see util/asset_pack.h) that is memory mapped at runtime.
+//
+//   packer <output.pack> [--lz4] [--textures] [--lods] [--meshlets] <files, directories or @lists>...
+//
+//   --lz4       compress the entries with LZ4 (an entry stays uncompressed if that doesn't save 1/8 of it)
+//   --textures  import the materials of the models (their textures are packed too)
+//   --lods      build the levels of detail of the models
+//   --meshlets  build the meshlets of the models
+//
+// Directories are packed recursively, @file reads one path per line. Models (by extension) are converted to the layout
+// of MeshData, everything else (textures, shaders, ...) is copied. Run it from the directory the demos run from and pass
+// the paths the demos use (e.g., ../resources/objects/helmet/helmet.obj), so the names match.
+// The model flags have to match how the demo loads the model (AssetManager::Add...), otherwise the levels of detail and
+// meshlets are rebuilt at load time.
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <util/asset_pack.h>
+#include <util/filesystem.h>
+#include <util/model.h>
+
+// (the demos get the implementation from util/assets.h)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <chrono> // for timing
+
+bool isModel(const std::string& path)
+{
+    static const char* extensions[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".blend", ".ply" };
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const char* e : extensions)
+        if (extension == e)
+            return true;
+    return false;
+}
+
+// adds path (a file, a directory or a @list) to the files to pack
+void collect(const std::string& path, std::vector<std::string>& files)
+{
+    if (!path.empty() && path[0] == '@')
+    {
+        std::ifstream list(path.substr(1));
+        if (!list)
+            std::cout << "Can't read the list " << path.substr(1) << std::endl;
+        std::string line;
+        while (std::getline(list, line))
+        {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#')
+                collect(line, files);
+        }
+    }
+    else if (std::filesystem::is_directory(path))
+    {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+            if (entry.is_regular_file())
+                files.push_back(entry.path().generic_string());
+    }
+    else
+        files.push_back(path);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: packer <output.pack> [--lz4] [--textures] [--lods] [--meshlets] <files, directories or @lists>..." << std::endl;
+        return 1;
+    }
+    bool compress = false, textures = false, lods = false, meshlets = false;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--lz4") compress = true;
+        else if (arg == "--textures") textures = true;
+        else if (arg == "--lods") lods = true;
+        else if (arg == "--meshlets") meshlets = true;
+        else collect(arg, files);
+    }
+
+    PackWriter pack;
+    if (!pack.Open(argv[1]))
+    {
+        std::cout << "Can't write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::set<std::string> packed; // (normalized names)
+    bool success = true;
+    for (size_t i = 0; i < files.size(); i++) // (files grows with the textures of the models)
+    {
+        const std::string path = files[i];
+        if (!packed.insert(normalizePackName(path)).second)
+            continue;
+
+        if (isModel(path))
+        {
+            ModelData data = Model::Load(path, textures, lods, meshlets);
+            if (data.meshes.empty())
+            {
+                std::cout << "Skipped " << path << " (no meshes)" << std::endl;
+                success = false;
+                continue;
+            }
+            for (const MaterialData& material : data.materials)
+                for (const std::string& texture : material.textures)
+                    if (!texture.empty())
+                        files.push_back(texture);
+
+            uint32_t flags = 0;
+            if (textures) flags |= MODEL_BLOB_TEXTURES;
+            if (lods) flags |= MODEL_BLOB_LODS;
+            if (meshlets) flags |= MODEL_BLOB_MESHLETS;
+            BlobWriter blob;
+            writeModelData(data, flags, blob);
+            success = pack.Add(path, blob.bytes.data(), blob.bytes.size(), PACK_MODEL, compress) && success;
+            std::cout << "model " << path << " (" << data.meshes.size() << " meshes, " << blob.bytes.size() << " bytes)" << std::endl;
+        }
+        else
+        {
+            FileData file;
+            if (!FileSystem::read(path, file))
+            {
+                std::cout << "Can't read " << path << std::endl;
+                success = false;
+                continue;
+            }
+            success = pack.Add(path, file.data, file.size, PACK_FILE, compress) && success;
+            std::cout << "file  " << path << " (" << file.size << " bytes)" << std::endl;
+        }
+    }
+    success = pack.Finish() && success;
+
+    float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << argv[1] << ": " << packed.size() << " entries, " << pack.bytesIn << " bytes -> " << pack.bytesOut
+        << " bytes stored (" << seconds << " s)" << std::endl;
+    return success ? 0 : 1;
+}